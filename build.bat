@@ -14,8 +14,8 @@ set REL=release\windows
 set OBJ=obj\windows
 set SRC=src
 
-set REL_DEP=%REL%\main.o %REL%\control.o %REL%\dfa.o %REL%\lexer.o %REL%\minimize.o %REL%\nfa.o %REL%\parser.o %REL%\set.o
-set DBG_DEP=%OBJ%\debug.o %OBJ%\control.o %OBJ%\dfa.o %OBJ%\lexer.o %OBJ%\minimize.o %OBJ%\nfa.o %OBJ%\parser.o %OBJ%\set.o
+set REL_DEP=%REL%\main.o %REL%\control.o %REL%\dfa.o %REL%\lexer.o %REL%\minimize.o %REL%\nfa.o %REL%\parser.o %REL%\set.o %REL%\simulate.o %REL%\budget.o %REL%\ast.o %REL%\glushkov.o %REL%\derivative.o %REL%\followpos.o %REL%\simplify.o %REL%\dictionary.o %REL%\bisimulation.o %REL%\charset.o %REL%\utf8.o %REL%\counter.o %REL%\search.o
+set DBG_DEP=%OBJ%\debug.o %OBJ%\control.o %OBJ%\dfa.o %OBJ%\lexer.o %OBJ%\minimize.o %OBJ%\nfa.o %OBJ%\parser.o %OBJ%\set.o %OBJ%\simulate.o %OBJ%\budget.o %OBJ%\ast.o %OBJ%\glushkov.o %OBJ%\derivative.o %OBJ%\followpos.o %OBJ%\simplify.o %OBJ%\dictionary.o %OBJ%\bisimulation.o %OBJ%\charset.o %OBJ%\utf8.o %OBJ%\counter.o %OBJ%\search.o
 
 :: release build
 gcc %CFLAGS% %REL_FLAGS% %SRC%\main.c -c -o %REL%\main.o
@@ -26,6 +26,19 @@ gcc %CFLAGS% %REL_FLAGS% %SRC%\minimize.c -c -o %REL%\minimize.o
 gcc %CFLAGS% %REL_FLAGS% %SRC%\nfa.c -c -o %REL%\nfa.o
 gcc %CFLAGS% %REL_FLAGS% %SRC%\parser.c -c -o %REL%\parser.o
 gcc %CFLAGS% %REL_FLAGS% %SRC%\set.c -c -o %REL%\set.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\simulate.c -c -o %REL%\simulate.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\budget.c -c -o %REL%\budget.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\ast.c -c -o %REL%\ast.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\glushkov.c -c -o %REL%\glushkov.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\derivative.c -c -o %REL%\derivative.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\followpos.c -c -o %REL%\followpos.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\simplify.c -c -o %REL%\simplify.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\dictionary.c -c -o %REL%\dictionary.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\bisimulation.c -c -o %REL%\bisimulation.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\charset.c -c -o %REL%\charset.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\utf8.c -c -o %REL%\utf8.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\counter.c -c -o %REL%\counter.o
+gcc %CFLAGS% %REL_FLAGS% %SRC%\search.c -c -o %REL%\search.o
 
 gcc %CFLAGS% %REL_FLAGS% %REL_DEP% -o tsuquo.exe
 
@@ -38,5 +51,18 @@ gcc %CFLAGS% %DBG_FLAGS% %SRC%\minimize.c -c -o %OBJ%\minimize.o
 gcc %CFLAGS% %DBG_FLAGS% %SRC%\nfa.c -c -o %OBJ%\nfa.o
 gcc %CFLAGS% %DBG_FLAGS% %SRC%\parser.c -c -o %OBJ%\parser.o
 gcc %CFLAGS% %DBG_FLAGS% %SRC%\set.c -c -o %OBJ%\set.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\simulate.c -c -o %OBJ%\simulate.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\budget.c -c -o %OBJ%\budget.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\ast.c -c -o %OBJ%\ast.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\glushkov.c -c -o %OBJ%\glushkov.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\derivative.c -c -o %OBJ%\derivative.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\followpos.c -c -o %OBJ%\followpos.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\simplify.c -c -o %OBJ%\simplify.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\dictionary.c -c -o %OBJ%\dictionary.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\bisimulation.c -c -o %OBJ%\bisimulation.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\charset.c -c -o %OBJ%\charset.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\utf8.c -c -o %OBJ%\utf8.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\counter.c -c -o %OBJ%\counter.o
+gcc %CFLAGS% %DBG_FLAGS% %SRC%\search.c -c -o %OBJ%\search.o
 
 gcc %CFLAGS% %DBG_FLAGS% %DBG_DEP% -o debug.exe
\ No newline at end of file
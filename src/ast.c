@@ -0,0 +1,663 @@
+/** ast.c
+
+Regex syntax trees. The parser builds one, then it gets lowered to whichever
+automaton construction we want.
+
+Nodes are bump allocated out of blocks owned by the AST, instead of one malloc()
+per node. Nothing is freed until the entire tree is destroyed, so a failed
+parse doesn't have to clean up its partial subtrees either.
+
+The parser builds chains of concatenations and alternations that are as deep as
+the regex is long, so nothing walks a tree by recursion, which would overflow
+the call stack on a long enough regex. Walks keep their own stack in a
+NodeList instead, or go over the nodes in the order of ast_postorder().
+
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "charset.h"
+#include "common.h"
+
+/* init_ast()
+	@return         ptr to dynamically allocated AST with no nodes, NULL if
+	                fail
+
+	Dynamically allocate an empty syntax tree and its arena.
+*/
+AST *init_ast(void)
+{
+	return calloc(1, sizeof(AST));
+}
+
+/* destroy_ast()
+	@ast            ptr to AST struct
+
+	Free an entire syntax tree, ie every block in its arena.
+*/
+void destroy_ast(AST *ast)
+{
+	if (!ast)
+		return;
+	ASTBlock *next;
+	for (ASTBlock *block = ast->blocks; block; block = next) {
+		next = block->next;
+		free(block);
+	}
+	free(ast);
+}
+
+/* ast_alloc()
+	@ast            ptr to AST struct
+	@size           number of bytes
+
+	@return         ptr to zeroed memory inside the arena, NULL if fail
+
+	Bump allocate memory that lives as long as the tree. A new block is only
+	malloc()'d when the newest one is full.
+*/
+void *ast_alloc(AST *ast, size_t size)
+{
+	// keep every allocation aligned for any type
+	size_t align = sizeof(max_align_t);
+	size = (size + align - 1) / align * align;
+
+	ASTBlock *block = ast->blocks;
+	if (!block || block->used + size > block->size) {
+		size_t capacity = size > AST_BLOCK_SIZE ? size : AST_BLOCK_SIZE;
+		block = malloc(sizeof(ASTBlock) + capacity);
+		if (!block)
+			return NULL;
+		block->used = 0;
+		block->size = capacity;
+		block->next = ast->blocks;
+		ast->blocks = block;
+		ast->num_blocks++;
+	}
+	void *mem = (U8 *)block->data + block->used;
+	block->used += size;
+	memset(mem, 0, size);
+	return mem;
+}
+
+/* init_ast_node()
+	@ast            ptr to AST struct
+	@kind           node kind, see ast.h
+	@left           left child
+	@right          right child
+
+	@return         ptr to ASTNode inside the arena, NULL if fail
+
+	Allocate a node with no other members set.
+*/
+static ASTNode *init_ast_node(AST *ast, int kind, ASTNode *left,
+                              ASTNode *right)
+{
+	ASTNode *node = ast_alloc(ast, sizeof(ASTNode));
+	if (!node)
+		return NULL;
+	node->kind = kind;
+	node->left = left;
+	node->right = right;
+	ast->num_nodes++;
+	return node;
+}
+
+/* ast_literal()
+	@ast            ptr to AST struct
+	@ch             the literal character
+
+	@return         ptr to new leaf, NULL if fail
+
+	Allocate a leaf that matches one character.
+*/
+ASTNode *ast_literal(AST *ast, U8 ch)
+{
+	ASTNode *node = init_ast_node(ast, AST_LITERAL, NULL, NULL);
+	if (!node)
+		return NULL;
+	node->ch = ch;
+	charset_add(&node->chars, ch);
+	return node;
+}
+
+/* ast_class()
+	@ast            ptr to AST struct
+	@chars          ptr to the chars in the class
+
+	@return         ptr to new leaf, NULL if fail
+
+	Allocate a leaf that matches any character in a set, eg a regex range
+	like [a-z0-9_].
+*/
+ASTNode *ast_class(AST *ast, const CharSet *chars)
+{
+	ASTNode *node = init_ast_node(ast, AST_CLASS, NULL, NULL);
+	if (!node)
+		return NULL;
+	node->chars = *chars;
+	return node;
+}
+
+/* ast_wildcard()
+	@ast            ptr to AST struct
+
+	@return         ptr to new leaf, NULL if fail
+
+	Allocate a leaf that matches every printable character, tab, and
+	newline.
+*/
+ASTNode *ast_wildcard(AST *ast)
+{
+	CharSet chars;
+	charset_wildcard(&chars);
+	return ast_class(ast, &chars);
+}
+
+/* ast_concat()
+	@ast            ptr to AST struct
+	@lhs            ptr to syntax tree
+	@rhs            ptr to another syntax tree
+
+	@return         ptr to new concatenation node, NULL if fail
+
+	Concatenate two syntax trees. If either is NULL, the other is returned
+	unchanged.
+*/
+ASTNode *ast_concat(AST *ast, ASTNode *lhs, ASTNode *rhs)
+{
+	if (!lhs)
+		return rhs;
+	if (!rhs)
+		return lhs;
+	return init_ast_node(ast, AST_CONCAT, lhs, rhs);
+}
+
+/* ast_alt()
+	@ast            ptr to AST struct
+	@lhs            ptr to syntax tree
+	@rhs            ptr to another syntax tree
+
+	@return         ptr to new alternation node, NULL if fail
+
+	Alternate two syntax trees. If either is NULL, the other is returned
+	unchanged.
+*/
+ASTNode *ast_alt(AST *ast, ASTNode *lhs, ASTNode *rhs)
+{
+	if (!lhs)
+		return rhs;
+	if (!rhs)
+		return lhs;
+	return init_ast_node(ast, AST_ALT, lhs, rhs);
+}
+
+/* ast_repeat()
+	@ast            ptr to AST struct
+	@node           ptr to syntax tree
+	@min            minimum number of repetitions
+	@max            maximum number of repetitions, or AST_UNBOUNDED
+
+	@return         ptr to new repeat node, NULL if fail
+
+	Repeat a syntax tree between @min and @max times.
+*/
+ASTNode *ast_repeat(AST *ast, ASTNode *node, int min, int max)
+{
+	if (!node)
+		return NULL;
+	ASTNode *r = init_ast_node(ast, AST_REPEAT, node, NULL);
+	if (!r)
+		return NULL;
+	r->min = min;
+	r->max = max;
+	return r;
+}
+
+/* ast_quantify()
+	@ast            ptr to AST struct
+	@node           ptr to syntax tree
+	@quantifier     regex quantifier character: *, ?, +
+
+	@return         ptr to new repeat node, NULL if fail or if the
+	                quantifier is invalid
+
+	Apply a quantifier to a syntax tree.
+*/
+ASTNode *ast_quantify(AST *ast, ASTNode *node, U8 quantifier)
+{
+	switch (quantifier) {
+	case '*': return ast_repeat(ast, node, 0, AST_UNBOUNDED);
+	case '?': return ast_repeat(ast, node, 0, 1);
+	case '+': return ast_repeat(ast, node, 1, AST_UNBOUNDED);
+	}
+	return NULL;
+}
+
+/* ast_clone()
+	@ast            ptr to AST struct
+	@node           ptr to syntax tree
+
+	@return         ptr to a deep copy of @node, NULL if fail
+
+	Copy every node of a syntax tree, so the copy has its own positions.
+	Children are copied before their parents, and the copies wait on a
+	stack until their parent is copied.
+*/
+ASTNode *ast_clone(AST *ast, ASTNode *node)
+{
+	NodeList order = {NULL, 0, 0};
+	NodeList copies = {NULL, 0, 0};
+	ASTNode *copy = NULL;
+	ASTNode *left, *right;
+	bool ok = ast_postorder(node, &order);
+	for (int i = 0; ok && i < order.size; i++) {
+		node = order.nodes[i];
+		right = node->right ? copies.nodes[--copies.size] : NULL;
+		left = node->left ? copies.nodes[--copies.size] : NULL;
+		copy = init_ast_node(ast, node->kind, left, right);
+		if (copy) {
+			copy->ch = node->ch;
+			copy->chars = node->chars;
+			copy->min = node->min;
+			copy->max = node->max;
+		}
+		ok = copy && push_node(&copies, copy);
+	}
+	free(order.nodes);
+	free(copies.nodes);
+	return ok ? copy : NULL;
+}
+
+/* ast_bounded_repeat()
+	@ast            ptr to AST struct
+	@node           ptr to syntax tree
+	@min            minimum number of repetitions
+	@max            maximum number of repetitions, at least 1 and @min, or
+	                AST_UNBOUNDED
+
+	@return         ptr to the expanded syntax tree, NULL if fail
+
+	Expand a counted repeat like x{2,5} into the quantifiers every
+	automaton construction understands: @min copies of x, then the optional
+	copies nested as x x (x(x(x)?)?)?. Nesting them means a copy can only
+	start once the one before it matched, so there's one way to stop early
+	instead of a choice at every copy like x x x?x?x?, which keeps the NFAs
+	and the subsets of the subset construction small. x{2,} is x x+.
+
+	@node itself becomes one of the copies, the others are clones.
+*/
+ASTNode *ast_bounded_repeat(AST *ast, ASTNode *node, int min, int max)
+{
+	if (!node)
+		return NULL;
+	ASTNode *tail = NULL;
+	ASTNode *head = NULL;
+	ASTNode *copy;
+	int copies = min;  // copies in front of the tail
+	if (max == AST_UNBOUNDED) {
+		if (!(tail = ast_repeat(ast, node, min > 0, AST_UNBOUNDED)))
+			return NULL;
+		if (min > 0)
+			copies--;
+	}
+	// build the optional copies from the innermost one out
+	for (int i = min; i < max; i++) {
+		copy = tail ? ast_clone(ast, node) : node;
+		if (copy && tail)
+			copy = ast_concat(ast, copy, tail);
+		if (!copy || !(tail = ast_repeat(ast, copy, 0, 1)))
+			return NULL;
+	}
+	for (int i = 0; i < copies; i++) {
+		copy = tail || head ? ast_clone(ast, node) : node;
+		if (!copy || !(head = ast_concat(ast, head, copy)))
+			return NULL;
+	}
+	return ast_concat(ast, head, tail);
+}
+
+/* ast_unanchor()
+	@ast            ptr to AST struct of a whole regex
+
+	@return         ptr to the new root, NULL if fail
+
+	Let a match start anywhere in the input instead of only at its start,
+	unless the regex began with ^. Every byte, newlines included, may come
+	before the match, so the root becomes [\x00-\xFF]*x. The DFA of that
+	tree reaches an accept state at the end of every match in one pass over
+	the input, instead of being run again from every offset, see search.c.
+*/
+ASTNode *ast_unanchor(AST *ast)
+{
+	if (ast->anchored_start)
+		return ast->root;
+	CharSet all = {{0}};
+	charset_add_range(&all, 0, 255);
+	ASTNode *prefix = ast_repeat(ast, ast_class(ast, &all), 0,
+	                             AST_UNBOUNDED);
+	if (!prefix)
+		return NULL;
+	ASTNode *root = ast_concat(ast, prefix, ast->root);
+	if (root)
+		ast->root = root;
+	return root;
+}
+
+/* push_node()
+	@list           ptr to NodeList struct
+	@node           ptr to syntax tree
+
+	@return         true if success, otherwise false
+
+	Append a syntax tree to a list, growing it if needed.
+*/
+bool push_node(NodeList *list, ASTNode *node)
+{
+	if (list->size == list->capacity) {
+		int capacity = list->capacity ? 2 * list->capacity : 8;
+		ASTNode **tmp = realloc(list->nodes,
+		                        capacity * sizeof(ASTNode *));
+		if (!tmp)
+			return false;
+		list->nodes = tmp;
+		list->capacity = capacity;
+	}
+	list->nodes[list->size++] = node;
+	return true;
+}
+
+/* ast_flatten()
+	@node           ptr to syntax tree
+	@kind           AST_CONCAT or AST_ALT
+	@list           ptr to NodeList struct which receives the operands
+
+	@return         true if success, otherwise false
+
+	Flatten nested nodes of one kind into a list of their operands, from
+	left to right, eg the factors of a concatenation no matter how it's
+	nested.
+*/
+bool ast_flatten(ASTNode *node, int kind, NodeList *list)
+{
+	NodeList stack = {NULL, 0, 0};
+	bool ok = push_node(&stack, node);
+	while (ok && stack.size > 0) {
+		node = stack.nodes[--stack.size];
+		if (node->kind != kind) {
+			ok = push_node(list, node);
+			continue;
+		}
+		// the right operand is popped last
+		ok = push_node(&stack, node->right) &&
+		     push_node(&stack, node->left);
+	}
+	free(stack.nodes);
+	return ok;
+}
+
+/* ast_postorder()
+	@root           ptr to root of a syntax tree
+	@order          ptr to empty NodeList struct which receives the nodes
+
+	@return         true if success, otherwise false
+
+	List every node of a syntax tree in postorder: each node comes after
+	its children, and a left subtree comes before the right one. That's the
+	order in which a recursive walk would finish the nodes, so a fold over
+	the list with a stack of results computes the same thing, and the
+	leaves are listed from left to right like positions are numbered.
+*/
+bool ast_postorder(ASTNode *root, NodeList *order)
+{
+	NodeList stack = {NULL, 0, 0};
+	int start = order->size;
+	bool ok = push_node(&stack, root);
+	ASTNode *node;
+	while (ok && stack.size > 0) {
+		node = stack.nodes[--stack.size];
+		ok = push_node(order, node) &&
+		     (!node->left || push_node(&stack, node->left)) &&
+		     (!node->right || push_node(&stack, node->right));
+	}
+	free(stack.nodes);
+
+	// that listed each node, then its right subtree, then its left one
+	ASTNode *tmp;
+	for (int i = start, j = order->size - 1; i < j; i++, j--) {
+		tmp = order->nodes[i];
+		order->nodes[i] = order->nodes[j];
+		order->nodes[j] = tmp;
+	}
+	return ok;
+}
+
+/* ast_is_counter()
+	@node           ptr to syntax tree node
+
+	@return         true if @node repeats one char with counts that aren't
+	                *, ?, or +, like [a-z]{3,8}
+
+	The parser only leaves these in the tree when it's told to keep counts,
+	see counter.c. Everywhere else, counted repeats are already expanded by
+	ast_bounded_repeat().
+*/
+bool ast_is_counter(ASTNode *node)
+{
+	return node->kind == AST_REPEAT &&
+	       (node->left->kind == AST_LITERAL ||
+	        node->left->kind == AST_CLASS) &&
+	       (node->min > 1 ||
+	        (node->max != 1 && node->max != AST_UNBOUNDED));
+}
+
+/* ast_matches()
+	@leaf           ptr to AST_LITERAL or AST_CLASS node
+	@ch             input character
+
+	@return         true if @leaf matches @ch
+*/
+bool ast_matches(ASTNode *leaf, U8 ch)
+{
+	return charset_has(&leaf->chars, ch);
+}
+
+/* ast_nullable()
+	@root           ptr to root of a syntax tree
+
+	@return         true if the tree matches the empty string, false if it
+	                doesn't or if fail
+*/
+bool ast_nullable(ASTNode *root)
+{
+	NodeList order = {NULL, 0, 0};
+	bool *stack = NULL;
+	if (ast_postorder(root, &order))
+		stack = malloc(order.size * sizeof(bool));
+
+	int top = 0;
+	ASTNode *node;
+	for (int i = 0; stack && i < order.size; i++) {
+		node = order.nodes[i];
+		switch (node->kind) {
+		case AST_CONCAT:
+			top--;
+			stack[top-1] = stack[top-1] && stack[top];
+			break;
+		case AST_ALT:
+			top--;
+			stack[top-1] = stack[top-1] || stack[top];
+			break;
+		case AST_REPEAT:
+			stack[top-1] = node->min == 0 || stack[top-1];
+			break;
+		default:
+			stack[top++] = false;
+		}
+	}
+	bool nullable = stack && stack[0];
+	free(order.nodes);
+	free(stack);
+	return nullable;
+}
+
+/* same_node()
+	@lhs            ptr to syntax tree node
+	@rhs            ptr to another syntax tree node
+
+	@return         true if the nodes are equal, not counting their children
+
+	Leaves are compared by the chars they match, so a class with one char
+	equals the literal.
+*/
+static bool same_node(ASTNode *lhs, ASTNode *rhs)
+{
+	if (!lhs || !rhs)
+		return false;
+	bool lhs_leaf = lhs->kind == AST_LITERAL || lhs->kind == AST_CLASS;
+	bool rhs_leaf = rhs->kind == AST_LITERAL || rhs->kind == AST_CLASS;
+	if (lhs_leaf || rhs_leaf) {
+		return lhs_leaf && rhs_leaf &&
+		       charset_equal(&lhs->chars, &rhs->chars);
+	}
+	if (lhs->kind != rhs->kind)
+		return false;
+	return lhs->kind != AST_REPEAT ||
+	       (lhs->min == rhs->min && lhs->max == rhs->max);
+}
+
+/* ast_equal()
+	@lhs            ptr to root of a syntax tree
+	@rhs            ptr to root of another syntax tree
+
+	@return         true if the trees have the same structure, false if they
+	                don't or if fail
+
+	Structurally compare two syntax trees, see same_node(). The pairs of
+	subtrees that are left to compare wait on a stack, 2 nodes per pair.
+*/
+bool ast_equal(ASTNode *lhs, ASTNode *rhs)
+{
+	// most trees already differ at their roots, or are leaves, so they
+	// don't need the stack
+	if (lhs == rhs)
+		return true;
+	if (!same_node(lhs, rhs))
+		return false;
+	if (!lhs->left)
+		return true;
+
+	NodeList stack = {NULL, 0, 0};
+	bool equal = push_node(&stack, lhs) && push_node(&stack, rhs);
+	while (equal && stack.size > 0) {
+		rhs = stack.nodes[--stack.size];
+		lhs = stack.nodes[--stack.size];
+		if (lhs == rhs)
+			continue;
+		equal = same_node(lhs, rhs);
+		if (equal && lhs->left) {
+			equal = push_node(&stack, lhs->left) &&
+			        push_node(&stack, rhs->left);
+		}
+		if (equal && lhs->right) {
+			equal = push_node(&stack, lhs->right) &&
+			        push_node(&stack, rhs->right);
+		}
+	}
+	free(stack.nodes);
+	return equal;
+}
+
+/* ast_hash()
+	@root           ptr to root of a syntax tree
+
+	@return         hash of the tree's structure, 0 if fail
+
+	Hash a syntax tree so that trees which are ast_equal() always have the
+	same hash, so leaves are only hashed by the chars they match. A node's
+	hash mixes in the hashes of its children, which wait on a stack.
+*/
+U64 ast_hash(ASTNode *root)
+{
+	NodeList order = {NULL, 0, 0};
+	U64 *stack = NULL;
+	if (ast_postorder(root, &order))
+		stack = malloc(order.size * sizeof(U64));
+
+	int top = 0;
+	U64 h;
+	ASTNode *node;
+	for (int i = 0; stack && i < order.size; i++) {
+		node = order.nodes[i];
+		h = 0xcbf29ce484222325;
+		if (node->kind == AST_LITERAL || node->kind == AST_CLASS) {
+			for (int w = 0; w < CHARSET_WORDS; w++)
+				h = (h ^ node->chars.bits[w]) * 0x100000001b3;
+		} else {
+			h = (h ^ node->kind) * 0x100000001b3;
+			if (node->kind == AST_REPEAT) {
+				h = (h ^ node->min) * 0x100000001b3;
+				h = (h ^ (U64)node->max) * 0x100000001b3;
+			}
+			// the right child's hash is on top
+			if (node->right)
+				h = (h ^ stack[--top]) * 0x100000001b3;
+			h = (h ^ stack[--top]) * 0x100000001b3;
+		}
+		stack[top++] = h ^ (h >> 32);
+	}
+	h = stack ? stack[0] : 0;
+	free(order.nodes);
+	free(stack);
+	return h;
+}
+
+/* count_positions()
+	@root           ptr to root of a syntax tree
+
+	@return         number of leaves in the tree, -1 if fail
+
+	Count the character positions in a syntax tree, ie the number of leaves.
+	A whole class is only one position.
+*/
+int count_positions(ASTNode *root)
+{
+	NodeList stack = {NULL, 0, 0};
+	int count = 0;
+	bool ok = !root || push_node(&stack, root);
+	ASTNode *node;
+	while (ok && stack.size > 0) {
+		node = stack.nodes[--stack.size];
+		if (node->kind == AST_LITERAL || node->kind == AST_CLASS)
+			count++;
+		ok = (!node->left || push_node(&stack, node->left)) &&
+		     (!node->right || push_node(&stack, node->right));
+	}
+	free(stack.nodes);
+	return ok ? count : -1;
+}
+
+/* count_nodes()
+	@root           ptr to root of a syntax tree
+
+	@return         number of nodes in the tree, -1 if fail
+*/
+int count_nodes(ASTNode *root)
+{
+	NodeList stack = {NULL, 0, 0};
+	int count = 0;
+	bool ok = !root || push_node(&stack, root);
+	ASTNode *node;
+	while (ok && stack.size > 0) {
+		node = stack.nodes[--stack.size];
+		count++;
+		ok = (!node->left || push_node(&stack, node->left)) &&
+		     (!node->right || push_node(&stack, node->right));
+	}
+	free(stack.nodes);
+	return ok ? count : -1;
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+/** ast.h
+
+Module definition for regex syntax trees.
+
+*/
+
+#ifndef AST_H
+#define AST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "charset.h"
+#include "common.h"
+
+// node kinds
+#define AST_LITERAL     0
+#define AST_CLASS       1
+#define AST_CONCAT      2
+#define AST_ALT         3
+#define AST_REPEAT      4
+
+// AST_REPEAT max for * and +
+#define AST_UNBOUNDED   (-1)
+
+// bytes in an arena block, unless one allocation needs more
+#define AST_BLOCK_SIZE  4096
+
+typedef struct ASTNode {
+	int kind;
+	U8 ch;             // AST_LITERAL
+	CharSet chars;     // chars matched by AST_LITERAL and AST_CLASS, eg
+	                   // a regex range or the wildcard
+	int min;           // AST_REPEAT
+	int max;
+	/*
+	* is {0, AST_UNBOUNDED}
+	? is {0, 1}
+	+ is {1, AST_UNBOUNDED}
+	*/
+	struct ASTNode *left;
+	struct ASTNode *right;
+	/*
+	AST_LITERAL and AST_CLASS have no children
+	AST_CONCAT and AST_ALT have both children
+	AST_REPEAT only has a left child
+	*/
+} ASTNode;
+
+typedef struct ASTBlock {
+	struct ASTBlock *next;
+	size_t used;
+	size_t size;
+	max_align_t data[];
+} ASTBlock;
+
+// every node of a tree lives in its arena, so the whole tree is freed at once
+typedef struct AST {
+	ASTNode *root;
+	ASTBlock *blocks;  // newest block first
+	int num_nodes;
+	int num_blocks;
+	bool anchored_start;  // regex started with ^, see parse_ast()
+	bool anchored_end;    // regex ended with $
+} AST;
+
+// a growable list of syntax trees, also used as the stack of a tree walk
+typedef struct NodeList {
+	ASTNode **nodes;
+	int size;
+	int capacity;
+} NodeList;
+
+AST *init_ast(void);
+void destroy_ast(AST *ast);
+void *ast_alloc(AST *ast, size_t size);
+
+ASTNode *ast_literal(AST *ast, U8 ch);
+ASTNode *ast_class(AST *ast, const CharSet *chars);
+ASTNode *ast_wildcard(AST *ast);
+ASTNode *ast_concat(AST *ast, ASTNode *lhs, ASTNode *rhs);
+ASTNode *ast_alt(AST *ast, ASTNode *lhs, ASTNode *rhs);
+ASTNode *ast_repeat(AST *ast, ASTNode *node, int min, int max);
+ASTNode *ast_quantify(AST *ast, ASTNode *node, U8 quantifier);
+ASTNode *ast_clone(AST *ast, ASTNode *node);
+ASTNode *ast_bounded_repeat(AST *ast, ASTNode *node, int min, int max);
+ASTNode *ast_unanchor(AST *ast);
+
+bool push_node(NodeList *list, ASTNode *node);
+bool ast_flatten(ASTNode *node, int kind, NodeList *list);
+bool ast_postorder(ASTNode *root, NodeList *order);
+
+bool ast_matches(ASTNode *leaf, U8 ch);
+bool ast_nullable(ASTNode *root);
+bool ast_is_counter(ASTNode *node);
+bool ast_equal(ASTNode *lhs, ASTNode *rhs);
+U64 ast_hash(ASTNode *root);
+int count_positions(ASTNode *root);
+int count_nodes(ASTNode *root);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,374 @@
+/** bisimulation.c
+
+Shrink a position automaton by merging bisimilar states.
+
+Two states are forward bisimilar if they both accept or both don't, and for
+every char they can step to the same classes of states. They accept the same
+suffixes, so either one can stand in for the other. Backward bisimilar states
+are the mirror image: they can be reached from the same classes of states, so
+they're reached by the same prefixes. Merging either kind of class into one
+state keeps the language intact, and every subset the subset construction
+makes afterwards is smaller.
+
+Every transition into a position reads that position's chars, so grouping
+states by their chars from the start keeps the merged automaton a valid
+PositionNFA, and a state's successors (or predecessors) determine its labeled
+transitions. The classes are found by partition refinement: split every class
+by the classes of its neighbors until no class splits anymore.
+
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "bisimulation.h"
+#include "charset.h"
+#include "common.h"
+#include "glushkov.h"
+
+// a state's chars plus whatever else it has to agree on from the start
+typedef struct InitialKey {
+	int state;
+	CharSet chars;
+	int flags;
+} InitialKey;
+
+// a state's class followed by the sorted classes of its neighbors
+typedef struct Signature {
+	int state;
+	int *classes;
+	int size;
+} Signature;
+
+#define KEY_START   1
+#define KEY_ACCEPT  2
+
+static int compare_ints(const void *i1, const void *i2)
+{
+	return *(const int *)i1 - *(const int *)i2;
+}
+
+static int compare_initial_keys(const void *k1, const void *k2)
+{
+	const InitialKey *a = (const InitialKey *)k1;
+	const InitialKey *b = (const InitialKey *)k2;
+	if (a->flags != b->flags)
+		return a->flags - b->flags;
+	return charset_compare(&a->chars, &b->chars);
+}
+
+static int compare_signatures(const void *s1, const void *s2)
+{
+	const Signature *a = (const Signature *)s1;
+	const Signature *b = (const Signature *)s2;
+	for (int i = 0; i < a->size && i < b->size; i++) {
+		if (a->classes[i] != b->classes[i])
+			return a->classes[i] - b->classes[i];
+	}
+	return a->size - b->size;
+}
+
+/* initial_partition()
+	@pnfa           ptr to PositionNFA struct
+	@direction      BISIM_FORWARD or BISIM_BACKWARD
+	@classes        ptr to output, class of each state
+
+	@return         number of classes, -1 if fail
+
+	Split the states by their chars. The start state reads nothing, so it
+	gets a class of its own. Forward bisimilar states must also agree on
+	whether they accept.
+*/
+static int initial_partition(PositionNFA *pnfa, int direction, int *classes)
+{
+	InitialKey *keys = malloc(pnfa->size * sizeof(InitialKey));
+	if (!keys)
+		return -1;
+	for (int p = 0; p < pnfa->size; p++) {
+		keys[p].state = p;
+		keys[p].chars = pnfa->chars[p];
+		keys[p].flags = p == 0 ? KEY_START : 0;
+		if (direction == BISIM_FORWARD && pnfa->is_accept[p])
+			keys[p].flags |= KEY_ACCEPT;
+	}
+	qsort(keys, pnfa->size, sizeof(InitialKey), compare_initial_keys);
+
+	int num_classes = 0;
+	for (int i = 0; i < pnfa->size; i++) {
+		if (i > 0 && compare_initial_keys(&keys[i - 1], &keys[i]) != 0)
+			num_classes++;
+		classes[keys[i].state] = num_classes;
+	}
+	free(keys);
+	return num_classes + 1;
+}
+
+/* refine()
+	@pnfa           ptr to PositionNFA struct
+	@edges          neighbors of each state, ie followers or predecessors
+	@classes        class of each state, refined in place
+	@num_classes    number of classes in @classes
+
+	@return         number of classes once no class splits anymore, -1 if
+	                fail
+
+	Repeatedly split every class by the classes of its states' neighbors.
+	The new class of a state is decided by its old class plus its set of
+	neighbor classes, so classes only ever split.
+*/
+static int refine(PositionNFA *pnfa, PosList *edges, int *classes,
+                  int num_classes)
+{
+	int num_edges = 0;
+	for (int p = 0; p < pnfa->size; p++)
+		num_edges += edges[p].size;
+	Signature *sigs = malloc(pnfa->size * sizeof(Signature));
+	int *buffer = malloc((pnfa->size + num_edges) * sizeof(int));
+	if (!sigs || !buffer) {
+		free(sigs);
+		free(buffer);
+		return -1;
+	}
+
+	int old_num_classes;
+	int *next;
+	int size;
+	do {
+		old_num_classes = num_classes;
+		next = buffer;
+		for (int p = 0; p < pnfa->size; p++) {
+			next[0] = classes[p];
+			for (int i = 0; i < edges[p].size; i++)
+				next[i + 1] = classes[edges[p].positions[i]];
+			// sort and dedupe the neighbors, not the state's own class
+			qsort(next + 1, edges[p].size, sizeof(int),
+			      compare_ints);
+			size = edges[p].size > 0 ? 2 : 1;
+			for (int i = 2; i <= edges[p].size; i++) {
+				if (next[i] != next[size - 1])
+					next[size++] = next[i];
+			}
+			sigs[p].state = p;
+			sigs[p].classes = next;
+			sigs[p].size = size;
+			next += size;
+		}
+		qsort(sigs, pnfa->size, sizeof(Signature), compare_signatures);
+
+		num_classes = 0;
+		for (int i = 0; i < pnfa->size; i++) {
+			if (i > 0 &&
+			    compare_signatures(&sigs[i - 1], &sigs[i]) != 0)
+				num_classes++;
+			classes[sigs[i].state] = num_classes;
+		}
+		num_classes++;
+	} while (num_classes != old_num_classes);
+
+	free(sigs);
+	free(buffer);
+	return num_classes;
+}
+
+/* predecessors()
+	@pnfa           ptr to PositionNFA struct
+
+	@return         ptr to array of sorted predecessor lists, one per state,
+	                NULL if fail
+
+	Reverse every follow set.
+*/
+static PosList *predecessors(PositionNFA *pnfa)
+{
+	PosList *preds = calloc(pnfa->size, sizeof(PosList));
+	int *counts = calloc(pnfa->size, sizeof(int));
+	if (!preds || !counts)
+		goto FAIL;
+	for (int p = 0; p < pnfa->size; p++) {
+		for (int i = 0; i < pnfa->follow[p].size; i++)
+			counts[pnfa->follow[p].positions[i]]++;
+	}
+	for (int q = 0; q < pnfa->size; q++) {
+		preds[q].positions = malloc((counts[q] + 1) * sizeof(int));
+		if (!preds[q].positions)
+			goto FAIL;
+	}
+	// p goes up, so every list ends up sorted
+	int q;
+	for (int p = 0; p < pnfa->size; p++) {
+		for (int i = 0; i < pnfa->follow[p].size; i++) {
+			q = pnfa->follow[p].positions[i];
+			preds[q].positions[preds[q].size++] = p;
+		}
+	}
+	free(counts);
+	return preds;
+
+FAIL:
+	if (preds) {
+		for (int p = 0; p < pnfa->size; p++)
+			free(preds[p].positions);
+	}
+	free(preds);
+	free(counts);
+	return NULL;
+}
+
+/* quotient()
+	@pnfa           ptr to PositionNFA struct
+	@classes        class of each state
+	@num_classes    number of classes
+
+	@return         ptr to new PositionNFA with one state per class, NULL
+	                if fail
+
+	Merge every class into one state. The classes are renumbered in order
+	of their lowest state, so the start state stays 0 and the positions
+	keep their relative order. A class accepts if any of its states does,
+	and it's followed by every class that follows any of its states.
+*/
+static PositionNFA *quotient(PositionNFA *pnfa, int *classes, int num_classes)
+{
+	PositionNFA *reduced = init_position_nfa(num_classes - 1);
+	int *renumber = malloc(num_classes * sizeof(int));
+	int *begin = calloc(num_classes + 1, sizeof(int));
+	int *members = malloc(pnfa->size * sizeof(int));
+	int *stamp = malloc(num_classes * sizeof(int));
+	if (!reduced || !renumber || !begin || !members || !stamp)
+		goto FAIL;
+	reduced->alphabet = pnfa->alphabet;
+
+	for (int c = 0; c < num_classes; c++)
+		renumber[c] = -1;
+	int next = 0;
+	int c;
+	for (int p = 0; p < pnfa->size; p++) {
+		c = classes[p];
+		if (renumber[c] == -1)
+			renumber[c] = next++;
+		begin[renumber[c] + 1]++;
+	}
+	// group the states by class, so the members of class c are
+	// members[begin[c]] .. members[begin[c+1] - 1]
+	// stamp[] is just the next free slot of each class for now
+	for (c = 0; c < num_classes; c++) {
+		begin[c + 1] += begin[c];
+		stamp[c] = begin[c];
+	}
+	for (int p = 0; p < pnfa->size; p++)
+		members[stamp[renumber[classes[p]]]++] = p;
+	for (c = 0; c < num_classes; c++)
+		stamp[c] = -1;
+
+	int p, q;
+	PosList *follow;
+	for (c = 0; c < num_classes; c++) {
+		p = members[begin[c]];
+		reduced->states[c].ch = pnfa->states[p].ch;
+		reduced->chars[c] = pnfa->chars[p];
+		follow = &reduced->follow[c];
+		follow->positions = malloc(num_classes * sizeof(int));
+		if (!follow->positions)
+			goto FAIL;
+		for (int m = begin[c]; m < begin[c + 1]; m++) {
+			p = members[m];
+			reduced->is_accept[c] |= pnfa->is_accept[p];
+			for (int i = 0; i < pnfa->follow[p].size; i++) {
+				q = pnfa->follow[p].positions[i];
+				q = renumber[classes[q]];
+				if (stamp[q] == c)
+					continue;
+				stamp[q] = c;
+				follow->positions[follow->size++] = q;
+			}
+		}
+		qsort(follow->positions, follow->size, sizeof(int),
+		      compare_ints);
+	}
+	free(renumber);
+	free(begin);
+	free(members);
+	free(stamp);
+	return reduced;
+
+FAIL:
+	destroy_position_nfa(reduced);
+	free(renumber);
+	free(begin);
+	free(members);
+	free(stamp);
+	return NULL;
+}
+
+/* reduce_once()
+	@pnfa           ptr to PositionNFA struct
+	@direction      BISIM_FORWARD or BISIM_BACKWARD
+
+	@return         ptr to new PositionNFA with the bisimilar states of
+	                @pnfa merged, NULL if fail
+*/
+static PositionNFA *reduce_once(PositionNFA *pnfa, int direction)
+{
+	PositionNFA *reduced = NULL;
+	PosList *preds = NULL;
+	int *classes = malloc(pnfa->size * sizeof(int));
+	if (!classes)
+		return NULL;
+	int num_classes = initial_partition(pnfa, direction, classes);
+	if (num_classes == -1)
+		goto CLEANUP;
+
+	if (direction == BISIM_FORWARD) {
+		num_classes = refine(pnfa, pnfa->follow, classes, num_classes);
+	} else {
+		preds = predecessors(pnfa);
+		if (!preds)
+			goto CLEANUP;
+		num_classes = refine(pnfa, preds, classes, num_classes);
+	}
+	if (num_classes != -1)
+		reduced = quotient(pnfa, classes, num_classes);
+
+CLEANUP:
+	if (preds) {
+		for (int p = 0; p < pnfa->size; p++)
+			free(preds[p].positions);
+		free(preds);
+	}
+	free(classes);
+	return reduced;
+}
+
+/* bisimulation_reduce()
+	@pnfa           ptr to PositionNFA struct
+	@direction      BISIM_FORWARD, BISIM_BACKWARD, or BISIM_BOTH
+
+	@return         ptr to new, equivalent PositionNFA with no more states
+	                than @pnfa, NULL if fail
+
+	Merge the bisimilar states of a PositionNFA, which is unmodified.
+	Merging one way can make more states bisimilar the other way, so
+	BISIM_BOTH alternates until a pass doesn't shrink the automaton.
+*/
+PositionNFA *bisimulation_reduce(PositionNFA *pnfa, int direction)
+{
+	if (direction != BISIM_BOTH)
+		return reduce_once(pnfa, direction);
+
+	PositionNFA *curr = reduce_once(pnfa, BISIM_FORWARD);
+	PositionNFA *next;
+	int turn = BISIM_BACKWARD;
+	int size;
+	// the coarsest bisimulation of the result merges nothing, so once a
+	// pass doesn't shrink the automaton, neither would the other direction
+	while (curr) {
+		size = curr->size;
+		next = reduce_once(curr, turn);
+		destroy_position_nfa(curr);
+		curr = next;
+		if (curr && curr->size == size)
+			break;
+		turn = turn == BISIM_FORWARD ? BISIM_BACKWARD : BISIM_FORWARD;
+	}
+	return curr;
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+/** bisimulation.h
+
+Module definition for reducing position automata with bisimulations.
+
+*/
+
+#ifndef BISIMULATION_H
+#define BISIMULATION_H
+
+#include "glushkov.h"
+
+// which way bisimilar states look alike
+#define BISIM_FORWARD   1  // same future: accept and followers
+#define BISIM_BACKWARD  2  // same past: predecessors
+#define BISIM_BOTH      3  // alternate both until neither merges anything
+
+PositionNFA *bisimulation_reduce(PositionNFA *pnfa, int direction);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,103 @@
+/** budget.c
+
+Track how many DFA states and bytes a compilation has used so far.
+
+Every budget function accepts a NULL budget, which means unlimited. So the
+compilation phases can charge their budget unconditionally.
+
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "budget.h"
+
+/* init_budget()
+	@max_states     maximum number of DFA states, 0 for unlimited
+	@max_bytes      maximum number of bytes allocated, 0 for unlimited
+
+	@return         ptr to dynamically allocated Budget, NULL if fail
+
+	Dynamically allocate a Budget and initialize its caps.
+*/
+Budget *init_budget(int max_states, size_t max_bytes)
+{
+	Budget *budget = calloc(1, sizeof(Budget));
+	if (!budget)
+		return NULL;
+	budget->max_states = max_states;
+	budget->max_bytes = max_bytes;
+	budget->status = BUDGET_OK;
+	return budget;
+}
+
+// for symmetry and to prevent confusion, a destroy_budget() function is
+// defined
+// the user could always call free(budget), though
+inline void destroy_budget(Budget *budget)
+{
+	free(budget);
+}
+
+/* reset_budget()
+	@budget         ptr to Budget struct
+
+	Forget everything charged to the budget so it can be reused. The caps
+	are unmodified.
+*/
+void reset_budget(Budget *budget)
+{
+	if (!budget)
+		return;
+	budget->states_used = 0;
+	budget->bytes_used = 0;
+	budget->status = BUDGET_OK;
+}
+
+/* budget_add_states()
+	@budget         ptr to Budget struct
+	@num_states     number of new DFA states
+
+	@return         true if the budget can afford the states, otherwise
+	                false
+
+	Charge new DFA states to the budget. If the state cap is exceeded, the
+	budget's status is set to BUDGET_STATES_EXCEEDED.
+*/
+bool budget_add_states(Budget *budget, int num_states)
+{
+	if (!budget)
+		return true;
+	if (budget->status != BUDGET_OK)
+		return false;
+	budget->states_used += num_states;
+	if (budget->max_states && budget->states_used > budget->max_states) {
+		budget->status = BUDGET_STATES_EXCEEDED;
+		return false;
+	}
+	return true;
+}
+
+/* budget_add_bytes()
+	@budget         ptr to Budget struct
+	@num_bytes      number of bytes that are about to be allocated
+
+	@return         true if the budget can afford the bytes, otherwise false
+
+	Charge an allocation to the budget BEFORE performing it. If the byte
+	cap is exceeded, the budget's status is set to BUDGET_BYTES_EXCEEDED.
+*/
+bool budget_add_bytes(Budget *budget, size_t num_bytes)
+{
+	if (!budget)
+		return true;
+	if (budget->status != BUDGET_OK)
+		return false;
+	budget->bytes_used += num_bytes;
+	if (budget->max_bytes && budget->bytes_used > budget->max_bytes) {
+		budget->status = BUDGET_BYTES_EXCEEDED;
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+/** budget.h
+
+Module definition for compilation budgets.
+
+*/
+
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Budget->status codes
+#define BUDGET_OK                0
+#define BUDGET_STATES_EXCEEDED   1
+#define BUDGET_BYTES_EXCEEDED    2
+
+// caps on the work done by the subset construction and the minimizer
+// a pathological regex can have exponentially many DFA states, so we must be
+// able to bail out before the machine runs out of memory
+typedef struct Budget {
+	int max_states;    // 0 means unlimited
+	size_t max_bytes;  // 0 means unlimited
+	int states_used;
+	size_t bytes_used;
+	int status;
+	/*
+	status is BUDGET_OK until a cap is exceeded, then it keeps the code of
+	whichever cap was exceeded first
+	*/
+} Budget;
+
+Budget *init_budget(int max_states, size_t max_bytes);
+void destroy_budget(Budget *budget);
+void reset_budget(Budget *budget);
+bool budget_add_states(Budget *budget, int num_states);
+bool budget_add_bytes(Budget *budget, size_t num_bytes);
+
+#endif
\ No newline at end of file
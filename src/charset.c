@@ -0,0 +1,228 @@
+/** charset.c
+
+Sets of byte values, and the byte classes of an automaton.
+
+Every byte from 0 to 255 can be matched, so a set of chars is 256 bits. Most
+regexes only distinguish a handful of them though, eg [a-z]+ only cares
+whether a char is a lowercase letter or not. byte_classes() groups the chars
+that no transition can tell apart, so a DFA only needs one column per group.
+
+*/
+
+#include <stdbool.h>
+
+#include "charset.h"
+#include "common.h"
+
+// A-Z in the CHARS64_127 word, a-z is the same bits shifted left by 32
+#define UPPERCASE_BITS 0x0000000007FFFFFEULL
+
+/* count_bits
+	@x              64-bit unsigned integer
+
+	@return         number of 1-bits in the integer
+
+	Counts the number of 1 bits in @x.
+
+	Taken from https://en.wikipedia.org/wiki/Hamming_weight
+	The alphabet bitfield is likely to have large contiguous chunks of
+	1 bits. There will be large contiguous chunks of 0s, so I could use the
+	Wegner algorithm, but there are very few chunks of 0s compared to the
+	amount of 1s. I would spend more time iterating over the chunk of 1s
+	even though there are lots of 0s.
+	So I opted for the popcount64c() implementation.
+*/
+static int count_bits(U64 x)
+{
+	x -= (x >> 1) & 0x5555555555555555;
+	x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
+	return (x * 0x0101010101010101) >> 56;
+}
+
+/* charset_add_range()
+	@cs             ptr to CharSet struct
+	@left           lower bound of a range of chars
+	@right          upper bound of a range of chars
+
+	Add every char from @left to @right to a set.
+*/
+void charset_add_range(CharSet *cs, U8 left, U8 right)
+{
+	for (int ch = left; ch <= right; ch++)
+		charset_add(cs, ch);
+}
+
+/* charset_fold_case()
+	@cs             ptr to CharSet struct
+
+	Add the other case of every ASCII letter in a set, so [a-c] becomes
+	[a-cA-C]. A-Z and a-z are both in the CHARS64_127 word, exactly 32
+	bits apart, so all 52 letters fold with two shifts.
+*/
+void charset_fold_case(CharSet *cs)
+{
+	U64 word = cs->bits[CHARS64_127];
+	cs->bits[CHARS64_127] |= ((word & UPPERCASE_BITS) << 32) |
+	                         ((word >> 32) & UPPERCASE_BITS);
+}
+
+/* charset_wildcard()
+	@cs             ptr to CharSet struct
+
+	Make @cs the set of chars that the wildcard `.` matches: every
+	printable char, tab, and newline.
+*/
+void charset_wildcard(CharSet *cs)
+{
+	*cs = (CharSet){{0}};
+	charset_add_range(cs, ' ', '~');
+	charset_add(cs, '\t');
+	charset_add(cs, '\n');
+}
+
+/* charset_is_wildcard()
+	@cs             ptr to CharSet struct
+
+	@return         true if @cs is exactly the set of the wildcard `.`
+*/
+bool charset_is_wildcard(const CharSet *cs)
+{
+	CharSet wildcard;
+	charset_wildcard(&wildcard);
+	return charset_equal(cs, &wildcard);
+}
+
+/* charset_size()
+	@cs             ptr to CharSet struct
+
+	@return         number of chars in @cs
+*/
+int charset_size(const CharSet *cs)
+{
+	int size = 0;
+	for (int i = 0; i < CHARSET_WORDS; i++)
+		size += count_bits(cs->bits[i]);
+	return size;
+}
+
+/* charset_single()
+	@cs             ptr to CharSet struct
+
+	@return         the only char in @cs, -1 if it has 0 or several
+*/
+int charset_single(const CharSet *cs)
+{
+	int ch = -1;
+	U64 word;
+	for (int i = 0; i < CHARSET_WORDS; i++) {
+		word = cs->bits[i];
+		if (!word)
+			continue;
+		// a word with one bit is a single char
+		if (ch != -1 || (word & (word - 1)))
+			return -1;
+		ch = 64 * i + __builtin_ctzll(word);
+	}
+	return ch;
+}
+
+/* charset_compare()
+	@a              ptr to CharSet struct
+	@b              ptr to another CharSet struct
+
+	@return         <0 if @a goes before @b, >0 if after, 0 if they're equal
+
+	Order sets by their highest word first, so sorting sets is just like
+	sorting 256-bit integers.
+*/
+int charset_compare(const CharSet *a, const CharSet *b)
+{
+	for (int i = CHARSET_WORDS - 1; i >= 0; i--) {
+		if (a->bits[i] != b->bits[i])
+			return a->bits[i] < b->bits[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+/* byte_classes()
+	@labels         array of the chars of every transition of an automaton
+	@num_labels     number of CharSets in @labels
+	@classes        array of NUM_CHARS ints, receives the class of every
+	                char, -1 for a char that's in no label
+
+	@return         number of byte classes
+
+	Partition the chars of all @labels so that two chars share a class iff
+	every label has either both of them or neither. The automaton can't
+	tell apart two chars of the same class, so only one char per class
+	needs to be tried during subset construction.
+
+	The partition is refined one label at a time: every class that's only
+	partly inside the label splits in two. Class 0 holds the chars that
+	aren't in any label yet, and it always gives its chars away. A
+	partition of 256 chars has at most 256 classes, plus class 0, and each
+	label only costs as much as the number of chars in it.
+
+	Classes are finally renumbered in order of their smallest char.
+*/
+int byte_classes(const CharSet *labels, int num_labels, int *classes)
+{
+	int size[NUM_CHARS + 1];    // number of chars in each class
+	int inside[NUM_CHARS + 1];  // chars of each class inside the label
+	int split[NUM_CHARS + 1];   // where those chars go
+	int touched[NUM_CHARS];     // classes with chars inside the label
+	int num_touched;
+	int num_ids = 1;
+	size[0] = NUM_CHARS;
+	for (int ch = 0; ch < NUM_CHARS; ch++)
+		classes[ch] = 0;
+	for (int c = 0; c <= NUM_CHARS; c++)
+		inside[c] = 0;
+
+	int c, ch;
+	U64 word;
+	for (int i = 0; i < num_labels; i++) {
+		num_touched = 0;
+		for (int w = 0; w < CHARSET_WORDS; w++) {
+			for (word = labels[i].bits[w]; word; word &= word - 1) {
+				c = classes[64 * w + __builtin_ctzll(word)];
+				if (!inside[c]++)
+					touched[num_touched++] = c;
+			}
+		}
+		for (int t = 0; t < num_touched; t++) {
+			c = touched[t];
+			if (c == 0 || inside[c] < size[c]) {
+				split[c] = num_ids;
+				size[num_ids++] = inside[c];
+				size[c] -= inside[c];
+			} else {
+				split[c] = c;
+			}
+			inside[c] = 0;
+		}
+		for (int w = 0; w < CHARSET_WORDS; w++) {
+			for (word = labels[i].bits[w]; word; word &= word - 1) {
+				ch = 64 * w + __builtin_ctzll(word);
+				classes[ch] = split[classes[ch]];
+			}
+		}
+	}
+
+	// split[] is reused to renumber the classes
+	int num_classes = 0;
+	for (c = 0; c < num_ids; c++)
+		split[c] = -1;
+	for (ch = 0; ch < NUM_CHARS; ch++) {
+		c = classes[ch];
+		if (c == 0) {
+			classes[ch] = -1;
+			continue;
+		}
+		if (split[c] == -1)
+			split[c] = num_classes++;
+		classes[ch] = split[c];
+	}
+	return num_classes;
+}
\ No newline at end of file
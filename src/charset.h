@@ -0,0 +1,64 @@
+/** charset.h
+
+Module definition for sets of byte values.
+
+*/
+
+#ifndef CHARSET_H
+#define CHARSET_H
+
+#include <stdbool.h>
+
+#include "common.h"
+
+#define NUM_CHARS       256
+#define CHARSET_WORDS   (NUM_CHARS / 64)
+
+// CharSet->bits[] indices
+#define CHARS0_63       0
+#define CHARS64_127     1
+#define CHARS128_191    2
+#define CHARS192_255    3
+
+// one bit per byte value, char ch is bit ch % 64 of bits[ch / 64]
+typedef struct CharSet {
+	U64 bits[CHARSET_WORDS];
+} CharSet;
+
+static inline void charset_add(CharSet *cs, U8 ch)
+{
+	cs->bits[ch / 64] |= (U64)1 << (ch % 64);
+}
+
+static inline bool charset_has(const CharSet *cs, U8 ch)
+{
+	return cs->bits[ch / 64] & ((U64)1 << (ch % 64));
+}
+
+static inline void charset_union(CharSet *dest, const CharSet *src)
+{
+	for (int i = 0; i < CHARSET_WORDS; i++)
+		dest->bits[i] |= src->bits[i];
+}
+
+static inline bool charset_is_empty(const CharSet *cs)
+{
+	return !(cs->bits[0] | cs->bits[1] | cs->bits[2] | cs->bits[3]);
+}
+
+static inline bool charset_equal(const CharSet *a, const CharSet *b)
+{
+	return a->bits[0] == b->bits[0] && a->bits[1] == b->bits[1] &&
+	       a->bits[2] == b->bits[2] && a->bits[3] == b->bits[3];
+}
+
+void charset_add_range(CharSet *cs, U8 left, U8 right);
+void charset_fold_case(CharSet *cs);
+void charset_wildcard(CharSet *cs);
+bool charset_is_wildcard(const CharSet *cs);
+int charset_size(const CharSet *cs);
+int charset_single(const CharSet *cs);
+int charset_compare(const CharSet *a, const CharSet *b);
+int byte_classes(const CharSet *labels, int num_labels, int *classes);
+
+#endif
\ No newline at end of file
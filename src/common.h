@@ -10,6 +10,8 @@ For any generic symbols shared by many other source files.
 #include <stdint.h>
 
 typedef uint8_t U8;
+typedef uint16_t U16;
+typedef uint32_t U32;
 typedef uint64_t U64;
 
 #endif
\ No newline at end of file
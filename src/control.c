@@ -4,6 +4,7 @@ Compiler control stores all necessary info for each phase of the compilation.
 
 */
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,9 +23,25 @@ CmpCtrl *init_cmpctrl(void)
 	CmpCtrl *cc = calloc(1, sizeof(CmpCtrl));
 	if (!cc)
 		return NULL;
+	cc->max_repeat = MAX_REPEAT;
 	return cc;
 }
 
+/* clear_tokens()
+	@cc             ptr to CmpCtrl struct
+
+	Forget the tokens of the previous buffer, see prelex().
+*/
+void clear_tokens(CmpCtrl *cc)
+{
+	free(cc->tokens);
+	free(cc->ends);
+	cc->tokens = NULL;
+	cc->ends = NULL;
+	cc->num_tokens = 0;
+	cc->next_token = 0;
+}
+
 /* destroy_cmpctrl()
 	@cc             ptr to CmpCtrl struct
 
@@ -32,11 +49,44 @@ CmpCtrl *init_cmpctrl(void)
 */
 void destroy_cmpctrl(CmpCtrl *cc)
 {
-	if (cc)
+	if (cc) {
 		free(cc->buffer);
+		clear_tokens(cc);
+	}
 	free(cc);
 }
 
+/* remove_char()
+	@buffer         array of chars
+	@len            number of chars in @buffer
+	@c              char to remove
+
+	@return         number of chars left in @buffer
+
+	Remove every occurrence of @c from @buffer, in place. memchr() finds
+	each occurrence and memmove() shifts the whole run of chars before
+	it, so there is no work per char outside of the C library.
+*/
+static size_t remove_char(char *buffer, size_t len, char c)
+{
+	char *found = memchr(buffer, c, len);
+	if (!found)
+		return len;
+
+	char *dest = found;
+	char *src = found + 1;
+	char *end = buffer + len;
+	size_t run;
+	while (src < end) {
+		found = memchr(src, c, end - src);
+		run = (found ? found : end) - src;
+		memmove(dest, src, run);
+		dest += run;
+		src += run + 1;
+	}
+	return dest - buffer;
+}
+
 /* read_file()
 	@cc             ptr to CmpCtrl struct
 	@file_name      name of file to read
@@ -46,6 +96,9 @@ void destroy_cmpctrl(CmpCtrl *cc)
 	Read a file which contains a regular expression into the CmpCtrl's
 	internal buffer. If the buffer already holds data, it is freed and
 	overwritten with new data.
+
+	The whole file is read with one fread(), then newlines are squeezed
+	out of the buffer.
 */
 int read_file(CmpCtrl *cc, const char *file_name)
 {
@@ -54,30 +107,35 @@ int read_file(CmpCtrl *cc, const char *file_name)
 		return -1;
 
 	// determine file size in bytes
-	// we don't actually need exactly this many since we will remove all
-	// newlines, but it's a few bytes so who cares
-	fseek(f, 0, SEEK_END);
+	if (fseek(f, 0, SEEK_END) != 0)
+		goto FAIL;
+	long size = ftell(f);
+	if (size < 0 || size > INT_MAX)
+		goto FAIL;
+	rewind(f);
 
 	free(cc->buffer);
-	cc->buffer = calloc(ftell(f), 1);
+	clear_tokens(cc);
+	cc->buffer_len = 0;
+	// malloc(0) may return NULL
+	cc->buffer = malloc(size ? size : 1);
 	if (!cc->buffer)
-		return -1;
-
-	rewind(f);
-
-	int c;
-	int i = 0;
-	while ((c = fgetc(f)) != EOF) {
-		if (c != '\r' && c != '\n')
-			cc->buffer[i++] = c;
-	}
+		goto FAIL;
+	if (fread(cc->buffer, 1, size, f) != (size_t)size)
+		goto FAIL;
 
-	cc->buffer_len = i;
+	size = remove_char(cc->buffer, size, '\n');
+	size = remove_char(cc->buffer, size, '\r');
+	cc->buffer_len = size;
 	// don't forget to reset position
 	cc->pos = 0;
 
 	fclose(f);
 	return 0;
+
+FAIL:
+	fclose(f);
+	return -1;
 }
 
 /* read_line()
@@ -94,6 +152,7 @@ int read_file(CmpCtrl *cc, const char *file_name)
 int read_line(CmpCtrl *cc, const char *line, const int size)
 {
 	free(cc->buffer);
+	clear_tokens(cc);
 	cc->buffer = malloc(size);
 	if (!cc->buffer)
 		return -1;
@@ -7,17 +7,27 @@ Module definition for the compiler control structure.
 #ifndef CONTROL_H
 #define CONTROL_H
 
+#include <stdbool.h>
+
 #include "common.h"
 
 #define CC_DISABLE_INSTEAD_FOUND    0x1
 #define CC_DISABLE_ERROR_MSG        0x2
 #define CC_DISABLE_LINE_PRINT       0x4
 #define CC_ABORT                    0x8
+#define CC_IGNORE_CASE              0x10
+#define CC_ANCHOR_START             0x20
+#define CC_ANCHOR_END               0x40
+
+// default cap on the counts of a repeat like a{2,5}, see quantifier()
+#define MAX_REPEAT                  1000
+// cap on the counts of a repeat that's kept as a counter, see keep_counts
+#define MAX_COUNT                   1000000
 
 // This project is, formally speaking, a compiler.
 // No one shall stop me from calling it such.
 typedef struct CompilerControl {
-	U8 token;
+	U16 token;
 	char *buffer;
 	int pos;
 	int buffer_len;
@@ -34,11 +44,31 @@ typedef struct CompilerControl {
 	CC_ABORT 0x8
 		end parsing and clean things up, no matter what the parse
 		procedures may indicate
+	CC_IGNORE_CASE 0x10
+		every letter matches both cases, set by a leading (?i) or
+		ignore_case, see parse_ast()
+	CC_ANCHOR_START 0x20
+		the regex started with ^
+	CC_ANCHOR_END 0x40
+		the regex ended with $
+	*/
+	U16 *tokens;      // rest of the buffer as tokens, see prelex()
+	int *ends;        // pos after each token
+	int num_tokens;
+	int next_token;
+	struct AST *ast;  // syntax tree under construction, see parse_ast()
+	int max_repeat;   // largest count allowed in a repeat like a{2,5}
+	bool ignore_case;  // compile every regex case-insensitively
+	bool keep_counts;
+	/*
+	if set, a repeat of one char like [a-z]{3,8} stays a single AST_REPEAT
+	node for counter.c instead of being copied, and only MAX_COUNT caps it
 	*/
 } CmpCtrl;
 
 CmpCtrl *init_cmpctrl(void);
 void destroy_cmpctrl(CmpCtrl *cc);
+void clear_tokens(CmpCtrl *cc);
 int read_file(CmpCtrl *cc, const char *file_name);
 int read_line(CmpCtrl *cc, const char *line, const int size);
 
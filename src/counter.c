@@ -0,0 +1,365 @@
+/** counter.c
+
+Match regexes with large repeat counts, like .{1000} or [0-9]{0,4096}, without
+a state per repetition.
+
+A repeat that gets expanded into copies costs a Glushkov position per copy,
+and the DFA a state per count. But when the repeated subexpression is a single
+char class, every copy reads the same chars, so the copies only differ in how
+many chars were read. The counter automaton keeps one position for the class
+and attaches a counter to it: reading a char there counts up, leaving needs at
+least the minimum, and entering it again starts a new count. The automaton is
+just the Glushkov automaton of a syntax tree built with cc->keep_counts, so its
+size doesn't depend on the counts at all.
+
+The VM runs the threads in lockstep like the PositionVM. Threads on the same
+counter position may have different counts, eg the counter of [a-z]*a[a-z]{3}
+starts another count at every a. They're all kept in a counting set: since
+every count goes up at the same time, storing when each count started is
+enough, the ones that pass the maximum are always the oldest, and the one that
+decides whether a thread may leave is also the oldest. Every operation is O(1)
+amortized, so matching stays O(n*m) for an input of length n and m positions.
+
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "charset.h"
+#include "common.h"
+#include "counter.h"
+#include "glushkov.h"
+#include "nfa.h"
+#include "simulate.h"
+
+/* number_counters()
+	@cnfa           ptr to CounterNFA struct
+	@root           ptr to root of the syntax tree
+
+	@return         true if success, otherwise false
+
+	Number the positions from left to right like glushkov() does, and
+	record the counts of each counter position. The leaf of a counter comes
+	right before the counter in postorder, so a counter's position is the
+	last one numbered.
+*/
+static bool number_counters(CounterNFA *cnfa, ASTNode *root)
+{
+	NodeList order = {NULL, 0, 0};
+	if (!ast_postorder(root, &order)) {
+		free(order.nodes);
+		return false;
+	}
+	int next = 1;
+	ASTNode *node;
+	for (int i = 0; i < order.size; i++) {
+		node = order.nodes[i];
+		if (node->kind == AST_LITERAL || node->kind == AST_CLASS) {
+			next++;
+		} else if (ast_is_counter(node)) {
+			cnfa->min[next-1] = node->min ? node->min : 1;
+			cnfa->max[next-1] = node->max;
+			cnfa->num_counters++;
+		}
+	}
+	free(order.nodes);
+	return true;
+}
+
+/* counter_nfa()
+	@root           ptr to root of a syntax tree, which may have counters
+
+	@return         ptr to counter automaton equivalent to the tree, NULL if
+	                fail
+
+	Build the counter automaton of a syntax tree. The tree is unmodified.
+*/
+CounterNFA *counter_nfa(ASTNode *root)
+{
+	CounterNFA *cnfa = calloc(1, sizeof(CounterNFA));
+	if (!cnfa)
+		return NULL;
+	cnfa->pnfa = glushkov(root);
+	if (!cnfa->pnfa) {
+		destroy_counter_nfa(cnfa);
+		return NULL;
+	}
+	cnfa->min = calloc(cnfa->pnfa->size, sizeof(int));
+	cnfa->max = calloc(cnfa->pnfa->size, sizeof(int));
+	if (!cnfa->min || !cnfa->max || !number_counters(cnfa, root)) {
+		destroy_counter_nfa(cnfa);
+		return NULL;
+	}
+	return cnfa;
+}
+
+/* destroy_counter_nfa()
+	@cnfa           ptr to CounterNFA struct
+
+	Free all the memory used by a CounterNFA.
+*/
+void destroy_counter_nfa(CounterNFA *cnfa)
+{
+	if (!cnfa)
+		return;
+	destroy_position_nfa(cnfa->pnfa);
+	free(cnfa->min);
+	free(cnfa->max);
+	free(cnfa);
+}
+
+/* init_counter_vm()
+	@cnfa           ptr to CounterNFA struct
+
+	@return         ptr to dynamically allocated CounterVM, NULL if fail
+
+	Allocate the thread lists and counting sets for simulating a
+	CounterNFA. The CounterNFA must outlive the CounterVM.
+
+	The counts in a counting set are all different. A bounded counter
+	never holds more than max of them. An unbounded one only keeps the
+	youngest count that reached the minimum, so it never holds more than
+	min + 1.
+*/
+CounterVM *init_counter_vm(CounterNFA *cnfa)
+{
+	CounterVM *vm = calloc(1, sizeof(CounterVM));
+	if (!vm)
+		return NULL;
+	int size = cnfa->pnfa->size;
+	vm->cnfa = cnfa;
+	vm->clist = init_sparse_set(size);
+	vm->nlist = init_sparse_set(size);
+	vm->counts = calloc(size, sizeof(CountingSet));
+	if (!vm->clist || !vm->nlist || !vm->counts) {
+		destroy_counter_vm(vm);
+		return NULL;
+	}
+	CountingSet *cs;
+	for (int p = 0; p < size; p++) {
+		if (!cnfa->max[p])
+			continue;
+		cs = &vm->counts[p];
+		cs->capacity = cnfa->max[p] == AST_UNBOUNDED ? cnfa->min[p] + 1
+		                                             : cnfa->max[p];
+		cs->starts = malloc(cs->capacity * sizeof(int));
+		if (!cs->starts) {
+			destroy_counter_vm(vm);
+			return NULL;
+		}
+	}
+	return vm;
+}
+
+/* destroy_counter_vm()
+	@vm             ptr to CounterVM struct
+
+	Free all the memory used by a CounterVM, but not its CounterNFA.
+*/
+void destroy_counter_vm(CounterVM *vm)
+{
+	if (!vm)
+		return;
+	if (vm->counts) {
+		for (int p = 0; p < vm->cnfa->pnfa->size; p++)
+			free(vm->counts[p].starts);
+	}
+	free(vm->counts);
+	destroy_sparse_set(vm->clist);
+	destroy_sparse_set(vm->nlist);
+	free(vm);
+}
+
+/* can_leave()
+	@vm             ptr to CounterVM struct
+	@p              position of a thread
+	@now            number of chars read so far
+
+	@return         true if some thread on @p may move on to the positions
+	                after it
+
+	A count that started at char i is now - i. The oldest count is the
+	largest.
+*/
+static inline bool can_leave(CounterVM *vm, int p, int now)
+{
+	CountingSet *cs = &vm->counts[p];
+	if (!vm->cnfa->max[p])
+		return true;
+	return cs->size && now - cs->starts[cs->head] >= vm->cnfa->min[p];
+}
+
+/* count_up()
+	@vm             ptr to CounterVM struct
+	@p              counter position which just read a char
+	@now            number of chars read so far, including that char
+
+	Drop the counts that went past the maximum. For an unbounded counter,
+	drop the counts that are redundant instead: once two counts both reach
+	the minimum, they behave the same from then on.
+*/
+static void count_up(CounterVM *vm, int p, int now)
+{
+	CountingSet *cs = &vm->counts[p];
+	int max = vm->cnfa->max[p];
+	if (max == AST_UNBOUNDED) {
+		int min = vm->cnfa->min[p];
+		while (cs->size >= 2 &&
+		       now - cs->starts[(cs->head + 1) % cs->capacity] >= min) {
+			cs->head = (cs->head + 1) % cs->capacity;
+			cs->size--;
+		}
+		return;
+	}
+	while (cs->size && now - cs->starts[cs->head] > max) {
+		cs->head = (cs->head + 1) % cs->capacity;
+		cs->size--;
+	}
+}
+
+/* counter_vm_match()
+	@vm             ptr to CounterVM struct
+	@input          string to match, not necessarily null-terminated
+	@len            length of @input
+
+	@return         true if the CounterNFA accepts the entire @input,
+	                otherwise false
+
+	Run every thread in lockstep over the input. For each char, the
+	threads that may leave their position enter the positions after it
+	that read the char, which starts a new count on a counter. Then every
+	count on a counter that reads the char goes up, and the counts on one
+	that doesn't are dropped.
+*/
+bool counter_vm_match(CounterVM *vm, const char *input, int len)
+{
+	CounterNFA *cnfa = vm->cnfa;
+	PositionNFA *pnfa = cnfa->pnfa;
+	SparseSet *clist = vm->clist;
+	SparseSet *nlist = vm->nlist;
+	SparseSet *tmp;
+	// forget the counts of the previous match
+	for (int t = 0; t < clist->size; t++)
+		vm->counts[clist->dense[t]].size = 0;
+	sparse_set_clear(clist);
+	sparse_set_insert(clist, 0);
+
+	U8 ch;
+	PosList *follow;
+	CountingSet *cs;
+	int p, q, entered;
+	for (int i = 0; i < len; i++) {
+		ch = (U8)input[i];
+		sparse_set_clear(nlist);
+		for (int t = 0; t < clist->size; t++) {
+			p = clist->dense[t];
+			if (!can_leave(vm, p, i))
+				continue;
+			follow = &pnfa->follow[p];
+			for (int j = 0; j < follow->size; j++) {
+				q = follow->positions[j];
+				if (charset_has(&pnfa->chars[q], ch) &&
+				    !sparse_set_contains(nlist, q))
+					sparse_set_insert(nlist, q);
+			}
+		}
+		entered = nlist->size;
+
+		for (int t = 0; t < clist->size; t++) {
+			p = clist->dense[t];
+			if (!cnfa->max[p])
+				continue;
+			cs = &vm->counts[p];
+			if (!charset_has(&pnfa->chars[p], ch)) {
+				cs->size = 0;
+				continue;
+			}
+			count_up(vm, p, i + 1);
+			if (cs->size && !sparse_set_contains(nlist, p))
+				sparse_set_insert(nlist, p);
+		}
+		// new counts are 1 after this char
+		for (int t = 0; t < entered; t++) {
+			q = nlist->dense[t];
+			if (!cnfa->max[q])
+				continue;
+			cs = &vm->counts[q];
+			cs->starts[(cs->head + cs->size) % cs->capacity] = i;
+			cs->size++;
+		}
+
+		tmp = clist;
+		clist = nlist;
+		nlist = tmp;
+		if (clist->size == 0)
+			break;
+	}
+
+	vm->clist = clist;
+	vm->nlist = nlist;
+	for (int t = 0; t < clist->size; t++) {
+		p = clist->dense[t];
+		if (pnfa->is_accept[p] && can_leave(vm, p, len))
+			return true;
+	}
+	return false;
+}
+
+/* gen_counter_nfa_graphviz()
+	@cnfa           ptr to CounterNFA struct
+	@file_name      .dot file name
+
+	@return         0 on success, otherwise -1
+
+	Generate a Graphviz dot representation of a CounterNFA. Every edge into
+	position p is labeled with the chars of p, and a counter is labeled
+	with its counts and gets a loop for counting up.
+*/
+int gen_counter_nfa_graphviz(CounterNFA *cnfa, const char *file_name)
+{
+	FILE *f = fopen(file_name, "w");
+	if (!f)
+		return -1;
+	PositionNFA *pnfa = cnfa->pnfa;
+
+	fprintf(f, "digraph NFA {\n");
+	fprintf(f, "\tfontname = \"Helvetica,Arial,sans-serif\";\n");
+	fprintf(f, "\tnode [fontname=\"Helvetica,Arial,sans-serif\"];\n");
+	fprintf(f, "\tedge [fontname=\"Helvetica,Arial,sans-serif\"];\n");
+	fprintf(f, "\trankdir = LR;\n");
+
+	fprintf(f, "\tnode [shape=doublecircle];");
+	for (int p = 0; p < pnfa->size; p++) {
+		if (pnfa->is_accept[p])
+			fprintf(f, " n%d", p);
+	}
+	fprintf(f, ";\n");
+
+	fprintf(f, "\tnode [shape=circle];\n");
+	for (int p = 0; p < pnfa->size; p++) {
+		if (!cnfa->max[p])
+			continue;
+		fprintf(f, "\tn%d [label=\"n%d\\n{%d,", p, p, cnfa->min[p]);
+		if (cnfa->max[p] != AST_UNBOUNDED)
+			fprintf(f, "%d", cnfa->max[p]);
+		fprintf(f, "}\"]\n");
+		fprintf(f, "\tn%d -> n%d [style=dashed, label=\"", p, p);
+		generate_transition_label(f, &pnfa->chars[p]);
+		fprintf(f, " ++\"]\n");
+	}
+	int q;
+	for (int p = 0; p < pnfa->size; p++) {
+		for (int i = 0; i < pnfa->follow[p].size; i++) {
+			q = pnfa->follow[p].positions[i];
+			fprintf(f, "\tn%d -> n%d [label=\"", p, q);
+			generate_transition_label(f, &pnfa->chars[q]);
+			fprintf(f, "\"]\n");
+		}
+	}
+	fprintf(f, "}\n");
+
+	fclose(f);
+	return 0;
+}
\ No newline at end of file
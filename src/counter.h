@@ -0,0 +1,57 @@
+/** counter.h
+
+Module definition for counter automata, which match large repeat counts in
+constant space.
+
+*/
+
+#ifndef COUNTER_H
+#define COUNTER_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "common.h"
+#include "glushkov.h"
+#include "simulate.h"
+
+// values of one position's counter across all threads, see counter.c
+typedef struct CountingSet {
+	int *starts;  // ring buffer of when each value started, oldest first
+	int head;
+	int size;
+	int capacity;
+} CountingSet;
+
+typedef struct CounterNFA {
+	PositionNFA *pnfa;
+	int *min;
+	int *max;
+	/*
+	Position p is a counter iff max[p] != 0, eg the [a-z] of [a-z]{3,8}
+	has min[p] = 3 and max[p] = 8. A thread can only leave p once it has
+	read at least min[p] chars there, and it can't read more than max[p],
+	which may be AST_UNBOUNDED. min[p] is at least 1, since the position
+	always reads one char. Whether the repeat can be skipped entirely is
+	part of the nullable property, like for any other subtree.
+	*/
+	int num_counters;
+} CounterNFA;
+
+typedef struct CounterVM {
+	CounterNFA *cnfa;  // not owned by the CounterVM
+	SparseSet *clist;
+	SparseSet *nlist;
+	CountingSet *counts;  // counts[p] is empty unless p is in clist
+} CounterVM;
+
+CounterNFA *counter_nfa(ASTNode *root);
+void destroy_counter_nfa(CounterNFA *cnfa);
+
+CounterVM *init_counter_vm(CounterNFA *cnfa);
+void destroy_counter_vm(CounterVM *vm);
+bool counter_vm_match(CounterVM *vm, const char *input, int len);
+
+int gen_counter_nfa_graphviz(CounterNFA *cnfa, const char *file_name);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,700 @@
+/** derivative.c
+
+Build DFAs directly out of regexes with Brzozowski derivatives, skipping NFAs
+entirely.
+
+The derivative of a regex r with respect to a char c matches every string s
+such that r matches cs. So each DFA state is a regex, and it transitions on c to
+its derivative. A state accepts if its regex matches the empty string.
+
+Derivatives only lead to finitely many states if equivalent regexes are
+recognized, so every term is hash-consed and alternations are normalized for
+associativity, commutativity, and idempotence. That's enough to guarantee
+termination, and the DFA is usually close to minimal. Since hash-consed terms
+are compared by pointer, there are no epsilon closures and no set comparisons.
+
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "budget.h"
+#include "charset.h"
+#include "common.h"
+#include "derivative.h"
+#include "dfa.h"
+#include "set.h"
+
+#define INITIAL_BUCKETS 256
+
+static Term *hash_cons(TermTable *tt, int kind, const CharSet *chars,
+                       Term *left, Term *right);
+
+/* init_term_table()
+	@return         ptr to dynamically allocated TermTable, NULL if fail
+
+	Dynamically allocate a TermTable which already holds the empty and
+	epsilon terms.
+*/
+TermTable *init_term_table(void)
+{
+	TermTable *tt = calloc(1, sizeof(TermTable));
+	if (!tt)
+		return NULL;
+	tt->num_buckets = INITIAL_BUCKETS;
+	tt->buckets = calloc(tt->num_buckets, sizeof(Term *));
+	if (!tt->buckets) {
+		free(tt);
+		return NULL;
+	}
+	for (int ch = 0; ch < NUM_CHARS; ch++)
+		tt->mappings[ch] = -1;
+	tt->empty = hash_cons(tt, TERM_EMPTY, NULL, NULL, NULL);
+	tt->epsilon = hash_cons(tt, TERM_EPSILON, NULL, NULL, NULL);
+	if (!tt->empty || !tt->epsilon) {
+		destroy_term_table(tt);
+		return NULL;
+	}
+	return tt;
+}
+
+/* destroy_term_table()
+	@tt             ptr to TermTable struct
+
+	Free all the memory used by a TermTable, including every term in it.
+*/
+void destroy_term_table(TermTable *tt)
+{
+	if (!tt)
+		return;
+	Term *curr, *next;
+	for (int i = 0; i < tt->num_buckets; i++) {
+		for (curr = tt->buckets[i]; curr; curr = next) {
+			next = curr->next;
+			free(curr->derivs);
+			free(curr);
+		}
+	}
+	free(tt->buckets);
+	free(tt);
+}
+
+/* compare_terms()
+	@t1             ptr to Term struct
+	@t2             ptr to another Term struct
+
+	@return         any value indicating the following:
+	                >0: t1 id goes after t2
+	                =0: t1 id is t2
+	                <0: t1 id goes before t2
+
+	Check whether two terms have the same id.
+*/
+int compare_terms(const void *t1, const void *t2)
+{
+	return ((Term *)t1)->id - ((Term *)t2)->id;
+}
+
+/* hash_term()
+	@kind           term kind
+	@chars          chars of a TERM_CLASS, NULL for other kinds
+	@left           left child or NULL
+	@right          right child or NULL
+
+	@return         hash of the term's structure
+
+	Children are identified by id, which is fine since they were
+	hash-consed already.
+*/
+static unsigned hash_term(int kind, const CharSet *chars, Term *left,
+                          Term *right)
+{
+	unsigned h = kind;
+	U64 word;
+	for (int i = 0; chars && i < CHARSET_WORDS; i++) {
+		word = chars->bits[i];
+		h = h * 31 + (unsigned)(word ^ (word >> 32));
+	}
+	h = h * 31 + (left ? left->id : -1);
+	h = h * 31 + (right ? right->id : -1);
+	return h ^ (h >> 16);
+}
+
+/* grow_table()
+	@tt             ptr to TermTable struct
+
+	@return         true if success, otherwise false
+
+	Double the number of buckets and rehash every term.
+*/
+static bool grow_table(TermTable *tt)
+{
+	int num_buckets = tt->num_buckets * 2;
+	Term **buckets = calloc(num_buckets, sizeof(Term *));
+	if (!buckets)
+		return false;
+	Term *curr, *next;
+	unsigned h;
+	for (int i = 0; i < tt->num_buckets; i++) {
+		for (curr = tt->buckets[i]; curr; curr = next) {
+			next = curr->next;
+			h = hash_term(curr->kind, curr->kind == TERM_CLASS ?
+			              &curr->chars : NULL, curr->left,
+			              curr->right);
+			curr->next = buckets[h % num_buckets];
+			buckets[h % num_buckets] = curr;
+		}
+	}
+	free(tt->buckets);
+	tt->buckets = buckets;
+	tt->num_buckets = num_buckets;
+	return true;
+}
+
+/* hash_cons()
+	@tt             ptr to TermTable struct
+	@kind           term kind
+	@chars          chars of a TERM_CLASS, NULL for other kinds
+	@left           left child or NULL
+	@right          right child or NULL
+
+	@return         ptr to the unique term with this structure, NULL if fail
+
+	Find the term with this exact structure, or make it if it doesn't exist
+	yet. Doesn't do any normalization, that's up to the smart constructors.
+*/
+static Term *hash_cons(TermTable *tt, int kind, const CharSet *chars,
+                       Term *left, Term *right)
+{
+	unsigned h = hash_term(kind, chars, left, right);
+	Term *term = tt->buckets[h % tt->num_buckets];
+	for (; term; term = term->next) {
+		if (term->kind == kind && term->left == left &&
+		    term->right == right &&
+		    (!chars || charset_equal(&term->chars, chars)))
+			return term;
+	}
+
+	if (tt->size >= tt->num_buckets && !grow_table(tt))
+		return NULL;
+	term = calloc(1, sizeof(Term));
+	if (!term)
+		return NULL;
+	term->kind = kind;
+	if (chars) {
+		term->chars = *chars;
+		tt->stale_classes = true;
+	}
+	term->left = left;
+	term->right = right;
+	term->id = tt->size++;
+	switch (kind) {
+	case TERM_EPSILON:
+	case TERM_STAR:   term->nullable = true; break;
+	case TERM_CONCAT: term->nullable = left->nullable && right->nullable;
+	                  break;
+	case TERM_ALT:    term->nullable = left->nullable || right->nullable;
+	                  break;
+	default:          term->nullable = false; break;
+	}
+	term->next = tt->buckets[h % tt->num_buckets];
+	tt->buckets[h % tt->num_buckets] = term;
+	return term;
+}
+
+/* term_char()
+	@tt             ptr to TermTable struct
+	@ch             the literal character
+
+	@return         ptr to term that matches @ch, NULL if fail
+
+	Make a term that matches one character, and add it to the alphabet.
+*/
+Term *term_char(TermTable *tt, U8 ch)
+{
+	CharSet chars = {{0}};
+	charset_add(&chars, ch);
+	return term_class(tt, &chars);
+}
+
+/* term_class()
+	@tt             ptr to TermTable struct
+	@chars          ptr to the chars the term matches
+
+	@return         ptr to term that matches any one of @chars, NULL if fail
+
+	Make a term that matches one character out of a set, and add them to
+	the alphabet. A class stays a single leaf, so eg [a-z] is differentiated
+	once per byte class instead of being an alternation of 26 chars.
+*/
+Term *term_class(TermTable *tt, const CharSet *chars)
+{
+	if (charset_is_empty(chars))
+		return tt->empty;
+	charset_union(&tt->alphabet, chars);
+	return hash_cons(tt, TERM_CLASS, chars, NULL, NULL);
+}
+
+/* update_classes()
+	@tt             ptr to TermTable struct
+
+	@return         true if success, otherwise false
+
+	Partition the chars into the byte classes of every leaf in the table,
+	see byte_classes(). Memoized derivatives are indexed by class, so
+	they're all dropped if the partition changed.
+*/
+static bool update_classes(TermTable *tt)
+{
+	CharSet *labels = malloc(tt->size * sizeof(CharSet));
+	if (!labels)
+		return false;
+	int num_labels = 0;
+	Term *curr;
+	for (int i = 0; i < tt->num_buckets; i++) {
+		for (curr = tt->buckets[i]; curr; curr = curr->next) {
+			if (curr->kind == TERM_CLASS)
+				labels[num_labels++] = curr->chars;
+		}
+	}
+	int mappings[NUM_CHARS];
+	int num_classes = byte_classes(labels, num_labels, mappings);
+	free(labels);
+
+	// classes are numbered by their smallest char, so the same partition
+	// always has the same mappings
+	if (memcmp(mappings, tt->mappings, sizeof(mappings)) != 0) {
+		for (int i = 0; i < tt->num_buckets; i++) {
+			for (curr = tt->buckets[i]; curr; curr = curr->next) {
+				free(curr->derivs);
+				curr->derivs = NULL;
+			}
+		}
+		memcpy(tt->mappings, mappings, sizeof(mappings));
+	}
+	tt->num_classes = num_classes;
+	tt->stale_classes = false;
+	return true;
+}
+
+/* term_concat()
+	@tt             ptr to TermTable struct
+	@lhs            ptr to term
+	@rhs            ptr to another term
+
+	@return         ptr to concatenation of the terms, NULL if fail
+
+	Concatenate two terms, simplifying with
+		∅r = r∅ = ∅
+		εr = rε = r
+		(rs)t = r(st)
+*/
+Term *term_concat(TermTable *tt, Term *lhs, Term *rhs)
+{
+	if (!lhs || !rhs)
+		return NULL;
+	if (lhs == tt->empty || rhs == tt->empty)
+		return tt->empty;
+	if (lhs == tt->epsilon)
+		return rhs;
+	if (rhs == tt->epsilon)
+		return lhs;
+	if (lhs->kind == TERM_CONCAT)
+		return term_concat(tt, lhs->left,
+		                   term_concat(tt, lhs->right, rhs));
+	return hash_cons(tt, TERM_CONCAT, NULL, lhs, rhs);
+}
+
+/* count_alts()
+	@term           ptr to term
+
+	@return         number of alternatives in @term
+
+	Count the alternatives in a normalized alternation, or 1 if @term isn't
+	an alternation.
+*/
+static int count_alts(Term *term)
+{
+	int count = 1;
+	for (; term->kind == TERM_ALT; term = term->right)
+		count++;
+	return count;
+}
+
+/* next_alt()
+	@term           ptr to ptr to the rest of an alternation
+
+	@return         the next alternative
+
+	Pop the first alternative off a normalized alternation.
+*/
+static Term *next_alt(Term **term)
+{
+	Term *alt = *term;
+	if (alt->kind != TERM_ALT) {
+		*term = NULL;
+		return alt;
+	}
+	*term = alt->right;
+	return alt->left;
+}
+
+/* term_alt()
+	@tt             ptr to TermTable struct
+	@lhs            ptr to term
+	@rhs            ptr to another term
+
+	@return         ptr to alternation of the terms, NULL if fail
+
+	Unite two terms, simplifying with
+		r|∅ = ∅|r = r
+		r|r = r
+		r|s = s|r
+		(r|s)|t = r|(s|t)
+	Both terms are already normalized, so their alternatives are merged
+	like two sorted lists.
+*/
+Term *term_alt(TermTable *tt, Term *lhs, Term *rhs)
+{
+	if (!lhs || !rhs)
+		return NULL;
+	if (lhs == rhs || rhs == tt->empty)
+		return lhs;
+	if (lhs == tt->empty)
+		return rhs;
+
+	Term **alts = malloc((count_alts(lhs) + count_alts(rhs)) *
+	                     sizeof(Term *));
+	if (!alts)
+		return NULL;
+	int n = 0;
+	Term *a = next_alt(&lhs);
+	Term *b = next_alt(&rhs);
+	do {
+		if (!b || (a && a->id < b->id)) {
+			alts[n++] = a;
+			a = lhs ? next_alt(&lhs) : NULL;
+		} else if (!a || b->id < a->id) {
+			alts[n++] = b;
+			b = rhs ? next_alt(&rhs) : NULL;
+		} else {
+			alts[n++] = a;
+			a = lhs ? next_alt(&lhs) : NULL;
+			b = rhs ? next_alt(&rhs) : NULL;
+		}
+	} while (a || b);
+
+	Term *result = alts[n-1];
+	for (int i = n-2; i >= 0 && result; i--)
+		result = hash_cons(tt, TERM_ALT, NULL, alts[i], result);
+	free(alts);
+	return result;
+}
+
+/* term_star()
+	@tt             ptr to TermTable struct
+	@term           ptr to term
+
+	@return         ptr to Kleene closure of the term, NULL if fail
+
+	Apply the Kleene star to a term, simplifying with
+		r** = r*
+		ε* = ∅* = ε
+*/
+Term *term_star(TermTable *tt, Term *term)
+{
+	if (!term)
+		return NULL;
+	if (term->kind == TERM_STAR)
+		return term;
+	if (term == tt->empty || term == tt->epsilon)
+		return tt->epsilon;
+	return hash_cons(tt, TERM_STAR, NULL, term, NULL);
+}
+
+/* term_from_ast()
+	@tt             ptr to TermTable struct
+	@root           ptr to root of a syntax tree
+
+	@return         ptr to term equivalent to the tree, NULL if fail
+
+	Convert a syntax tree to a term. A class stays one leaf, r? becomes
+	ε|r, and r+ becomes rr*.
+
+	Each node on the work stack is visited twice: first to push its
+	operands above it, then to combine their terms once they're all done.
+	The operands of a concatenation are all of its factors, which are
+	concatenated from the right. Terms are right-nested, so doing it from
+	the left like the parser's left-deep tree would rebuild the whole
+	concatenation for every factor.
+*/
+Term *term_from_ast(TermTable *tt, ASTNode *root)
+{
+	int num_nodes = count_nodes(root);
+	if (num_nodes < 0)
+		return NULL;
+	// work[i] waits on the terms from terms[base[i]] onward, base[i] is -1
+	// until its operands are pushed
+	ASTNode **work = malloc(num_nodes * sizeof(ASTNode *));
+	int *base = malloc(num_nodes * sizeof(int));
+	Term **terms = malloc(num_nodes * sizeof(Term *));
+	NodeList operands = {NULL, 0, 0};
+	Term *result = NULL;
+	bool ok = work && base && terms;
+	int top = 0;
+	int size = 0;
+	if (ok) {
+		work[top] = root;
+		base[top++] = -1;
+	}
+
+	ASTNode *node;
+	Term *lhs;
+	int first;
+	while (ok && top > 0) {
+		node = work[top-1];
+		if (base[top-1] == -1) {
+			base[top-1] = size;
+			operands.size = 0;
+			if (node->kind == AST_CONCAT || node->kind == AST_ALT)
+				ok = ast_flatten(node, node->kind, &operands);
+			else if (node->kind == AST_REPEAT)
+				ok = push_node(&operands, node->left);
+			// the leftmost operand is converted first
+			for (int i = operands.size - 1; ok && i >= 0; i--) {
+				work[top] = operands.nodes[i];
+				base[top++] = -1;
+			}
+			continue;
+		}
+
+		first = base[--top];
+		switch (node->kind) {
+		case AST_LITERAL:
+		case AST_CLASS:
+			result = term_class(tt, &node->chars);
+			break;
+		case AST_CONCAT:
+			result = terms[size-1];
+			for (int i = size - 2; i >= first; i--)
+				result = term_concat(tt, terms[i], result);
+			break;
+		case AST_ALT:
+			result = terms[first];
+			for (int i = first + 1; i < size; i++)
+				result = term_alt(tt, result, terms[i]);
+			break;
+		case AST_REPEAT:
+			// only *, ?, and + reach here
+			lhs = terms[first];
+			if (node->max != AST_UNBOUNDED)
+				result = term_alt(tt, tt->epsilon, lhs);
+			else if (node->min == 0)
+				result = term_star(tt, lhs);
+			else
+				result = term_concat(tt, lhs,
+				                     term_star(tt, lhs));
+			break;
+		}
+		size = first;
+		ok = result;
+		terms[size++] = result;
+	}
+
+	free(work);
+	free(base);
+	free(terms);
+	free(operands.nodes);
+	return ok ? result : NULL;
+}
+
+/* derivative()
+	@tt             ptr to TermTable struct
+	@term           ptr to term
+	@ch             char to differentiate by
+
+	@return         ptr to the derivative of @term with respect to @ch, NULL
+	                if fail
+
+	Compute the Brzozowski derivative:
+		d(∅) = d(ε) = ∅
+		d([...c...]) = ε, d(class without c) = ∅
+		d(r|s) = d(r)|d(s)
+		d(rs) = d(r)s|d(s) if r is nullable, otherwise d(r)s
+		d(r*) = d(r)r*
+	Results are memoized per byte class since the same subterms get
+	differentiated over and over while building a DFA.
+*/
+Term *derivative(TermTable *tt, Term *term, U8 ch)
+{
+	if (tt->stale_classes && !update_classes(tt))
+		return NULL;
+	int c = tt->mappings[ch];
+	if (c == -1)
+		return tt->empty;  // no leaf matches @ch
+	if (term->derivs && term->derivs[c])
+		return term->derivs[c];
+
+	Term *result;
+	switch (term->kind) {
+	case TERM_CLASS:
+		return charset_has(&term->chars, ch) ? tt->epsilon : tt->empty;
+	case TERM_CONCAT:
+		result = term_concat(tt, derivative(tt, term->left, ch),
+		                     term->right);
+		if (term->left->nullable)
+			result = term_alt(tt, result,
+			                  derivative(tt, term->right, ch));
+		break;
+	case TERM_ALT:
+		result = term_alt(tt, derivative(tt, term->left, ch),
+		                  derivative(tt, term->right, ch));
+		break;
+	case TERM_STAR:
+		result = term_concat(tt, derivative(tt, term->left, ch), term);
+		break;
+	default:
+		return tt->empty;
+	}
+
+	if (!result)
+		return NULL;
+	if (!term->derivs)
+		term->derivs = calloc(tt->num_classes, sizeof(Term *));
+	if (term->derivs)
+		term->derivs[c] = result;
+	return result;
+}
+
+/* derivative_dfa()
+	@tt             ptr to TermTable struct
+	@term           ptr to term
+
+	@return         ptr to a new DFA that's equivalent to @term, NULL if fail
+
+	Build a DFA out of a term with Brzozowski derivatives.
+*/
+DFA *derivative_dfa(TermTable *tt, Term *term)
+{
+	return bounded_derivative_dfa(tt, term, NULL);
+}
+
+/* add_term_state()
+	@dfa            ptr to the DFA under construction
+	@term           ptr to term that forms the new DFAState
+
+	@return         ptr to the new DFAState, NULL if fail or if the DFA's
+	                budget was exceeded
+
+	Create a DFAState for a term. Its set of constituent states holds the
+	term itself.
+*/
+static DFAState *add_term_state(DFA *dfa, Term *term)
+{
+	Set *states = init_set(compare_terms);
+	if (!states)
+		return NULL;
+	DFAState *state = NULL;
+	if (set_insert(states, term) == INSERT_SUCCESS)
+		state = add_dfastate(dfa, states, term->nullable);
+	if (!state)
+		destroy_set(states);
+	return state;
+}
+
+/* bounded_derivative_dfa()
+	@tt             ptr to TermTable struct
+	@term           ptr to term
+	@budget         ptr to Budget struct, NULL if unlimited
+
+	@return         ptr to a new DFA that's equivalent to @term, NULL if fail
+	                or if the budget was exceeded
+
+	Build a DFA out of a term with Brzozowski derivatives, without
+	exceeding a budget, and populate the internal tables in the DFA struct.
+	Every DFAState holds a term instead of NFAStates, so don't print the
+	constituent states with gen_dfa_graphviz(). @tt must outlive the DFA.
+*/
+DFA *bounded_derivative_dfa(TermTable *tt, Term *term, Budget *budget)
+{
+	if (!budget_add_bytes(budget, sizeof(DFA)))
+		return NULL;
+	// the DFA gets the byte classes of the leaves, so each state takes
+	// one derivative per class, by its smallest char
+	if (tt->stale_classes && !update_classes(tt))
+		return NULL;
+	CharSet labels[NUM_CHARS] = {{{0}}};
+	for (int ch = 0; ch < NUM_CHARS; ch++) {
+		if (tt->mappings[ch] != -1)
+			charset_add(&labels[tt->mappings[ch]], ch);
+	}
+	DFA *dfa = init_dfa_with_labels(labels, tt->num_classes);
+	if (!dfa)
+		return NULL;
+	dfa->budget = budget;
+
+	// DFAStates in order of their index, which doubles as the worklist
+	int capacity = 16;
+	DFAState **states = malloc(capacity * sizeof(DFAState *));
+	// maps term id to its DFAState, if it has one
+	int num_ids = tt->size;
+	DFAState **by_id = calloc(num_ids, sizeof(DFAState *));
+	if (!states || !by_id || !budget_add_bytes(budget, dfa->alphabet_size))
+		goto FAIL;
+	if (!(dfa->start = add_term_state(dfa, term)))
+		goto FAIL;
+	states[0] = by_id[term->id] = dfa->start;
+
+	DFAState *qstate, *found;
+	Term *q, *t;
+	void *grown;
+	for (int next = 0; next < dfa->mem_region->size; next++) {
+		qstate = states[next];
+		q = (Term *)(qstate->constituent_nfastates->head->element);
+		for (int i = 0; i < dfa->alphabet_size; i++) {
+			t = derivative(tt, q, dfa->alphabet[i]);
+			if (!t)
+				goto FAIL;
+			if (t == tt->empty)
+				continue;  // dead state
+			if (t->id >= num_ids) {
+				// differentiating made new terms
+				grown = realloc(by_id, tt->size * sizeof(DFAState *));
+				if (!grown)
+					goto FAIL;
+				by_id = grown;
+				for (; num_ids < tt->size; num_ids++)
+					by_id[num_ids] = NULL;
+			}
+			found = by_id[t->id];
+			if (!found) {
+				// t represents a new DFA state
+				if (!(found = add_term_state(dfa, t)))
+					goto FAIL;
+				if (dfa->mem_region->size > capacity) {
+					capacity *= 2;
+					grown = realloc(states, capacity *
+					                sizeof(DFAState *));
+					if (!grown)
+						goto FAIL;
+					states = grown;
+				}
+				states[found->index] = by_id[t->id] = found;
+			}
+			// i automatically maps to an outs[] index
+			qstate->outs[i] = found;
+		}
+	}
+	free(states);
+	free(by_id);
+	dfa->size = dfa->mem_region->size;
+	return build_dfa_tables(dfa);
+
+FAIL:
+	free(states);
+	free(by_id);
+	destroy_dfa(dfa);
+	return NULL;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+/** derivative.h
+
+Module definition for Brzozowski derivatives of regex terms.
+
+*/
+
+#ifndef DERIVATIVE_H
+#define DERIVATIVE_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "budget.h"
+#include "charset.h"
+#include "common.h"
+#include "dfa.h"
+#include "set.h"
+
+// term kinds
+#define TERM_EMPTY      0  // matches nothing
+#define TERM_EPSILON    1  // matches only the empty string
+#define TERM_CLASS      2  // matches one char of a set
+#define TERM_CONCAT     3
+#define TERM_ALT        4
+#define TERM_STAR       5
+
+typedef struct Term {
+	int kind;
+	CharSet chars;  // only meaningful for TERM_CLASS
+	bool nullable;
+	int id;  // unique per TermTable, so equal terms have equal ids
+	struct Term *left;
+	struct Term *right;
+	/*
+	TERM_CONCAT and TERM_ALT have both children
+	TERM_STAR only has a left child
+
+	Alternations are normalized into a right-nested list whose left
+	children are sorted by id, with no duplicates, no TERM_EMPTY, and no
+	nested TERM_ALT. Concatenations are right-nested too. So two
+	alternations with the same alternatives are always the same Term.
+	*/
+	struct Term **derivs;  // memoized derivatives indexed by byte class,
+	                       // NULL until the term gets differentiated
+	struct Term *next;     // next term in the same hash bucket
+} Term;
+
+typedef struct TermTable {
+	Term **buckets;
+	/*
+	Hash-consing table. Every term is built by a smart constructor which
+	first looks for an identical term in here, so structurally equal terms
+	are always the same pointer and can be compared in O(1).
+	The table owns every Term.
+	*/
+	int num_buckets;
+	int size;  // number of terms, also the next unused id
+
+	Term *empty;
+	Term *epsilon;
+
+	CharSet alphabet;  // every char that appears in a TERM_CLASS
+
+	int mappings[NUM_CHARS];
+	/*
+	Maps a char to its byte class, -1 if no TERM_CLASS has it. Chars of
+	the same class are in exactly the same leaves, so every term has the
+	same derivative by all of them, and only memoizes one per class.
+	*/
+	int num_classes;
+	bool stale_classes;  // a leaf was made since the classes were computed
+} TermTable;
+
+TermTable *init_term_table(void);
+void destroy_term_table(TermTable *tt);
+int compare_terms(const void *t1, const void *t2);
+
+Term *term_char(TermTable *tt, U8 ch);
+Term *term_class(TermTable *tt, const CharSet *chars);
+Term *term_concat(TermTable *tt, Term *lhs, Term *rhs);
+Term *term_alt(TermTable *tt, Term *lhs, Term *rhs);
+Term *term_star(TermTable *tt, Term *term);
+Term *term_from_ast(TermTable *tt, ASTNode *root);
+
+Term *derivative(TermTable *tt, Term *term, U8 ch);
+DFA *derivative_dfa(TermTable *tt, Term *term);
+DFA *bounded_derivative_dfa(TermTable *tt, Term *term, Budget *budget);
+
+#endif
\ No newline at end of file
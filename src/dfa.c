@@ -6,16 +6,19 @@ construction.
 */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "budget.h"
+#include "charset.h"
 #include "common.h"
 #include "dfa.h"
 #include "nfa.h"
 #include "set.h"
 
 /* init_dfastate()
-	@alphabet_size  number of characters in an NFA's alphabet
+	@alphabet_size  number of byte classes in the alphabet
 
 	@return         ptr to dynamically allocated DFAState, or NULL if fail
 
@@ -79,71 +82,73 @@ int compare_dfastates(const void *d1, const void *d2)
 	return ((DFAState *)d1)->index - ((DFAState *)d2)->index;
 }
 
-/* count_bits
-	@x              64-bit unsigned integer
-
-	@return         number of 1-bits in the integer
+/* init_dfa()
+	@nfa            ptr to NFA which is used to construct the DFA
 
-	Counts the number of 1 bits in @x.
+	@return         ptr to dynamically allocated DFA, or NULL if fail
 
-	Taken from https://en.wikipedia.org/wiki/Hamming_weight
-	The NFA alphabet bitfield is likely to have large contiguous chunks of
-	1 bits. There will be large contiguous chunks of 0s, so I could use the
-	Wegner algorithm, but there are very few chunks of 0s compared to the
-	amount of 1s. I would spend more time iterating over the chunk of 1s
-	even though there are lots of 0s.
-	So I opted for the popcount64c() implementation.
+	Dynamically allocate a DFA struct and initialize its members, using a
+	base NFA as a guide.
 */
-static int count_bits(U64 x)
+DFA *init_dfa(NFA *nfa)
 {
-	x -= (x >> 1) & 0x5555555555555555;
-	x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
-	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
-	return (x * 0x0101010101010101) >> 56;
+	CharSet *labels = malloc(nfa->mem_region->size * sizeof(CharSet));
+	if (!labels)
+		return NULL;
+	int num_labels = 0;
+	NFAState *state;
+	for (Iterator *it = set_begin(nfa->mem_region); it; advance_iter(&it)) {
+		state = (NFAState *)(it->element);
+		if (state->ch != EPSILON)
+			labels[num_labels++] = state->chars;
+	}
+	DFA *dfa = init_dfa_with_labels(labels, num_labels);
+	free(labels);
+	return dfa;
 }
 
-/* init_dfa()
-	@nfa            ptr to NFA which is used to construct the DFA
+/* init_dfa_with_labels()
+	@labels         array of the chars of every transition of the automaton
+	                the DFA is built from
+	@num_labels     number of CharSets in @labels
 
 	@return         ptr to dynamically allocated DFA, or NULL if fail
 
-	Dynamically allocate a DFA struct and initialize its members, using a
-	base NFA as a guide.
+	Dynamically allocate a DFA struct and initialize its members, for
+	constructions that don't start from a Thompson NFA. The alphabet is
+	every byte class of the labels.
 */
-DFA *init_dfa(NFA *nfa)
+DFA *init_dfa_with_labels(const CharSet *labels, int num_labels)
 {
 	DFA *dfa = calloc(1, sizeof(DFA));
 	if (!dfa)
 		return NULL;
 
-	dfa->alphabet_size = count_bits(nfa->alphabet0_63);
-	dfa->alphabet_size += count_bits(nfa->alphabet64_127);
-
-	dfa->alphabet = malloc(dfa->alphabet_size);
+	dfa->alphabet_size = byte_classes(labels, num_labels, dfa->mappings);
+	// one extra so nothing is malloc(0)
+	dfa->alphabet = malloc(dfa->alphabet_size + 1);
+	dfa->classes = calloc(dfa->alphabet_size + 1, sizeof(CharSet));
 	dfa->accepts = init_set(compare_dfastates);
 	dfa->mem_region = init_set(compare_sets);
-	if (!(dfa->alphabet || dfa->accepts || dfa->mem_region)) {
+	if (!dfa->alphabet || !dfa->classes || !dfa->accepts ||
+	    !dfa->mem_region) {
 		destroy_set(dfa->accepts);
 		destroy_set(dfa->mem_region);
 		free(dfa->alphabet);
+		free(dfa->classes);
 		free(dfa);
 		return NULL;
 	}
 
-	// build alphabet and its mapping to an index into state->outs[]
-	U8 ascii = 0;
-	int i = 0;
-	U64 bitfield = nfa->alphabet0_63;
-	while (ascii < NUM_ASCII_CHARS) {
-		if (bitfield & 1) {
-			dfa->alphabet[i] = ascii;
-			dfa->mappings[ascii] = i;
-			i++;
-		}
-		ascii++;
-		bitfield >>= 1;
-		if (ascii == NUM_ASCII_CHARS / 2)
-			bitfield = nfa->alphabet64_127;
+	// walk down from the highest char, so the char that ends up in
+	// alphabet[] is the smallest of its class
+	int c;
+	for (int ch = NUM_CHARS - 1; ch >= 0; ch--) {
+		c = dfa->mappings[ch];
+		if (c == -1)
+			continue;
+		dfa->alphabet[c] = ch;
+		charset_add(&dfa->classes[c], ch);
 	}
 	return dfa;
 
@@ -161,6 +166,7 @@ void destroy_dfa(DFA *dfa)
 	if (!dfa)
 		return;
 	free(dfa->alphabet);
+	free(dfa->classes);
 	destroy_set(dfa->accepts);
 
 	// for each set in the set of sets of nfastates
@@ -189,8 +195,8 @@ void destroy_dfa(DFA *dfa)
 
 	@return         set of NFA states reachable from @nfastates via @ch
 
-	For each state in @nfastates, transition on @ch and find the epsilon
-	closure of that transition (if any). Aggregate all the epsilon closures
+	For each state in @nfastates whose transition reads @ch, find the
+	epsilon closure of that transition. Aggregate all the epsilon closures
 	into one set.
 */
 Set *epsilon_closure_delta(Set *nfastates, U8 ch)
@@ -200,7 +206,7 @@ Set *epsilon_closure_delta(Set *nfastates, U8 ch)
 	NFAState *nfastate;
 	for (Iterator *it = set_begin(nfastates); it; advance_iter(&it)) {
 		nfastate = (NFAState *)(it->element);
-		if (nfastate->ch == ch) {
+		if (nfastate_reads(nfastate, ch)) {
 			epsilon = epsilon_closure(nfastate->out1);
 			result = set_union(result, epsilon);
 			destroy_set(epsilon);
@@ -218,29 +224,95 @@ Set *epsilon_closure_delta(Set *nfastates, U8 ch)
 */
 DFA *subset(NFA *nfa)
 {
-	DFA *dfa = init_dfa(nfa);
-	int state_index = 0;
+	return bounded_subset(nfa, NULL);
+}
+
+/* charge_dfastate()
+	@budget         ptr to Budget struct, NULL if unlimited
+	@dfa            ptr to the DFA under construction
+	@states         set of states that forms the new DFAState
+
+	@return         true if the budget can afford the new DFAState,
+	                otherwise false
+
+	Charge one new DFAState and its constituent states to a budget.
+*/
+static bool charge_dfastate(Budget *budget, DFA *dfa, Set *states)
+{
+	size_t bytes = sizeof(DFAState);
+	bytes += dfa->alphabet_size * sizeof(DFAState *);
+	bytes += sizeof(Set) + states->size * sizeof(Node);
+	// one node in dfa->mem_region, maybe one in the worklist
+	bytes += 2 * sizeof(Node);
+	return budget_add_states(budget, 1) && budget_add_bytes(budget, bytes);
+}
+
+/* add_dfastate()
+	@dfa            ptr to the DFA under construction
+	@states         set of states that forms the new DFAState
+	@is_accept      whether the new DFAState accepts
+
+	@return         ptr to the new DFAState, NULL if fail or if the DFA's
+	                budget was exceeded
+
+	Create the next DFAState out of a set of constituent states and
+	doubly-link the two. The DFA takes ownership of @states on success,
+	otherwise the caller still owns it.
+*/
+DFAState *add_dfastate(DFA *dfa, Set *states, bool is_accept)
+{
+	if (!charge_dfastate(dfa->budget, dfa, states))
+		return NULL;
+	DFAState *state = init_dfastate(dfa->alphabet_size);
+	if (!state)
+		return NULL;
+	if (set_insert(dfa->mem_region, states) == INSERT_ERROR) {
+		destroy_dfastate(state);
+		return NULL;
+	}
+	state->index = dfa->mem_region->size - 1;
+	states->id = state;
+	state->constituent_nfastates = states;
+	if (is_accept) {
+		state->is_accept = true;
+		set_insert(dfa->accepts, state);
+	}
+	return state;
+}
+
+/* bounded_subset()
+	@nfa            ptr to NFA struct
+	@budget         ptr to Budget struct, NULL if unlimited
 
-	DFAState *start = init_dfastate(dfa->alphabet_size);
-	start->index = state_index;
-	state_index++;
-	dfa->start = start;
+	@return         the NFA's equivalent DFA, or NULL if fail or if the
+	                budget was exceeded
+
+	Convert an NFA to a DFA via the subset construction, but give up as
+	soon as the DFA would need more states or bytes than the budget allows.
+	@budget->status tells which cap was exceeded.
+*/
+DFA *bounded_subset(NFA *nfa, Budget *budget)
+{
+	if (!budget_add_bytes(budget, sizeof(DFA)))
+		return NULL;
+	DFA *dfa = init_dfa(nfa);
+	if (!dfa)
+		return NULL;
+	dfa->budget = budget;
 
 	Set *q0 = epsilon_closure(nfa->start);
-	// doubly link the DFA state and the set of NFA states
-	q0->id = start;
-	start->constituent_nfastates = q0;
-	if (set_find(q0, nfa->accept)) {
-		start->is_accept = true;
-		set_insert(dfa->accepts, start);
+	if (!budget_add_bytes(budget, dfa->alphabet_size) ||
+	    !(dfa->start = add_dfastate(dfa, q0, set_find(q0, nfa->accept)))) {
+		destroy_set(q0);
+		destroy_dfa(dfa);
+		return NULL;
 	}
-	set_insert(dfa->mem_region, q0);
 
 	Set *worklist = init_set(compare_sets);
 	set_insert(worklist, q0);
 
 	Set *q, *t, *found;
-	DFAState *new, *qstate;
+	DFAState *qstate;
 	U8 ch;
 	while (!set_is_empty(worklist)) {
 		q = set_decapitate(worklist);
@@ -255,23 +327,19 @@ DFA *subset(NFA *nfa)
 			found = set_find(dfa->mem_region, t);
 			if (!found) {
 				// t represents a new DFA state
-				new = init_dfastate(dfa->alphabet_size);
-				new->index = state_index;
-				state_index++;
-				// doubly link the DFA state with the set of NFA
-				// states
-				t->id = new;
-				new->constituent_nfastates = t;
-
 				// q transitions to t via ch
-				qstate->outs[i] = (DFAState *)(t->id);
 				// i automatically maps to an outs[] index
-
-				if (set_find(t, nfa->accept)) {
-					new->is_accept = true;
-					set_insert(dfa->accepts, t->id);
+				qstate->outs[i] = add_dfastate(dfa, t,
+				                  set_find(t, nfa->accept));
+				if (!qstate->outs[i]) {
+					// every set in the worklist is also in
+					// dfa->mem_region, so destroy_dfa()
+					// frees them
+					destroy_set(t);
+					destroy_set(worklist);
+					destroy_dfa(dfa);
+					return NULL;
 				}
-				set_insert(dfa->mem_region, t);
 				set_insert(worklist, t);
 			} else {
 				// t represents an already-existing DFA state
@@ -285,10 +353,6 @@ Oh my god this mistake is so obvious in hindsight wtf was I thinking???
 */
 				// i automatically maps to an outs[] index
 				qstate->outs[i] = (DFAState *)(found->id);
-				if (set_find(found, nfa->accept)) {
-					qstate->outs[i]->is_accept = true;
-					set_insert(dfa->accepts, found->id);
-				}
 				destroy_set(t);
 			}
 		}
@@ -311,17 +375,57 @@ Oh my god this mistake is so obvious in hindsight wtf was I thinking???
 */
 DFA *convert_nfa_to_dfa(NFA *nfa)
 {
-	index_states(nfa);
-	DFA *dfa = subset(nfa);
+	return bounded_convert_nfa_to_dfa(nfa, NULL);
+}
+
+/* bounded_convert_nfa_to_dfa()
+	@nfa            ptr to NFA struct
+	@budget         ptr to Budget struct, NULL if unlimited
+
+	@return         ptr to a new DFA that's equivalent to the NFA, NULL if
+	                fail or if the budget was exceeded
+
+	Convert an NFA to a DFA without exceeding a budget, and populate the
+	internal tables in the DFA struct. The DFA remembers the budget so the
+	minimizer can keep charging it.
+*/
+DFA *bounded_convert_nfa_to_dfa(NFA *nfa, Budget *budget)
+{
+	if (index_states(nfa) == -1)
+		return NULL;
+	DFA *dfa = bounded_subset(nfa, budget);
 	if (!dfa)
 		return NULL;
 
+	return build_dfa_tables(dfa);
+}
+
+/* build_dfa_tables()
+	@dfa            ptr to DFA struct whose states are all constructed
+
+	@return         @dfa with its internal tables populated, NULL if fail or
+	                if the DFA's budget was exceeded
+
+	Build the transition table and the state table of a finished DFA. If
+	this fails, the DFA is destroyed.
+*/
+DFA *build_dfa_tables(DFA *dfa)
+{
+	size_t table_bytes = dfa->size * sizeof(int *);
+	table_bytes += (size_t)dfa->size * dfa->alphabet_size * sizeof(int);
+	table_bytes += dfa->size * sizeof(DFAState *);
+	if (!budget_add_bytes(dfa->budget, table_bytes)) {
+		destroy_dfa(dfa);
+		return NULL;
+	}
+
 	// dynamically allocate 2D transition table
-	int **T = malloc(dfa->size * sizeof(int *));
+	int **T = calloc(dfa->size, sizeof(int *));
 	if (!T) {
 		destroy_dfa(dfa);
 		return NULL;
 	}
+	dfa->delta = T;
 	for (int i = 0; i < dfa->size; i++) {
 		T[i] = malloc(dfa->alphabet_size * sizeof(int));
 		if (!T[i]) {
@@ -329,7 +433,6 @@ DFA *convert_nfa_to_dfa(NFA *nfa)
 			return NULL;
 		}
 	}
-	dfa->delta = T;
 
 	dfa->states = calloc(dfa->size, sizeof(DFAState *));
 	if (!dfa->states) {
@@ -451,24 +554,9 @@ int gen_dfa_graphviz(DFA *dfa, const char *file_name, bool include_nfastates)
 			// when we loop over the alphabet, the alphabet char is
 			// automatically mapped to an outs[] index (ie i)
 			fprintf(f, " d%d", currq->outs[c]->index);
-			switch (dfa->alphabet[c]) {
-			case '"':
-				fprintf(f, " [label=\"\\\"\"]\n");
-				break;
-			case '\\':
-				fprintf(f, " [label=\"\\\\\"]\n");
-				break;
-			case '\t':
-				fprintf(f, " [label=\"\\\\t\"]\n");
-				break;
-			case '\n':
-				fprintf(f, " [label=\"\\\\n\"]\n");
-				break;
-			default:
-				fprintf(f, " [label=\"%c\"]\n",
-				        dfa->alphabet[c]);
-				break;
-			}
+			fprintf(f, " [label=\"");
+			generate_transition_label(f, &dfa->classes[c]);
+			fprintf(f, "\"]\n");
 		}
 	}
 	fprintf(f, "}\n");
@@ -9,11 +9,12 @@ Module definition for deterministic finite automata.
 
 #include <stdbool.h>
 
+#include "budget.h"
+#include "charset.h"
 #include "common.h"
 #include "nfa.h"
 #include "set.h"
 
-#define NUM_ASCII_CHARS 128
 #define DEAD_STATE -1
 
 typedef struct DFAState {
@@ -32,9 +33,16 @@ typedef struct DFAState {
 typedef struct DFA {
 	DFAState *start;
 	Set *accepts;
-	U8 *alphabet;  // array of chars instead of bitfield
+	U8 *alphabet;  // smallest char of each byte class
 	               // lends itself more easily to a for loop
-	int alphabet_size;
+	CharSet *classes;  // every char of each byte class
+	int alphabet_size;  // number of byte classes
+	/*
+	Chars that no transition can tell apart share a byte class, see
+	byte_classes(). Each state only has one out per class, so eg [a-z] is
+	one out instead of 26, and trying the smallest char of a class is
+	enough to know where every char of the class goes.
+	*/
 
 	Set *mem_region;
 	/*
@@ -45,8 +53,9 @@ typedef struct DFA {
 	*/
 	int size;  // determined after subset construction
 
-	int mappings[NUM_ASCII_CHARS];  // maps alphabet char to an index into
-	                                // the DFAState->outs array
+	int mappings[NUM_CHARS];  // maps a char to its byte class, ie an index
+	                          // into the DFAState->outs array, -1 if no
+	                          // transition reads the char
 
 	// the following are intended for minimization, but may have future uses
 	int **delta;
@@ -57,16 +66,24 @@ typedef struct DFA {
 		-1 indicates no transition
 	*/
 	DFAState **states;  // makes it easy to access states by their index
+
+	Budget *budget;  // caps the subset construction and the minimizer
+	                 // NULL means unlimited
 } DFA;
 
 DFAState *init_dfastate(int alphabet_size);
 void destroy_dfastate(DFAState *state);
 DFA *init_dfa(NFA *nfa);
+DFA *init_dfa_with_labels(const CharSet *labels, int num_labels);
 void destroy_dfa(DFA *dfa);
+DFAState *add_dfastate(DFA *dfa, Set *states, bool is_accept);
+DFA *build_dfa_tables(DFA *dfa);
 
 Set *epsilon_closure_delta(Set *nfastates, U8 ch);
 DFA *subset(NFA *nfa);
+DFA *bounded_subset(NFA *nfa, Budget *budget);
 DFA *convert_nfa_to_dfa(NFA *nfa);
+DFA *bounded_convert_nfa_to_dfa(NFA *nfa, Budget *budget);
 
 int gen_dfa_graphviz(DFA *dfa, const char *file_name, bool include_nfastates);
 
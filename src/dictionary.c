@@ -0,0 +1,651 @@
+/** dictionary.c
+
+Build the minimal DFA of a sorted word list directly, in one pass over the
+words, using the incremental construction of Daciuk, Mihov, Watson and Watson.
+
+The automaton is a trie whose states get merged as soon as they can't change
+anymore. When a word is added, every state along the previous word past their
+common prefix is finished, since sorted input never comes back to it. So those
+states are minimized bottom-up: each one is either replaced by an equivalent
+state from the register, or added to the register. The automaton is minimal
+after every word, and it never holds more than one unminimized path.
+
+The input must be sorted by char value, eg with `LC_ALL=C sort -u`.
+
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "budget.h"
+#include "charset.h"
+#include "common.h"
+#include "dfa.h"
+#include "dictionary.h"
+#include "minimize.h"
+#include "nfa.h"
+#include "set.h"
+
+#define INITIAL_BUCKETS 256
+
+// a transition of a DictState, see gen_dictionary_graphviz()
+typedef struct DictEdge {
+	int dest;  // index of the destination state
+	U8 ch;
+} DictEdge;
+
+/* init_dictstate()
+	@dict           ptr to Dictionary struct
+
+	@return         ptr to dynamically allocated DictState, NULL if fail
+*/
+static DictState *init_dictstate(Dictionary *dict)
+{
+	DictState *state = calloc(1, sizeof(DictState));
+	if (!state)
+		return NULL;
+	state->id = dict->next_id++;
+	state->index = -1;
+	dict->size++;
+	return state;
+}
+
+/* destroy_dictstate()
+	@dict           ptr to Dictionary struct
+	@state          ptr to DictState struct
+*/
+static void destroy_dictstate(Dictionary *dict, DictState *state)
+{
+	free(state->chars);
+	free(state->outs);
+	free(state);
+	dict->size--;
+}
+
+/* init_dictionary()
+	@return         ptr to dynamically allocated Dictionary, NULL if fail
+
+	Dynamically allocate a Dictionary which holds no words yet.
+*/
+Dictionary *init_dictionary(void)
+{
+	Dictionary *dict = calloc(1, sizeof(Dictionary));
+	if (!dict)
+		return NULL;
+	dict->num_buckets = INITIAL_BUCKETS;
+	dict->buckets = calloc(dict->num_buckets, sizeof(DictState *));
+	dict->path_capacity = 16;
+	dict->path = malloc((dict->path_capacity + 1) * sizeof(DictState *));
+	dict->prev_word = malloc(dict->path_capacity);
+	dict->start = init_dictstate(dict);
+	if (!dict->buckets || !dict->path || !dict->prev_word ||
+	    !dict->start) {
+		destroy_dictionary(dict);
+		return NULL;
+	}
+	dict->path[0] = dict->start;
+	return dict;
+}
+
+/* destroy_dictionary()
+	@dict           ptr to Dictionary struct
+
+	Free all the memory used by a Dictionary, including every state in it.
+*/
+void destroy_dictionary(Dictionary *dict)
+{
+	if (!dict)
+		return;
+	DictState *curr, *next;
+	if (dict->buckets) {
+		for (int i = 0; i < dict->num_buckets; i++) {
+			for (curr = dict->buckets[i]; curr; curr = next) {
+				next = curr->next;
+				destroy_dictstate(dict, curr);
+			}
+		}
+	}
+	// unregistered states along the previous word
+	if (dict->path) {
+		for (int i = 1; i <= dict->path_size; i++)
+			destroy_dictstate(dict, dict->path[i]);
+	}
+	if (dict->start)
+		destroy_dictstate(dict, dict->start);
+	free(dict->buckets);
+	free(dict->path);
+	free(dict->prev_word);
+	free(dict);
+}
+
+/* hash_dictstate()
+	@state          ptr to DictState struct
+
+	@return         hash of the state's finality and transitions
+
+	Destinations are identified by id, which is fine since they were
+	registered already.
+*/
+static unsigned hash_dictstate(DictState *state)
+{
+	unsigned h = state->is_final;
+	for (int i = 0; i < state->num_outs; i++) {
+		h = h * 31 + state->chars[i];
+		h = h * 31 + state->outs[i]->id;
+	}
+	return h ^ (h >> 16);
+}
+
+/* equivalent()
+	@s1             ptr to DictState struct
+	@s2             ptr to another DictState struct
+
+	@return         true if the states accept the same suffixes
+
+	Both states' destinations are registered, so they're equivalent only if
+	they're the exact same states.
+*/
+static bool equivalent(DictState *s1, DictState *s2)
+{
+	if (s1->is_final != s2->is_final || s1->num_outs != s2->num_outs)
+		return false;
+	for (int i = 0; i < s1->num_outs; i++) {
+		if (s1->chars[i] != s2->chars[i] || s1->outs[i] != s2->outs[i])
+			return false;
+	}
+	return true;
+}
+
+/* grow_register()
+	@dict           ptr to Dictionary struct
+
+	@return         true if success, otherwise false
+
+	Double the number of buckets and rehash every registered state.
+*/
+static bool grow_register(Dictionary *dict)
+{
+	int num_buckets = dict->num_buckets * 2;
+	DictState **buckets = calloc(num_buckets, sizeof(DictState *));
+	if (!buckets)
+		return false;
+	DictState *curr, *next;
+	unsigned h;
+	for (int i = 0; i < dict->num_buckets; i++) {
+		for (curr = dict->buckets[i]; curr; curr = next) {
+			next = curr->next;
+			h = hash_dictstate(curr) % num_buckets;
+			curr->next = buckets[h];
+			buckets[h] = curr;
+		}
+	}
+	free(dict->buckets);
+	dict->buckets = buckets;
+	dict->num_buckets = num_buckets;
+	return true;
+}
+
+/* replace_or_register()
+	@dict           ptr to Dictionary struct
+	@depth          length of the common prefix of the previous word and
+	                the next one
+
+	@return         true if success, otherwise false
+
+	Minimize the states along the previous word that are deeper than
+	@depth, from the last one up. Each state's transitions all lead to
+	registered states by the time it's visited, so it's either a duplicate
+	of a registered state, in which case its parent's last transition is
+	redirected there, or it gets registered itself.
+*/
+static bool replace_or_register(Dictionary *dict, int depth)
+{
+	DictState *child, *parent, *equal;
+	unsigned h;
+	for (; dict->path_size > depth; dict->path_size--) {
+		child = dict->path[dict->path_size];
+		parent = dict->path[dict->path_size - 1];
+		h = hash_dictstate(child);
+		equal = dict->buckets[h % dict->num_buckets];
+		for (; equal && !equivalent(equal, child); equal = equal->next)
+			;
+
+		if (equal) {
+			// words are sorted, so the child is always the parent's
+			// last transition
+			parent->outs[parent->num_outs - 1] = equal;
+			destroy_dictstate(dict, child);
+			continue;
+		}
+		if (dict->num_registered >= dict->num_buckets) {
+			if (!grow_register(dict))
+				return false;
+		}
+		child->next = dict->buckets[h % dict->num_buckets];
+		dict->buckets[h % dict->num_buckets] = child;
+		dict->num_registered++;
+	}
+	return true;
+}
+
+/* add_transition()
+	@state          ptr to DictState struct
+	@ch             transition char, greater than every char @state already
+	                transitions on
+	@out            destination state
+
+	@return         true if success, otherwise false
+*/
+static bool add_transition(DictState *state, U8 ch, DictState *out)
+{
+	if (state->num_outs == state->capacity) {
+		int capacity = state->capacity ? 2 * state->capacity : 2;
+		U8 *chars = realloc(state->chars, capacity);
+		if (!chars)
+			return false;
+		state->chars = chars;
+		DictState **outs = realloc(state->outs,
+		                           capacity * sizeof(DictState *));
+		if (!outs)
+			return false;
+		state->outs = outs;
+		state->capacity = capacity;
+	}
+	state->chars[state->num_outs] = ch;
+	state->outs[state->num_outs] = out;
+	state->num_outs++;
+	return true;
+}
+
+/* dictionary_add_word()
+	@dict           ptr to Dictionary struct
+	@word           word to add, not null-terminated
+	@len            number of chars in @word
+
+	@return         DICT_SUCCESS, DICT_UNSORTED if @word goes before the
+	                previous word, or DICT_ERROR if fail
+
+	Add a word to the dictionary. Words must be added in increasing order
+	of char value. Duplicates of the previous word and empty words are
+	ignored.
+*/
+int dictionary_add_word(Dictionary *dict, const U8 *word, int len)
+{
+	if (dict->finished)
+		return DICT_ERROR;
+	dict->num_lines++;
+	if (len == 0)
+		return DICT_SUCCESS;
+
+	int prefix = 0;
+	while (prefix < len && prefix < dict->path_size &&
+	       word[prefix] == dict->prev_word[prefix])
+		prefix++;
+	if (prefix == len && prefix == dict->path_size)
+		return DICT_SUCCESS;
+	if (prefix == len ||
+	    (prefix < dict->path_size && word[prefix] < dict->prev_word[prefix]))
+		return DICT_UNSORTED;
+
+	if (!replace_or_register(dict, prefix))
+		return DICT_ERROR;
+
+	if (len > dict->path_capacity) {
+		int capacity = 2 * len;
+		DictState **path = realloc(dict->path,
+		                           (capacity + 1) * sizeof(DictState *));
+		if (!path)
+			return DICT_ERROR;
+		dict->path = path;
+		U8 *prev_word = realloc(dict->prev_word, capacity);
+		if (!prev_word)
+			return DICT_ERROR;
+		dict->prev_word = prev_word;
+		dict->path_capacity = capacity;
+	}
+
+	DictState *state;
+	for (int i = prefix; i < len; i++) {
+		state = init_dictstate(dict);
+		if (!state)
+			return DICT_ERROR;
+		if (!add_transition(dict->path[i], word[i], state)) {
+			destroy_dictstate(dict, state);
+			return DICT_ERROR;
+		}
+		dict->path[i+1] = state;
+		dict->prev_word[i] = word[i];
+		dict->path_size = i + 1;
+	}
+	dict->path[len]->is_final = true;
+	dict->num_words++;
+	return DICT_SUCCESS;
+}
+
+/* finish_dictionary()
+	@dict           ptr to Dictionary struct
+
+	@return         true if success, otherwise false
+
+	Minimize the states along the last word. No more words can be added
+	afterwards.
+*/
+bool finish_dictionary(Dictionary *dict)
+{
+	if (dict->finished)
+		return true;
+	if (!replace_or_register(dict, 0))
+		return false;
+	dict->finished = true;
+	return true;
+}
+
+/* read_dictionary()
+	@dict           ptr to Dictionary struct
+	@file_name      name of file which has one word per line
+
+	@return         same as dictionary_add_word(), DICT_ERROR if the file
+	                can't be read
+
+	Add every word of a sorted word list to a dictionary, then finish it.
+	If a word can't be added, @dict->num_lines is its line number.
+*/
+int read_dictionary(Dictionary *dict, const char *file_name)
+{
+	FILE *f = fopen(file_name, "rb");
+	if (!f)
+		return DICT_ERROR;
+
+	int capacity = 64;
+	U8 *line = malloc(capacity);
+	int len = 0;
+	int c;
+	int status = line ? DICT_SUCCESS : DICT_ERROR;
+	while (status == DICT_SUCCESS && (c = fgetc(f)) != EOF) {
+		if (c == '\n') {
+			status = dictionary_add_word(dict, line, len);
+			len = 0;
+			continue;
+		}
+		if (c == '\r')
+			continue;
+		if (len == capacity) {
+			U8 *tmp = realloc(line, 2 * capacity);
+			if (!tmp) {
+				status = DICT_ERROR;
+				break;
+			}
+			line = tmp;
+			capacity *= 2;
+		}
+		line[len++] = c;
+	}
+	// last line might not end in a newline
+	if (status == DICT_SUCCESS && len)
+		status = dictionary_add_word(dict, line, len);
+	if (status == DICT_SUCCESS && !finish_dictionary(dict))
+		status = DICT_ERROR;
+
+	free(line);
+	fclose(f);
+	return status;
+}
+
+/* dictionary_contains()
+	@dict           ptr to Dictionary struct
+	@word           word to look up, not null-terminated
+	@len            number of chars in @word
+
+	@return         true if @word was added to the dictionary
+*/
+bool dictionary_contains(Dictionary *dict, const U8 *word, int len)
+{
+	DictState *state = dict->start;
+	int lo, hi, mid;
+	for (int i = 0; i < len; i++) {
+		// binary search, since the chars are sorted
+		lo = 0;
+		hi = state->num_outs - 1;
+		while (lo <= hi) {
+			mid = (lo + hi) / 2;
+			if (state->chars[mid] < word[i])
+				lo = mid + 1;
+			else
+				hi = mid - 1;
+		}
+		if (lo == state->num_outs || state->chars[lo] != word[i])
+			return false;
+		state = state->outs[lo];
+	}
+	return state->is_final;
+}
+
+/* number_states()
+	@dict           ptr to a finished Dictionary struct
+
+	@return         ptr to dynamically allocated array of every state in
+	                index order, NULL if fail
+
+	Number the states breadth-first from the start state, which is 0. The
+	caller sets every index back to -1 afterwards.
+*/
+static DictState **number_states(Dictionary *dict)
+{
+	DictState **queue = malloc(dict->size * sizeof(DictState *));
+	if (!queue)
+		return NULL;
+	int tail = 0;
+	queue[tail++] = dict->start;
+	dict->start->index = 0;
+	DictState *curr;
+	for (int head = 0; head < tail; head++) {
+		curr = queue[head];
+		for (int i = 0; i < curr->num_outs; i++) {
+			if (curr->outs[i]->index == -1) {
+				curr->outs[i]->index = tail;
+				queue[tail++] = curr->outs[i];
+			}
+		}
+	}
+	return queue;
+}
+
+/* dictionary_to_minimal_dfa()
+	@dict           ptr to a finished Dictionary struct
+	@budget         ptr to Budget struct, or NULL for no caps
+
+	@return         ptr to dynamically allocated MinimalDFA struct, or NULL
+	                if fail
+
+	Copy a dictionary's automaton into a MinimalDFA, so it can be output
+	like any other. States are numbered breadth-first from the start state.
+	The MinimalDFA's transition table is quadratic in the number of states,
+	so it's charged to @budget first, and NULL is returned without
+	allocating it if the budget can't afford it; @budget->status tells
+	which cap was exceeded.
+*/
+MinimalDFA *dictionary_to_minimal_dfa(Dictionary *dict, Budget *budget)
+{
+	if (!dict->finished)
+		return NULL;
+
+	size_t n = dict->size;
+	size_t bytes = sizeof(MinimalDFA) + n * sizeof(int);
+	bytes += n * (sizeof(MinimalDFAState) + sizeof(Set) + sizeof(Node));
+	bytes += n * sizeof(CharSet *) + n * n * sizeof(CharSet);
+	if (!budget_add_states(budget, n) || !budget_add_bytes(budget, bytes))
+		return NULL;
+
+	DictState **queue = number_states(dict);
+	if (!queue)
+		return NULL;
+	int tail = dict->size;
+
+	MinimalDFA *min_dfa = calloc(1, sizeof(MinimalDFA));
+	if (!min_dfa) {
+		for (int i = 0; i < tail; i++)
+			queue[i]->index = -1;
+		free(queue);
+		return NULL;
+	}
+	min_dfa->accepts = init_set(compare_minimal_dfastates);
+	min_dfa->mem_region = init_set(compare_minimal_sets);
+	min_dfa->numbers = malloc(n * sizeof(int));
+	min_dfa->delta = calloc(n, sizeof(CharSet *));
+	if (!min_dfa->accepts || !min_dfa->mem_region || !min_dfa->numbers ||
+	    !min_dfa->delta)
+		goto FAIL;
+	min_dfa->size = n;
+
+	// each minimal state is the equivalence class of just itself
+	Set *min_set;
+	MinimalDFAState *min_state;
+	for (int i = 0; i < tail; i++) {
+		min_dfa->numbers[i] = i;
+		min_set = init_set(compare_ints);
+		min_state = init_minimal_dfastate();
+		if (!min_set || !min_state ||
+		    set_insert(min_set, &(min_dfa->numbers[i])) == INSERT_ERROR ||
+		    set_insert(min_dfa->mem_region, min_set) == INSERT_ERROR) {
+			destroy_set(min_set);
+			destroy_minimal_dfastate(min_state);
+			goto FAIL;
+		}
+		min_state->index = i;
+		min_state->constituent_dfa_indices = min_set;
+		min_set->id = min_state;
+		if (i == 0)
+			min_dfa->start = min_state;
+		if (queue[i]->is_final) {
+			min_state->is_accept = true;
+			if (set_insert(min_dfa->accepts, min_state) == INSERT_ERROR)
+				goto FAIL;
+		}
+	}
+
+	int dest;
+	for (int i = 0; i < tail; i++) {
+		min_dfa->delta[i] = calloc(n, sizeof(CharSet));
+		if (!min_dfa->delta[i])
+			goto FAIL;
+		for (int j = 0; j < queue[i]->num_outs; j++) {
+			dest = queue[i]->outs[j]->index;
+			charset_add(&min_dfa->delta[i][dest], queue[i]->chars[j]);
+		}
+	}
+	for (int i = 0; i < tail; i++)
+		queue[i]->index = -1;
+	free(queue);
+	return min_dfa;
+
+FAIL:
+	for (int i = 0; i < tail; i++)
+		queue[i]->index = -1;
+	free(queue);
+	// destroy_minimal_dfa() expects a full transition table
+	if (min_dfa->delta) {
+		for (size_t i = 0; i < n && min_dfa->delta[i]; i++)
+			free(min_dfa->delta[i]);
+		free(min_dfa->delta);
+		min_dfa->delta = NULL;
+	}
+	destroy_minimal_dfa(min_dfa);
+	return NULL;
+}
+
+/* compare_edges()
+	@e1             ptr to DictEdge
+	@e2             ptr to another DictEdge
+
+	@return         <0 if @e1 goes first, >0 if @e2 goes first
+
+	Order transitions by destination, then by char.
+*/
+static int compare_edges(const void *e1, const void *e2)
+{
+	const DictEdge *lhs = e1;
+	const DictEdge *rhs = e2;
+	if (lhs->dest != rhs->dest)
+		return lhs->dest - rhs->dest;
+	return lhs->ch - rhs->ch;
+}
+
+/* gen_dictionary_graphviz()
+	@dict           ptr to a finished Dictionary struct
+	@file_name      string containing the output file name
+
+	@return         0 if success, -1 if fail
+
+	Generate the same Graphviz DOT representation that
+	gen_minimal_dfa_graphviz() would for dictionary_to_minimal_dfa(), but
+	straight from the dictionary's states. The MinimalDFA's transition
+	table is quadratic in the number of states, this takes time linear in
+	the number of transitions, so a million words can be written too.
+*/
+int gen_dictionary_graphviz(Dictionary *dict, const char *file_name)
+{
+	if (!dict->finished)
+		return -1;
+	DictState **queue = number_states(dict);
+	if (!queue)
+		return -1;
+	FILE *f = fopen(file_name, "w");
+	if (!f) {
+		for (int i = 0; i < dict->size; i++)
+			queue[i]->index = -1;
+		free(queue);
+		return -1;
+	}
+
+	fprintf(f, "digraph MinimalDFA {\n");
+	fprintf(f, "\tfontname = \"Helvetica,Arial,sans-serif\"\n");
+	fprintf(f, "\tnode [fontname=\"Helvetica,Arial,sans-serif\"]\n");
+	fprintf(f, "\tedge [fontname=\"Helvetica,Arial,sans-serif\"]\n");
+	fprintf(f, "\trankdir = LR\n");
+	fprintf(f, "\n");
+
+	fprintf(f, "\tnode [shape=doublecircle]\n");
+	for (int i = 0; i < dict->size; i++) {
+		if (queue[i]->is_final)
+			fprintf(f, "\tq%d\n", i);
+	}
+	fprintf(f, "\n");
+
+	fprintf(f, "\tnode [shape=circle]\n");
+	for (int i = 0; i < dict->size; i++) {
+		if (!queue[i]->is_final)
+			fprintf(f, "\tq%d\n", i);
+	}
+	fprintf(f, "\n");
+
+	// one edge per destination, labeled with every char that goes there
+	DictEdge edges[NUM_CHARS];
+	CharSet label;
+	DictState *curr;
+	int j, k;
+	for (int i = 0; i < dict->size; i++) {
+		curr = queue[i];
+		for (j = 0; j < curr->num_outs; j++) {
+			edges[j].dest = curr->outs[j]->index;
+			edges[j].ch = curr->chars[j];
+		}
+		qsort(edges, curr->num_outs, sizeof(DictEdge), compare_edges);
+		for (j = 0; j < curr->num_outs; j = k) {
+			label = (CharSet){{0}};
+			for (k = j; k < curr->num_outs &&
+			     edges[k].dest == edges[j].dest; k++)
+				charset_add(&label, edges[k].ch);
+			fprintf(f, "\tq%d -> q%d [label=\"", i, edges[j].dest);
+			generate_transition_label(f, &label);
+			fprintf(f, "\"]\n");
+		}
+	}
+	fprintf(f, "}\n");
+	fclose(f);
+
+	for (int i = 0; i < dict->size; i++)
+		queue[i]->index = -1;
+	free(queue);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+/** dictionary.h
+
+Module definition for minimal automata built directly from sorted word lists.
+
+*/
+
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <stdbool.h>
+
+#include "budget.h"
+#include "common.h"
+#include "minimize.h"
+
+// dictionary_add_word() and read_dictionary() return codes
+#define DICT_SUCCESS     0
+#define DICT_UNSORTED    1  // word goes before the previous word
+#define DICT_ERROR      -1
+
+typedef struct DictState {
+	U8 *chars;                // transition chars, in increasing order
+	struct DictState **outs;  // destination of each char in chars[]
+	int num_outs;
+	int capacity;
+	bool is_final;
+	int id;     // unique per Dictionary, used for hashing
+	int index;  // breadth-first index, see number_states()
+	struct DictState *next;  // next state in the same register bucket
+} DictState;
+
+typedef struct Dictionary {
+	DictState *start;
+	DictState **buckets;
+	/*
+	The register: a hash table of every state that's already minimal, ie
+	none of them are equivalent. Two states are equivalent if they're both
+	final or both not, and they have the same transitions to the same
+	registered states, so a lookup is just one comparison per candidate.
+	The start state never gets registered.
+	*/
+	int num_buckets;
+	int num_registered;
+
+	DictState **path;
+	/*
+	States along the previous word, path[0] is the start state. Since the
+	words are sorted, these are the only states that can still get new
+	transitions, so every state that isn't on the path is in the register.
+	*/
+	int path_size;  // number of chars in the previous word
+	int path_capacity;
+	U8 *prev_word;
+
+	int size;       // number of live states
+	int next_id;
+	int num_words;  // distinct words added so far
+	int num_lines;  // calls to dictionary_add_word(), including duplicates
+	                // and empty lines, so the line number of the last word
+	bool finished;
+} Dictionary;
+
+Dictionary *init_dictionary(void);
+void destroy_dictionary(Dictionary *dict);
+
+int dictionary_add_word(Dictionary *dict, const U8 *word, int len);
+bool finish_dictionary(Dictionary *dict);
+int read_dictionary(Dictionary *dict, const char *file_name);
+bool dictionary_contains(Dictionary *dict, const U8 *word, int len);
+
+MinimalDFA *dictionary_to_minimal_dfa(Dictionary *dict, Budget *budget);
+int gen_dictionary_graphviz(Dictionary *dict, const char *file_name);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,537 @@
+/** followpos.c
+
+Construct DFAs directly out of regex syntax trees with the followpos algorithm
+from the dragon book (Aho, Sethi, Ullman section 3.9).
+
+The regex r is augmented to r#, where # is an end marker. Then each leaf is a
+position, and we compute the usual properties of every subtree:
+	nullable: whether the subtree matches the empty string
+	firstpos: positions that can match the first char of the subtree
+	lastpos: positions that can match the last char of the subtree
+plus followpos(p), the positions that can come right after position p. Each
+DFAState is a set of positions, starting from firstpos(r#). A DFAState that
+holds # accepts.
+
+This is the same automaton that glushkov.c determinizes, but no NFAStates or
+linked-list sets are ever made for it. Every set of positions is a bitfield,
+so taking a transition is a few ORs and finding an existing DFAState is a hash
+table lookup instead of comparing against every set in dfa->mem_region.
+
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "budget.h"
+#include "charset.h"
+#include "common.h"
+#include "dfa.h"
+#include "followpos.h"
+#include "set.h"
+
+#define INITIAL_DSTATES 16
+
+static inline void set_position(U64 *bits, int p)
+{
+	bits[p / 64] |= (U64)1 << (p % 64);
+}
+
+static inline bool has_position(U64 *bits, int p)
+{
+	return bits[p / 64] & ((U64)1 << (p % 64));
+}
+
+/* add_followers()
+	@fp             ptr to Followpos struct
+	@positions      bitfield of positions
+	@followers      bitfield of positions which can follow them
+
+	Add @followers to followpos(p) for every p in @positions.
+*/
+static void add_followers(Followpos *fp, U64 *positions, U64 *followers)
+{
+	int p;
+	U64 *row;
+	for (int w = 0; w < fp->words; w++) {
+		for (U64 x = positions[w]; x; x &= x - 1) {
+			// the builtin is supported by both gcc and clang
+			p = w * 64 + __builtin_ctzll(x);
+			row = &fp->followpos[p * fp->words];
+			for (int v = 0; v < fp->words; v++)
+				row[v] |= followers[v];
+		}
+	}
+}
+
+/* compare_possets()
+	@s1             ptr to PosSet struct
+	@s2             ptr to another PosSet struct of the same width
+
+	@return         any value indicating the following:
+	                >0: s1 goes after s2
+	                =0: s1 has the same positions as s2
+	                <0: s1 goes before s2
+
+	Compare two sets of positions.
+*/
+int compare_possets(const void *s1, const void *s2)
+{
+	PosSet *lhs = (PosSet *)s1;
+	PosSet *rhs = (PosSet *)s2;
+	return memcmp(lhs->bits, rhs->bits, lhs->words * sizeof(U64));
+}
+
+/* followpos_helper()
+	@fp             ptr to Followpos struct
+	@root           ptr to root of the syntax tree
+	@nullable       ptr to output, whether @root matches the empty string
+	@first          output bitfield, firstpos of @root, must be zeroed
+	@last           output bitfield, lastpos of @root, must be zeroed
+
+	@return         true if success, otherwise false
+
+	Number the positions of a syntax tree from left to right, compute
+	nullable, firstpos, and lastpos of every subtree, and fill in followpos
+	along the way. The nodes are visited in postorder with a stack of
+	results, and a node's results replace those of its children. The stack
+	only gets as tall as the deepest chain of right children, so it's
+	measured first instead of holding 2 bitfields for every node.
+*/
+static bool followpos_helper(Followpos *fp, ASTNode *root, bool *nullable,
+                             U64 *first, U64 *last)
+{
+	NodeList order = {NULL, 0, 0};
+	if (!ast_postorder(root, &order))
+		goto FAIL;
+	int height = 0;
+	int top = 0;
+	for (int i = 0; i < order.size; i++) {
+		if (order.nodes[i]->kind == AST_LITERAL ||
+		    order.nodes[i]->kind == AST_CLASS) {
+			if (++top > height)
+				height = top;
+		} else if (order.nodes[i]->kind != AST_REPEAT) {
+			top--;
+		}
+	}
+	// firstpos of the ith result is sets[2 * i * words], then its lastpos
+	bool *nullables = malloc(height * sizeof(bool));
+	U64 *sets = malloc((size_t)2 * height * fp->words * sizeof(U64));
+	if (!nullables || !sets) {
+		free(nullables);
+		free(sets);
+		goto FAIL;
+	}
+
+	int next = 1;
+	int p;
+	ASTNode *node;
+	U64 *f1, *l1, *f2, *l2;
+	top = 0;
+	for (int i = 0; i < order.size; i++) {
+		node = order.nodes[i];
+		if (node->kind == AST_LITERAL || node->kind == AST_CLASS) {
+			p = next++;
+			fp->chars[p] = node->chars;
+			charset_union(&fp->alphabet, &node->chars);
+			for (int ch = 0; ch < NUM_CHARS; ch++) {
+				if (!ast_matches(node, ch))
+					continue;
+				if (!fp->char_positions[ch]) {
+					fp->char_positions[ch] =
+						calloc(fp->words, sizeof(U64));
+					if (!fp->char_positions[ch])
+						goto CLEANUP;
+				}
+				set_position(fp->char_positions[ch], p);
+			}
+			f1 = &sets[2 * top * fp->words];
+			memset(f1, 0, 2 * fp->words * sizeof(U64));
+			set_position(f1, p);
+			set_position(f1 + fp->words, p);
+			nullables[top++] = false;
+			continue;
+		}
+
+		if (node->kind == AST_REPEAT) {
+			// only *, ?, and + reach here, and they leave firstpos
+			// and lastpos alone
+			f1 = &sets[2 * (top-1) * fp->words];
+			if (node->max == AST_UNBOUNDED) {
+				// rule 2: every position in lastpos(r) is
+				// followed by every position in firstpos(r)
+				// for r* and r+
+				add_followers(fp, f1 + fp->words, f1);
+			}
+			if (node->min == 0)
+				nullables[top-1] = true;
+			continue;
+		}
+
+		f1 = &sets[2 * (top-2) * fp->words];
+		l1 = f1 + fp->words;
+		f2 = l1 + fp->words;
+		l2 = f2 + fp->words;
+		if (node->kind == AST_CONCAT) {
+			// rule 1: every position in lastpos(c1) is followed by
+			// every position in firstpos(c2)
+			add_followers(fp, l1, f2);
+			for (int w = 0; w < fp->words; w++) {
+				if (nullables[top-2])
+					f1[w] |= f2[w];
+				l1[w] = nullables[top-1] ? l1[w] | l2[w]
+				                         : l2[w];
+			}
+			nullables[top-2] = nullables[top-2] &&
+			                   nullables[top-1];
+		} else {
+			for (int w = 0; w < fp->words; w++) {
+				f1[w] |= f2[w];
+				l1[w] |= l2[w];
+			}
+			nullables[top-2] = nullables[top-2] ||
+			                   nullables[top-1];
+		}
+		top--;
+	}
+
+	*nullable = nullables[0];
+	memcpy(first, sets, fp->words * sizeof(U64));
+	memcpy(last, sets + fp->words, fp->words * sizeof(U64));
+	free(order.nodes);
+	free(nullables);
+	free(sets);
+	return true;
+
+CLEANUP:
+	free(nullables);
+	free(sets);
+FAIL:
+	free(order.nodes);
+	return false;
+}
+
+/* followpos()
+	@root           ptr to root of a syntax tree
+
+	@return         ptr to dynamically allocated Followpos, NULL if fail
+
+	Augment a syntax tree with an end marker and compute the followpos of
+	every position. The tree is unmodified.
+*/
+Followpos *followpos(ASTNode *root)
+{
+	Followpos *fp = calloc(1, sizeof(Followpos));
+	if (!fp)
+		return NULL;
+	int num_leaves = count_positions(root);
+	if (num_leaves < 0) {
+		free(fp);
+		return NULL;
+	}
+	fp->num_positions = num_leaves + 1;
+	fp->end = fp->num_positions;
+	fp->words = fp->end / 64 + 1;  // bits 0 through end
+
+	fp->chars = calloc(fp->end + 1, sizeof(CharSet));
+	fp->followpos = calloc((size_t)(fp->end + 1) * fp->words,
+	                       sizeof(U64));
+	fp->firstpos = calloc(fp->words, sizeof(U64));
+	// lastpos(r), then a set that only holds #
+	U64 *last = calloc(2 * fp->words, sizeof(U64));
+	fp->capacity = INITIAL_DSTATES;
+	fp->dstates = malloc(fp->capacity * sizeof(PosSet *));
+	fp->num_buckets = 2 * INITIAL_DSTATES;
+	fp->buckets = malloc(fp->num_buckets * sizeof(int));
+	if (!fp->chars || !fp->followpos || !fp->firstpos || !last ||
+	    !fp->dstates || !fp->buckets) {
+		free(last);
+		destroy_followpos(fp);
+		return NULL;
+	}
+	memset(fp->buckets, -1, fp->num_buckets * sizeof(int));
+
+	bool nullable;
+	if (!followpos_helper(fp, root, &nullable, fp->firstpos, last)) {
+		free(last);
+		destroy_followpos(fp);
+		return NULL;
+	}
+
+	// r# means lastpos(r) is followed by #, and # is in firstpos(r#) if r
+	// is nullable
+	U64 *marker = last + fp->words;
+	set_position(marker, fp->end);
+	add_followers(fp, last, marker);
+	if (nullable)
+		set_position(fp->firstpos, fp->end);
+	free(last);
+	return fp;
+}
+
+/* destroy_followpos()
+	@fp             ptr to Followpos struct
+
+	Free all the memory used by a Followpos, including every set of
+	positions that a DFA built from it references.
+*/
+void destroy_followpos(Followpos *fp)
+{
+	if (!fp)
+		return;
+	free(fp->chars);
+	free(fp->followpos);
+	free(fp->firstpos);
+	for (int c = 0; c < NUM_CHARS; c++)
+		free(fp->char_positions[c]);
+	for (int i = 0; i < fp->num_dstates; i++)
+		free(fp->dstates[i]);
+	free(fp->dstates);
+	free(fp->buckets);
+	free(fp);
+}
+
+/* hash_positions()
+	@bits           bitfield of positions
+	@words          number of U64s in @bits
+
+	@return         hash of the positions
+
+	FNV-1a, one U64 at a time.
+*/
+static U64 hash_positions(U64 *bits, int words)
+{
+	U64 h = 0xcbf29ce484222325;
+	for (int w = 0; w < words; w++) {
+		h ^= bits[w];
+		h *= 0x100000001b3;
+	}
+	return h ^ (h >> 32);
+}
+
+/* grow_buckets()
+	@fp             ptr to Followpos struct
+
+	@return         true if success, otherwise false
+
+	Double the hash table of sets of positions and rehash all of them.
+*/
+static bool grow_buckets(Followpos *fp)
+{
+	int num_buckets = 2 * fp->num_buckets;
+	int *buckets = malloc(num_buckets * sizeof(int));
+	if (!buckets)
+		return false;
+	memset(buckets, -1, num_buckets * sizeof(int));
+	int b;
+	for (int i = 0; i < fp->num_dstates; i++) {
+		b = hash_positions(fp->dstates[i]->bits, fp->words) %
+		    num_buckets;
+		while (buckets[b] != -1)
+			b = (b + 1) % num_buckets;
+		buckets[b] = i;
+	}
+	free(fp->buckets);
+	fp->buckets = buckets;
+	fp->num_buckets = num_buckets;
+	return true;
+}
+
+/* intern_positions()
+	@fp             ptr to Followpos struct
+	@bits           bitfield of positions
+	@budget         ptr to Budget struct, NULL if unlimited
+
+	@return         index into fp->dstates of the set equal to @bits, -1 if
+	                fail or if the budget was exceeded
+
+	Find the set of positions equal to @bits, or make a copy of @bits if
+	there isn't one yet.
+*/
+static int intern_positions(Followpos *fp, U64 *bits, Budget *budget)
+{
+	size_t bytes = fp->words * sizeof(U64);
+	int b = hash_positions(bits, fp->words) % fp->num_buckets;
+	for (; fp->buckets[b] != -1; b = (b + 1) % fp->num_buckets) {
+		if (memcmp(fp->dstates[fp->buckets[b]]->bits, bits, bytes) == 0)
+			return fp->buckets[b];
+	}
+
+	if (!budget_add_bytes(budget, sizeof(PosSet) + bytes))
+		return -1;
+	if (fp->num_dstates == fp->capacity) {
+		PosSet **grown = realloc(fp->dstates,
+		                         2 * fp->capacity * sizeof(PosSet *));
+		if (!grown)
+			return -1;
+		fp->dstates = grown;
+		fp->capacity *= 2;
+	}
+	PosSet *set = malloc(sizeof(PosSet) + bytes);
+	if (!set)
+		return -1;
+	set->words = fp->words;
+	memcpy(set->bits, bits, bytes);
+	fp->dstates[fp->num_dstates] = set;
+	fp->buckets[b] = fp->num_dstates++;
+
+	// keep the load factor at most 1/2
+	if (2 * fp->num_dstates > fp->num_buckets && !grow_buckets(fp))
+		return -1;
+	return fp->num_dstates - 1;
+}
+
+/* followpos_dfa()
+	@fp             ptr to Followpos struct
+
+	@return         ptr to a new DFA that's equivalent to the regex, NULL if
+	                fail
+
+	Build a DFA out of sets of positions.
+*/
+DFA *followpos_dfa(Followpos *fp)
+{
+	return bounded_followpos_dfa(fp, NULL);
+}
+
+/* add_posset_state()
+	@dfa            ptr to the DFA under construction
+	@fp             ptr to Followpos struct
+	@dstate         index into fp->dstates
+
+	@return         ptr to the new DFAState, NULL if fail or if the DFA's
+	                budget was exceeded
+
+	Create a DFAState for a set of positions. Its set of constituent states
+	holds the PosSet.
+*/
+static DFAState *add_posset_state(DFA *dfa, Followpos *fp, int dstate)
+{
+	Set *states = init_set(compare_possets);
+	if (!states)
+		return NULL;
+	PosSet *set = fp->dstates[dstate];
+	DFAState *state = NULL;
+	if (set_insert(states, set) == INSERT_SUCCESS)
+		state = add_dfastate(dfa, states,
+		                     has_position(set->bits, fp->end));
+	if (!state)
+		destroy_set(states);
+	return state;
+}
+
+/* bounded_followpos_dfa()
+	@fp             ptr to Followpos struct
+	@budget         ptr to Budget struct, NULL if unlimited
+
+	@return         ptr to a new DFA that's equivalent to the regex, NULL if
+	                fail or if the budget was exceeded
+
+	Build a DFA out of sets of positions without exceeding a budget, and
+	populate the internal tables in the DFA struct.
+	Every DFAState holds a PosSet instead of NFAStates, so don't print the
+	constituent states with gen_dfa_graphviz(). @fp must outlive the DFA.
+	Sets of positions are kept in @fp, so building the DFA again reuses
+	them.
+*/
+DFA *bounded_followpos_dfa(Followpos *fp, Budget *budget)
+{
+	if (!budget_add_bytes(budget, sizeof(DFA)))
+		return NULL;
+	DFA *dfa = init_dfa_with_labels(fp->chars, fp->end + 1);
+	if (!dfa)
+		return NULL;
+	dfa->budget = budget;
+
+	// order[i] is the fp->dstates index of DFAState i, which doubles as
+	// the worklist
+	int capacity = INITIAL_DSTATES;
+	int *order = malloc(capacity * sizeof(int));
+	// maps fp->dstates index to its DFAState, if it has one yet
+	int num_mapped = fp->capacity;
+	DFAState **by_dstate = calloc(num_mapped, sizeof(DFAState *));
+	U64 *u = malloc(fp->words * sizeof(U64));
+	int d = -1;
+	if (!order || !by_dstate || !u ||
+	    !budget_add_bytes(budget, dfa->alphabet_size) ||
+	    (d = intern_positions(fp, fp->firstpos, budget)) == -1 ||
+	    !(dfa->start = add_posset_state(dfa, fp, d)))
+		goto FAIL;
+	order[0] = d;
+	by_dstate[d] = dfa->start;
+
+	DFAState *qstate, *found;
+	PosSet *q;
+	U64 *positions;
+	U64 *row;
+	void *grown;
+	int p;
+	bool any;
+	for (int next = 0; next < dfa->mem_region->size; next++) {
+		q = fp->dstates[order[next]];
+		qstate = by_dstate[order[next]];
+		for (int i = 0; i < dfa->alphabet_size; i++) {
+			// union of followpos(p) for every p in q that
+			// matches the char
+			positions = fp->char_positions[dfa->alphabet[i]];
+			memset(u, 0, fp->words * sizeof(U64));
+			any = false;
+			for (int w = 0; w < fp->words; w++) {
+				for (U64 x = q->bits[w] & positions[w]; x;
+				     x &= x - 1) {
+					p = w * 64 + __builtin_ctzll(x);
+					row = &fp->followpos[p * fp->words];
+					for (int v = 0; v < fp->words; v++)
+						u[v] |= row[v];
+					any = true;
+				}
+			}
+			if (!any)
+				continue;  // dead state
+
+			if ((d = intern_positions(fp, u, budget)) == -1)
+				goto FAIL;
+			if (d >= num_mapped) {
+				grown = realloc(by_dstate, fp->capacity *
+				                sizeof(DFAState *));
+				if (!grown)
+					goto FAIL;
+				by_dstate = grown;
+				for (; num_mapped < fp->capacity; num_mapped++)
+					by_dstate[num_mapped] = NULL;
+			}
+			found = by_dstate[d];
+			if (!found) {
+				// u represents a new DFA state
+				if (!(found = add_posset_state(dfa, fp, d)))
+					goto FAIL;
+				if (dfa->mem_region->size > capacity) {
+					capacity *= 2;
+					grown = realloc(order,
+					                capacity * sizeof(int));
+					if (!grown)
+						goto FAIL;
+					order = grown;
+				}
+				order[found->index] = d;
+				by_dstate[d] = found;
+			}
+			// i automatically maps to an outs[] index
+			qstate->outs[i] = found;
+		}
+	}
+	free(order);
+	free(by_dstate);
+	free(u);
+	dfa->size = dfa->mem_region->size;
+	return build_dfa_tables(dfa);
+
+FAIL:
+	free(order);
+	free(by_dstate);
+	free(u);
+	destroy_dfa(dfa);
+	return NULL;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+/** followpos.h
+
+Module definition for the followpos (Aho-Sethi-Ullman) DFA construction.
+
+*/
+
+#ifndef FOLLOWPOS_H
+#define FOLLOWPOS_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "budget.h"
+#include "charset.h"
+#include "common.h"
+#include "dfa.h"
+
+// a set of positions as a bitfield, also one DFAState
+typedef struct PosSet {
+	int words;  // number of U64s in bits[]
+	U64 bits[];
+} PosSet;
+
+typedef struct Followpos {
+	int num_positions;  // number of leaves + 1 for the end marker
+	int end;            // position of the end marker #
+	int words;          // number of U64s in one set of positions
+	/*
+	Positions are numbered from 1 like in the dragon book, so bit 0 of
+	every set is unused. The regex r is augmented to r#, and a DFAState
+	accepts if it holds the position of #.
+	*/
+	CharSet *chars;     // chars[p] is the set of chars position p reads,
+	                    // empty for the end marker
+	U64 *followpos;     // followpos of p starts at followpos[p * words]
+	U64 *firstpos;      // firstpos of r#, ie the start state
+	U64 *char_positions[NUM_CHARS];
+	// positions of each alphabet char, NULL for chars outside it
+	// the end marker matches no char, so it's left out of these
+	CharSet alphabet;
+
+	// the DFA references these, so they live as long as the Followpos
+	PosSet **dstates;
+	int num_dstates;
+	int capacity;
+	int *buckets;  // hash table of dstates indices, -1 if empty
+	int num_buckets;
+} Followpos;
+
+int compare_possets(const void *s1, const void *s2);
+
+Followpos *followpos(ASTNode *root);
+void destroy_followpos(Followpos *fp);
+
+DFA *followpos_dfa(Followpos *fp);
+DFA *bounded_followpos_dfa(Followpos *fp, Budget *budget);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,639 @@
+/** glushkov.c
+
+Construct Glushkov automata (also called position automata) out of regex
+syntax trees, and convert them to DFAs.
+
+Thompson's construction adds about 2 epsilon states per operator, and the
+subset construction spends most of its time chasing those epsilon edges. The
+Glushkov automaton has exactly one state per character position plus a start
+state, and no epsilon transitions at all. It's built from 3 properties of each
+subtree:
+	nullable: whether the subtree matches the empty string
+	first: positions that can match the first char of the subtree
+	last: positions that can match the last char of the subtree
+plus the follow set of each position, ie the positions that can come right
+after it.
+
+A Thompson NFA can be squeezed into the same shape by removing its epsilon
+transitions, since each of its char states is really a position.
+
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "budget.h"
+#include "charset.h"
+#include "common.h"
+#include "dfa.h"
+#include "glushkov.h"
+#include "nfa.h"
+#include "set.h"
+
+/* init_position_nfa()
+	@num_positions  number of character positions in the regex
+
+	@return         ptr to dynamically allocated PositionNFA, NULL if fail
+
+	Dynamically allocate a PositionNFA with no transitions.
+*/
+PositionNFA *init_position_nfa(int num_positions)
+{
+	PositionNFA *pnfa = calloc(1, sizeof(PositionNFA));
+	if (!pnfa)
+		return NULL;
+	pnfa->size = num_positions + 1;
+	pnfa->states = calloc(pnfa->size, sizeof(NFAState));
+	pnfa->follow = calloc(pnfa->size, sizeof(PosList));
+	pnfa->chars = calloc(pnfa->size, sizeof(CharSet));
+	pnfa->is_accept = calloc(pnfa->size, sizeof(bool));
+	if (!pnfa->states || !pnfa->follow || !pnfa->chars ||
+	    !pnfa->is_accept) {
+		destroy_position_nfa(pnfa);
+		return NULL;
+	}
+	for (int p = 0; p < pnfa->size; p++) {
+		pnfa->states[p].ch = EPSILON;
+		pnfa->states[p].index = p;
+	}
+	return pnfa;
+}
+
+/* destroy_position_nfa()
+	@pnfa           ptr to PositionNFA struct
+
+	Free all the memory used by a PositionNFA.
+*/
+void destroy_position_nfa(PositionNFA *pnfa)
+{
+	if (!pnfa)
+		return;
+	if (pnfa->follow) {
+		for (int p = 0; p < pnfa->size; p++)
+			free(pnfa->follow[p].positions);
+	}
+	free(pnfa->follow);
+	free(pnfa->states);
+	free(pnfa->chars);
+	free(pnfa->is_accept);
+	free(pnfa);
+}
+
+// the properties of one subtree, see glushkov_helper()
+typedef struct Subtree {
+	bool nullable;
+	PosList first;
+	PosList last;
+} Subtree;
+
+/* pos_union()
+	@dest           ptr to sorted PosList
+	@src            ptr to another sorted PosList
+
+	@return         true if success, otherwise false
+
+	Merge @src into @dest. Both stay sorted and @src is unmodified.
+*/
+static bool pos_union(PosList *dest, PosList *src)
+{
+	if (src->size == 0)
+		return true;
+	int *merged = malloc((dest->size + src->size) * sizeof(int));
+	if (!merged)
+		return false;
+
+	int i = 0, j = 0, k = 0;
+	while (i < dest->size && j < src->size) {
+		if (dest->positions[i] < src->positions[j]) {
+			merged[k++] = dest->positions[i++];
+		} else if (dest->positions[i] > src->positions[j]) {
+			merged[k++] = src->positions[j++];
+		} else {
+			merged[k++] = dest->positions[i++];
+			j++;
+		}
+	}
+	while (i < dest->size)
+		merged[k++] = dest->positions[i++];
+	while (j < src->size)
+		merged[k++] = src->positions[j++];
+
+	free(dest->positions);
+	dest->positions = merged;
+	dest->size = k;
+	return true;
+}
+
+/* add_follow()
+	@pnfa           ptr to PositionNFA struct
+	@from           positions which gain followers
+	@to             positions which can follow each of @from
+
+	@return         true if success, otherwise false
+
+	Add every position in @to to the follow set of every position in @from.
+*/
+static bool add_follow(PositionNFA *pnfa, PosList *from, PosList *to)
+{
+	for (int i = 0; i < from->size; i++) {
+		if (!pos_union(&pnfa->follow[from->positions[i]], to))
+			return false;
+	}
+	return true;
+}
+
+/* glushkov_helper()
+	@pnfa           ptr to PositionNFA struct
+	@root           ptr to root of the syntax tree
+	@nullable       ptr to output, whether @root matches the empty string
+	@first          ptr to output, first set of @root
+	@last           ptr to output, last set of @root
+
+	@return         true if success, otherwise false
+
+	Number the positions of a syntax tree from left to right, compute the
+	nullable, first, and last properties of every subtree, and fill in the
+	follow sets along the way. The nodes are visited in postorder, so the
+	properties of a node's children are on top of the stack when the node
+	is reached, and get replaced by the properties of the node.
+	@first and @last are only set if this succeeds.
+*/
+static bool glushkov_helper(PositionNFA *pnfa, ASTNode *root, bool *nullable,
+                            PosList *first, PosList *last)
+{
+	NodeList order = {NULL, 0, 0};
+	Subtree *stack = NULL;
+	if (ast_postorder(root, &order))
+		stack = malloc(order.size * sizeof(Subtree));
+	bool ok = stack;
+
+	int top = 0;
+	int next = 1;
+	int p;
+	ASTNode *node;
+	Subtree *lhs, *rhs;
+	for (int i = 0; ok && i < order.size; i++) {
+		node = order.nodes[i];
+		if (node->kind == AST_LITERAL || node->kind == AST_CLASS) {
+			p = next++;
+			pnfa->states[p].ch = node->kind == AST_LITERAL
+			                     ? node->ch : CHAR_CLASS;
+			pnfa->chars[p] = node->chars;
+			charset_union(&pnfa->alphabet, &node->chars);
+			lhs = &stack[top++];
+			lhs->nullable = false;
+			lhs->first.positions = malloc(sizeof(int));
+			lhs->last.positions = malloc(sizeof(int));
+			if (!lhs->first.positions || !lhs->last.positions) {
+				ok = false;
+				break;
+			}
+			lhs->first.positions[0] = lhs->last.positions[0] = p;
+			lhs->first.size = lhs->last.size = 1;
+			continue;
+		}
+
+		if (node->kind == AST_REPEAT) {
+			// the last chars of *, ?, and + can loop back to the
+			// first chars iff it's unbounded, a counter like
+			// [a-z]{3,8} is only the position of its char and
+			// counter.c does the counting
+			lhs = &stack[top-1];
+			if (node->max == AST_UNBOUNDED && !ast_is_counter(node))
+				ok = add_follow(pnfa, &lhs->last, &lhs->first);
+			lhs->nullable = node->min == 0 || lhs->nullable;
+			continue;
+		}
+
+		lhs = &stack[top-2];
+		rhs = &stack[top-1];
+		if (node->kind == AST_CONCAT) {
+			// the last chars of the lhs can be followed by the
+			// first chars of the rhs
+			ok = add_follow(pnfa, &lhs->last, &rhs->first);
+			if (ok && lhs->nullable)
+				ok = pos_union(&lhs->first, &rhs->first);
+			if (ok && rhs->nullable)
+				ok = pos_union(&rhs->last, &lhs->last);
+			lhs->nullable = lhs->nullable && rhs->nullable;
+			free(lhs->last.positions);
+			lhs->last = rhs->last;
+			free(rhs->first.positions);
+		} else {
+			ok = pos_union(&lhs->first, &rhs->first) &&
+			     pos_union(&lhs->last, &rhs->last);
+			lhs->nullable = lhs->nullable || rhs->nullable;
+			free(rhs->first.positions);
+			free(rhs->last.positions);
+		}
+		top--;
+	}
+
+	if (ok) {
+		*nullable = stack[0].nullable;
+		*first = stack[0].first;
+		*last = stack[0].last;
+	} else {
+		for (int i = 0; i < top; i++) {
+			free(stack[i].first.positions);
+			free(stack[i].last.positions);
+		}
+	}
+	free(order.nodes);
+	free(stack);
+	return ok;
+}
+
+/* glushkov()
+	@root           ptr to root of a syntax tree
+
+	@return         ptr to Glushkov automaton equivalent to the tree, NULL if
+	                fail
+
+	Build the Glushkov automaton of a syntax tree. The tree is unmodified.
+*/
+PositionNFA *glushkov(ASTNode *root)
+{
+	int num_positions = count_positions(root);
+	PositionNFA *pnfa = num_positions < 0 ? NULL
+	                    : init_position_nfa(num_positions);
+	if (!pnfa)
+		return NULL;
+
+	bool nullable;
+	PosList first, last;
+	if (!glushkov_helper(pnfa, root, &nullable, &first, &last)) {
+		destroy_position_nfa(pnfa);
+		return NULL;
+	}
+
+	// the start state transitions to the first positions of the regex
+	pnfa->follow[0] = first;
+	pnfa->is_accept[0] = nullable;
+	for (int i = 0; i < last.size; i++)
+		pnfa->is_accept[last.positions[i]] = true;
+	free(last.positions);
+	return pnfa;
+}
+
+/* compare_ints()
+	@i1             ptr to int
+	@i2             ptr to another int
+
+	@return         <0, 0, or >0 like strcmp()
+*/
+static int compare_ints(const void *i1, const void *i2)
+{
+	return *(const int *)i1 - *(const int *)i2;
+}
+
+/* closure_positions()
+	@nfa            ptr to the Thompson NFA
+	@position       position of each NFA state by index, 0 if it's epsilon
+	@from           ptr to first NFA state of the closure
+	@stack          work stack, one slot per NFA edge
+	@stamp          last closure that visited each NFA state, by index
+	@id             id of this closure
+	@follow         ptr to output, sorted positions in the closure
+
+	@return         true if the closure contains the NFA's accept state
+
+	Follow every epsilon edge out of @from. The closure stops at states
+	that read a char, and those become the positions of @follow.
+*/
+static bool closure_positions(NFA *nfa, int *position, NFAState *from,
+                              NFAState **stack, int *stamp, int id,
+                              PosList *follow)
+{
+	bool accepts = false;
+	int top = 0;
+	stack[top++] = from;
+	stamp[from->index] = id;
+
+	NFAState *curr;
+	while (top > 0) {
+		curr = stack[--top];
+		if (curr == nfa->accept)
+			accepts = true;
+		if (curr->ch != EPSILON) {
+			follow->positions[follow->size++] =
+				position[curr->index];
+			continue;
+		}
+		if (curr->out1 && stamp[curr->out1->index] != id) {
+			stamp[curr->out1->index] = id;
+			stack[top++] = curr->out1;
+		}
+		if (curr->out2 && stamp[curr->out2->index] != id) {
+			stamp[curr->out2->index] = id;
+			stack[top++] = curr->out2;
+		}
+		for (int i = 0; i < curr->num_outs; i++) {
+			if (stamp[curr->outs[i]->index] != id) {
+				stamp[curr->outs[i]->index] = id;
+				stack[top++] = curr->outs[i];
+			}
+		}
+	}
+	qsort(follow->positions, follow->size, sizeof(int), compare_ints);
+	return accepts;
+}
+
+/* remove_epsilons()
+	@nfa            ptr to Thompson NFA struct
+
+	@return         ptr to epsilon-free PositionNFA equivalent to @nfa, NULL
+	                if fail
+
+	Remove every epsilon transition from a Thompson NFA. Only the start
+	state and the states that read a char survive, numbered in index_states()
+	order, so the result is small, index-addressed, and can go anywhere a
+	Glushkov automaton can. Each char state's transition is redirected
+	past the epsilon states after it, straight to the char states in the
+	epsilon closure of its destination, and it accepts if that closure has
+	the accept state. Every closure is computed exactly once.
+	The NFA is re-indexed but otherwise unmodified.
+*/
+PositionNFA *remove_epsilons(NFA *nfa)
+{
+	int num_states = index_states(nfa) + 1;
+	if (num_states == 0)
+		return NULL;
+	NFAState **by_index = malloc(num_states * sizeof(NFAState *));
+	int *position = calloc(num_states, sizeof(int));
+	int *stamp = malloc(num_states * sizeof(int));
+	if (!by_index || !position || !stamp)
+		goto FAIL;
+
+	int num_positions = 0;
+	int num_edges = 0;
+	NFAState *state;
+	for (Iterator *it = set_begin(nfa->mem_region); it; advance_iter(&it)) {
+		state = (NFAState *)(it->element);
+		if (state->index == -1)
+			continue;  // unreachable from the start state
+		by_index[state->index] = state;
+		num_edges += (state->out1 != NULL) + (state->out2 != NULL) +
+		             state->num_outs;
+	}
+	for (int i = 0; i < num_states; i++) {
+		stamp[i] = -1;
+		if (by_index[i]->ch != EPSILON)
+			position[i] = ++num_positions;
+	}
+
+	PositionNFA *pnfa = init_position_nfa(num_positions);
+	// a state is pushed at most once per edge into it, plus @from itself
+	NFAState **stack = malloc((num_edges + 1) * sizeof(NFAState *));
+	// each closure is collected here, then copied out at its own size, so
+	// a long regex doesn't need a full-size list per position
+	PosList scratch = {malloc((num_positions + 1) * sizeof(int)), 0};
+	if (!pnfa || !stack || !scratch.positions) {
+		destroy_position_nfa(pnfa);
+		free(stack);
+		free(scratch.positions);
+		goto FAIL;
+	}
+	pnfa->alphabet = nfa->alphabet;
+
+	// closure 0 starts at the start state, closure p at the destination
+	// of the char state of position p
+	NFAState *from;
+	int p;
+	for (int i = -1; i < num_states; i++) {
+		if (i == -1) {
+			from = nfa->start;
+			p = 0;
+		} else if ((p = position[i]) != 0) {
+			state = by_index[i];
+			from = state->out1;
+			pnfa->states[p].ch = state->ch;
+			pnfa->chars[p] = state->chars;
+		} else {
+			continue;
+		}
+		scratch.size = 0;
+		pnfa->is_accept[p] = closure_positions(nfa, position, from,
+		                     stack, stamp, i + 1, &scratch);
+		if (scratch.size == 0)
+			continue;
+		pnfa->follow[p].positions = malloc(scratch.size * sizeof(int));
+		if (!pnfa->follow[p].positions) {
+			destroy_position_nfa(pnfa);
+			free(stack);
+			free(scratch.positions);
+			goto FAIL;
+		}
+		memcpy(pnfa->follow[p].positions, scratch.positions,
+		       scratch.size * sizeof(int));
+		pnfa->follow[p].size = scratch.size;
+	}
+	free(stack);
+	free(scratch.positions);
+	free(by_index);
+	free(position);
+	free(stamp);
+	return pnfa;
+
+FAIL:
+	free(by_index);
+	free(position);
+	free(stamp);
+	return NULL;
+}
+
+/* position_delta()
+	@pnfa           ptr to PositionNFA struct
+	@states         set of position NFAStates
+	@ch             transition character
+
+	@return         set of positions reachable from @states via @ch, NULL if
+	                fail
+
+	For each position in @states, find its followers that read @ch.
+	There are no epsilon closures to compute.
+*/
+Set *position_delta(PositionNFA *pnfa, Set *states, U8 ch)
+{
+	Set *result = init_set(compare_nfastates);
+	if (!result)
+		return NULL;
+	PosList *follow;
+	int q;
+	for (Iterator *it = set_begin(states); it; advance_iter(&it)) {
+		follow = &pnfa->follow[((NFAState *)(it->element))->index];
+		for (int i = 0; i < follow->size; i++) {
+			q = follow->positions[i];
+			if (charset_has(&pnfa->chars[q], ch))
+				set_insert(result, &pnfa->states[q]);
+		}
+	}
+	return result;
+}
+
+/* has_accept()
+	@pnfa           ptr to PositionNFA struct
+	@states         set of position NFAStates
+
+	@return         true if any position in @states accepts
+
+	Check whether a set of positions forms an accepting DFAState.
+*/
+static bool has_accept(PositionNFA *pnfa, Set *states)
+{
+	for (Iterator *it = set_begin(states); it; advance_iter(&it)) {
+		if (pnfa->is_accept[((NFAState *)(it->element))->index])
+			return true;
+	}
+	return false;
+}
+
+/* position_subset()
+	@pnfa           ptr to PositionNFA struct
+	@budget         ptr to Budget struct, NULL if unlimited
+
+	@return         the Glushkov automaton's equivalent DFA, or NULL if fail
+	                or if the budget was exceeded
+
+	Convert a Glushkov automaton to a DFA via the subset construction. Each
+	DFAState is a set of positions.
+*/
+DFA *position_subset(PositionNFA *pnfa, Budget *budget)
+{
+	if (!budget_add_bytes(budget, sizeof(DFA)))
+		return NULL;
+	DFA *dfa = init_dfa_with_labels(pnfa->chars, pnfa->size);
+	if (!dfa)
+		return NULL;
+	dfa->budget = budget;
+
+	Set *q0 = init_set(compare_nfastates);
+	if (!q0) {
+		destroy_dfa(dfa);
+		return NULL;
+	}
+	set_insert(q0, &pnfa->states[0]);
+	if (!budget_add_bytes(budget, dfa->alphabet_size) ||
+	    !(dfa->start = add_dfastate(dfa, q0, pnfa->is_accept[0]))) {
+		destroy_set(q0);
+		destroy_dfa(dfa);
+		return NULL;
+	}
+
+	Set *worklist = init_set(compare_sets);
+	set_insert(worklist, q0);
+
+	Set *q, *t, *found;
+	DFAState *qstate;
+	while (!set_is_empty(worklist)) {
+		q = set_decapitate(worklist);
+		qstate = (DFAState *)(q->id);
+		for (int i = 0; i < dfa->alphabet_size; i++) {
+			t = position_delta(pnfa, q, dfa->alphabet[i]);
+			if (t && set_is_empty(t)) {
+				destroy_set(t);
+				continue;
+			}
+			found = t ? set_find(dfa->mem_region, t) : NULL;
+			if (found) {
+				qstate->outs[i] = (DFAState *)(found->id);
+				destroy_set(t);
+				continue;
+			}
+			if (t)
+				qstate->outs[i] = add_dfastate(dfa, t,
+				                  has_accept(pnfa, t));
+			if (!t || !qstate->outs[i]) {
+				// every set in the worklist is also in
+				// dfa->mem_region, so destroy_dfa() frees them
+				destroy_set(t);
+				destroy_set(worklist);
+				destroy_dfa(dfa);
+				return NULL;
+			}
+			set_insert(worklist, t);
+		}
+	}
+	destroy_set(worklist);
+	dfa->size = dfa->mem_region->size;
+	return dfa;
+}
+
+/* convert_glushkov_to_dfa()
+	@pnfa           ptr to PositionNFA struct
+
+	@return         ptr to a new DFA that's equivalent to the Glushkov
+	                automaton, NULL if fail
+
+	Convert a Glushkov automaton to a DFA and populate the internal tables
+	in the DFA struct.
+*/
+DFA *convert_glushkov_to_dfa(PositionNFA *pnfa)
+{
+	return bounded_convert_glushkov_to_dfa(pnfa, NULL);
+}
+
+/* bounded_convert_glushkov_to_dfa()
+	@pnfa           ptr to PositionNFA struct
+	@budget         ptr to Budget struct, NULL if unlimited
+
+	@return         ptr to a new DFA that's equivalent to the Glushkov
+	                automaton, NULL if fail or if the budget was exceeded
+
+	Convert a Glushkov automaton to a DFA without exceeding a budget, and
+	populate the internal tables in the DFA struct.
+*/
+DFA *bounded_convert_glushkov_to_dfa(PositionNFA *pnfa, Budget *budget)
+{
+	DFA *dfa = position_subset(pnfa, budget);
+	if (!dfa)
+		return NULL;
+	return build_dfa_tables(dfa);
+}
+
+/* gen_position_nfa_graphviz()
+	@pnfa           ptr to PositionNFA struct
+	@file_name      .dot file name
+
+	@return         0 on success, otherwise -1
+
+	Generate a Graphviz dot representation of a PositionNFA. Every edge into
+	position p is labeled with the chars of p.
+*/
+int gen_position_nfa_graphviz(PositionNFA *pnfa, const char *file_name)
+{
+	FILE *f = fopen(file_name, "w");
+	if (!f)
+		return -1;
+
+	fprintf(f, "digraph NFA {\n");
+	fprintf(f, "\tfontname = \"Helvetica,Arial,sans-serif\";\n");
+	fprintf(f, "\tnode [fontname=\"Helvetica,Arial,sans-serif\"];\n");
+	fprintf(f, "\tedge [fontname=\"Helvetica,Arial,sans-serif\"];\n");
+	fprintf(f, "\trankdir = LR;\n");
+
+	fprintf(f, "\tnode [shape=doublecircle];");
+	for (int p = 0; p < pnfa->size; p++) {
+		if (pnfa->is_accept[p])
+			fprintf(f, " n%d", p);
+	}
+	fprintf(f, ";\n");
+
+	fprintf(f, "\tnode [shape=circle];\n");
+	int q;
+	for (int p = 0; p < pnfa->size; p++) {
+		for (int i = 0; i < pnfa->follow[p].size; i++) {
+			q = pnfa->follow[p].positions[i];
+			fprintf(f, "\tn%d -> n%d [label=\"", p, q);
+			generate_transition_label(f, &pnfa->chars[q]);
+			fprintf(f, "\"]\n");
+		}
+	}
+	fprintf(f, "}\n");
+
+	fclose(f);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+/** glushkov.h
+
+Module definition for Glushkov (position) automata.
+
+*/
+
+#ifndef GLUSHKOV_H
+#define GLUSHKOV_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "budget.h"
+#include "charset.h"
+#include "common.h"
+#include "dfa.h"
+#include "nfa.h"
+
+// sorted list of positions
+typedef struct PosList {
+	int *positions;
+	int size;
+} PosList;
+
+// built by glushkov() from a syntax tree, or by remove_epsilons() from a
+// Thompson NFA
+typedef struct PositionNFA {
+	int size;  // number of positions + 1 for the start state
+
+	NFAState *states;
+	/*
+	states[0] is the start state, states[p] is position p
+	Every transition INTO position p reads one of the chars of position p,
+	so the automaton has no epsilon transitions at all. states[p].ch is
+	the char of a literal position, CHAR_CLASS for a class.
+	The out1/out2 members are unused. Only ch and index matter, and index
+	is simply the position.
+	NFAStates are reused so subset construction can store them in sets with
+	compare_nfastates(), and gen_dfa_graphviz() can print them.
+	*/
+	PosList *follow;
+	/*
+	follow[p] holds every position that can come right after position p
+	follow[0] is the first set of the whole regex
+	*/
+	CharSet *chars;  // chars[p] is the set of chars that position p reads
+	bool *is_accept;  // is_accept[p] iff p is in the last set of the regex
+	                  // is_accept[0] iff the regex matches the empty string
+
+	CharSet alphabet;
+} PositionNFA;
+
+PositionNFA *init_position_nfa(int num_positions);
+void destroy_position_nfa(PositionNFA *pnfa);
+PositionNFA *glushkov(ASTNode *root);
+PositionNFA *remove_epsilons(NFA *nfa);
+
+Set *position_delta(PositionNFA *pnfa, Set *states, U8 ch);
+DFA *position_subset(PositionNFA *pnfa, Budget *budget);
+DFA *convert_glushkov_to_dfa(PositionNFA *pnfa);
+DFA *bounded_convert_glushkov_to_dfa(PositionNFA *pnfa, Budget *budget);
+
+int gen_position_nfa_graphviz(PositionNFA *pnfa, const char *file_name);
+
+#endif
\ No newline at end of file
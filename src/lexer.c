@@ -4,13 +4,19 @@ Lexical analyzer for regular expressions.
 
 */
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "common.h"
 #include "control.h"
 #include "lexer.h"
 
+#define ONES    0x0101010101010101ULL
+#define HIGHS   0x8080808080808080ULL
+
 /* get_char()
 	@cc             ptr to CmpCtrl struct
 
@@ -19,23 +25,87 @@ Lexical analyzer for regular expressions.
 	Read a character from control's buffer and advance the internal state
 	to the next character.
 */
-U8 get_char(CmpCtrl *cc)
+U16 get_char(CmpCtrl *cc)
 {
 	if (cc->pos >= cc->buffer_len)
 		return TK_EOF;
-	return cc->buffer[cc->pos++];
+	return (U8)cc->buffer[cc->pos++];
 }
 
-/* lex()
+/* hex_digit()
+	@ch             raw character
+
+	@return         value of the hex digit @ch, -1 if it isn't one
+*/
+static int hex_digit(U16 ch)
+{
+	if ('0' <= ch && ch <= '9')
+		return ch - '0';
+	if ('a' <= ch && ch <= 'f')
+		return ch - 'a' + 10;
+	if ('A' <= ch && ch <= 'F')
+		return ch - 'A' + 10;
+	return -1;
+}
+
+/* hex_escape()
 	@cc             ptr to CmpCtrl struct
 
-	@return         next token
+	@return         byte written as 2 hex digits after \x, TK_ILLEGAL if
+	                they aren't hex digits
+
+	Read the rest of an escape sequence like \x7F, which matches any byte
+	even if it can't be typed.
+*/
+static U16 hex_escape(CmpCtrl *cc)
+{
+	int high = hex_digit(get_char(cc));
+	if (high == -1)
+		return TK_ILLEGAL;
+	int low = hex_digit(get_char(cc));
+	if (low == -1)
+		return TK_ILLEGAL;
+	return high * 16 + low;
+}
+
+/* starts_repeat()
+	@cc             ptr to CmpCtrl struct
+
+	@return         true if the chars after a { are a repeat count
 
-	Fetch the next token.
+	Look ahead for the rest of {m}, {m,}, or {m,n} without consuming
+	anything. Anything else, like the { in a C token list, is a literal.
 */
-U8 lex(CmpCtrl *cc)
+static bool starts_repeat(const CmpCtrl *cc)
 {
-	U8 ch = get_char(cc);
+	int i = cc->pos;
+	int digits = 0;
+	while (i < cc->buffer_len && '0' <= cc->buffer[i] &&
+	       cc->buffer[i] <= '9') {
+		i++;
+		digits++;
+	}
+	if (!digits || i >= cc->buffer_len)
+		return false;
+	if (cc->buffer[i] == ',') {
+		i++;
+		while (i < cc->buffer_len && '0' <= cc->buffer[i] &&
+		       cc->buffer[i] <= '9')
+			i++;
+	}
+	return i < cc->buffer_len && cc->buffer[i] == '}';
+}
+
+/* scan_token()
+	@cc             ptr to CmpCtrl struct
+
+	@return         next token in the buffer
+
+	Read the raw chars of one token and translate them.
+*/
+static U16 scan_token(CmpCtrl *cc)
+{
+	U16 ch = get_char(cc);
 
 	if (ch == '\\') {
 		ch = get_char(cc);
@@ -49,9 +119,14 @@ U8 lex(CmpCtrl *cc)
 		case '?':
 		case '+':
 		case ']':
+		case '{':
+		case '}':
+		case '^':
+		case '$':
 		case '\\': break;  // retain the value in ch
 		case 'n': ch = '\n'; break;
 		case 't': ch = '\t'; break;
+		case 'x': ch = hex_escape(cc); break;
 		default: ch = TK_ILLEGAL; break;  // invalid escape sequence
 		}
 	} else {
@@ -65,13 +140,116 @@ U8 lex(CmpCtrl *cc)
 		case '?': ch = TK_QUESTION; break;
 		case '+': ch = TK_PLUS; break;
 		case ']': ch = TK_RBRACKET; break;
+		case '{':
+			if (starts_repeat(cc))
+				ch = TK_LBRACE;
+			break;
+		case '$':
+			// only the last char of the regex is an anchor
+			if (cc->pos == cc->buffer_len) {
+				cc->flags |= CC_ANCHOR_END;
+				ch = TK_EOF;
+			}
+			break;
 		default: break;
 		}
 	}
-	cc->token = ch;
 	return ch;
 }
 
+/* has_metachar()
+	@word           8 chars of a regex
+
+	@return         true if any of the chars isn't a plain literal
+
+	Compare all 8 chars against every char that lex() translates at once.
+	A byte of word ^ (ONES * c) is zero exactly where that char is c, and
+	(x - ONES) & ~x & HIGHS is nonzero exactly when some byte of x is zero.
+*/
+static inline bool has_metachar(U64 word)
+{
+	static const U8 metachars[] = "\\.()[|*?+]{$";
+	U64 x;
+	U64 found = 0;
+	for (size_t i = 0; i < sizeof(metachars) - 1; i++) {
+		x = word ^ (ONES * metachars[i]);
+		found |= (x - ONES) & ~x & HIGHS;
+	}
+	return found;
+}
+
+/* prelex()
+	@cc             ptr to CmpCtrl struct
+
+	@return         true if success, otherwise false
+
+	Lex the rest of the buffer into cc->tokens, ending with TK_EOF, and
+	remember where each token ends so print_error() can still place its
+	arrow. Runs of 8 chars without a metachar are copied straight into
+	the token array. lex() then just reads the array. If this fails, lex()
+	keeps scanning the buffer directly.
+*/
+bool prelex(CmpCtrl *cc)
+{
+	clear_tokens(cc);
+	// at most one token per char, plus TK_EOF
+	int capacity = cc->buffer_len - cc->pos + 1;
+	cc->tokens = malloc(capacity * sizeof(U16));
+	cc->ends = malloc(capacity * sizeof(int));
+	if (!cc->tokens || !cc->ends) {
+		clear_tokens(cc);
+		return false;
+	}
+
+	int start = cc->pos;
+	int n = 0;
+	U64 word;
+	while (cc->pos < cc->buffer_len) {
+		while (cc->pos + 8 <= cc->buffer_len) {
+			memcpy(&word, cc->buffer + cc->pos, 8);
+			if (has_metachar(word))
+				break;
+			for (int i = 0; i < 8; i++) {
+				cc->tokens[n] = (U8)cc->buffer[cc->pos];
+				cc->ends[n++] = ++cc->pos;
+			}
+		}
+		if (cc->pos >= cc->buffer_len)
+			break;
+		cc->tokens[n] = scan_token(cc);
+		// a trailing $ already ends the regex
+		if (cc->tokens[n] == TK_EOF)
+			break;
+		cc->ends[n++] = cc->pos;
+	}
+	cc->tokens[n] = TK_EOF;
+	cc->ends[n++] = cc->pos;
+	cc->num_tokens = n;
+	cc->pos = start;
+	return true;
+}
+
+/* lex()
+	@cc             ptr to CmpCtrl struct
+
+	@return         next token
+
+	Fetch the next token, from cc->tokens if the buffer was prelexed.
+*/
+U16 lex(CmpCtrl *cc)
+{
+	if (cc->tokens) {
+		cc->token = cc->tokens[cc->next_token];
+		cc->pos = cc->ends[cc->next_token];
+		// stay on TK_EOF
+		if (cc->next_token < cc->num_tokens - 1)
+			cc->next_token++;
+		return cc->token;
+	}
+	cc->token = scan_token(cc);
+	return cc->token;
+}
+
 /* print_error()
 	@cc             ptr to CmpCtrl struct
 	@msg            string containg an error message
@@ -99,11 +277,16 @@ void print_error(const CmpCtrl *cc, const char *msg)
 		case TK_STAR: printf(" '*'"); break;
 		case TK_QUESTION: printf(" '?'"); break;
 		case TK_PLUS: printf(" '+'"); break;
+		case TK_LBRACE: printf(" '{'"); break;
 		case TK_RBRACKET: printf(" ']'"); break;
 		case TK_ILLEGAL: printf(" illegal escape sequence"); break;
 		default:
-			str[1] = cc->token;
-			printf(" %s", str);
+			if (' ' <= cc->token && cc->token <= '~') {
+				str[1] = cc->token;
+				printf(" %s", str);
+			} else {
+				printf(" '\\x%02X'", cc->token);
+			}
 		}
 	}
 	putchar('\n');
@@ -7,37 +7,40 @@ Module definition for the lexical analyzer.
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stdbool.h>
+
 #include "common.h"
 #include "control.h"
 
 // tokens for special regex chars like . ( * ? ] etc.
-#define TK_WILDCARD     127  // replaces ASCII 127 = DEL
-                             // who tf gonna match the DELETE char anyway???
-#define TK_EOF          128
-#define TK_LPAREN       129
-#define TK_RPAREN       130
-#define TK_LBRACKET     131
-#define TK_PIPE         132
-#define TK_STAR         133
-#define TK_QUESTION     134
-#define TK_PLUS         135
-#define TK_RBRACKET     136
-#define TK_ILLEGAL      137
+#define TK_WILDCARD     256
+#define TK_EOF          257
+#define TK_LPAREN       258
+#define TK_RPAREN       259
+#define TK_LBRACKET     260
+#define TK_PIPE         261
+#define TK_STAR         262
+#define TK_QUESTION     263
+#define TK_PLUS         264
+#define TK_LBRACE       265  // only when a repeat count like {2,5} follows
+#define TK_RBRACKET     266
+#define TK_ILLEGAL      267
 /*
 If the user wants to literally match them like \( \) \* etc. then the plain
-ASCII value will function as the token.
+byte value will function as the token. A { that doesn't start a repeat count,
+and the digits, comma, and } of one, are plain bytes too.
 
 Thus these token values are easily used in the NFAs/DFAs to indicate transition
 chars.
 
 Full character mapping:
-        0: indicates epsilon transition (NOT a token)
-  [1,127]: regular ASCII or . (what the user enters)
-[128,255]: special tokens
+  [0,255]: a byte to match, written as itself or as an escape like \xFF
+[256,267]: special tokens
 */
 
-U8 get_char(CmpCtrl *cc);
-U8 lex(CmpCtrl *cc);
+U16 get_char(CmpCtrl *cc);
+bool prelex(CmpCtrl *cc);
+U16 lex(CmpCtrl *cc);
 void print_error(const CmpCtrl *cc, const char *msg);
 
 #endif
\ No newline at end of file
@@ -1,38 +1,259 @@
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "bisimulation.h"
+#include "budget.h"
 #include "common.h"
 #include "control.h"
+#include "counter.h"
+#include "derivative.h"
 #include "dfa.h"
+#include "dictionary.h"
+#include "followpos.h"
+#include "glushkov.h"
 #include "lexer.h"
 #include "minimize.h"
 #include "nfa.h"
 #include "parser.h"
+#include "simplify.h"
 
-#define ABORT(file_name, cc, nfa, dfa, min_dfa, exit_msg) \
-	do { \
-		free((file_name)); \
-		destroy_cmpctrl((cc)); \
-		destroy_nfa_and_states((nfa)); \
-		destroy_dfa((dfa)); \
-		destroy_minimal_dfa((min_dfa)); \
-		fprintf(stderr, (exit_msg)); \
-		return EXIT_FAILURE; \
-	} while (0);
+// exit code when the DFA would exceed the -s or -b budget
+#define EXIT_OVER_BUDGET 2
+// exit code when -f wrote the NFA because the DFA would exceed the budget
+#define EXIT_NFA_ONLY    3
+
+// how the DFA gets built
+#define BUILD_GLUSHKOV   0
+#define BUILD_THOMPSON   1  // -t
+#define BUILD_DERIVATIVE 2  // -d
+#define BUILD_FOLLOWPOS  3  // -p
+#define BUILD_DICTIONARY 4  // -w, the file is a sorted word list, not a regex
+#define BUILD_EPS_FREE   5  // -e, Thompson NFA with its epsilons removed
+#define BUILD_COUNTER    6  // -c, counter automaton instead of a DFA
+
+// milliseconds of CPU time since an earlier clock()
+#define MS_SINCE(start) (1000.0 * (clock() - (start)) / CLOCKS_PER_SEC)
+
+#define USAGE "usage: tsuquo [-s max_dfa_states] [-b max_bytes] " \
+              "[-n max_repeat] [-i] [-u] [-f] [-r] " \
+              "[-t | -d | -p | -w | -e | -c] " \
+              "file\n"
+
+/* over_budget()
+	@budget         ptr to Budget that was exceeded
+	@fallback       whether to write the NFA instead
+	@root           ptr to root of the regex's syntax tree, or NULL
+	@file_name      name of output file
+
+	@return         exit code for main()
+
+	Report which cap was exceeded. If @fallback is set and there's a regex,
+	produce the Thompson NFA's file instead. No DFA was built either way,
+	so the exit code says which of the two happened.
+*/
+static int over_budget(Budget *budget, bool fallback, ASTNode *root,
+                       const char *file_name)
+{
+	if (budget->status == BUDGET_STATES_EXCEEDED)
+		fprintf(stderr, "DFA needs more than %d states\n",
+		        budget->max_states);
+	else
+		fprintf(stderr, "DFA needs more than %zu bytes\n",
+		        budget->max_bytes);
+
+	if (!fallback || !root)
+		return EXIT_OVER_BUDGET;
+	NFA *nfa = thompson(root);
+	if (!nfa || gen_nfa_graphviz(nfa, file_name) != 0) {
+		destroy_nfa_and_states(nfa);
+		return EXIT_FAILURE;
+	}
+	destroy_nfa_and_states(nfa);
+	printf("fallback: produced NFA file '%s' instead of a DFA\n",
+	       file_name);
+	return EXIT_NFA_ONLY;
+}
+
+/* build_minimal_dfa()
+	@root           ptr to root of a syntax tree
+	@budget         ptr to Budget, or NULL
+
+	@return         ptr to the minimal DFA of the tree, NULL if fail or if
+	                the budget was exceeded
+*/
+static MinimalDFA *build_minimal_dfa(ASTNode *root, Budget *budget)
+{
+	PositionNFA *pnfa = glushkov(root);
+	DFA *dfa = pnfa ? bounded_convert_glushkov_to_dfa(pnfa, budget) : NULL;
+	MinimalDFA *min_dfa = dfa ? minimize(dfa) : NULL;
+	destroy_dfa(dfa);
+	destroy_position_nfa(pnfa);
+	return min_dfa;
+}
+
+/* gen_span_graphviz()
+	@ast            ptr to AST struct of the regex
+	@regex          ptr to root of the regex's syntax tree, before it was
+	                unanchored
+	@budget         ptr to Budget, or NULL
+	@file_name      name of the forward DFA's output file
+
+	@return         exit code for main()
+
+	Produce the other two DFAs search_span() needs next to the forward
+	one: the minimal DFA of the regex itself, as "<name>_anchored.dot",
+	which finds where the leftmost-longest match ends, and its reverse, as
+	"<name>_reverse.dot", which walks back from there to its start.
+*/
+static int gen_span_graphviz(AST *ast, ASTNode *regex, Budget *budget,
+                             const char *file_name)
+{
+	int exit_code = EXIT_FAILURE;
+	MinimalDFA *anchored = NULL;
+	MinimalDFA *reverse = NULL;
+	// -4 for ".dot"
+	// +13 for "_anchored.dot", the longer suffix
+	// +1 for \0
+	size_t len = strlen(file_name) - 4;
+	char *span_name = calloc(len + 14, 1);
+	if (!span_name)
+		goto CLEANUP;
+	memcpy(span_name, file_name, len);
+
+	anchored = build_minimal_dfa(regex, budget);
+	reverse = anchored ? minimize_reverse(anchored, budget) : NULL;
+	if (!reverse && budget && budget->status != BUDGET_OK) {
+		exit_code = over_budget(budget, false, NULL, file_name);
+		goto CLEANUP;
+	}
+	if (!reverse) {
+		fprintf(stderr, "reverse DFA construction failed\n");
+		goto CLEANUP;
+	}
+	// the reversed DFA reads towards the start of the input
+	reverse->anchored_end = ast->anchored_start;
+	anchored->anchored_end = ast->anchored_end;
+	memcpy(span_name + len, "_reverse.dot", 13);
+	gen_minimal_dfa_graphviz(reverse, span_name);
+	printf("success: produced file '%s'\n", span_name);
+	memcpy(span_name + len, "_anchored.dot", 14);
+	gen_minimal_dfa_graphviz(anchored, span_name);
+	printf("success: produced file '%s'\n", span_name);
+	exit_code = 0;
+
+CLEANUP:
+	free(span_name);
+	destroy_minimal_dfa(anchored);
+	destroy_minimal_dfa(reverse);
+	return exit_code;
+}
 
 int main(int argc, char **argv)
 {
 	char *file_name = NULL;
 	CmpCtrl *cc = NULL;
+	AST *ast = NULL;
+	ASTNode *regex = NULL;
+	PositionNFA *pnfa = NULL;
+	CounterNFA *cnfa = NULL;
+	TermTable *tt = NULL;
+	Followpos *fp = NULL;
+	Dictionary *dict = NULL;
 	NFA *nfa = NULL;
 	DFA *dfa = NULL;
 	MinimalDFA *min_dfa = NULL;
+	Budget *budget = NULL;
+	const char *error = NULL;  // printed to stderr on the way out
+	int exit_code = 0;
+
+	int max_states = 0;
+	long max_bytes = 0;
+	int max_repeat = MAX_REPEAT;
+	bool fallback = false;
+	bool ignore_case = false;
+	bool unanchored = false;
+	bool reduce = false;
+	int construction = BUILD_GLUSHKOV;
+	int num_constructions = 0;
+	int arg = 1;
+	for (; arg < argc - 1; arg++) {
+		if (strcmp(argv[arg], "-s") == 0 && arg + 2 < argc) {
+			max_states = atoi(argv[++arg]);
+			if (max_states <= 0) {
+				error = USAGE;
+				goto CLEANUP;
+			}
+		} else if (strcmp(argv[arg], "-b") == 0 && arg + 2 < argc) {
+			max_bytes = atol(argv[++arg]);
+			if (max_bytes <= 0) {
+				error = USAGE;
+				goto CLEANUP;
+			}
+		} else if (strcmp(argv[arg], "-n") == 0 && arg + 2 < argc) {
+			max_repeat = atoi(argv[++arg]);
+			if (max_repeat <= 0) {
+				error = USAGE;
+				goto CLEANUP;
+			}
+		} else if (strcmp(argv[arg], "-i") == 0) {
+			ignore_case = true;
+		} else if (strcmp(argv[arg], "-u") == 0) {
+			unanchored = true;
+		} else if (strcmp(argv[arg], "-f") == 0) {
+			fallback = true;
+		} else if (strcmp(argv[arg], "-r") == 0) {
+			reduce = true;
+		} else if (strcmp(argv[arg], "-t") == 0) {
+			construction = BUILD_THOMPSON;
+			num_constructions++;
+		} else if (strcmp(argv[arg], "-d") == 0) {
+			construction = BUILD_DERIVATIVE;
+			num_constructions++;
+		} else if (strcmp(argv[arg], "-p") == 0) {
+			construction = BUILD_FOLLOWPOS;
+			num_constructions++;
+		} else if (strcmp(argv[arg], "-w") == 0) {
+			construction = BUILD_DICTIONARY;
+			num_constructions++;
+		} else if (strcmp(argv[arg], "-e") == 0) {
+			construction = BUILD_EPS_FREE;
+			num_constructions++;
+		} else if (strcmp(argv[arg], "-c") == 0) {
+			construction = BUILD_COUNTER;
+			num_constructions++;
+		} else {
+			error = USAGE;
+			goto CLEANUP;
+		}
+	}
+	if (arg != argc - 1 || num_constructions > 1) {
+		error = USAGE;
+		goto CLEANUP;
+	}
+	// a word list is matched exactly as written
+	if ((ignore_case || unanchored) && construction == BUILD_DICTIONARY) {
+		error = USAGE;
+		goto CLEANUP;
+	}
+	// only the position automata can be reduced
+	if (reduce && construction != BUILD_GLUSHKOV &&
+	    construction != BUILD_EPS_FREE) {
+		error = USAGE;
+		goto CLEANUP;
+	}
 
-	if (argc != 2)
-		ABORT(file_name, cc, nfa, dfa, min_dfa, "invalid cmdline args\n");
+	if (max_states || max_bytes) {
+		budget = init_budget(max_states, max_bytes);
+		if (!budget) {
+			error = "fatal memory error\n";
+			goto CLEANUP;
+		}
+	}
 
-	char *begin = argv[1];
+	char *begin = argv[arg];
 	char *true_begin = begin + strlen(begin);
 	while (*true_begin != '.')
 		true_begin--;
@@ -51,36 +272,226 @@ int main(int argc, char **argv)
 	// +4 for ".dot"
 	// +1 for \0
 	file_name = calloc(len + 10, 1);
-	if (!file_name)
-		ABORT(file_name, cc, nfa, dfa, min_dfa, "fatal memory error\n");
+	if (!file_name) {
+		error = "fatal memory error\n";
+		goto CLEANUP;
+	}
 	memcpy(file_name, "dots/", 5);
 	memcpy(file_name + 5, true_begin, len);
 	memcpy(file_name + 5 + len, ".dot", 4);
 
+	int status;
+	if (construction == BUILD_DICTIONARY) {
+		dict = init_dictionary();
+		if (!dict) {
+			error = "fatal memory error\n";
+			goto CLEANUP;
+		}
+		status = read_dictionary(dict, argv[arg]);
+		if (status == DICT_UNSORTED) {
+			fprintf(stderr, "line %d: word list isn't sorted\n",
+			        dict->num_lines);
+			error = "compilation failed\n";
+			goto CLEANUP;
+		}
+		if (status != DICT_SUCCESS) {
+			error = "couldn't read word list\n";
+			goto CLEANUP;
+		}
+		printf("built minimal DFA of %d states from %d words\n",
+		       dict->size, dict->num_words);
+
+		// the file is written straight from the dictionary, which is
+		// linear, so only the -s cap applies
+		if (!budget_add_states(budget, dict->size)) {
+			exit_code = over_budget(budget, fallback, NULL, file_name);
+			goto CLEANUP;
+		}
+		if (gen_dictionary_graphviz(dict, file_name) != 0) {
+			error = "couldn't write output file\n";
+			goto CLEANUP;
+		}
+		printf("success: produced file '%s'\n", file_name);
+		goto CLEANUP;
+	}
+
 	cc = init_cmpctrl();
-	if (!cc)
-		ABORT(file_name, cc, nfa, dfa, min_dfa, "fatal memory error\n");
-	if (read_file(cc, argv[1]) != 0)
-		ABORT(file_name, cc, nfa, dfa, min_dfa, "couldn't open input file\n")
+	if (!cc) {
+		error = "fatal memory error\n";
+		goto CLEANUP;
+	}
+	if (read_file(cc, argv[arg]) != 0) {
+		error = "couldn't open input file\n";
+		goto CLEANUP;
+	}
+	cc->max_repeat = max_repeat;
+	cc->ignore_case = ignore_case;
+	cc->keep_counts = construction == BUILD_COUNTER;
+
+	ast = parse_ast(cc);
+	if (!ast || cc->flags & CC_ABORT) {
+		error = "compilation failed\n";
+		goto CLEANUP;
+	}
+	int num_nodes = count_nodes(ast->root);
+	if (!simplify_ast(ast)) {
+		error = "fatal memory error\n";
+		goto CLEANUP;
+	}
+	printf("simplified syntax tree from %d to %d nodes\n", num_nodes,
+	       count_nodes(ast->root));
+	// match anywhere in the input, so one pass of the DFA finds every match
+	// the regex itself stays a subtree, its reverse finds where they start
+	regex = ast->root;
+	if (unanchored && !ast_unanchor(ast)) {
+		error = "fatal memory error\n";
+		goto CLEANUP;
+	}
+	// no automaton can read past the end of the input, so $ is up to
+	// whatever runs it
+	if (unanchored && ast->anchored_end)
+		printf("only a match at the end of the input counts\n");
+
+	// the Glushkov automaton has no epsilon transitions, so the subset
+	// construction is much faster with it than with the Thompson NFA
+	Term *term;
+	switch (construction) {
+	case BUILD_THOMPSON:
+		nfa = thompson(ast->root);
+		if (!nfa) {
+			error = "fatal memory error\n";
+			goto CLEANUP;
+		}
+		dfa = bounded_convert_nfa_to_dfa(nfa, budget);
+		break;
+	case BUILD_EPS_FREE:
+		nfa = thompson(ast->root);
+		pnfa = nfa ? remove_epsilons(nfa) : NULL;
+		if (!pnfa) {
+			error = "fatal memory error\n";
+			goto CLEANUP;
+		}
+		printf("removed epsilons from NFA of %d states, %d are left\n",
+		       nfa->size, pnfa->size);
+		break;
+	case BUILD_DERIVATIVE:
+		tt = init_term_table();
+		term = tt ? term_from_ast(tt, ast->root) : NULL;
+		if (!term) {
+			error = "fatal memory error\n";
+			goto CLEANUP;
+		}
+		dfa = bounded_derivative_dfa(tt, term, budget);
+		break;
+	case BUILD_COUNTER:
+		cnfa = counter_nfa(ast->root);
+		if (!cnfa) {
+			error = "fatal memory error\n";
+			goto CLEANUP;
+		}
+		printf("built counter automaton of %d states with %d counters\n",
+		       cnfa->pnfa->size, cnfa->num_counters);
+		if (gen_counter_nfa_graphviz(cnfa, file_name) != 0) {
+			error = "couldn't write output file\n";
+			goto CLEANUP;
+		}
+		printf("success: produced file '%s'\n", file_name);
+		goto CLEANUP;
+	case BUILD_FOLLOWPOS:
+		fp = followpos(ast->root);
+		if (!fp) {
+			error = "fatal memory error\n";
+			goto CLEANUP;
+		}
+		dfa = bounded_followpos_dfa(fp, budget);
+		break;
+	default:
+		pnfa = glushkov(ast->root);
+		if (!pnfa) {
+			error = "fatal memory error\n";
+			goto CLEANUP;
+		}
+		break;
+	}
 
-	nfa = parse(cc);
-	if (!nfa || cc->flags & CC_ABORT)
-		ABORT(file_name, cc, nfa, dfa, min_dfa, "compilation failed\n");
+	double unreduced_ms = -1.0;
+	clock_t start;
+	if (pnfa && reduce) {
+		start = clock();
+		PositionNFA *reduced = bisimulation_reduce(pnfa, BISIM_BOTH);
+		if (!reduced) {
+			error = "fatal memory error\n";
+			goto CLEANUP;
+		}
+		printf("reduced NFA from %d to %d states (%.0f%% removed) "
+		       "in %.2f ms\n", pnfa->size, reduced->size,
+		       100.0 * (pnfa->size - reduced->size) / pnfa->size,
+		       MS_SINCE(start));
+		// the DFA is the same either way, only the time differs
+		start = clock();
+		dfa = bounded_convert_glushkov_to_dfa(pnfa, budget);
+		if (dfa)
+			unreduced_ms = MS_SINCE(start);
+		destroy_dfa(dfa);
+		dfa = NULL;
+		reset_budget(budget);
+		destroy_position_nfa(pnfa);
+		pnfa = reduced;
+	}
+	if (pnfa) {
+		start = clock();
+		dfa = bounded_convert_glushkov_to_dfa(pnfa, budget);
+		if (dfa && reduce)
+			printf("subset construction took %.2f ms\n",
+			       MS_SINCE(start));
+		if (dfa && reduce && unreduced_ms >= 0.0)
+			printf("without the reduction it took %.2f ms\n",
+			       unreduced_ms);
+		else if (dfa && reduce)
+			printf("without the reduction it failed\n");
+	}
 
-	dfa = convert_nfa_to_dfa(nfa);
-	if (!dfa)
-		ABORT(file_name, cc, nfa, dfa, min_dfa, "DFA construction failed\n");
+	if (!dfa && budget && budget->status != BUDGET_OK) {
+		exit_code = over_budget(budget, fallback, ast->root, file_name);
+		goto CLEANUP;
+	}
+	if (!dfa) {
+		error = "DFA construction failed\n";
+		goto CLEANUP;
+	}
 
 	min_dfa = minimize(dfa);
-	if (!min_dfa)
-		ABORT(file_name, cc, nfa, dfa, min_dfa, "DFA minimization failed\n");
+	if (!min_dfa && budget && budget->status != BUDGET_OK) {
+		exit_code = over_budget(budget, fallback, ast->root, file_name);
+		goto CLEANUP;
+	}
+	if (!min_dfa) {
+		error = "DFA minimization failed\n";
+		goto CLEANUP;
+	}
+	min_dfa->anchored_end = unanchored && ast->anchored_end;
+
 	gen_minimal_dfa_graphviz(min_dfa, file_name);
 	printf("success: produced file '%s'\n", file_name);
+	if (unanchored)
+		exit_code = gen_span_graphviz(ast, regex, budget, file_name);
 
+CLEANUP:
+	if (error) {
+		fprintf(stderr, "%s", error);
+		exit_code = EXIT_FAILURE;
+	}
 	free(file_name);
 	destroy_cmpctrl(cc);
+	destroy_ast(ast);
+	destroy_position_nfa(pnfa);
+	destroy_counter_nfa(cnfa);
+	destroy_term_table(tt);
+	destroy_followpos(fp);
+	destroy_dictionary(dict);
 	destroy_nfa_and_states(nfa);
 	destroy_dfa(dfa);
 	destroy_minimal_dfa(min_dfa);
-	return 0;
+	destroy_budget(budget);
+	return exit_code;
 }
\ No newline at end of file
@@ -5,14 +5,23 @@ Minimize a deterministic finite automata.
 */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "budget.h"
+#include "charset.h"
 #include "common.h"
 #include "dfa.h"
 #include "minimize.h"
+#include "nfa.h"
 #include "set.h"
 
+// acyclic_heights() DFS colors
+#define UNVISITED 0
+#define ON_STACK  1
+#define FINISHED  2
+
 /* compare_minimal_dfastates()
 	@m1             ptr to MinimalDFAState
 	@m2             ptr to another MinimalDFAState
@@ -94,9 +103,18 @@ inline void destroy_minimal_dfastate(MinimalDFAState *min_state)
 	@return         ptr to dynamically allocated MinimalDFA, or NULL if fail
 
 	Dynamically allocate a MinimalDFA and initialize all possible members.
+	The quadratic merge[][] table is charged to the DFA's budget first, so
+	return NULL without allocating anything if the budget can't afford it.
 */
 MinimalDFA *init_minimal_dfa(DFA *dfa)
 {
+	size_t bytes = sizeof(MinimalDFA);
+	bytes += (dfa->size - 1) * sizeof(int *);
+	bytes += (size_t)(dfa->size - 1) * dfa->size * sizeof(int);
+	bytes += dfa->size * sizeof(int);  // numbers[]
+	if (!budget_add_bytes(dfa->budget, bytes))
+		return NULL;
+
 	MinimalDFA *min_dfa = calloc(1, sizeof(MinimalDFA));
 	if (!min_dfa)
 		return NULL;
@@ -131,7 +149,7 @@ MinimalDFA *init_minimal_dfa(DFA *dfa)
 				min_dfa->merge[i][j] = 1;
 		}
 		// values at column indices < j will be uninitialized
-		// this had caused a problem in quotient() --> distinguishable()
+		// this had caused a problem in quotient()
 		// i will keep the uninitialized values, since it allows
 		// valgrind to detect it
 	}
@@ -169,11 +187,8 @@ void destroy_minimal_dfa(MinimalDFA *min_dfa)
 	free(min_dfa->merge);
 
 	if (min_dfa->delta) {
-		for (int i = 0; i < min_dfa->size; i++) {
-			for (int j = 0; j < min_dfa->size; j++)
-				free(min_dfa->delta[i][j]);
+		for (int i = 0; i < min_dfa->size; i++)
 			free(min_dfa->delta[i]);
-		}
 	}
 	free(min_dfa->delta);
 
@@ -194,128 +209,131 @@ void destroy_minimal_dfa(MinimalDFA *min_dfa)
 }
 
 
-/* distinguishable()
-	@i              a DFA state index
-	@j              another DFA state index
+/* quotient()
 	@min_dfa        ptr to MinimalDFA struct
 	@dfa            ptr to DFA struct
 
-	@return         true if states i,j are distinguishable, otherwise false
+	@return         0 if success, -1 if fail or if the DFA's budget can't
+	                afford the work tables
+
+	Perform the quotient construction on a DFA in order to find equivalent
+	states.
 
-	Check whether two states are distinguishable according to the quotient
-	construction.
+	A pair is distinguishable if it's already marked, or if some char takes
+	it to a marked pair. So instead of asking every pair whether a suffix
+	distinguishes it, start from the marked pairs and walk the transitions
+	backwards: every pair that goes to a marked pair on some char gets
+	marked too, and is walked from in turn. Each pair is walked from at
+	most once, so this takes O(n^2) time for n states and a fixed alphabet.
 
-	If only one of i,j is an accepting state, then they are distinguishable.
-	Otherwise, if some suffix causes only one of i,j to transition to an
-	accepting state, then they are distinguishable.
-	Otherwise, no such suffix exists. Then i,j are in the same equivalence
-	class, so they are indistinguishable.
+	The dead state is state n, and goes to itself on every char. Pairs with
+	it don't have a spot in merge[][], so they're marked in their own
+	array.
 */
-bool distinguishable(int i, int j, MinimalDFA *min_dfa, DFA *dfa)
+int quotient(MinimalDFA *min_dfa, DFA *dfa)
 {
-	// a state is always indistinguishable with itself
-	// no suffix can ever distinguish a state from itself, because every
-	// suffix will generate the same transitions on i,j because i,j are
-	// the same state
-	if (i == j)
-		return false;
+	int n = dfa->size;
+	int alphabet_size = dfa->alphabet_size;
+	size_t num_edges = (size_t)(n + 1) * alphabet_size;
+	size_t bytes = (num_edges + 2) * sizeof(int) + num_edges * sizeof(int);
+	bytes += (size_t)(n + 1) * n * sizeof(int) + n * sizeof(bool);
+	if (!budget_add_bytes(dfa->budget, bytes))
+		return -1;
 
-	// dead/error state doesn't have a spot in the merge[][] table
-	if (i != DEAD_STATE && j != DEAD_STATE) {
-		if (i == min_dfa->rows) {
-/*
-We can't index the row with i so flip the indices and then check if the pair is
-already marked as distinguishable.
-
-If there are N states, they are numbered from 0..N-1. There are N columns (last
-index N-1) but only N-1 rows (last index N-2).
-So the highest that j can go is N-1, but in this if-block, we know that i == N-1
-because i == rows == N-1.
-Since we checked i == j which was false, j is not dead and not i. i is currently
-the maximum possible value that j could take, so if j != i then j must be less
-than i.
-j therefore must be in interval [0, rows). We can safely index the row with j.
-
-We can't use the check that comes after this if-block, because in there, we need
-to continue with the regular distinguishablility algorithm if the check fails.
-But when i == rows we definitely cannot do that since it would require us to
-access row index i which doesn't exist
-So that's why we need this separate if-block, so we can do `return false` at the
-very end without breaking the other scenario.
-*/
-			if (!min_dfa->merge[j][i])
-				return true;
-			return false;
+	// the states that go to t on c are preds[first[e]] up to
+	// preds[first[e+1]], where e = t * alphabet_size + c
+	int *first = calloc(num_edges + 2, sizeof(int));
+	int *preds = malloc(num_edges * sizeof(int));
+	// each pair is marked once, so it's on the worklist at most once
+	int *worklist = malloc(((size_t)(n + 1) * n + 2) * sizeof(int));
+	bool *dead_marks = calloc(n, sizeof(bool));
+	int status = -1;
+	if (!first || !preds || !worklist || !dead_marks)
+		goto CLEANUP;
+
+	// counting sort of the transitions by destination and char
+	int out;
+	size_t e;
+	for (int p = 0; p <= n; p++) {
+		for (int c = 0; c < alphabet_size; c++) {
+			out = p == n ? DEAD_STATE : dfa->delta[p][c];
+			if (out == DEAD_STATE)
+				out = n;
+			first[(size_t)out * alphabet_size + c + 2]++;
 		}
-
-		// i < j ALWAYS!!!
-		// if i > j then you'll access uninitialized merge[][] memory
-		int actuali = i < j ? i : j;
-		int actualj = i > j ? i : j;
-		// is the pair already marked as distinguishable?
-		if (!min_dfa->merge[actuali][actualj])
-			return true;
-	}
-
-	DFAState *accepti;
-	DFAState *acceptj;
-	if (i == DEAD_STATE)
-		accepti = NULL;
-	else
-		accepti = set_find(dfa->accepts, dfa->states[i]);
-	if (j == DEAD_STATE)
-		acceptj = NULL;
-	else
-		acceptj = set_find(dfa->accepts, dfa->states[j]);
-	if (!accepti ^ !acceptj) {
-		return true;
-	} else {
-		// recursively generate every suffix that could come out of
-		// states i,j
-		int outi, outj;
-		for (int c = 0; c < dfa->alphabet_size; c++) {
-			outi = i;
-			outj = j;
-			// don't index delta with -1
-			if (i != DEAD_STATE)
-				outi = dfa->delta[i][c];
-			if (j != DEAD_STATE)
-				outj = dfa->delta[j][c];
-			if (distinguishable(outi, outj, min_dfa, dfa))
-				return true;
+	}
+	for (e = 2; e < num_edges + 2; e++)
+		first[e] += first[e-1];
+	for (int p = 0; p <= n; p++) {
+		for (int c = 0; c < alphabet_size; c++) {
+			out = p == n ? DEAD_STATE : dfa->delta[p][c];
+			if (out == DEAD_STATE)
+				out = n;
+			preds[first[(size_t)out * alphabet_size + c + 1]++] = p;
 		}
-		return false;
 	}
-}
-
-/* quotient()
-	@min_dfa        ptr to MinimalDFA struct
-	@dfa            ptr to DFA struct
 
-	@return         0 if success (there should be no other return codes)
+	// the pairs marked so far
+	size_t top = 0;
+	for (int i = 0; i < min_dfa->rows; i++) {
+		for (int j = i+1; j < min_dfa->cols; j++) {
+			if (!min_dfa->merge[i][j]) {
+				worklist[top++] = i;
+				worklist[top++] = j;
+			}
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		if (dfa->states[i]->is_accept) {
+			dead_marks[i] = true;
+			worklist[top++] = i;
+			worklist[top++] = n;
+		}
+	}
 
-	Perform the quotient construction on a DFA in order to find equivalent
-	states.
-*/
-int quotient(MinimalDFA *min_dfa, DFA *dfa)
-{
-	bool made_mark = true;
-	while (made_mark) {
-		made_mark = false;
-		for (int i = 0; i < min_dfa->rows; i++) {
-			for (int j = i+1; j < min_dfa->cols; j++) {
-				// pair is already marked as distinguishable
-				// distinguishable = don't merge
-				if (!min_dfa->merge[i][j])
-					continue;
-				if (distinguishable(i, j, min_dfa, dfa)) {
-					min_dfa->merge[i][j] = false;
-					made_mark = true;
+	int p, q, a, b;
+	int *mark;
+	size_t f;
+	while (top) {
+		q = worklist[--top];
+		p = worklist[--top];
+		for (int c = 0; c < alphabet_size; c++) {
+			e = (size_t)p * alphabet_size + c;
+			f = (size_t)q * alphabet_size + c;
+			for (int x = first[e]; x < first[e+1]; x++) {
+				for (int y = first[f]; y < first[f+1]; y++) {
+					a = preds[x];
+					b = preds[y];
+					if (a > b) {
+						a = preds[y];
+						b = preds[x];
+					}
+					if (a == b)
+						continue;
+					if (b == n) {
+						if (dead_marks[a])
+							continue;
+						dead_marks[a] = true;
+					} else {
+						mark = &min_dfa->merge[a][b];
+						if (!*mark)
+							continue;
+						*mark = 0;
+					}
+					worklist[top++] = a;
+					worklist[top++] = b;
 				}
 			}
 		}
 	}
-	return 0;
+	status = 0;
+
+CLEANUP:
+	free(first);
+	free(preds);
+	free(worklist);
+	free(dead_marks);
+	return status;
 }
 
 /* collect_equivalents()
@@ -424,6 +442,9 @@ MinimalDFA *construct_minimal_states(MinimalDFA *min_dfa, DFA *dfa)
 				break;
 			}
 		}
+		// a DFA of one state has no rows, so its start is only here
+		if (min_dfa->rows == 0)
+			min_dfa->start = min_state;
 		set_insert(min_dfa->mem_region, min_set);
 	}
 	min_dfa->size = min_dfa->mem_region->size;
@@ -451,6 +472,33 @@ static Set *find_min_set(MinimalDFA *min_dfa, int state_index)
 	return NULL;
 }
 
+/* init_transition_table()
+	@size           number of minimal states
+
+	@return         ptr to dynamically allocated table of empty CharSets,
+	                NULL if fail
+*/
+static CharSet **init_transition_table(int size)
+{
+	// 1. allocate row for each minimal state
+	CharSet **T = calloc(size, sizeof(CharSet *));
+	if (!T)
+		return NULL;
+	for (int i = 0; i < size; i++) {
+		// 2. allocate a set of chars for each outgoing minimal state
+		T[i] = calloc(size, sizeof(CharSet));
+		if (!T[i])
+			goto FAIL;
+	}
+	return T;
+
+FAIL:
+	for (int i = 0; i < size && T[i]; i++)
+		free(T[i]);
+	free(T);
+	return NULL;
+}
+
 /* construct_transition_table()
 	@min_dfa        ptr to MinimalDFA struct
 	@dfa            ptr to DFA struct
@@ -458,30 +506,22 @@ static Set *find_min_set(MinimalDFA *min_dfa, int state_index)
 	@return         ptr to minimal DFA that has a newly allocated transition
 	                table, or NULL if fail
 
-	Allocate and construct the transition table for a minimized DFA.
+	Allocate and construct the transition table for a minimized DFA. The
+	table is charged to the DFA's budget first, so return NULL without
+	allocating anything if the budget can't afford it.
 */
 MinimalDFA *construct_transition_table(MinimalDFA *min_dfa, DFA *dfa)
 {
-	// represent a 2D array of bitfields of transition chars
-	// full bitfield requires two slots of U64, so concretely, array is 3D
+	// represent a 2D array of CharSets of transition chars, one row of
+	// CharSets per state
+	size_t n = min_dfa->size;
+	size_t bytes = n * sizeof(CharSet *) + n * n * sizeof(CharSet);
+	if (!budget_add_bytes(dfa->budget, bytes))
+		return NULL;
 
-	// 1. allocate row for each minimal state
-	U64 ***T = calloc(min_dfa->size, sizeof(U64 **));
-	if (!T)
+	min_dfa->delta = init_transition_table(min_dfa->size);
+	if (!min_dfa->delta)
 		return NULL;
-	for (int i = 0; i < min_dfa->size; i++) {
-		// 2. allocate column for each outgoing minimal state
-		T[i] = calloc(min_dfa->size, sizeof(U64 *));
-		if (!T[i])
-			return NULL;
-		for (int j = 0; j < min_dfa->size; j++) {
-			// 3. allocate slots for each bitfield
-			T[i][j] = calloc(2, sizeof(U64));
-			if (!T[i][j])
-				return NULL;
-		}
-	}
-	min_dfa->delta = T;
 
 	Iterator *it = set_begin(min_dfa->mem_region);
 	Set *curr_set, *dest_set;
@@ -496,22 +536,324 @@ MinimalDFA *construct_transition_table(MinimalDFA *min_dfa, DFA *dfa)
 		curr_index = ((MinimalDFAState *)(curr_set->id))->index;
 
 		// to where does the "set" transition?
-		U8 ch;
 		for (int i = 0; i < dfa->alphabet_size; i++) {
 			// i automatically maps to an outs index
 			out = dfa->states[head_index]->outs[i];
 			if (out) {
 				dest_set = find_min_set(min_dfa, out->index);
 				dest_index = ((MinimalDFAState *)(dest_set->id))->index;
-				ch = dfa->alphabet[i];
-				if (ch >= 64)
-					min_dfa->delta[curr_index][dest_index][ASCII64_127] |= (1ULL << (ch-64));
-				else
-					min_dfa->delta[curr_index][dest_index][ASCII0_63] |= (1ULL << ch);
+				charset_union(&min_dfa->delta[curr_index][dest_index],
+				              &dfa->classes[i]);
+			}
+		}
+	}
+	return min_dfa;
+}
+
+/* acyclic_heights()
+	@dfa            ptr to DFA struct
+
+	@return         array of the height of every DFA state, NULL if the DFA
+	                has a cycle or if fail
+
+	The height of a state is the length of the longest path from it to a
+	state without transitions, which only exists if there are no cycles.
+	Computed by a depth-first search with an explicit stack, which also
+	finds cycles since a cycle leads back to a state that's still on the
+	stack.
+*/
+static int *acyclic_heights(DFA *dfa)
+{
+	int *heights = calloc(dfa->size, sizeof(int));
+	int *stack = malloc(dfa->size * sizeof(int));
+	int *next_char = calloc(dfa->size, sizeof(int));
+	U8 *color = calloc(dfa->size, 1);
+	if (!heights || !stack || !next_char || !color)
+		goto FAIL;
+
+	int top = 0;
+	int q, out;
+	for (int root = 0; root < dfa->size; root++) {
+		if (color[root] != UNVISITED)
+			continue;
+		stack[top++] = root;
+		color[root] = ON_STACK;
+		while (top) {
+			q = stack[top-1];
+			if (next_char[q] == dfa->alphabet_size) {
+				color[q] = FINISHED;
+				top--;
+				if (top && heights[q] + 1 > heights[stack[top-1]])
+					heights[stack[top-1]] = heights[q] + 1;
+				continue;
+			}
+			out = dfa->delta[q][next_char[q]++];
+			if (out == DEAD_STATE)
+				continue;
+			if (color[out] == ON_STACK)
+				goto FAIL;
+			if (color[out] == FINISHED) {
+				if (heights[out] + 1 > heights[q])
+					heights[q] = heights[out] + 1;
+				continue;
+			}
+			stack[top++] = out;
+			color[out] = ON_STACK;
+		}
+	}
+	free(stack);
+	free(next_char);
+	free(color);
+	return heights;
+
+FAIL:
+	free(heights);
+	free(stack);
+	free(next_char);
+	free(color);
+	return NULL;
+}
+
+/* hash_signature()
+	@dfa            ptr to DFA struct
+	@q              DFA state index
+	@classes        equivalence class of every DFA state of lower height
+
+	@return         hash of whether @q accepts and the classes it
+	                transitions to
+*/
+static unsigned hash_signature(DFA *dfa, int q, int *classes)
+{
+	unsigned h = dfa->states[q]->is_accept;
+	int out;
+	for (int c = 0; c < dfa->alphabet_size; c++) {
+		out = dfa->delta[q][c];
+		h = h * 31 + (out == DEAD_STATE ? 0 : classes[out] + 1);
+	}
+	return h ^ (h >> 16);
+}
+
+/* same_signature()
+	@dfa            ptr to DFA struct
+	@q              DFA state index
+	@r              another DFA state index, of the same height
+	@classes        equivalence class of every DFA state of lower height
+
+	@return         true if @q and @r are equivalent
+*/
+static bool same_signature(DFA *dfa, int q, int r, int *classes)
+{
+	if (dfa->states[q]->is_accept != dfa->states[r]->is_accept)
+		return false;
+	int outq, outr;
+	for (int c = 0; c < dfa->alphabet_size; c++) {
+		outq = dfa->delta[q][c];
+		outr = dfa->delta[r][c];
+		if (outq == DEAD_STATE || outr == DEAD_STATE) {
+			if (outq != outr)
+				return false;
+		} else if (classes[outq] != classes[outr]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* revuz()
+	@dfa            ptr to acyclic DFA struct
+	@heights        height of every DFA state, see acyclic_heights()
+	@classes        array which receives the equivalence class of every
+	                DFA state
+
+	@return         number of equivalence classes, -1 if fail
+
+	Revuz's linear minimization of acyclic DFAs. Equivalent states always
+	have the same height, and a state only transitions to lower states. So
+	the states are bucket sorted by height, and the buckets are visited
+	from the bottom up: by then, every destination already has its class,
+	and two states are equivalent if they both accept or both don't, and
+	they transition on the same chars to the same classes. Those signatures
+	are hashed, so each state is only compared with the few that collide
+	with it. Finally, the classes are numbered in order of their lowest DFA
+	state, the same as construct_minimal_states() does.
+*/
+static int revuz(DFA *dfa, int *heights, int *classes)
+{
+	int n = dfa->size;
+	int max_height = 0;
+	for (int i = 0; i < n; i++) {
+		if (heights[i] > max_height)
+			max_height = heights[i];
+	}
+
+	int *bucket_start = calloc(max_height + 2, sizeof(int));
+	int *order = malloc(n * sizeof(int));
+	int *table = malloc(2 * n * sizeof(int));
+	int *numbering = malloc(n * sizeof(int));
+	int num_classes = -1;
+	if (!bucket_start || !order || !table || !numbering)
+		goto CLEANUP;
+
+	// bucket sort by height
+	for (int i = 0; i < n; i++)
+		bucket_start[heights[i] + 1]++;
+	for (int h = 0; h <= max_height; h++)
+		bucket_start[h+1] += bucket_start[h];
+	for (int i = 0; i < n; i++)
+		order[bucket_start[heights[i]]++] = i;
+	for (int h = max_height; h > 0; h--)
+		bucket_start[h] = bucket_start[h-1];
+	bucket_start[0] = 0;
+
+	// open addressing, with twice as many slots as states of a height
+	int count = 0;
+	int begin, size, slot, q;
+	for (int h = 0; h <= max_height; h++) {
+		begin = bucket_start[h];
+		size = 2 * (bucket_start[h+1] - begin);
+		for (int i = 0; i < size; i++)
+			table[i] = -1;
+		for (int i = begin; i < bucket_start[h+1]; i++) {
+			q = order[i];
+			slot = hash_signature(dfa, q, classes) % size;
+			while (table[slot] != -1 &&
+			       !same_signature(dfa, q, table[slot], classes))
+				slot = (slot + 1) % size;
+			if (table[slot] == -1) {
+				table[slot] = q;
+				classes[q] = count++;
+			} else {
+				classes[q] = classes[table[slot]];
 			}
 		}
 	}
+
+	for (int i = 0; i < count; i++)
+		numbering[i] = -1;
+	num_classes = 0;
+	for (int i = 0; i < n; i++) {
+		if (numbering[classes[i]] == -1)
+			numbering[classes[i]] = num_classes++;
+		classes[i] = numbering[classes[i]];
+	}
+
+CLEANUP:
+	free(bucket_start);
+	free(order);
+	free(table);
+	free(numbering);
+	return num_classes;
+}
+
+/* minimize_acyclic()
+	@dfa            ptr to acyclic DFA struct
+	@heights        height of every DFA state, see acyclic_heights()
+
+	@return         ptr to dynamically allocated MinimalDFA struct, or NULL
+	                if fail
+
+	Minimize an acyclic DFA with revuz(), skipping the quadratic merge[][]
+	table and the quotient construction altogether. The result is the same
+	as the quotient construction's, except merge[][] stays NULL. The
+	transition table is charged to the DFA's budget first.
+*/
+static MinimalDFA *minimize_acyclic(DFA *dfa, int *heights)
+{
+	int *classes = malloc(dfa->size * sizeof(int));
+	if (!classes)
+		return NULL;
+	int num_classes = revuz(dfa, heights, classes);
+	if (num_classes == -1) {
+		free(classes);
+		return NULL;
+	}
+
+	size_t n = num_classes;
+	size_t bytes = sizeof(MinimalDFA) + dfa->size * sizeof(int);
+	bytes += n * sizeof(CharSet *) + n * n * sizeof(CharSet);
+	MinimalDFA *min_dfa = NULL;
+	Set **min_sets = calloc(num_classes, sizeof(Set *));
+	if (!min_sets || !budget_add_bytes(dfa->budget, bytes))
+		goto FAIL;
+
+	min_dfa = calloc(1, sizeof(MinimalDFA));
+	if (!min_dfa)
+		goto FAIL;
+	min_dfa->accepts = init_set(compare_minimal_dfastates);
+	min_dfa->mem_region = init_set(compare_minimal_sets);
+	min_dfa->numbers = malloc(dfa->size * sizeof(int));
+	if (!min_dfa->accepts || !min_dfa->mem_region || !min_dfa->numbers)
+		goto FAIL;
+
+	MinimalDFAState *min_state;
+	for (int i = 0; i < num_classes; i++) {
+		min_sets[i] = init_set(compare_ints);
+		if (!min_sets[i])
+			goto FAIL;
+	}
+	for (int i = 0; i < dfa->size; i++) {
+		min_dfa->numbers[i] = i;
+		if (set_insert(min_sets[classes[i]], &(min_dfa->numbers[i])) ==
+		    INSERT_ERROR)
+			goto FAIL;
+	}
+	for (int i = 0; i < num_classes; i++) {
+		min_state = init_minimal_dfastate();
+		if (!min_state)
+			goto FAIL;
+		min_state->index = i;
+		min_state->constituent_dfa_indices = min_sets[i];
+		min_sets[i]->id = min_state;
+		if (set_insert(min_dfa->mem_region, min_sets[i]) ==
+		    INSERT_ERROR) {
+			destroy_minimal_dfastate(min_state);
+			goto FAIL;
+		}
+		min_sets[i] = NULL;  // owned by mem_region now
+	}
+
+	int head;
+	Iterator *it = set_begin(min_dfa->mem_region);
+	for (; it; advance_iter(&it)) {
+		min_state = (MinimalDFAState *)((Set *)it->element)->id;
+		head = *(int *)((Set *)it->element)->head->element;
+		if (dfa->states[head]->is_accept) {
+			min_state->is_accept = true;
+			if (set_insert(min_dfa->accepts, min_state) ==
+			    INSERT_ERROR)
+				goto FAIL;
+		}
+	}
+	min_dfa->start = (MinimalDFAState *)
+	                 ((Set *)set_begin(min_dfa->mem_region)->element)->id;
+	min_dfa->size = num_classes;
+
+	min_dfa->delta = init_transition_table(num_classes);
+	if (!min_dfa->delta)
+		goto FAIL;
+	int out;
+	for (int i = 0; i < dfa->size; i++) {
+		for (int c = 0; c < dfa->alphabet_size; c++) {
+			out = dfa->delta[i][c];
+			if (out == DEAD_STATE)
+				continue;
+			charset_union(&min_dfa->delta[classes[i]][classes[out]],
+			              &dfa->classes[c]);
+		}
+	}
+	free(classes);
+	free(min_sets);
 	return min_dfa;
+
+FAIL:
+	if (min_sets) {
+		for (int i = 0; i < num_classes; i++)
+			destroy_set(min_sets[i]);
+	}
+	free(min_sets);
+	free(classes);
+	destroy_minimal_dfa(min_dfa);
+	return NULL;
 }
 
 /* minimize()
@@ -520,138 +862,168 @@ MinimalDFA *construct_transition_table(MinimalDFA *min_dfa, DFA *dfa)
 	@return         ptr to dynamically allocated MinimalDFA struct, or NULL
 	                if fail
 
-	Minimize a DFA and produce a MinimalDFA.
+	Minimize a DFA and produce a MinimalDFA. If the DFA has no cycles, eg
+	the regex has no * or +, it's minimized in linear time with Revuz's
+	algorithm, otherwise with the quotient construction. If the DFA has a
+	budget and minimization would exceed it, return NULL;
+	@dfa->budget->status tells which cap was exceeded.
 */
 MinimalDFA *minimize(DFA *dfa)
 {
+	int *heights = acyclic_heights(dfa);
+	if (heights) {
+		MinimalDFA *min_dfa = minimize_acyclic(dfa, heights);
+		free(heights);
+		return min_dfa;
+	}
+
 	MinimalDFA *min_dfa = init_minimal_dfa(dfa);
 	if (!min_dfa)
 		return NULL;
-	if (quotient(min_dfa, dfa) != 0)
+	if (quotient(min_dfa, dfa) != 0 ||
+	    !construct_minimal_states(min_dfa, dfa) ||
+	    !construct_transition_table(min_dfa, dfa)) {
+		destroy_minimal_dfa(min_dfa);
 		return NULL;
-	if (!construct_minimal_states(min_dfa, dfa))
+	}
+	return min_dfa;
+}
+
+/* add_nfastate()
+	@nfa            ptr to NFA struct under construction
+
+	@return         ptr to a new epsilon state owned by @nfa, NULL if fail
+*/
+static NFAState *add_nfastate(NFA *nfa)
+{
+	NFAState *state = init_nfastate();
+	if (!state)
 		return NULL;
-	if (!construct_transition_table(min_dfa, dfa))
+	if (set_insert(nfa->mem_region, state) == INSERT_ERROR) {
+		destroy_nfastate(state);
 		return NULL;
-	return min_dfa;
+	}
+	nfa->size++;
+	return state;
 }
 
-// check if a character needs to be escaped in a regex range
-static inline bool needs_escape(U8 ch)
+/* fan_out()
+	@state          ptr to epsilon NFAState
+	@targets        array of states to reach from @state
+	@n              number of states in @targets
+
+	@return         true if success, otherwise false
+
+	Give an epsilon state one epsilon transition to every target, in out1,
+	out2, and then outs[] like nfa_union_all() does.
+*/
+static bool fan_out(NFAState *state, NFAState **targets, int n)
 {
-	return ch == ']' || ch == '\\';
+	state->out1 = n > 0 ? targets[0] : NULL;
+	state->out2 = n > 1 ? targets[1] : NULL;
+	if (n <= 2)
+		return true;
+	state->outs = malloc((n - 2) * sizeof(NFAState *));
+	if (!state->outs)
+		return false;
+	for (int i = 2; i < n; i++)
+		state->outs[i-2] = targets[i];
+	state->num_outs = n - 2;
+	return true;
 }
 
-/* generate_transition_label()
-	@f              output file
-	@lower          bitfield of transition chars (ASCII [0,63])
-	@upper          bitfield of transition chars (ASCII [64,127])
+/* reverse_minimal_dfa()
+	@min_dfa        ptr to MinimalDFA struct
 
-	Print a transition label to a Graphviz dot file.
+	@return         ptr to an NFA that accepts every string of @min_dfa
+	                backwards, NULL if fail
+
+	Flip every transition of a minimal DFA. Many transitions can lead into
+	one state, and they become transitions out of it, but a Thompson state
+	only reads one set of chars. So each DFA state becomes an epsilon state
+	that fans out to one new state per flipped transition, which reads the
+	transition's chars. The start fans out to every accept state of the
+	DFA, and the DFA's start gets an epsilon to the accept state.
 */
-static void generate_transition_label(FILE *f, U64 lower, U64 upper)
+NFA *reverse_minimal_dfa(MinimalDFA *min_dfa)
 {
-	if (lower == (0xFFFFFFFF00000000 | 1ULL << '\n' | 1ULL << '\t') &&
-	    upper == 0x7FFFFFFFFFFFFFFF) {
-		fprintf(f, "&Sigma;");
-		return;
+	int size = min_dfa->size;
+	NFA *nfa = init_nfa();
+	NFAState **fans = calloc(size, sizeof(NFAState *));
+	// every state's transitions in, plus the accept state
+	NFAState **targets = malloc((size + 1) * sizeof(NFAState *));
+	if (!nfa || !fans || !targets)
+		goto FAIL;
+	if (!(nfa->start = add_nfastate(nfa)) ||
+	    !(nfa->accept = add_nfastate(nfa)))
+		goto FAIL;
+	for (int i = 0; i < size; i++) {
+		if (!(fans[i] = add_nfastate(nfa)))
+			goto FAIL;
 	}
 
-	U64 bitfield = lower;
-	U8 i = 0;
-	U8 left, right;
-	bool first_time = true;
-	// print transitions for one contiguous chunk of 1s, and chop the bits
-	// off
-	do {
-		// skip leading 0-bits
-		while (!(bitfield & 1)) {
-			bitfield >>= 1;
-			i++;
-			if (i == 64)
-				bitfield = upper;
-			else if (i >= 128)
-				goto STOP;  // YEEEEEEEEEEEEEEAAAAAAAAAAHHHHHHHH
-		}
-
-		// found the next leftmost 1-bit
-		left = i;
-		right = i;
-
-		// check if there are contiguous 1s, ie a range
-		// if so, find the rightmost 1-bit of the range
-		bitfield >>= 1;
-		i++;
-		while (bitfield & 1) {
-			right = i;
-			bitfield >>= 1;
-			i++;
-			if (i == 64)
-				bitfield = upper;
+	int n, single;
+	NFAState *state;
+	for (int j = 0; j < size; j++) {
+		n = 0;
+		for (int i = 0; i < size; i++) {
+			if (charset_is_empty(&min_dfa->delta[i][j]))
+				continue;
+			if (!(state = add_nfastate(nfa)))
+				goto FAIL;
+			single = charset_single(&min_dfa->delta[i][j]);
+			state->ch = single == -1 ? CHAR_CLASS : single;
+			state->chars = min_dfa->delta[i][j];
+			state->out1 = fans[i];
+			charset_union(&nfa->alphabet, &state->chars);
+			targets[n++] = state;
 		}
+		if (j == min_dfa->start->index)
+			targets[n++] = nfa->accept;
+		if (!fan_out(fans[j], targets, n))
+			goto FAIL;
+	}
 
-		if (!first_time)
-			fprintf(f, "\\n");
-		else
-			first_time = false;
+	n = 0;
+	Iterator *it = set_begin(min_dfa->accepts);
+	for (; it; advance_iter(&it))
+		targets[n++] = fans[((MinimalDFAState *)it->element)->index];
+	if (!fan_out(nfa->start, targets, n))
+		goto FAIL;
+
+	free(fans);
+	free(targets);
+	return nfa;
+
+FAIL:
+	destroy_nfa_and_states(nfa);
+	free(fans);
+	free(targets);
+	return NULL;
+}
 
-		if (left == right) {
-			// one char
-			switch (left) {
-			case '\\':
-				fprintf(f, "\\\\");
-				break;
-			case '\"':
-				fprintf(f, "\\\"");
-				break;
-			case '\n':
-				fprintf(f, "\\\\n");
-				break;
-			case '\t':
-				fprintf(f, "\\\\t");
-				break;
-			default:
-				fprintf(f, "%c", left);
-				break;
-			}
-		} else {
-			// range
-			fprintf(f, "[");
-			if (left == '\t') {
-				fprintf(f, "\\\\t");
-			} else if (left == '\n') {
-				fprintf(f, "\\\\n");
-			} else if (left == '\"') {
-				fprintf(f, "\\\"");
-				// double quote needs an escape because we are
-				// in a string, not because we are in a regex
-				// range
-			} else {
-				if (needs_escape(left))
-					fprintf(f, "\\\\");
-				fprintf(f, "%c", left);
-			}
+/* minimize_reverse()
+	@min_dfa        ptr to MinimalDFA struct
+	@budget         ptr to Budget struct, NULL if unlimited
 
-			if (right - left != 1)
-				fprintf(f, "-");
-			// if range is 2 adjacent chars, don't print a hyphen
+	@return         ptr to the minimal DFA that accepts every string of
+	                @min_dfa backwards, NULL if fail or if the budget was
+	                exceeded
 
-			if (right == '\t') {
-				fprintf(f, "\\\\t");
-			} else if (right == '\n') {
-				fprintf(f, "\\\\n");
-			} else if (right == '\"') {
-				fprintf(f, "\\\"");
-			} else {
-				if (needs_escape(right))
-					fprintf(f, "\\\\");
-				fprintf(f, "%c", right);
-			}
-			fprintf(f, "]");
-		}
-	} while (1);
-STOP:
-	return;
+	Reverse a minimal DFA, then run the subset construction and minimize
+	the result. Reversing can make the subset construction blow up like
+	any other NFA, so it's charged to the budget too.
+*/
+MinimalDFA *minimize_reverse(MinimalDFA *min_dfa, Budget *budget)
+{
+	NFA *nfa = reverse_minimal_dfa(min_dfa);
+	if (!nfa)
+		return NULL;
+	DFA *dfa = bounded_convert_nfa_to_dfa(nfa, budget);
+	MinimalDFA *reverse = dfa ? minimize(dfa) : NULL;
+	destroy_dfa(dfa);
+	destroy_nfa_and_states(nfa);
+	return reverse;
 }
 
 /* gen_minimal_dfa_graphviz()
@@ -660,7 +1032,8 @@ STOP:
 
 	@return         0 if success, -1 if fail
 
-	Generate a Graphviz DOT representation of a minimal DFA.
+	Generate a Graphviz DOT representation of a minimal DFA. A DFA that's
+	anchored at the end of the input says so in the graph's label.
 */
 int gen_minimal_dfa_graphviz(MinimalDFA *min_dfa, const char *file_name)
 {
@@ -673,6 +1046,10 @@ int gen_minimal_dfa_graphviz(MinimalDFA *min_dfa, const char *file_name)
 	fprintf(f, "\tnode [fontname=\"Helvetica,Arial,sans-serif\"]\n");
 	fprintf(f, "\tedge [fontname=\"Helvetica,Arial,sans-serif\"]\n");
 	fprintf(f, "\trankdir = LR\n");
+	if (min_dfa->anchored_end) {
+		fprintf(f, "\tlabel = \"only accepts at the end of the ");
+		fprintf(f, "input\"\n");
+	}
 	fprintf(f, "\n");
 
 	fprintf(f, "\tnode [shape=doublecircle]\n");
@@ -693,17 +1070,14 @@ int gen_minimal_dfa_graphviz(MinimalDFA *min_dfa, const char *file_name)
 	}
 	fprintf(f, "\n");
 
-	U64 lower, upper;
 	for (int i = 0; i < min_dfa->size; i++) {
 		for (int j = 0; j < min_dfa->size; j++) {
-			lower = min_dfa->delta[i][j][ASCII0_63];
-			upper = min_dfa->delta[i][j][ASCII64_127];
-			if (lower != 0 || upper != 0) {
+			if (!charset_is_empty(&min_dfa->delta[i][j])) {
 				fprintf(f, "\tq%d", i);
 				fprintf(f, " ->");
 				fprintf(f, " q%d", j);
 				fprintf(f, " [label=\"");
-				generate_transition_label(f, lower, upper);
+				generate_transition_label(f, &min_dfa->delta[i][j]);
 				fprintf(f, "\"]\n");
 			}
 		}
@@ -9,13 +9,13 @@ Module definition for the DFA minimizer.
 
 #include <stdbool.h>
 
+#include "budget.h"
+#include "charset.h"
 #include "common.h"
 #include "dfa.h"
+#include "nfa.h"
 #include "set.h"
 
-#define ASCII0_63   0
-#define ASCII64_127 1
-
 typedef struct MinimalDFAState {
 	int index;
 	bool is_accept;
@@ -51,7 +51,7 @@ typedef struct MinimalDFA {
 	// equivalence class
 	// see construct_minimal_states() for more
 
-	U64 ***delta;
+	CharSet **delta;
 	/*
 	Inverse transition table
 	Regular DFA maps a char to a destination state
@@ -59,9 +59,9 @@ typedef struct MinimalDFA {
 	can hold all the minimal DFA state transitions, whereas the regular DFA
 	states each need their own individual array of transitions
 
-	This table stores char bitfields that denote all the valid transitions
-	eg: delta[0][2][ASCII64_127] = 0x1
-		This indicates that d0 transitions to d2 on ASCII value 64
+	This table stores CharSets that denote all the valid transitions
+	eg: charset_has(&delta[0][2], 64) is true
+		This indicates that d0 transitions to d2 on char value 64
 	*/
 	int rows, cols;  // delta dimensions
 
@@ -81,6 +81,14 @@ typedef struct MinimalDFA {
 	                  // it functions as a (kinda) region-based memory
 	                  // manager
 	int size;  // determined after construct_minimal_states() is called
+
+	bool anchored_end;
+	/*
+	Only a match at the end of the input counts, ie the regex ended with $
+	for a DFA that searches forwards, and started with ^ for a reversed one.
+	The transitions can't say that, so it's carried along to the DOT file
+	and to init_search_dfa().
+	*/
 } MinimalDFA;
 
 int compare_minimal_dfastates(const void *m1, const void *m2);
@@ -93,12 +101,14 @@ void destroy_minimal_dfastate(MinimalDFAState *min_state);
 MinimalDFA *init_minimal_dfa(DFA *dfa);
 void destroy_minimal_dfa(MinimalDFA *min_dfa);
 
-bool distinguishable(int i, int j, MinimalDFA *min_dfa, DFA *dfa);
 int quotient(MinimalDFA *min_dfa, DFA *dfa);
 MinimalDFA *construct_minimal_states(MinimalDFA *min_dfa, DFA *dfa);
 MinimalDFA *construct_transition_table(MinimalDFA *min_dfa, DFA *dfa);
 MinimalDFA *minimize(DFA *dfa);
 
+NFA *reverse_minimal_dfa(MinimalDFA *min_dfa);
+MinimalDFA *minimize_reverse(MinimalDFA *min_dfa, Budget *budget);
+
 int gen_minimal_dfa_graphviz(MinimalDFA *min_dfa, const char *file_name);
 
 #endif
\ No newline at end of file
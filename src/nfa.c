@@ -9,13 +9,30 @@ expressions.
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "charset.h"
 #include "common.h"
 #include "lexer.h"
 #include "nfa.h"
 #include "set.h"
 
-// to recursively enumerate every NFA state
-static int state_index = 0;
+// initial capacity of an epsilon closure's work stack
+#define CLOSURE_STACK_SIZE 16
+
+// a state whose transitions are being walked, see nth_out()
+typedef struct NFAFrame {
+	NFAState *state;
+	int next;  // next transition to follow
+} NFAFrame;
+
+static inline void set_visited(U64 *bits, int i)
+{
+	bits[i / 64] |= (U64)1 << (i % 64);
+}
+
+static inline bool was_visited(U64 *bits, int i)
+{
+	return bits[i / 64] & ((U64)1 << (i % 64));
+}
 
 /* init_nfastate()
 	@return         ptr to dynamically allocated NFAState, NULL if fail
@@ -27,10 +44,9 @@ NFAState *init_nfastate(void)
 	NFAState *state = calloc(1, sizeof(NFAState));
 	if (!state)
 		return NULL;
+	state->ch = EPSILON;
 	// -1 is a sentinel
 	state->index = -1;
-	// not sure if calloc automatically fulfills this
-	state->seen = false;
 	return state;
 }
 
@@ -39,6 +55,8 @@ NFAState *init_nfastate(void)
 // the user could always call free(state), though
 inline void destroy_nfastate(NFAState *state)
 {
+	if (state)
+		free(state->outs);
 	free(state);
 }
 
@@ -119,30 +137,34 @@ void destroy_nfa_and_states(NFA *nfa)
 
 	Construct a basic Thompson NFA unit: one start state and one accept
 	state, with a single transition on @ch. Exception: if @ch is the
-	wildcard `.`, produce the appropriate NFA.
+	wildcard `.`, the transition is on every printable char, tab, and
+	newline.
 */
-NFA *init_thompson_nfa(U8 ch)
+NFA *init_thompson_nfa(U16 ch)
 {
-	if (ch == TK_WILDCARD) {
-		NFA *wildcard = init_range_nfa(' ', '~');
-		if (!wildcard)
-			return NULL;
-		NFA *tab = init_thompson_nfa('\t');
-		if (!tab)
-			return NULL;
-		NFA *newline = init_thompson_nfa('\n');
-		if (!newline)
-			return NULL;
+	CharSet chars = {{0}};
+	if (ch == TK_WILDCARD)
+		charset_wildcard(&chars);
+	else
+		charset_add(&chars, ch);
+	return init_class_nfa(&chars);
+}
 
-		NFA *result = nfa_union(tab, newline);
-		result = nfa_union(wildcard, result);
-		return result;
-	}
+/* init_class_nfa()
+	@chars          ptr to the chars which trigger the transition
+
+	@return         ptr to newly constructed NFA, or NULL if fail
 
+	Construct a Thompson NFA unit with a single transition on a set of
+	chars. The transition is labeled with the char itself if the set only
+	has one, otherwise CHAR_CLASS.
+*/
+NFA *init_class_nfa(const CharSet *chars)
+{
 	NFAState *start = init_nfastate();
 	NFAState *accept = init_nfastate();
 	NFA *nfa = init_nfa();
-	if (!(start || accept || nfa)) {
+	if (!start || !accept || !nfa) {
 		destroy_nfastate(start);
 		destroy_nfastate(accept);
 		destroy_nfa(nfa);
@@ -151,14 +173,13 @@ NFA *init_thompson_nfa(U8 ch)
 	set_insert(nfa->mem_region, start);
 	set_insert(nfa->mem_region, accept);
 
-	start->ch = ch;
+	int single = charset_single(chars);
+	start->ch = single == -1 ? CHAR_CLASS : single;
+	start->chars = *chars;
 	start->out1 = accept;
 	nfa->start = start;
 	nfa->accept = accept;
-	if (ch <= 63)
-		nfa->alphabet0_63 |= (1ULL << ch);
-	else
-		nfa->alphabet64_127 |= (1ULL << (ch-64));
+	nfa->alphabet = *chars;
 	nfa->size = 2;
 	return nfa;
 }
@@ -178,37 +199,63 @@ NFA *nfa_union(NFA *lhs, NFA *rhs)
 		return lhs;
 	if (!lhs)
 		return rhs;
+	NFA *nfas[2] = {lhs, rhs};
+	return nfa_union_all(nfas, 2);
+}
+
+/* nfa_union_all()
+	@nfas           array of ptrs to NFA structs
+	@size           number of NFAs, at least 1
+
+	@return         ptr to modified @nfas[0], NULL if fail
+
+	Perform the Thompson construction for the union of any number of NFAs.
+	Instead of nesting pairwise unions, one new start state fans out to
+	every NFA and one new accept state joins them, so every alternative is
+	just one epsilon transition away. The first two are out1 and out2 like
+	in a regular union, and the rest go in outs[]. Original @nfas[0] is
+	modified and the other NFAs are destroyed.
+*/
+NFA *nfa_union_all(NFA **nfas, int size)
+{
+	NFA *lhs = nfas[0];
+	if (size == 1)
+		return lhs;
 
 	NFAState *new_accept = init_nfastate();
 	NFAState *new_start = init_nfastate();
-	if (!(new_accept || new_start)) {
+	if (new_start && size > 2)
+		new_start->outs = malloc((size - 2) * sizeof(NFAState *));
+	if (!new_accept || !new_start || (size > 2 && !new_start->outs)) {
 		destroy_nfastate(new_accept);
 		destroy_nfastate(new_start);
 		return NULL;
 	}
 
 	new_start->out1 = lhs->start;
-	new_start->out2 = rhs->start;
-	lhs->accept->out1 = new_accept;
-	rhs->accept->out1 = new_accept;
+	new_start->out2 = nfas[1]->start;
+	for (int i = 2; i < size; i++)
+		new_start->outs[i-2] = nfas[i]->start;
+	new_start->num_outs = size - 2;
+	for (int i = 0; i < size; i++)
+		nfas[i]->accept->out1 = new_accept;
 	lhs->start = new_start;
 	lhs->accept = new_accept;
-
-	// rhs brings new symbols to the alphabet
-	lhs->alphabet0_63 |= rhs->alphabet0_63;
-	lhs->alphabet64_127 |= rhs->alphabet64_127;
-
 	lhs->size += 2;
-	lhs->size += rhs->size;
 
-	if (!set_union(lhs->mem_region, rhs->mem_region)) {
-		destroy_nfastate(new_accept);
-		destroy_nfastate(new_start);
-		return NULL;
+	for (int i = 1; i < size; i++) {
+		// the others bring new symbols to the alphabet
+		charset_union(&lhs->alphabet, &nfas[i]->alphabet);
+		lhs->size += nfas[i]->size;
+		if (!set_union(lhs->mem_region, nfas[i]->mem_region)) {
+			destroy_nfastate(new_accept);
+			destroy_nfastate(new_start);
+			return NULL;
+		}
+		destroy_nfa(nfas[i]);
 	}
 	set_insert(lhs->mem_region, new_accept);
 	set_insert(lhs->mem_region, new_start);
-	destroy_nfa(rhs);
 	return lhs;
 }
 
@@ -236,8 +283,7 @@ NFA *nfa_append(NFA *lhs, NFA *rhs)
 
 	lhs->size += rhs->size;
 
-	lhs->alphabet0_63 |= rhs->alphabet0_63;
-	lhs->alphabet64_127 |= rhs->alphabet64_127;
+	charset_union(&lhs->alphabet, &rhs->alphabet);
 
 	if (!set_union(lhs->mem_region, rhs->mem_region))
 		return NULL;
@@ -308,132 +354,250 @@ NFA *transform(NFA *nfa, U8 quantifier)
 	@return         ptr to NFA struct representing the entire range, NULL if
 	                fail
 
-	Recursively construct an NFA that represents a regular expression range.
-
-	TODO: The result NFA almost resembles a binary tree but it's not
-	perfect. Improve it later.
+	Construct an NFA that represents a regular expression range. It's only
+	2 states, no matter how wide the range is.
 */
 NFA *init_range_nfa(U8 left, U8 right)
 {
-	NFA *t1, *t2;
-	if (left == right) {
-		return init_thompson_nfa(left);
-	} else {
-		t1 = init_range_nfa(left, left+((right-left)/2));
-		t2 = init_range_nfa(left+((right-left)/2)+1, right);
-		return nfa_union(t1, t2);
-	}
+	CharSet chars = {{0}};
+	charset_add_range(&chars, left, right);
+	return init_class_nfa(&chars);
 }
 
-/* reset_states()
+/* nth_out()
+	@state          ptr to NFA state
+	@n              which transition
+
+	@return         destination of the @n-th transition of @state, NULL if
+	                it has no such transition
+
+	Transitions are numbered out1, out2, then outs[], which is the order
+	every traversal follows them in. Every @n from 0 to @state->num_outs + 1
+	is valid.
+*/
+static inline NFAState *nth_out(NFAState *state, int n)
+{
+	if (n == 0)
+		return state->out1;
+	if (n == 1)
+		return state->out2;
+	return state->outs[n - 2];
+}
+
+/* index_states()
 	@nfa            ptr to NFA struct
 
-	Tag all of the NFA's states to have index -1 and flag the state as
-	unseen.
+	@return         index of the last NFA state that was tagged, -1 if fail
+
+	Enumerate every state in an NFA in depth-first preorder, following
+	out1, out2, then outs[]. Unreachable states get index -1. The depth-
+	first search keeps its own stack, so a huge NFA, eg from a very long
+	literal, can't overflow the C stack.
 */
-static void reset_states(NFA *nfa)
+int index_states(NFA *nfa)
 {
-	state_index = 0;
-	for (Iterator *it = set_begin(nfa->mem_region); it; advance_iter(&it)) {
+	Iterator *it = set_begin(nfa->mem_region);
+	for (; it; advance_iter(&it))
 		((NFAState *)(it->element))->index = -1;
-		((NFAState *)(it->element))->seen = false;
+
+	// every state is pushed at most once
+	NFAFrame *stack = malloc(nfa->mem_region->size * sizeof(NFAFrame));
+	if (!stack)
+		return -1;
+	int top = 0;
+	int state_index = 0;
+	nfa->start->index = state_index;
+	stack[top++] = (NFAFrame){nfa->start, 0};
+
+	NFAFrame *frame;
+	NFAState *out;
+	while (top > 0) {
+		frame = &stack[top - 1];
+		if (frame->next == frame->state->num_outs + 2) {
+			top--;
+			continue;
+		}
+		out = nth_out(frame->state, frame->next++);
+		// only descend if the state has not already been tagged with a
+		// meaningful index
+		if (out && out->index == -1) {
+			out->index = ++state_index;
+			stack[top++] = (NFAFrame){out, 0};
+		}
 	}
+	free(stack);
+	return state_index;
 }
 
-/* index_helper()
-	@state          ptr to NFA state
+// check if a character needs to be escaped in a regex range
+static inline bool needs_escape(U8 ch)
+{
+	return ch == ']' || ch == '\\';
+}
+
+/* print_label_char()
+	@f              output file
+	@ch             transition char
+	@in_range       whether @ch is a bound of a range
 
-	Recursively enumerate all NFA states.
+	Print one char of a transition label. Chars that can't be printed are
+	written as hex escapes like \x7F.
 */
-static void index_helper(NFAState *state)
+static void print_label_char(FILE *f, U8 ch, bool in_range)
 {
-	if (state->out1) {
-		// only recurse if state has not already been tagged with a
-		// meaningful index
-		if (state->out1->index == -1) {
-			state_index++;
-			state->out1->index = state_index;
-			index_helper(state->out1);
-		}
+	switch (ch) {
+	case '\t':
+		fprintf(f, "\\\\t");
+		return;
+	case '\n':
+		fprintf(f, "\\\\n");
+		return;
+	case '"':
+		// double quote needs an escape because we are in a string, not
+		// because we are in a regex range
+		fprintf(f, "\\\"");
+		return;
 	}
-	if (state->out2) {
-		if (state->out2->index == -1) {
-			state_index++;
-			state->out2->index = state_index;
-			index_helper(state->out2);
-		}
+	if (ch < ' ' || ch > '~') {
+		fprintf(f, "\\\\x%02X", ch);
+		return;
 	}
-	return;
+	// double backslash because we are representing a string in a string
+	if (ch == '\\' || (in_range && needs_escape(ch)))
+		fprintf(f, "\\\\");
+	if (ch != '\\' || in_range)
+		fprintf(f, "%c", ch);
 }
 
-/* index_states()
-	@nfa            ptr to NFA struct
-
-	@return         index of the last NFA state that was tagged
+/* print_transition()
+	@f              output file
+	@state          ptr to NFA state
+	@n              which transition, see nth_out()
 
-	Enumerate every state in an NFA.
+	Print the Graphviz DOT representation of one transition.
 */
-int index_states(NFA *nfa)
+static void print_transition(FILE *f, NFAState *state, int n)
 {
-	reset_states(nfa);
-	nfa->start->index = state_index;
-	index_helper(nfa->start);
-	return state_index;
+	fprintf(f, "\tn%d", state->index);
+	fprintf(f, " ->");
+	fprintf(f, " n%d", nth_out(state, n)->index);
+	// out2 and outs[] are always epsilon transitions because any
+	// non-epsilon transition goes to out1 by default, and Thompson NFA
+	// states can't have two transitions that read input
+	switch (n == 0 ? state->ch : EPSILON) {
+	case EPSILON:
+		fprintf(f, " [label=\"&epsilon;\"]\n");
+		break;
+	case CHAR_CLASS:
+		fprintf(f, " [label=\"");
+		generate_transition_label(f, &state->chars);
+		fprintf(f, "\"]\n");
+		break;
+	default:
+		fprintf(f, " [label=\"");
+		print_label_char(f, state->ch, false);
+		fprintf(f, "\"]\n");
+		break;
+	}
 }
 
 /* graphviz_helper()
-	@state          ptr to NFA state
+	@nfa            ptr to indexed NFA struct
 	@f              output file
 
-	Recursively print the Graphviz DOT representation for every transition
-	in an NFA.
+	@return         0 if success, otherwise -1
+
+	Print the Graphviz DOT representation for every transition in an NFA,
+	in depth-first order. A bitset of visited state indices keeps every
+	state from being walked twice, and the search keeps its own stack.
 */
-static void graphviz_helper(NFAState *state, FILE *f)
+static int graphviz_helper(NFA *nfa, FILE *f)
 {
-	state->seen = true;
-	if (state->out1) {
-		fprintf(f, "\tn%d", state->index);
-		fprintf(f, " ->");
-		fprintf(f, " n%d", state->out1->index);
-		switch (state->ch) {
-		case EPSILON:
-			fprintf(f, " [label=\"&epsilon;\"]\n");
-			break;
-		case '"':
-			fprintf(f, " [label=\"\\\"\"]\n");
-			break;
-		case '\\':
-			// double backslash because we are representing a string
-			// in a string
-			fprintf(f, " [label=\"\\\\\"]\n");
-			break;
-		case '\t':
-			fprintf(f, " [label=\"\\\\t\"]\n");
-			break;
-		case '\n':
-			fprintf(f, " [label=\"\\\\n\"]\n");
-			break;
-		default:
-			fprintf(f, " [label=\"%c\"]\n", state->ch);
-			break;
+	int size = nfa->mem_region->size;
+	U64 *visited = calloc((size + 63) / 64, sizeof(U64));
+	NFAFrame *stack = malloc(size * sizeof(NFAFrame));
+	if (!visited || !stack) {
+		free(visited);
+		free(stack);
+		return -1;
+	}
+	int top = 0;
+	set_visited(visited, nfa->start->index);
+	stack[top++] = (NFAFrame){nfa->start, 0};
+
+	NFAFrame *frame;
+	NFAState *out;
+	while (top > 0) {
+		frame = &stack[top - 1];
+		if (frame->next == frame->state->num_outs + 2) {
+			top--;
+			continue;
+		}
+		out = nth_out(frame->state, frame->next);
+		if (!out) {
+			frame->next++;
+			continue;
+		}
+		print_transition(f, frame->state, frame->next++);
+		// we printed the transition, but only perform it if the out
+		// state hasn't been visited
+		if (!was_visited(visited, out->index)) {
+			set_visited(visited, out->index);
+			stack[top++] = (NFAFrame){out, 0};
 		}
-		// we printed transition, but only perform the transition if the
-		// out state hasn't been tagged as seen
-		if (!state->out1->seen)
-			graphviz_helper(state->out1, f);
 	}
-	if (state->out2) {
-		fprintf(f, "\tn%d", state->index);
-		fprintf(f, " ->");
-		fprintf(f, " n%d", state->out2->index);
-		// out2 is always an epsilon transition because any non-epsilon
-		// transition goes to out1 by default, and Thompson NFA states
-		// can't have transitions on two different symbols
-		fprintf(f, " [label=\"&epsilon;\"]\n");
-		if (!state->out2->seen)
-			graphviz_helper(state->out2, f);
+	free(visited);
+	free(stack);
+	return 0;
+}
+
+/* generate_transition_label()
+	@f              output file
+	@chars          ptr to the transition chars
+
+	Print a transition label to a Graphviz dot file. Contiguous chars are
+	printed as ranges, and the wildcard is printed as Sigma.
+*/
+void generate_transition_label(FILE *f, const CharSet *chars)
+{
+	if (charset_is_wildcard(chars)) {
+		fprintf(f, "&Sigma;");
+		return;
+	}
+
+	int left, right;
+	bool first_time = true;
+	// print transitions for one contiguous chunk of chars at a time
+	for (int ch = 0; ch < NUM_CHARS; ch++) {
+		if (!charset_has(chars, ch))
+			continue;
+		// found the next leftmost char
+		left = right = ch;
+		// check if there are contiguous chars, ie a range
+		// if so, find the rightmost char of the range
+		while (right + 1 < NUM_CHARS && charset_has(chars, right + 1))
+			right++;
+		ch = right;
+
+		if (!first_time)
+			fprintf(f, "\\n");
+		else
+			first_time = false;
+
+		if (left == right) {
+			// one char
+			print_label_char(f, left, false);
+		} else {
+			// range
+			fprintf(f, "[");
+			print_label_char(f, left, true);
+			if (right - left != 1)
+				fprintf(f, "-");
+			// if range is 2 adjacent chars, don't print a hyphen
+			print_label_char(f, right, true);
+			fprintf(f, "]");
+		}
 	}
-	return;
 }
 
 /* gen_nfa_graphviz()
@@ -446,7 +610,8 @@ static void graphviz_helper(NFAState *state, FILE *f)
 */
 int gen_nfa_graphviz(NFA *nfa, const char *file_name)
 {
-	index_states(nfa);
+	if (index_states(nfa) == -1)
+		return -1;
 	FILE *f = fopen(file_name, "w");
 	if (!f)
 		return -1;
@@ -461,11 +626,11 @@ int gen_nfa_graphviz(NFA *nfa, const char *file_name)
 	fprintf(f, " n%d;\n", nfa->accept->index);
 
 	fprintf(f, "\tnode [shape=circle];\n");
-	graphviz_helper(nfa->start, f);
+	int status = graphviz_helper(nfa, f);
 	fprintf(f, "}\n");
 
 	fclose(f);
-	return 0;
+	return status;
 }
 
 /* compare_nfastates()
@@ -485,39 +650,94 @@ int compare_nfastates(const void *n1, const void *n2)
 	return ((NFAState *)n1)->index - ((NFAState *)n2)->index;
 }
 
-/* epsilon_helper()
-	@state          ptr to NFAState struct
-	@set            ptr to set of NFAStates
-
-	@return         set of states in the epsilon closure of @state
+/* compare_nfastates_desc()
+	@n1             ptr to ptr to NFAState struct
+	@n2             ptr to another ptr to NFAState struct
 
-	Recursively find the epsilon closure of an NFA state.
+	@return         <0 if n1 has the higher index, >0 if n2 does, otherwise 0
 */
-static Set *epsilon_helper(NFAState *state, Set *set)
+static int compare_nfastates_desc(const void *n1, const void *n2)
 {
-	if (set_insert(set, state) == INSERT_DUPLICATE)
-		return set;
-	if (state->ch != EPSILON)
-		return set;
-	if (state->out1)
-		epsilon_helper(state->out1, set);
-	if (state->out2)
-		epsilon_helper(state->out2, set);
-	return set;
+	return (*(NFAState **)n2)->index - (*(NFAState **)n1)->index;
 }
 
-/* epsilon_helper()
-	@state          ptr to NFAState struct
+/* epsilon_closure()
+	@state          ptr to indexed NFAState struct
 
-	@return         set of states in the epsilon closure of @state
+	@return         set of states in the epsilon closure of @state, NULL if
+	                fail
 
 	Find the epsilon closure of an NFA state. The NFA state itself is also
-	included.
+	included. States wait on a work stack instead of the C stack, and a
+	bitset of state indices, grown as needed, marks the visited ones.
+	The states are inserted into the set from the highest index down, so
+	each insertion is at the head of the set.
 */
 Set *epsilon_closure(NFAState *state)
 {
 	Set *set = init_set(compare_nfastates);
-	if (!set)
-		return NULL;
-	return epsilon_helper(state, set);
+	int capacity = CLOSURE_STACK_SIZE;
+	int words = (state->index + CLOSURE_STACK_SIZE) / 64 + 1;
+	NFAState **closure = malloc(capacity * sizeof(NFAState *));
+	U64 *visited = calloc(words, sizeof(U64));
+	if (!set || !closure || !visited)
+		goto FAIL;
+	// closure[0] .. closure[top - 1] are still waiting to be walked, and
+	// closure[top] .. closure[size - 1] are done
+	int size = 1;
+	int top = 1;
+	closure[0] = state;
+	set_visited(visited, state->index);
+
+	NFAState *curr, *out;
+	void *bigger;
+	int more;
+	while (top > 0) {
+		curr = closure[--top];
+		if (curr->ch != EPSILON)
+			continue;
+		for (int n = 0; n < curr->num_outs + 2; n++) {
+			out = nth_out(curr, n);
+			if (!out)
+				continue;
+			if (out->index >= 64 * words) {
+				more = out->index / 64 + 1 + words;
+				bigger = realloc(visited, more * sizeof(U64));
+				if (!bigger)
+					goto FAIL;
+				visited = bigger;
+				for (; words < more; words++)
+					visited[words] = 0;
+			}
+			if (was_visited(visited, out->index))
+				continue;
+			set_visited(visited, out->index);
+			if (size == capacity) {
+				capacity *= 2;
+				bigger = realloc(closure,
+				                 capacity * sizeof(NFAState *));
+				if (!bigger)
+					goto FAIL;
+				closure = bigger;
+			}
+			// keep the waiting states together at the front
+			closure[size++] = closure[top];
+			closure[top++] = out;
+		}
+	}
+
+	qsort(closure, size, sizeof(NFAState *), compare_nfastates_desc);
+	for (int i = 0; i < size; i++) {
+		if (set_insert(set, closure[i]) == INSERT_ERROR)
+			goto FAIL;
+	}
+	free(closure);
+	free(visited);
+	return set;
+
+FAIL:
+	destroy_set(set);
+	free(closure);
+	free(visited);
+	return NULL;
 }
\ No newline at end of file
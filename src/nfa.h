@@ -8,26 +8,41 @@ Module definition for Thompson nondeterministic finite automata.
 #define NFA_H
 
 #include <stdbool.h>
+#include <stdio.h>
 
+#include "charset.h"
 #include "common.h"
 #include "set.h"
 
 // epsilon transition
-#define EPSILON 0x00
+#define EPSILON 0x100
+// transition on a set of chars
+#define CHAR_CLASS 0x101
 
 typedef struct NFAState {
 	struct NFAState *out1;
 	struct NFAState *out2;
-	U8 ch;
+	U16 ch;
+	CharSet chars;  // every char that triggers out1, empty if ch is EPSILON
+	/*
+	ch labels the transition: EPSILON, one byte, or CHAR_CLASS for a set
+	of chars like a range or the wildcard. Matching always tests the
+	bitfields, so a whole class is just one transition.
+	*/
+	struct NFAState **outs;  // more epsilon transitions, after out1 and out2
+	int num_outs;
+	/*
+	Only the fan-out state of an alternation of 3 or more NFAs has outs[],
+	so the whole alternation is one state wide instead of a chain of
+	nested unions.
+	*/
 	int index;  // should be DISREGARDED until index_states() is called!!!
-	bool seen;
 } NFAState;
 
 typedef struct NFA {
 	NFAState *start;
 	NFAState *accept;
-	U64 alphabet0_63;  // store alphabet as a bitfield
-	U64 alphabet64_127;
+	CharSet alphabet;
 	int size;
 	Set *mem_region;  // set of ptrs for every NFAState in the NFA
 	                  // this (kinda) region-based memory system simplifies
@@ -41,13 +56,21 @@ int compare_nfastate_ptr(const void *n1, const void *n2);
 NFA *init_nfa(void);
 void destroy_nfa(NFA *nfa);
 void destroy_nfa_and_states(NFA *nfa);
-NFA *init_thompson_nfa(U8 ch);
+NFA *init_thompson_nfa(U16 ch);
+NFA *init_class_nfa(const CharSet *chars);
 NFA *nfa_union(NFA *lhs, NFA *rhs);
+NFA *nfa_union_all(NFA **nfas, int size);
 NFA *nfa_append(NFA *lhs, NFA *rhs);
 NFA *transform(NFA *nfa, U8 quantifier);
 NFA *init_range_nfa(U8 left, U8 right);
 
+static inline bool nfastate_reads(NFAState *state, U8 ch)
+{
+	return charset_has(&state->chars, ch);
+}
+
 int index_states(NFA *nfa);
+void generate_transition_label(FILE *f, const CharSet *chars);
 int gen_nfa_graphviz(NFA *nfa, const char *file_name);
 int compare_nfastates(const void *n1, const void *n2);
 Set *epsilon_closure(NFAState *state);
@@ -1,22 +1,58 @@
 /** parser.c
 
-Parse regular expressions and build a Thompson NFA representation.
+Parse regular expressions and build a syntax tree. The tree is then lowered to
+a Thompson NFA representation.
 
 My definitions that probably aren't standard
-	Pattern: a sequence of literal/escaped ASCII characters, plus
+	Pattern: a sequence of literal/escaped characters, plus
 	         possible quantifiers
+	Range: a bracketed class of chars, where multibyte UTF-8 chars are
+	       decoded, so [α-ω] matches the bytes of any Greek lowercase letter
+	Quantifier: * ? + or a count like {m}, {m,}, {m,n}
 	Group: a parenthetical regular expression, a sequence of 1 or more
 	       patterns, or a sequence of 1 or more ranges
 
 */
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "ast.h"
+#include "charset.h"
 #include "common.h"
 #include "control.h"
 #include "lexer.h"
 #include "nfa.h"
 #include "parser.h"
+#include "utf8.h"
+
+// what regex() does next
+#define ENTER_REGEX     0
+#define ENTER_GROUP     1
+#define ENTER_GPRIME    2
+#define RETURN          3  // hand result to the frame on top of the stack
+
+// where a production resumes once the one it called returns
+#define RESUME_REGEX_GROUP   0  // regex, after its group
+#define RESUME_REGEX_GPRIME  1  // regex, after its gprime
+#define RESUME_GROUP_REGEX   2  // group, after the regex between parentheses
+#define RESUME_GPRIME_GROUP  3  // gprime, after the group it tried first
+#define RESUME_GPRIME_PIPE   4  // gprime, after the group following '|'
+
+#define PARSE_STACK_SIZE 64
+
+typedef struct ParseFrame {
+	int resume;
+	ASTNode *local;  // what the production built before its call
+} ParseFrame;
+
+typedef struct ParseStack {
+	ParseFrame *frames;
+	int size;
+	int capacity;
+} ParseStack;
 
 /* parse()
 	@cc             ptr to CmpCtrl struct
@@ -28,97 +64,511 @@ My definitions that probably aren't standard
 */
 NFA *parse(CmpCtrl *cc)
 {
-	cc->flags = 0;
-	NFA *god;
+	AST *ast = parse_ast(cc);
+	if (!ast)
+		return NULL;
+	NFA *nfa = thompson(ast->root);
+	destroy_ast(ast);
+	if (!nfa) {
+		cc->flags |= CC_DISABLE_LINE_PRINT;
+		print_error(cc, "!!!FATAL MEMORY ERROR!!!");
+	}
+	return nfa;
+}
+
+/* parse_ast()
+	@cc             ptr to CmpCtrl struct
+
+	@return         syntax tree of a regex, NULL if fail
+
+	Parse a regular expression and build its syntax tree. The productions
+	allocate nodes from cc->ast, which is reset to NULL afterwards.
+
+	A leading (?i), or cc->ignore_case, makes the regex case-insensitive.
+	Letters then become classes like [Hh], so they cost no more states
+	than the letter alone, and both cases land in the same byte class.
+
+	Like in POSIX basic regexes, ^ is only an anchor as the first char of
+	the regex, after any (?i), and $ only as the last one. Anywhere else
+	they're literals, and \^ or \$ are literals everywhere. The anchors
+	are recorded in the tree. They only matter when searching, since
+	otherwise the whole input has to match anyway, see ast_unanchor().
+*/
+AST *parse_ast(CmpCtrl *cc)
+{
+	cc->flags = cc->ignore_case ? CC_IGNORE_CASE : 0;
+	AST *ast = cc->ast = init_ast();
+	if (!ast)
+		return NULL;
+	if (cc->buffer_len - cc->pos >= 4 &&
+	    memcmp(cc->buffer + cc->pos, "(?i)", 4) == 0) {
+		cc->flags |= CC_IGNORE_CASE;
+		cc->pos += 4;
+	}
+	if (cc->pos < cc->buffer_len && cc->buffer[cc->pos] == '^') {
+		cc->flags |= CC_ANCHOR_START;
+		cc->pos++;
+	}
+	// if this fails, lex() just scans the buffer as it goes
+	prelex(cc);
 	lex(cc);
-	if ((god = regex(cc))) {
+	if ((ast->root = regex(cc))) {
 		if (!(cc->flags & CC_ABORT)) {
-			if (cc->token == TK_EOF)
-				return god;
-			else
+			if (cc->token == TK_EOF) {
+				ast->anchored_start = cc->flags & CC_ANCHOR_START;
+				ast->anchored_end = cc->flags & CC_ANCHOR_END;
+				cc->ast = NULL;
+				return ast;
+			} else {
 				print_error(cc, "expected end of regex");
+			}
 		}
 	}
-	destroy_nfa_and_states(god);
+	cc->ast = NULL;
+	destroy_ast(ast);
 	return NULL;
 }
 
-NFA *regex(CmpCtrl *cc)
+// the start and accept states of a lowered subtree, see thompson()
+typedef struct Fragment {
+	NFAState *start;
+	NFAState *accept;
+} Fragment;
+
+/* compare_states_desc()
+	@n1             ptr to ptr to an NFAState struct
+	@n2             ptr to ptr to another NFAState struct
+
+	@return         the opposite of compare_nfastate_ptr()
+*/
+static int compare_states_desc(const void *n1, const void *n2)
 {
-	NFA *local;
-	if ((local = group(cc))) {
-		// gprime() modifies `local`'s members, so no need to assign
-		// the return val to anything
-		if (gprime(cc, local))
-			return local;
-		else if (cc->flags & CC_ABORT)  // did gprime set ABORT flag?
-			return NULL;
-		else if (cc->token == TK_RPAREN)
-			return local;
-		else
-			print_error(cc, "expected '|', ')', or pattern");
+	return compare_nfastate_ptr(*(NFAState **)n2, *(NFAState **)n1);
+}
+
+/* new_state()
+	@states         array of every state made so far
+	@size           ptr to number of states in @states
+
+	@return         ptr to a new epsilon state, NULL if fail
+*/
+static NFAState *new_state(NFAState **states, int *size)
+{
+	NFAState *state = init_nfastate();
+	if (state)
+		states[(*size)++] = state;
+	return state;
+}
+
+/* lower_node()
+	@node           ptr to syntax tree node
+	@frags          fragments of the operands of @node, which get replaced
+	                by the fragment of @node
+	@num_frags      number of operands
+	@states         array of every state made so far
+	@size           ptr to number of states in @states
+
+	@return         true if success, otherwise false
+
+	Link the operands of a node the same way as init_class_nfa(),
+	nfa_append(), transform(), and nfa_union_all(). The operands of an
+	AST_ALT are its whole chain of alternatives, so they share one fan-out
+	state.
+*/
+static bool lower_node(ASTNode *node, Fragment *frags, int num_frags,
+                       NFAState **states, int *size)
+{
+	NFAState *start, *accept;
+	int single;
+	switch (node->kind) {
+	case AST_LITERAL:
+	case AST_CLASS:
+		start = new_state(states, size);
+		accept = new_state(states, size);
+		if (!start || !accept)
+			return false;
+		single = charset_single(&node->chars);
+		start->ch = single == -1 ? CHAR_CLASS : single;
+		start->chars = node->chars;
+		start->out1 = accept;
+		break;
+	case AST_CONCAT:
+		frags[0].accept->out1 = frags[1].start;
+		frags[0].accept = frags[1].accept;
+		return true;
+	case AST_REPEAT:
+		start = new_state(states, size);
+		accept = new_state(states, size);
+		if (!start || !accept)
+			return false;
+		// *, ?, and +, the only repeats left to lower
+		if (node->max == AST_UNBOUNDED)
+			frags[0].accept->out2 = frags[0].start;
+		frags[0].accept->out1 = accept;
+		start->out1 = frags[0].start;
+		if (node->max != AST_UNBOUNDED || node->min == 0)
+			start->out2 = accept;
+		break;
+	default:
+		start = new_state(states, size);
+		accept = new_state(states, size);
+		if (!start || !accept)
+			return false;
+		if (num_frags > 2) {
+			start->outs = malloc((num_frags - 2) *
+			                     sizeof(NFAState *));
+			if (!start->outs)
+				return false;
+		}
+		start->out1 = frags[0].start;
+		start->out2 = frags[1].start;
+		for (int i = 2; i < num_frags; i++)
+			start->outs[i-2] = frags[i].start;
+		start->num_outs = num_frags - 2;
+		for (int i = 0; i < num_frags; i++)
+			frags[i].accept->out1 = accept;
 	}
-	return NULL;
+	frags[0].start = start;
+	frags[0].accept = accept;
+	return true;
 }
 
-NFA *group(CmpCtrl *cc)
+/* thompson()
+	@root           ptr to root of a syntax tree
+
+	@return         ptr to Thompson NFA equivalent to the tree, NULL if fail
+
+	Lower a syntax tree to a Thompson NFA. The tree is unmodified.
+
+	Each node on the work stack is visited twice: first to push its
+	operands above it, then to link their fragments once they're all
+	lowered, see lower_node(). Every state is also kept in an array, and
+	only goes in the NFA's memory region at the end. Merging the regions
+	of 2 subtrees costs as much as both of them, so merging them node by
+	node like nfa_append() would be quadratic on a long regex.
+*/
+NFA *thompson(ASTNode *root)
 {
-	NFA *g;
-	if (cc->token == TK_LPAREN) {
-		lex(cc);
-		if (!(g = regex(cc))) {
-			cc->flags |= CC_DISABLE_INSTEAD_FOUND;
-			print_error(cc, "malformed regex");
-			return NULL;
+	int num_nodes = count_nodes(root);
+	if (num_nodes < 0)
+		return NULL;
+	// work[i] waits on the fragments from frags[base[i]] onward, base[i]
+	// is -1 until its operands are pushed
+	ASTNode **work = malloc(num_nodes * sizeof(ASTNode *));
+	int *base = malloc(num_nodes * sizeof(int));
+	Fragment *frags = malloc(num_nodes * sizeof(Fragment));
+	// every node makes at most 2 states
+	NFAState **states = malloc(2 * num_nodes * sizeof(NFAState *));
+	NodeList operands = {NULL, 0, 0};
+	NFA *nfa = NULL;
+	CharSet alphabet = {{0}};
+	bool ok = work && base && frags && states;
+	int top = 0;
+	int num_frags = 0;
+	int num_states = 0;
+	if (ok) {
+		work[top] = root;
+		base[top++] = -1;
+	}
+
+	ASTNode *node;
+	int first;
+	while (ok && top > 0) {
+		node = work[top-1];
+		if (base[top-1] == -1) {
+			base[top-1] = num_frags;
+			operands.size = 0;
+			if (node->kind == AST_ALT)
+				ok = ast_flatten(node, AST_ALT, &operands);
+			else if (node->left)
+				ok = push_node(&operands, node->left) &&
+				     (!node->right ||
+				      push_node(&operands, node->right));
+			// the leftmost operand is lowered first
+			for (int i = operands.size - 1; ok && i >= 0; i--) {
+				work[top] = operands.nodes[i];
+				base[top++] = -1;
+			}
+			continue;
 		}
-		if (cc->token != TK_RPAREN) {
-			print_error(cc, "expected ')'");
-			destroy_nfa_and_states(g);
-			cc->flags |= CC_DISABLE_ERROR_MSG;
-			return NULL;
+
+		first = base[--top];
+		if (node->kind == AST_LITERAL || node->kind == AST_CLASS) {
+			charset_union(&alphabet, &node->chars);
+			num_frags++;
+		}
+		ok = lower_node(node, frags + first, num_frags - first, states,
+		                &num_states);
+		num_frags = first + 1;
+	}
+
+	if (ok)
+		nfa = init_nfa();
+	if (nfa) {
+		// inserting from the largest address down only ever prepends
+		// to the sorted region
+		qsort(states, num_states, sizeof(NFAState *),
+		      compare_states_desc);
+		for (int i = 0; i < num_states && nfa; i++) {
+			if (set_insert(nfa->mem_region, states[i]) ==
+			    INSERT_ERROR) {
+				destroy_nfa(nfa);
+				nfa = NULL;
+			}
+		}
+	}
+	if (nfa) {
+		nfa->start = frags[0].start;
+		nfa->accept = frags[0].accept;
+		nfa->alphabet = alphabet;
+		nfa->size = num_states;
+	} else {
+		for (int i = 0; states && i < num_states; i++)
+			destroy_nfastate(states[i]);
+	}
+	free(work);
+	free(base);
+	free(frags);
+	free(states);
+	free(operands.nodes);
+	return nfa;
+}
+
+/* push_frame()
+	@stack          ptr to ParseStack struct
+	@resume         where the caller resumes, one of the RESUME_ macros
+	@local          syntax tree the caller has built so far, if any
+
+	@return         true if success, otherwise false
+*/
+static bool push_frame(ParseStack *stack, int resume, ASTNode *local)
+{
+	if (stack->size == stack->capacity) {
+		int capacity = stack->capacity ? 2 * stack->capacity
+		                               : PARSE_STACK_SIZE;
+		ParseFrame *frames = realloc(stack->frames,
+		                             capacity * sizeof(ParseFrame));
+		if (!frames)
+			return false;
+		stack->frames = frames;
+		stack->capacity = capacity;
+	}
+	stack->frames[stack->size].resume = resume;
+	stack->frames[stack->size].local = local;
+	stack->size++;
+	return true;
+}
+
+/* regex()
+	@cc             ptr to CmpCtrl struct
+
+	@return         syntax tree of a regex, NULL if fail
+
+	Parse the productions
+
+		regex  -> group gprime
+		group  -> ( regex ) quantifier | pattern gprime | range quantifier
+		gprime -> group gprime | '|' group gprime | (empty)
+
+	where the empty gprime has to be followed by the end of the regex or
+	')'. They're mutually recursive, so a huge regex, eg tens of thousands
+	of alternatives, would overflow the C stack. Instead, each call that
+	isn't a tail call pushes a frame recording where the caller resumes,
+	and the frames live on the heap. The trees, error messages, and flags
+	are exactly what the recursive descent would produce.
+*/
+ASTNode *regex(CmpCtrl *cc)
+{
+	ParseStack stack = {NULL, 0, 0};
+	int state = ENTER_REGEX;
+	ASTNode *local = NULL;   // the argument of gprime
+	ASTNode *result = NULL;  // the return value of the last production
+	ParseFrame frame;
+	for (;;) {
+		switch (state) {
+		case ENTER_REGEX:
+			if (!push_frame(&stack, RESUME_REGEX_GROUP, NULL))
+				goto FAIL;
+			state = ENTER_GROUP;
+			break;
+		case ENTER_GROUP:
+			if (cc->token == TK_LPAREN) {
+				lex(cc);
+				if (!push_frame(&stack, RESUME_GROUP_REGEX, NULL))
+					goto FAIL;
+				state = ENTER_REGEX;
+			} else if ((local = pattern(cc))) {
+				state = ENTER_GPRIME;
+			} else {
+				if ((result = range(cc)))
+					result = quantifier(cc, result);
+				state = RETURN;
+			}
+			break;
+		case ENTER_GPRIME:
+			if (!push_frame(&stack, RESUME_GPRIME_GROUP, local))
+				goto FAIL;
+			state = ENTER_GROUP;
+			break;
+		case RETURN:
+			if (stack.size == 0) {
+				free(stack.frames);
+				return result;
+			}
+			frame = stack.frames[--stack.size];
+			switch (frame.resume) {
+			case RESUME_REGEX_GROUP:
+				if (!result)
+					break;
+				if (!push_frame(&stack, RESUME_REGEX_GPRIME, NULL))
+					goto FAIL;
+				local = result;
+				state = ENTER_GPRIME;
+				break;
+			case RESUME_REGEX_GPRIME:
+				// did gprime set ABORT flag?
+				if (!result && !(cc->flags & CC_ABORT))
+					print_error(cc, "expected '|', ')', or pattern");
+				break;
+			case RESUME_GROUP_REGEX:
+				if (!result) {
+					cc->flags |= CC_DISABLE_INSTEAD_FOUND;
+					print_error(cc, "malformed regex");
+				} else if (cc->token != TK_RPAREN) {
+					print_error(cc, "expected ')'");
+					cc->flags |= CC_DISABLE_ERROR_MSG;
+					result = NULL;
+				} else {
+					lex(cc);
+					result = quantifier(cc, result);
+				}
+				break;
+			case RESUME_GPRIME_GROUP:
+				if (result) {
+					local = ast_concat(cc->ast, frame.local,
+					                   result);
+					state = local ? ENTER_GPRIME : RETURN;
+					result = NULL;
+				} else if (cc->token == TK_PIPE) {
+					lex(cc);
+					if (!push_frame(&stack, RESUME_GPRIME_PIPE,
+					                frame.local))
+						goto FAIL;
+					state = ENTER_GROUP;
+				} else if (cc->token == TK_EOF ||
+				           cc->token == TK_RPAREN) {
+					result = frame.local;
+				}
+				break;
+			case RESUME_GPRIME_PIPE:
+				if (result) {
+					local = ast_alt(cc->ast, frame.local, result);
+					state = local ? ENTER_GPRIME : RETURN;
+					result = NULL;
+					break;
+				}
+				print_error(cc, "expected '(', '[', or pattern");
+				cc->flags |= CC_DISABLE_ERROR_MSG;
+				// regexes like (a|) will fail gprime
+				// but then we propagate back to regex, which would
+				// match RPAREN
+				// that's incorrect, so gprime sets an abort flag
+				// when PIPE fails to be parsed
+				cc->flags |= CC_ABORT;
+				break;
+			}
+			break;
 		}
-		lex(cc);
-		return g = quantifier(cc, g);
-	} else if ((g = pattern(cc))) {
-		return gprime(cc, g);
-	} else if ((g = range(cc))) {
-		return g = quantifier(cc, g);
 	}
+
+FAIL:
+	free(stack.frames);
+	cc->flags |= CC_DISABLE_LINE_PRINT;
+	print_error(cc, "!!!FATAL MEMORY ERROR!!!");
+	cc->flags |= CC_DISABLE_ERROR_MSG | CC_ABORT;
 	return NULL;
 }
 
-NFA *gprime(CmpCtrl *cc, NFA *local)
+/* repeat_count()
+	@cc             ptr to CmpCtrl struct
+	@limit          largest count allowed
+
+	@return         number written by the next digit tokens, capped at
+	                @limit + 1 so it can't overflow
+*/
+static int repeat_count(CmpCtrl *cc, int limit)
 {
-	NFA *g;
-	if ((g = group(cc))) {
-		local = nfa_append(local, g);
-		return gprime(cc, local);
-	} else if (cc->token == TK_PIPE) {
+	int count = 0;
+	while ('0' <= cc->token && cc->token <= '9') {
+		count = 10 * count + cc->token - '0';
+		if (count > limit)
+			count = limit + 1;
 		lex(cc);
-		if ((g = group(cc))) {
-			local = nfa_union(local, g);
-			return gprime(cc, local);
-		} else {
-			print_error(cc, "expected '(', '[', or pattern");
-			destroy_nfa_and_states(g);
-			destroy_nfa_and_states(local);
-			cc->flags |= CC_DISABLE_ERROR_MSG;
-			// regexes like (a|) will fail gprime()
-			// but then we propagate back to regex(), which would
-			// match RPAREN
-			// that's incorrect, so gprime() sets an abort flag
-			// when PIPE fails to be parsed
-			cc->flags |= CC_ABORT;
-			return NULL;
-		}
-	} else if (cc->token == TK_EOF || cc->token == TK_RPAREN) {
-		return local;
 	}
+	return count;
+}
+
+/* counted_repeat()
+	@cc             ptr to CmpCtrl struct
+	@node           ptr to syntax tree that's repeated
+
+	@return         ptr to the expanded syntax tree, NULL if fail
+
+	Read the rest of a {m}, {m,}, or {m,n} quantifier, which lex() only
+	starts with TK_LBRACE if it's well formed. The counts are capped by
+	cc->max_repeat, since every repetition is a copy of @node, see
+	ast_bounded_repeat(). With cc->keep_counts, a repeated char isn't
+	copied at all, so it's only capped by MAX_COUNT.
+*/
+static ASTNode *counted_repeat(CmpCtrl *cc, ASTNode *node)
+{
+	bool keep = cc->keep_counts && (node->kind == AST_LITERAL ||
+	                                node->kind == AST_CLASS);
+	int limit = keep ? MAX_COUNT : cc->max_repeat;
+	lex(cc);
+	int min = repeat_count(cc, limit);
+	int max = min;
+	if (cc->token == ',') {
+		lex(cc);
+		max = cc->token == '}' ? AST_UNBOUNDED
+		                       : repeat_count(cc, limit);
+	}
+	cc->flags |= CC_DISABLE_INSTEAD_FOUND;
+	if (min > limit || max > limit) {
+		print_error(cc, "repeat count is too large");
+		goto FAIL;
+	}
+	if (max == 0) {
+		print_error(cc, "repeat count must be at least 1");
+		goto FAIL;
+	}
+	if (max != AST_UNBOUNDED && max < min) {
+		print_error(cc, "repeat's upper bound is less than lower bound");
+		goto FAIL;
+	}
+	cc->flags &= ~CC_DISABLE_INSTEAD_FOUND;
+	lex(cc);
+	if (keep && (min > 1 || (max != 1 && max != AST_UNBOUNDED)))
+		node = ast_repeat(cc->ast, node, min, max);
+	else
+		node = ast_bounded_repeat(cc->ast, node, min, max);
+	if (!node) {
+		cc->flags |= CC_DISABLE_LINE_PRINT;
+		print_error(cc, "!!!FATAL MEMORY ERROR!!!");
+		goto FAIL;
+	}
+	return node;
+
+FAIL:
+	cc->flags |= CC_DISABLE_ERROR_MSG | CC_ABORT;
 	return NULL;
 }
 
-NFA *quantifier(CmpCtrl *cc, NFA *nfa)
+ASTNode *quantifier(CmpCtrl *cc, ASTNode *node)
 {
+	if (cc->token == TK_LBRACE)
+		return counted_repeat(cc, node);
+
 	U8 q;
 	switch (cc->token) {
 	case TK_STAR:     q = '*'; break;
@@ -128,24 +578,47 @@ NFA *quantifier(CmpCtrl *cc, NFA *nfa)
 	}
 
 	if (q) {
-		nfa = transform(nfa, q);
+		node = ast_quantify(cc->ast, node, q);
 		lex(cc);
-		return nfa;
+		return node;
 	} else if (cc->token <= TK_PIPE) {
-		// ASCII, `.`, EOF, (, ), [, |
-		return nfa;
+		// byte, `.`, EOF, (, ), [, |
+		return node;
 	}
 	print_error(cc, "expected '(', ')', '[', '|', or pattern");
 	return NULL;
 }
 
-NFA *pattern(CmpCtrl *cc)
+/* literal()
+	@cc             ptr to CmpCtrl struct
+	@ch             char to match
+
+	@return         ptr to new leaf, NULL if fail
+
+	Allocate a leaf for a char outside of a range. If the regex ignores
+	case, a letter matches both of its cases.
+*/
+static ASTNode *literal(CmpCtrl *cc, U8 ch)
+{
+	CharSet chars = {{0}};
+	charset_add(&chars, ch);
+	if (cc->flags & CC_IGNORE_CASE)
+		charset_fold_case(&chars);
+	if (charset_single(&chars) != -1)
+		return ast_literal(cc->ast, ch);
+	return ast_class(cc->ast, &chars);
+}
+
+ASTNode *pattern(CmpCtrl *cc)
 {
-	NFA *final_nfa = NULL;
-	NFA *thompson;
+	ASTNode *final_ast = NULL;
+	ASTNode *leaf;
 	while (cc->token <= TK_WILDCARD) {
-		thompson = init_thompson_nfa(cc->token);
-		if (!thompson) {
+		if (cc->token == TK_WILDCARD)
+			leaf = ast_wildcard(cc->ast);
+		else
+			leaf = literal(cc, cc->token);
+		if (!leaf) {
 			cc->flags |= CC_DISABLE_LINE_PRINT;
 			print_error(cc, "!!!FATAL MEMORY ERROR!!!");
 			// all subsequent errors will be meaningless
@@ -153,20 +626,16 @@ NFA *pattern(CmpCtrl *cc)
 			return NULL;
 		}
 		lex(cc);
-		if (!quantifier(cc, thompson)) {
-			destroy_nfa_and_states(final_nfa);
-			destroy_nfa_and_states(thompson);
+		if (!(leaf = quantifier(cc, leaf)))
 			return NULL;
-		}
-		final_nfa = nfa_append(final_nfa, thompson);
+		final_ast = ast_concat(cc->ast, final_ast, leaf);
 	}
 
 	if (TK_EOF <= cc->token && cc->token <= TK_PIPE) {
 		// EOF, (, ), [, |
-		return final_nfa;
+		return final_ast;
 	} else {
 		print_error(cc, "expected pattern, '(', '[', or end of regex");
-		destroy_nfa_and_states(final_nfa);
 		// try to minimize redundant messages when we propagate up the
 		// call stack
 		cc->flags |= CC_DISABLE_ERROR_MSG;
@@ -174,9 +643,9 @@ NFA *pattern(CmpCtrl *cc)
 	}
 }
 
-NFA *range(CmpCtrl *cc)
+ASTNode *range(CmpCtrl *cc)
 {
-	NFA *r;
+	ASTNode *r;
 	if (cc->token == TK_LBRACKET) {
 		lex(cc);
 		if (!(r = allowed(cc)))
@@ -186,46 +655,158 @@ NFA *range(CmpCtrl *cc)
 			return r;
 		}
 		print_error(cc, "expected ']'");
-		destroy_nfa_and_states(r);
 	}
 	return NULL;
 }
 
+/* class_char()
+	@cc             ptr to CmpCtrl struct
+	@ch             receives the char
+	@is_utf8        receives true if @ch is a codepoint decoded from
+	                several bytes
+
+	@return         true if success, false if the char is malformed UTF-8
+
+	Read one char of a range, and the token after it. A lead byte followed
+	by continuation bytes is decoded as one UTF-8 char, eg [α-ω] is the
+	Greek lowercase letters. Any other byte, including a lead byte that
+	isn't followed by a continuation byte, matches itself.
+*/
+static bool class_char(CmpCtrl *cc, U32 *ch, bool *is_utf8)
+{
+	U8 lead = cc->token;
+	int len = utf8_length(lead);
+	*ch = lead;
+	*is_utf8 = false;
+	lex(cc);
+	if (len < 2 || !utf8_is_continuation(cc->token))
+		return true;
+
+	// drop the 110, 1110, or 11110 length prefix
+	U32 cp = lead & (0x7F >> len);
+	for (int i = 1; i < len; i++) {
+		if (!utf8_is_continuation(cc->token)) {
+			print_error(cc, "incomplete UTF-8 char");
+			return false;
+		}
+		cp = (cp << 6) | (cc->token & 0x3F);
+		lex(cc);
+	}
+	if (!utf8_is_valid(cp, len)) {
+		cc->flags |= CC_DISABLE_INSTEAD_FOUND;
+		print_error(cc, "invalid UTF-8 char");
+		return false;
+	}
+	*ch = cp;
+	*is_utf8 = true;
+	return true;
+}
+
+/* add_codepoints()
+	@ranges         ptr to dynamic array of codepoint ranges
+	@size           ptr to number of ranges
+	@capacity       ptr to capacity of the array
+	@lo             smallest codepoint of the new range
+	@hi             largest codepoint of the new range
+
+	@return         true if success, otherwise false
+*/
+static bool add_codepoints(CodepointRange **ranges, int *size, int *capacity,
+                           U32 lo, U32 hi)
+{
+	if (*size == *capacity) {
+		int new_capacity = *capacity ? 2 * *capacity : 4;
+		CodepointRange *grown = realloc(*ranges, new_capacity *
+		                                sizeof(CodepointRange));
+		if (!grown)
+			return false;
+		*ranges = grown;
+		*capacity = new_capacity;
+	}
+	(*ranges)[*size].lo = lo;
+	(*ranges)[*size].hi = hi;
+	(*size)++;
+	return true;
+}
+
 // if you want to match - then put it right after the opening bracket
 //   eg [-a] matches '-' or 'a'
-NFA *allowed(CmpCtrl *cc)
+ASTNode *allowed(CmpCtrl *cc)
 {
-	NFA *result = NULL;
-	NFA *segment;
-	U8 left, right;
-	if (cc->token > '~') {
-		print_error(cc, "expected ASCII or escape char");
+	CharSet chars = {{0}};
+	// codepoints past ASCII, see utf8_class()
+	CodepointRange *codepoints = NULL;
+	int num_codepoints = 0;
+	int capacity = 0;
+	U32 left, right;
+	bool left_utf8, right_utf8;
+	ASTNode *node = NULL;
+	ASTNode *utf8;
+	if (cc->token >= NUM_CHARS) {
+		print_error(cc, "expected char or escape char");
 		cc->flags |= CC_ABORT;
 		return NULL;
 	}
-	while (cc->token <= '~') {
-		left = cc->token;
-		lex(cc);
+	while (cc->token < NUM_CHARS) {
+		if (!class_char(cc, &left, &left_utf8))
+			goto CLEANUP;
+		right = left;
+		right_utf8 = left_utf8;
 		if (cc->token == '-') {
 			lex(cc);
-			if (cc->token > '~') {
-				print_error(cc, "expected ASCII or escape char");
-				destroy_nfa_and_states(result);
-				return NULL;
+			if (cc->token >= NUM_CHARS) {
+				print_error(cc, "expected char or escape char");
+				goto CLEANUP;
 			}
-			if (cc->token < left) {
+			if (!class_char(cc, &right, &right_utf8))
+				goto CLEANUP;
+			if ((left_utf8 && !right_utf8 && right >= 0x80) ||
+			    (right_utf8 && !left_utf8 && left >= 0x80)) {
+				cc->flags |= CC_DISABLE_INSTEAD_FOUND;
+				print_error(cc, "range mixes a byte and a UTF-8 char");
+				goto CLEANUP;
+			}
+			if (right < left) {
 				cc->flags |= CC_DISABLE_INSTEAD_FOUND;
 				print_error(cc, "range's upper bound is less than lower bound");
-				destroy_nfa_and_states(result);
-				return NULL;
+				goto CLEANUP;
 			}
-			right = cc->token;
-			lex(cc);
-			segment = init_range_nfa(left, right);
-		} else {
-			segment = init_thompson_nfa(left);
 		}
-		result = nfa_union(result, segment);
+		if (!left_utf8 && !right_utf8) {
+			charset_add_range(&chars, left, right);
+			continue;
+		}
+		// a range like [a-é] is partly ASCII
+		if (left < 0x80) {
+			charset_add_range(&chars, left, 0x7F);
+			left = 0x80;
+		}
+		if (!add_codepoints(&codepoints, &num_codepoints, &capacity,
+		                    left, right))
+			goto MEMORY_FAIL;
 	}
-	return result;
+
+	if (cc->flags & CC_IGNORE_CASE)
+		charset_fold_case(&chars);
+	if (!num_codepoints) {
+		node = ast_class(cc->ast, &chars);
+		goto CLEANUP;
+	}
+	utf8 = utf8_class(cc->ast, codepoints, num_codepoints);
+	if (!utf8)
+		goto MEMORY_FAIL;
+	if (!charset_is_empty(&chars)) {
+		if (!(node = ast_class(cc->ast, &chars)))
+			goto CLEANUP;
+	}
+	node = ast_alt(cc->ast, node, utf8);
+	goto CLEANUP;
+
+MEMORY_FAIL:
+	cc->flags |= CC_DISABLE_LINE_PRINT;
+	print_error(cc, "!!!FATAL MEMORY ERROR!!!");
+	cc->flags |= CC_DISABLE_ERROR_MSG;
+CLEANUP:
+	free(codepoints);
+	return node;
 }
\ No newline at end of file
@@ -7,16 +7,18 @@ Module definition for the parser.
 #ifndef PARSER_H
 #define PARSER_H
 
+#include "ast.h"
 #include "control.h"
 #include "nfa.h"
 
 NFA *parse(CmpCtrl *cc);
-NFA *regex(CmpCtrl *cc);
-NFA *group(CmpCtrl *cc);
-NFA *gprime(CmpCtrl *cc, NFA *local);
-NFA *quantifier(CmpCtrl *cc, NFA *nfa);
-NFA *pattern(CmpCtrl *cc);
-NFA *range(CmpCtrl *cc);
-NFA *allowed(CmpCtrl *cc);
+AST *parse_ast(CmpCtrl *cc);
+NFA *thompson(ASTNode *root);
+
+ASTNode *regex(CmpCtrl *cc);
+ASTNode *quantifier(CmpCtrl *cc, ASTNode *node);
+ASTNode *pattern(CmpCtrl *cc);
+ASTNode *range(CmpCtrl *cc);
+ASTNode *allowed(CmpCtrl *cc);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,300 @@
+/** search.c
+
+Find matches of a regex inside a longer input with its minimal DFA.
+
+A DFA built from the regex as written only accepts when the whole input
+matches, so searching with it means running it again from every offset, which
+takes O(n^2) time for an input of length n. A DFA built from a tree that went
+through ast_unanchor() starts with [\x00-\xFF]*, so it's in an accept state
+right after every match, wherever that match started. One pass finds them all
+in O(n) time.
+
+That only tells whether and where some match ends, which isn't the span of the
+leftmost-longest match. search_span() finds that one in two passes, each
+bounded by the match:
+1. The minimal DFA of the regex itself runs forwards from every offset at once.
+   Runs in the same state read the same input from then on, so only the one
+   that started first is kept, and there's at most one run per state. Once one
+   accepts, runs that started later are dropped and no new ones start, so the
+   run that started first goes on to the longest end and the pass stops when
+   it dies.
+2. The minimal DFA of the regex is reversed, see minimize_reverse(), and runs
+   backwards from that end. Its last accept state is the leftmost start of a
+   match that ends there, which is the leftmost start of any match.
+Both passes stop soon after the match for most regexes, so searching again from
+the end of every match reads each char a bounded number of times, at a cost of
+one step per run.
+
+The minimal DFA's inverse table is flattened into a table indexed by state and
+byte class first, so each input char costs one class lookup and one transition.
+
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "charset.h"
+#include "common.h"
+#include "dfa.h"
+#include "minimize.h"
+#include "search.h"
+#include "set.h"
+#include "simulate.h"
+
+/* init_search_dfa()
+	@min_dfa        ptr to MinimalDFA struct
+
+	@return         ptr to dynamically allocated SearchDFA, NULL if fail
+
+	Build the flat transition table of a minimal DFA, which keeps its end
+	anchor. The MinimalDFA isn't needed afterwards.
+*/
+SearchDFA *init_search_dfa(MinimalDFA *min_dfa)
+{
+	SearchDFA *sdfa = calloc(1, sizeof(SearchDFA));
+	if (!sdfa)
+		return NULL;
+	int size = min_dfa->size;
+	sdfa->size = size;
+	sdfa->start = min_dfa->start->index;
+	sdfa->anchored_end = min_dfa->anchored_end;
+	sdfa->is_accept = calloc(size, sizeof(bool));
+	sdfa->runs = init_sparse_set(size);
+	sdfa->next_runs = init_sparse_set(size);
+	CharSet *labels = malloc((size_t)size * size * sizeof(CharSet));
+	if (!sdfa->is_accept || !sdfa->runs || !sdfa->next_runs || !labels) {
+		free(labels);
+		destroy_search_dfa(sdfa);
+		return NULL;
+	}
+
+	int num_labels = 0;
+	for (int i = 0; i < size; i++) {
+		for (int j = 0; j < size; j++) {
+			if (!charset_is_empty(&min_dfa->delta[i][j]))
+				labels[num_labels++] = min_dfa->delta[i][j];
+		}
+	}
+	sdfa->num_classes = byte_classes(labels, num_labels, sdfa->classes);
+	free(labels);
+
+	int n = sdfa->num_classes;
+	sdfa->next = malloc((size_t)size * (n ? n : 1) * sizeof(int));
+	if (!sdfa->next) {
+		destroy_search_dfa(sdfa);
+		return NULL;
+	}
+	// every char of a class goes to the same state, so try one of them
+	int rep[NUM_CHARS];
+	for (int ch = NUM_CHARS - 1; ch >= 0; ch--) {
+		if (sdfa->classes[ch] != -1)
+			rep[sdfa->classes[ch]] = ch;
+	}
+	for (int i = 0; i < size; i++) {
+		for (int c = 0; c < n; c++)
+			sdfa->next[i * n + c] = DEAD_STATE;
+		for (int j = 0; j < size; j++) {
+			for (int c = 0; c < n; c++) {
+				if (charset_has(&min_dfa->delta[i][j], rep[c]))
+					sdfa->next[i * n + c] = j;
+			}
+		}
+	}
+
+	Iterator *it = set_begin(min_dfa->accepts);
+	for (; it; advance_iter(&it))
+		sdfa->is_accept[((MinimalDFAState *)it->element)->index] = true;
+	return sdfa;
+}
+
+/* destroy_search_dfa()
+	@sdfa           ptr to SearchDFA struct
+
+	Free all the memory used by a SearchDFA.
+*/
+void destroy_search_dfa(SearchDFA *sdfa)
+{
+	if (!sdfa)
+		return;
+	free(sdfa->next);
+	free(sdfa->is_accept);
+	destroy_sparse_set(sdfa->runs);
+	destroy_sparse_set(sdfa->next_runs);
+	free(sdfa);
+}
+
+/* search_dfa()
+	@sdfa           ptr to SearchDFA struct
+	@input          string to search, not necessarily null-terminated
+	@len            length of @input
+	@mode           SEARCH_EARLIEST or SEARCH_LONGEST
+
+	@return         offset right after the match, SEARCH_NO_MATCH if there's
+	                none
+
+	Run the DFA over the input until it can't change the answer anymore.
+	SEARCH_EARLIEST stops at the first accept state, ie the match that ends
+	first. SEARCH_LONGEST keeps going while the DFA is alive and returns
+	the last accept state it passed. For a regex anchored with ^, that's
+	the longest match at the start of the input. For an unanchored one, the
+	DFA never dies, so it's the end of the last match in the input.
+
+	If the regex ended with $, only an accept state at the end of the
+	input counts, but a dead state still ends the search early.
+*/
+int search_dfa(SearchDFA *sdfa, const char *input, int len, int mode)
+{
+	int n = sdfa->num_classes;
+	int s = sdfa->start;
+	int end = SEARCH_NO_MATCH;
+	int c;
+	for (int i = 0;; i++) {
+		if (sdfa->is_accept[s] && (!sdfa->anchored_end || i == len)) {
+			end = i;
+			if (mode == SEARCH_EARLIEST)
+				break;
+		}
+		if (i == len)
+			break;
+		c = sdfa->classes[(U8)input[i]];
+		if (c == -1)
+			break;
+		s = sdfa->next[s * n + c];
+		if (s == DEAD_STATE)
+			break;
+	}
+	return end;
+}
+
+/* search_dfa_reverse()
+	@sdfa           ptr to SearchDFA struct of a reversed regex
+	@input          string to search, not necessarily null-terminated
+	@end            offset to start from, the input is read backwards from
+	                @input[@end - 1]
+	@mode           SEARCH_EARLIEST or SEARCH_LONGEST
+
+	@return         offset of the first char of the match, SEARCH_NO_MATCH
+	                if there's none
+
+	Like search_dfa(), but backwards. A reversed regex ends where the regex
+	starts, so if the regex started with ^, only an accept state at offset
+	0 counts.
+*/
+int search_dfa_reverse(SearchDFA *sdfa, const char *input, int end,
+                       int mode)
+{
+	int n = sdfa->num_classes;
+	int s = sdfa->start;
+	int begin = SEARCH_NO_MATCH;
+	int c;
+	for (int i = end;; i--) {
+		if (sdfa->is_accept[s] && (!sdfa->anchored_end || i == 0)) {
+			begin = i;
+			if (mode == SEARCH_EARLIEST)
+				break;
+		}
+		if (i == 0)
+			break;
+		c = sdfa->classes[(U8)input[i-1]];
+		if (c == -1)
+			break;
+		s = sdfa->next[s * n + c];
+		if (s == DEAD_STATE)
+			break;
+	}
+	return begin;
+}
+
+/* leftmost_longest_end()
+	@sdfa           ptr to SearchDFA struct of the regex itself
+	@input          string to search, not necessarily null-terminated
+	@len            length of @input
+	@anchored_start true if a match can only start at offset 0
+
+	@return         offset right after the leftmost-longest match,
+	                SEARCH_NO_MATCH if there's none
+
+	Run the DFA from every offset at once, with its runs in the order they
+	started. A run that reaches a state another one is already in is
+	dropped, since the earlier one makes every match it would. The first
+	run in an accept state is the leftmost match that ends there. Runs
+	after it start later, so they're dropped and no new ones start. The
+	runs before it started earlier, so any match of theirs wins, and its
+	own later accepts are longer. The last accept is the answer, once no
+	run is left.
+*/
+static int leftmost_longest_end(SearchDFA *sdfa, const char *input, int len,
+                                bool anchored_start)
+{
+	SparseSet *runs = sdfa->runs;
+	SparseSet *next_runs = sdfa->next_runs;
+	SparseSet *tmp;
+	int n = sdfa->num_classes;
+	int end = SEARCH_NO_MATCH;
+	int c, s;
+	sparse_set_clear(runs);
+	for (int i = 0;; i++) {
+		// a run that starts here comes after all the others
+		if (end == SEARCH_NO_MATCH && (!anchored_start || i == 0) &&
+		    !sparse_set_contains(runs, sdfa->start))
+			sparse_set_insert(runs, sdfa->start);
+		for (int r = 0; r < runs->size; r++) {
+			if (sdfa->is_accept[runs->dense[r]] &&
+			    (!sdfa->anchored_end || i == len)) {
+				end = i;
+				runs->size = r + 1;
+				break;
+			}
+		}
+		if (i == len || !runs->size)
+			break;
+		sparse_set_clear(next_runs);
+		c = sdfa->classes[(U8)input[i]];
+		for (int r = 0; c != -1 && r < runs->size; r++) {
+			s = sdfa->next[runs->dense[r] * n + c];
+			if (s == DEAD_STATE ||
+			    sparse_set_contains(next_runs, s))
+				continue;
+			sparse_set_insert(next_runs, s);
+		}
+		tmp = runs;
+		runs = next_runs;
+		next_runs = tmp;
+	}
+	return end;
+}
+
+/* search_span()
+	@anchored       ptr to SearchDFA struct of the regex itself
+	@reverse        ptr to SearchDFA struct of the reversed regex
+	@input          string to search, not necessarily null-terminated
+	@len            length of @input
+	@begin          receives the offset of the match's first char
+	@end            receives the offset right after the match
+
+	@return         true if there's a match, otherwise false
+
+	Find the leftmost-longest match, like POSIX: the one that starts first,
+	and the longest of those. The anchored DFA finds where it ends, see
+	leftmost_longest_end(), and the reverse DFA walks back from there to
+	where it starts. The match that ends first isn't enough, eg abcd|c
+	finds c in "abcd" first, but abcd starts earlier.
+
+	The reverse DFA is anchored at its end if the regex started with ^,
+	so the anchored DFA only starts at offset 0 then.
+
+	To find every match, search again from *@end, or from *@end + 1 after
+	an empty match. The passes only read past the match while some run
+	that started in it is alive, so that takes linear time in total for
+	most regexes.
+*/
+bool search_span(SearchDFA *anchored, SearchDFA *reverse, const char *input,
+                 int len, int *begin, int *end)
+{
+	*end = leftmost_longest_end(anchored, input, len,
+	                            reverse->anchored_end);
+	if (*end == SEARCH_NO_MATCH)
+		return false;
+	*begin = search_dfa_reverse(reverse, input, *end, SEARCH_LONGEST);
+	return *begin != SEARCH_NO_MATCH;
+}
\ No newline at end of file
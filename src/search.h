@@ -0,0 +1,51 @@
+/** search.h
+
+Module definition for searching input with a compiled DFA.
+
+*/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+
+#include "charset.h"
+#include "common.h"
+#include "minimize.h"
+#include "simulate.h"
+
+// where search_dfa() stops
+#define SEARCH_EARLIEST  0  // at the first accept state
+#define SEARCH_LONGEST   1  // at a dead state, or the end of the input
+
+#define SEARCH_NO_MATCH  (-1)
+
+typedef struct SearchDFA {
+	int size;
+	int start;
+	int num_classes;
+	int classes[NUM_CHARS];  // byte class of every char, -1 if no
+	                         // transition reads it
+	int *next;
+	/*
+	Flat transition table, next[s * num_classes + c] is where state s goes
+	on a char of class c, or DEAD_STATE. One lookup per input char.
+	*/
+	bool *is_accept;
+	bool anchored_end;  // only a match at the end of the input counts,
+	                    // see MinimalDFA
+
+	// runs of the DFA for search_span(), one per state at most
+	SparseSet *runs;
+	SparseSet *next_runs;
+} SearchDFA;
+
+SearchDFA *init_search_dfa(MinimalDFA *min_dfa);
+void destroy_search_dfa(SearchDFA *sdfa);
+int search_dfa(SearchDFA *sdfa, const char *input, int len, int mode);
+int search_dfa_reverse(SearchDFA *sdfa, const char *input, int end,
+                       int mode);
+bool search_span(SearchDFA *anchored, SearchDFA *reverse, const char *input,
+                 int len, int *begin, int *end);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,438 @@
+/** simplify.c
+
+Rewrite regex syntax trees into smaller equivalent ones before any automaton
+gets built. Every node that's removed here is 2 fewer Thompson NFA states, and
+fewer positions for the Glushkov and followpos constructions.
+
+The rewrites, applied bottom-up:
+	a|[bc]|d      =>  [a-d]   char alternatives are merged into one class
+	r|s|r         =>  r|s     duplicate alternatives are dropped
+	(r*)*, (r+)?  =>  r*      nested quantifiers are collapsed
+	(r*s?)+       =>  (r*s?)* + of something nullable is *
+	(r*s?)?       =>  r*s?    ? of something nullable is redundant
+	[a]           =>  a
+	abc|abd       =>  ab[cd]  common prefixes are factored into a trie
+	ac|bc         =>  [ab]c   and so are common suffixes
+Groups never make it into the tree in the first place, so (((a))) is already
+just a.
+
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "charset.h"
+#include "common.h"
+#include "simplify.h"
+
+/* is_quantifier()
+	@node           ptr to AST_REPEAT node
+
+	@return         true if @node is *, ?, or +
+*/
+static bool is_quantifier(ASTNode *node)
+{
+	return node->min <= 1 &&
+	       (node->max == 1 || node->max == AST_UNBOUNDED);
+}
+
+/* is_leaf()
+	@node           ptr to syntax tree node
+
+	@return         true if @node matches exactly one char
+*/
+static inline bool is_leaf(ASTNode *node)
+{
+	return node->kind == AST_LITERAL || node->kind == AST_CLASS;
+}
+
+/* simplify_leaf()
+	@node           ptr to AST_LITERAL or AST_CLASS node
+
+	@return         @node
+
+	Turn a class with only one char into a literal.
+*/
+static ASTNode *simplify_leaf(ASTNode *node)
+{
+	int ch = charset_single(&node->chars);
+	if (ch != -1) {
+		node->kind = AST_LITERAL;
+		node->ch = ch;
+	} else if (!charset_is_empty(&node->chars)) {
+		node->kind = AST_CLASS;
+		node->ch = 0;
+	}
+	return node;
+}
+
+/* simplify_repeat()
+	@node           ptr to AST_REPEAT node whose child is simplified
+
+	@return         ptr to equivalent subtree
+
+	Collapse quantifiers. If both quantifiers allow 0 repetitions, so does
+	the result, and if either is unbounded, so is the result.
+*/
+static ASTNode *simplify_repeat(ASTNode *node)
+{
+	if (!is_quantifier(node))
+		return node;
+	ASTNode *child = node->left;
+	if (child->kind == AST_REPEAT && is_quantifier(child)) {
+		child->min = node->min && child->min;
+		if (node->max == AST_UNBOUNDED)
+			child->max = AST_UNBOUNDED;
+		return child;
+	}
+	if (ast_nullable(child)) {
+		if (node->max == 1)
+			return child;
+		node->min = 0;
+	}
+	return node;
+}
+
+/* join()
+	@ast            ptr to AST struct
+	@kind           AST_CONCAT or AST_ALT
+	@nodes          array of syntax trees
+	@size           number of trees in @nodes
+
+	@return         ptr to left-deep tree of @kind nodes, like the parser
+	                builds, NULL if fail or if @size is 0
+*/
+static ASTNode *join(AST *ast, int kind, ASTNode **nodes, int size)
+{
+	ASTNode *result = size ? nodes[0] : NULL;
+	for (int i = 1; i < size && result; i++) {
+		if (kind == AST_CONCAT)
+			result = ast_concat(ast, result, nodes[i]);
+		else
+			result = ast_alt(ast, result, nodes[i]);
+	}
+	return result;
+}
+
+static ASTNode *simplify_alts(AST *ast, NodeList *alts);
+
+/* factor()
+	@ast            ptr to AST struct
+	@alts           ptr to list of alternatives
+	@suffix         factor out common suffixes instead of prefixes
+	@result         ptr to empty list which receives the new alternatives
+
+	@return         true if success, otherwise false
+
+	Group the alternatives by their first (or last) factor, and rewrite
+	each group with more than one member as that factor concatenated with
+	the alternation of the rests, eg abc|abd|x => a(bc|bd)|x. The rests are
+	simplified recursively, so the result is a trie: a(bc|bd) => ab[cd].
+	If one of the rests is empty, eg +|++, the alternation of the others is
+	optional: \+\+?
+	The groups are found in one pass with a hash table of their factors,
+	and each group keeps the order its members had in @alts.
+*/
+static bool factor(AST *ast, NodeList *alts, bool suffix, NodeList *result)
+{
+	int num_alts = alts->size;
+	int num_buckets = 2 * num_alts;  // load factor at most 1/2
+	NodeList *factors = calloc(num_alts, sizeof(NodeList));
+	ASTNode **keys = malloc(num_alts * sizeof(ASTNode *));
+	U64 *hashes = malloc(num_alts * sizeof(U64));
+	// the members of a group are chained by next[] from the first one,
+	// which is the only one in the table and in last[]
+	int *next = malloc(num_alts * sizeof(int));
+	int *last = malloc(num_alts * sizeof(int));
+	int *buckets = malloc(num_buckets * sizeof(int));
+	NodeList rests = {NULL, 0, 0};
+	NodeList joined = {NULL, 0, 0};
+	bool ok = factors && keys && hashes && next && last && buckets;
+	if (ok)
+		memset(buckets, -1, num_buckets * sizeof(int));
+
+	NodeList *f;
+	int b;
+	for (int i = 0; ok && i < num_alts; i++) {
+		f = &factors[i];
+		ok = ast_flatten(alts->nodes[i], AST_CONCAT, f);
+		if (!ok)
+			break;
+		keys[i] = suffix ? f->nodes[f->size - 1] : f->nodes[0];
+		hashes[i] = ast_hash(keys[i]);
+		next[i] = -1;
+		b = hashes[i] % num_buckets;
+		for (; buckets[b] != -1; b = (b + 1) % num_buckets) {
+			if (hashes[buckets[b]] == hashes[i] &&
+			    ast_equal(keys[buckets[b]], keys[i]))
+				break;
+		}
+		if (buckets[b] == -1) {
+			buckets[b] = last[i] = i;
+			continue;
+		}
+		next[last[buckets[b]]] = i;
+		last[buckets[b]] = i;
+		last[i] = -1;
+	}
+
+	ASTNode *rest;
+	bool has_empty;
+	for (int i = 0; ok && i < num_alts; i++) {
+		// only the first member of each group starts one
+		if (last[i] == -1)
+			continue;
+		if (next[i] == -1) {
+			ok = push_node(result, alts->nodes[i]);
+			continue;
+		}
+		rests.size = 0;
+		has_empty = false;
+		for (int j = i; ok && j != -1; j = next[j]) {
+			f = &factors[j];
+			if (f->size == 1) {
+				has_empty = true;
+				continue;
+			}
+			rest = join(ast, AST_CONCAT, f->nodes + !suffix,
+			            f->size - 1);
+			ok = rest && push_node(&rests, rest);
+		}
+		if (!ok)
+			break;
+
+		rest = rests.size ? simplify_alts(ast, &rests) : NULL;
+		if (rests.size && !rest) {
+			ok = false;
+			break;
+		}
+		if (rest && has_empty)
+			rest = ast_repeat(ast, rest, 0, 1);
+		if (rest && rest->kind == AST_REPEAT)
+			rest = simplify_repeat(rest);
+
+		// keep the concatenation left-deep
+		joined.size = 0;
+		ok = (suffix || push_node(&joined, keys[i])) &&
+		     (!rest || ast_flatten(rest, AST_CONCAT, &joined)) &&
+		     (!suffix || push_node(&joined, keys[i]));
+		rest = ok ? join(ast, AST_CONCAT, joined.nodes, joined.size)
+		          : NULL;
+		ok = rest && push_node(result, rest);
+	}
+
+	if (factors) {
+		for (int i = 0; i < num_alts; i++)
+			free(factors[i].nodes);
+	}
+	free(factors);
+	free(keys);
+	free(hashes);
+	free(next);
+	free(last);
+	free(buckets);
+	free(rests.nodes);
+	free(joined.nodes);
+	return ok;
+}
+
+/* drop_duplicates()
+	@alts           ptr to list of alternatives, which gets modified
+
+	@return         true if success, otherwise false
+
+	Drop every alternative that's ast_equal() to an earlier one. Each
+	alternative is looked up in a hash table of the ones kept so far, so it
+	only gets compared to the few with the same hash instead of all of
+	them.
+*/
+static bool drop_duplicates(NodeList *alts)
+{
+	if (alts->size < 2)
+		return true;
+	// keep the load factor at most 1/2
+	int num_buckets = 2 * alts->size;
+	int *buckets = malloc(num_buckets * sizeof(int));
+	U64 *hashes = malloc(alts->size * sizeof(U64));
+	if (!buckets || !hashes) {
+		free(buckets);
+		free(hashes);
+		return false;
+	}
+	memset(buckets, -1, num_buckets * sizeof(int));
+
+	int kept = 0;
+	int b;
+	ASTNode *alt;
+	for (int i = 0; i < alts->size; i++) {
+		alt = alts->nodes[i];
+		hashes[kept] = ast_hash(alt);
+		b = hashes[kept] % num_buckets;
+		for (; buckets[b] != -1; b = (b + 1) % num_buckets) {
+			if (hashes[buckets[b]] == hashes[kept] &&
+			    ast_equal(alts->nodes[buckets[b]], alt))
+				break;
+		}
+		if (buckets[b] != -1)
+			continue;
+		buckets[b] = kept;
+		alts->nodes[kept++] = alt;
+	}
+	alts->size = kept;
+	free(buckets);
+	free(hashes);
+	return true;
+}
+
+/* simplify_alts()
+	@ast            ptr to AST struct
+	@alts           ptr to list of simplified alternatives, which gets
+	                modified
+
+	@return         ptr to alternation equivalent to @alts, NULL if fail
+
+	Drop duplicate alternatives and factor out common prefixes and
+	suffixes. Then merge every single-char alternative into one class,
+	which takes the place of the first of them. Factoring goes first
+	because a|ab is better off as ab? than as a|ab with one less leaf.
+*/
+static ASTNode *simplify_alts(AST *ast, NodeList *alts)
+{
+	NodeList prefixed = {NULL, 0, 0};
+	NodeList suffixed = {NULL, 0, 0};
+	ASTNode *result = NULL;
+	if (!drop_duplicates(alts) ||
+	    !factor(ast, alts, false, &prefixed) ||
+	    !factor(ast, &prefixed, true, &suffixed))
+		goto CLEANUP;
+
+	ASTNode *chars = NULL;
+	int kept = 0;
+	for (int i = 0; i < suffixed.size; i++) {
+		if (is_leaf(suffixed.nodes[i])) {
+			if (chars) {
+				charset_union(&chars->chars,
+				              &suffixed.nodes[i]->chars);
+				continue;
+			}
+			chars = suffixed.nodes[i];
+		}
+		suffixed.nodes[kept++] = suffixed.nodes[i];
+	}
+	if (chars)
+		simplify_leaf(chars);
+	result = join(ast, AST_ALT, suffixed.nodes, kept);
+
+CLEANUP:
+	free(prefixed.nodes);
+	free(suffixed.nodes);
+	return result;
+}
+
+/* simplify()
+	@ast            ptr to AST struct that owns @node
+	@node           ptr to syntax tree
+
+	@return         ptr to simplified subtree, NULL if fail
+
+	Simplify a syntax tree bottom-up. Nodes may be modified or replaced,
+	and any new nodes are allocated from @ast.
+
+	Each node on the work stack is visited twice: first to push its
+	operands above it, then to combine their simplified results once
+	they're all done. The operands of an alternation are all of its
+	alternatives rather than its 2 children, so that factoring sees all of
+	them at once.
+*/
+ASTNode *simplify(AST *ast, ASTNode *node)
+{
+	int num_nodes = count_nodes(node);
+	if (num_nodes < 0)
+		return NULL;
+	// work[i] waits on the results from results.nodes[base[i]] onward,
+	// base[i] is -1 until its operands are pushed
+	ASTNode **work = malloc(num_nodes * sizeof(ASTNode *));
+	int *base = malloc(num_nodes * sizeof(int));
+	NodeList results = {NULL, 0, 0};
+	NodeList operands = {NULL, 0, 0};
+	NodeList alts = {NULL, 0, 0};
+	ASTNode *result = NULL;
+	bool ok = work && base;
+	int top = 0;
+	if (ok) {
+		work[top] = node;
+		base[top++] = -1;
+	}
+
+	int first;
+	while (ok && top > 0) {
+		node = work[top-1];
+		if (base[top-1] == -1) {
+			base[top-1] = results.size;
+			operands.size = 0;
+			if (node->kind == AST_ALT)
+				ok = ast_flatten(node, AST_ALT, &operands);
+			else if (!is_leaf(node))
+				ok = push_node(&operands, node->left) &&
+				     (!node->right ||
+				      push_node(&operands, node->right));
+			// the leftmost operand is simplified first
+			for (int i = operands.size - 1; ok && i >= 0; i--) {
+				work[top] = operands.nodes[i];
+				base[top++] = -1;
+			}
+			continue;
+		}
+
+		first = base[--top];
+		switch (node->kind) {
+		case AST_LITERAL:
+		case AST_CLASS:
+			result = simplify_leaf(node);
+			break;
+		case AST_REPEAT:
+			node->left = results.nodes[first];
+			result = simplify_repeat(node);
+			break;
+		case AST_CONCAT:
+			node->left = results.nodes[first];
+			node->right = results.nodes[first + 1];
+			result = node;
+			break;
+		case AST_ALT:
+			alts.size = 0;
+			for (int i = first; ok && i < results.size; i++)
+				ok = ast_flatten(results.nodes[i], AST_ALT,
+				                 &alts);
+			result = ok ? simplify_alts(ast, &alts) : NULL;
+			break;
+		}
+		results.size = first;
+		ok = result && push_node(&results, result);
+	}
+
+	free(work);
+	free(base);
+	free(results.nodes);
+	free(operands.nodes);
+	free(alts.nodes);
+	return ok ? result : NULL;
+}
+
+/* simplify_ast()
+	@ast            ptr to AST struct
+
+	@return         true if success, otherwise false
+
+	Simplify an entire syntax tree in place.
+*/
+bool simplify_ast(AST *ast)
+{
+	ASTNode *root = simplify(ast, ast->root);
+	if (!root)
+		return false;
+	ast->root = root;
+	return true;
+}
\ No newline at end of file
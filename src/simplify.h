@@ -0,0 +1,17 @@
+/** simplify.h
+
+Module definition for syntax tree simplification.
+
+*/
+
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+
+ASTNode *simplify(AST *ast, ASTNode *node);
+bool simplify_ast(AST *ast);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,357 @@
+/** simulate.c
+
+Simulate a Thompson NFA directly with a Pike VM.
+
+The subset construction can blow up exponentially, but simulating the NFA one
+input char at a time never visits more than every NFA state per char. So
+matching takes O(n*m) time for an input of length n and an NFA of m states,
+and compiling takes no time beyond the NFA itself.
+
+Every table is allocated by init_pikevm(). Matching allocates nothing.
+
+A PositionVM does the same for an epsilon-free PositionNFA, eg one made by
+remove_epsilons(). Each thread steps straight to the positions after it.
+
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "charset.h"
+#include "common.h"
+#include "glushkov.h"
+#include "nfa.h"
+#include "set.h"
+#include "simulate.h"
+
+/* init_sparse_set()
+	@capacity       maximum element value + 1
+
+	@return         ptr to dynamically allocated SparseSet, NULL if fail
+
+	Dynamically allocate a SparseSet which can hold the integers
+	[0, @capacity).
+*/
+SparseSet *init_sparse_set(int capacity)
+{
+	SparseSet *ss = calloc(1, sizeof(SparseSet));
+	if (!ss)
+		return NULL;
+	// sparse[] doesn't technically need to be zeroed, but valgrind and
+	// the sanitizers will complain about reading garbage
+	ss->dense = calloc(capacity, sizeof(int));
+	ss->sparse = calloc(capacity, sizeof(int));
+	if (!ss->dense || !ss->sparse) {
+		destroy_sparse_set(ss);
+		return NULL;
+	}
+	return ss;
+}
+
+/* destroy_sparse_set()
+	@ss             ptr to SparseSet struct
+
+	Free all the memory used by a SparseSet.
+*/
+void destroy_sparse_set(SparseSet *ss)
+{
+	if (!ss)
+		return;
+	free(ss->dense);
+	free(ss->sparse);
+	free(ss);
+}
+
+/* sparse_set_contains()
+	@ss             ptr to SparseSet struct
+	@i              integer to find
+
+	@return         true if @i is in the set, otherwise false
+
+	Check set membership in constant time.
+*/
+inline bool sparse_set_contains(SparseSet *ss, int i)
+{
+	int s = ss->sparse[i];
+	return s < ss->size && ss->dense[s] == i;
+}
+
+/* sparse_set_insert()
+	@ss             ptr to SparseSet struct
+	@i              integer to insert
+
+	Insert an integer that is NOT already in the set.
+*/
+inline void sparse_set_insert(SparseSet *ss, int i)
+{
+	ss->dense[ss->size] = i;
+	ss->sparse[i] = ss->size;
+	ss->size++;
+}
+
+// clearing doesn't need to touch the arrays at all
+inline void sparse_set_clear(SparseSet *ss)
+{
+	ss->size = 0;
+}
+
+/* init_pikevm()
+	@nfa            ptr to NFA struct
+
+	@return         ptr to dynamically allocated PikeVM, NULL if fail
+
+	Flatten an NFA into index-addressed tables and precompute the epsilon
+	edges of every state. The NFA is re-indexed but otherwise unmodified,
+	and the PikeVM does not reference it afterwards.
+*/
+PikeVM *init_pikevm(NFA *nfa)
+{
+	PikeVM *vm = calloc(1, sizeof(PikeVM));
+	if (!vm)
+		return NULL;
+
+	vm->num_states = index_states(nfa) + 1;
+	if (vm->num_states == 0) {
+		free(vm);
+		return NULL;
+	}
+	vm->start = nfa->start->index;
+	vm->accept = nfa->accept->index;
+
+	int n = vm->num_states;
+	vm->chars = calloc(n, sizeof(CharSet));
+	vm->outs = malloc(n * sizeof(int));
+	vm->eps_begin = calloc(n + 1, sizeof(int));
+	vm->clist = init_sparse_set(n);
+	vm->nlist = init_sparse_set(n);
+	if (!vm->chars || !vm->outs || !vm->eps_begin || !vm->clist ||
+	    !vm->nlist) {
+		destroy_pikevm(vm);
+		return NULL;
+	}
+
+	// count epsilon edges so each state knows where its slice begins
+	NFAState *state;
+	Iterator *it = set_begin(nfa->mem_region);
+	for (; it; advance_iter(&it)) {
+		state = (NFAState *)(it->element);
+		if (state->index == -1)
+			continue;  // unreachable from the start state
+		vm->chars[state->index] = state->chars;
+		vm->outs[state->index] = -1;
+		if (state->ch != EPSILON) {
+			vm->outs[state->index] = state->out1->index;
+			continue;
+		}
+		if (state->out1)
+			vm->eps_begin[state->index + 1]++;
+		if (state->out2)
+			vm->eps_begin[state->index + 1]++;
+		vm->eps_begin[state->index + 1] += state->num_outs;
+	}
+	for (int i = 0; i < n; i++)
+		vm->eps_begin[i + 1] += vm->eps_begin[i];
+
+	int num_eps = vm->eps_begin[n];
+	vm->eps = malloc((num_eps + 1) * sizeof(int));
+	// each state is pushed at most once per epsilon edge pointing to it,
+	// plus the state that begins the closure
+	vm->stack = malloc((num_eps + 1) * sizeof(int));
+	if (!vm->eps || !vm->stack) {
+		destroy_pikevm(vm);
+		return NULL;
+	}
+
+	// out1 goes before out2 to preserve Thompson's thread priority
+	int slot;
+	for (it = set_begin(nfa->mem_region); it; advance_iter(&it)) {
+		state = (NFAState *)(it->element);
+		if (state->index == -1 || state->ch != EPSILON)
+			continue;
+		slot = vm->eps_begin[state->index];
+		if (state->out1)
+			vm->eps[slot++] = state->out1->index;
+		if (state->out2)
+			vm->eps[slot++] = state->out2->index;
+		for (int i = 0; i < state->num_outs; i++)
+			vm->eps[slot++] = state->outs[i]->index;
+	}
+	return vm;
+}
+
+/* destroy_pikevm()
+	@vm             ptr to PikeVM struct
+
+	Free all the memory used by a PikeVM.
+*/
+void destroy_pikevm(PikeVM *vm)
+{
+	if (!vm)
+		return;
+	free(vm->chars);
+	free(vm->outs);
+	free(vm->eps_begin);
+	free(vm->eps);
+	destroy_sparse_set(vm->clist);
+	destroy_sparse_set(vm->nlist);
+	free(vm->stack);
+	free(vm);
+}
+
+/* add_thread()
+	@vm             ptr to PikeVM struct
+	@list           thread list that receives the new threads
+	@state          index of the NFA state to add
+
+	Add a thread for @state, plus a thread for every state in its epsilon
+	closure, unless the list already has them.
+*/
+static void add_thread(PikeVM *vm, SparseSet *list, int state)
+{
+	int top = 0;
+	vm->stack[top++] = state;
+
+	int curr;
+	while (top > 0) {
+		curr = vm->stack[--top];
+		if (sparse_set_contains(list, curr))
+			continue;
+		sparse_set_insert(list, curr);
+		// push in reverse so out1 gets popped first
+		for (int e = vm->eps_begin[curr + 1] - 1;
+		     e >= vm->eps_begin[curr]; e--) {
+			if (!sparse_set_contains(list, vm->eps[e]))
+				vm->stack[top++] = vm->eps[e];
+		}
+	}
+}
+
+/* pikevm_match()
+	@vm             ptr to PikeVM struct
+	@input          string to match, not necessarily null-terminated
+	@len            length of @input
+
+	@return         true if the NFA accepts the entire @input, otherwise
+	                false
+
+	Run every NFA thread in lockstep over the input.
+*/
+bool pikevm_match(PikeVM *vm, const char *input, int len)
+{
+	SparseSet *clist = vm->clist;
+	SparseSet *nlist = vm->nlist;
+	SparseSet *tmp;
+	sparse_set_clear(clist);
+	add_thread(vm, clist, vm->start);
+
+	U8 ch;
+	int s;
+	for (int i = 0; i < len; i++) {
+		ch = (U8)input[i];
+		sparse_set_clear(nlist);
+		for (int t = 0; t < clist->size; t++) {
+			s = clist->dense[t];
+			if (charset_has(&vm->chars[s], ch))
+				add_thread(vm, nlist, vm->outs[s]);
+		}
+		tmp = clist;
+		clist = nlist;
+		nlist = tmp;
+		// every thread died, so nothing can ever match again
+		if (clist->size == 0)
+			break;
+	}
+
+	// restore the lists so the next call starts from a known state
+	vm->clist = clist;
+	vm->nlist = nlist;
+	return sparse_set_contains(clist, vm->accept);
+}
+
+/* init_position_vm()
+	@pnfa           ptr to PositionNFA struct
+
+	@return         ptr to dynamically allocated PositionVM, NULL if fail
+
+	Allocate the thread lists for simulating a PositionNFA. The PositionNFA
+	must outlive the PositionVM.
+*/
+PositionVM *init_position_vm(PositionNFA *pnfa)
+{
+	PositionVM *vm = calloc(1, sizeof(PositionVM));
+	if (!vm)
+		return NULL;
+	vm->pnfa = pnfa;
+	vm->clist = init_sparse_set(pnfa->size);
+	vm->nlist = init_sparse_set(pnfa->size);
+	if (!vm->clist || !vm->nlist) {
+		destroy_position_vm(vm);
+		return NULL;
+	}
+	return vm;
+}
+
+/* destroy_position_vm()
+	@vm             ptr to PositionVM struct
+
+	Free all the memory used by a PositionVM, but not its PositionNFA.
+*/
+void destroy_position_vm(PositionVM *vm)
+{
+	if (!vm)
+		return;
+	destroy_sparse_set(vm->clist);
+	destroy_sparse_set(vm->nlist);
+	free(vm);
+}
+
+/* position_vm_match()
+	@vm             ptr to PositionVM struct
+	@input          string to match, not necessarily null-terminated
+	@len            length of @input
+
+	@return         true if the PositionNFA accepts the entire @input,
+	                otherwise false
+
+	Run every thread in lockstep over the input. A thread on position p
+	moves to each position in p's follow set that reads the next char.
+*/
+bool position_vm_match(PositionVM *vm, const char *input, int len)
+{
+	PositionNFA *pnfa = vm->pnfa;
+	SparseSet *clist = vm->clist;
+	SparseSet *nlist = vm->nlist;
+	SparseSet *tmp;
+	sparse_set_clear(clist);
+	sparse_set_insert(clist, 0);
+
+	U8 ch;
+	PosList *follow;
+	int q;
+	for (int i = 0; i < len; i++) {
+		ch = (U8)input[i];
+		sparse_set_clear(nlist);
+		for (int t = 0; t < clist->size; t++) {
+			follow = &pnfa->follow[clist->dense[t]];
+			for (int j = 0; j < follow->size; j++) {
+				q = follow->positions[j];
+				if (charset_has(&pnfa->chars[q], ch) &&
+				    !sparse_set_contains(nlist, q))
+					sparse_set_insert(nlist, q);
+			}
+		}
+		tmp = clist;
+		clist = nlist;
+		nlist = tmp;
+		if (clist->size == 0)
+			break;
+	}
+
+	vm->clist = clist;
+	vm->nlist = nlist;
+	for (int t = 0; t < clist->size; t++) {
+		if (pnfa->is_accept[clist->dense[t]])
+			return true;
+	}
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+/** simulate.h
+
+Module definition for the Pike VM, which simulates a Thompson NFA directly.
+
+*/
+
+#ifndef SIMULATE_H
+#define SIMULATE_H
+
+#include <stdbool.h>
+
+#include "charset.h"
+#include "common.h"
+#include "glushkov.h"
+#include "nfa.h"
+
+// sparse set of NFAState indices
+// membership, insertion, and clearing are all O(1), and iteration follows
+// insertion order, which is exactly what a thread list needs
+typedef struct SparseSet {
+	int *dense;
+	int *sparse;
+	int size;
+} SparseSet;
+
+typedef struct PikeVM {
+	int num_states;
+	int start;
+	int accept;
+
+	CharSet *chars;  // chars[i] is the set of chars that state i reads,
+	                 // empty if it's epsilon
+	int *outs;  // destination of each state's char transition, -1 if none
+	/*
+	Precomputed epsilon edges, stored compactly:
+		the epsilon successors of state i are
+		eps[eps_begin[i]] .. eps[eps_begin[i+1] - 1]
+	A Thompson state has at most two epsilon edges, except the fan-out
+	state of an alternation which has one per alternative, so eps is sized
+	after counting them.
+	*/
+	int *eps_begin;
+	int *eps;
+
+	// thread lists for the current and next input position
+	SparseSet *clist;
+	SparseSet *nlist;
+	int *stack;  // work stack for following epsilon edges
+} PikeVM;
+
+// simulates an epsilon-free PositionNFA, so there are no closures to follow
+typedef struct PositionVM {
+	PositionNFA *pnfa;  // not owned by the PositionVM
+	SparseSet *clist;
+	SparseSet *nlist;
+} PositionVM;
+
+SparseSet *init_sparse_set(int capacity);
+void destroy_sparse_set(SparseSet *ss);
+bool sparse_set_contains(SparseSet *ss, int i);
+void sparse_set_insert(SparseSet *ss, int i);
+void sparse_set_clear(SparseSet *ss);
+
+PikeVM *init_pikevm(NFA *nfa);
+void destroy_pikevm(PikeVM *vm);
+bool pikevm_match(PikeVM *vm, const char *input, int len);
+
+PositionVM *init_position_vm(PositionNFA *pnfa);
+void destroy_position_vm(PositionVM *vm);
+bool position_vm_match(PositionVM *vm, const char *input, int len);
+
+#endif
\ No newline at end of file
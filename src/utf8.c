@@ -0,0 +1,371 @@
+/** utf8.c
+
+Compile ranges of Unicode codepoints, like [α-ω], to automata over UTF-8 bytes.
+
+Expanding a range into one alternative per codepoint would make huge automata,
+eg [一-龥] has over 20,000 chars. Instead, the range is split so that each piece
+encodes to a fixed number of bytes, and every byte of the piece varies over a
+contiguous range independently of the others. [α-ω] is U+03B1-U+03C9, which
+becomes CE [B1-BF] | CF [80-89]. A range of any size splits into at most
+UTF8_MAX_SEQUENCES pieces.
+
+The pieces mostly differ in their first bytes and end with the same
+continuation bytes, so they're merged by their suffixes: a 3 byte range like
+[\xE1-\xEC][\x80-\xBF][\x80-\xBF] shares its last byte with every other 3 and 4
+byte piece. The automaton still reads one byte per transition, so a DFA built
+from it stays a plain byte table.
+
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "charset.h"
+#include "common.h"
+#include "utf8.h"
+
+#define SURROGATE_LO  0xD800
+#define SURROGATE_HI  0xDFFF
+
+/* utf8_length()
+	@lead           first byte of a UTF-8 char
+
+	@return         number of bytes in the char, 0 if @lead can't start one
+*/
+int utf8_length(U16 lead)
+{
+	if (lead < 0x80)
+		return 1;
+	if (0xC2 <= lead && lead <= 0xDF)
+		return 2;
+	if (0xE0 <= lead && lead <= 0xEF)
+		return 3;
+	if (0xF0 <= lead && lead <= 0xF4)
+		return 4;
+	// continuation bytes, overlong 2 byte leads, and past U+10FFFF
+	return 0;
+}
+
+/* utf8_is_continuation()
+	@byte           token or byte
+
+	@return         true if @byte is 10xxxxxx
+*/
+bool utf8_is_continuation(U16 byte)
+{
+	return 0x80 <= byte && byte <= 0xBF;
+}
+
+/* encoded_length()
+	@cp             Unicode codepoint
+
+	@return         number of bytes in the shortest encoding of @cp
+*/
+static int encoded_length(U32 cp)
+{
+	if (cp < 0x80)
+		return 1;
+	if (cp < 0x800)
+		return 2;
+	if (cp < 0x10000)
+		return 3;
+	return 4;
+}
+
+/* utf8_is_valid()
+	@cp             codepoint decoded from a UTF-8 char
+	@len            number of bytes it was decoded from
+
+	@return         true if @cp is a char and @len bytes is its shortest
+	                encoding
+*/
+bool utf8_is_valid(U32 cp, int len)
+{
+	if (cp > UTF8_MAX_CODEPOINT)
+		return false;
+	if (SURROGATE_LO <= cp && cp <= SURROGATE_HI)
+		return false;
+	return encoded_length(cp) == len;
+}
+
+/* utf8_encode()
+	@cp             Unicode codepoint, at most UTF8_MAX_CODEPOINT
+	@bytes          array of at least UTF8_MAX_BYTES bytes, receives the
+	                encoding of @cp
+
+	@return         number of bytes written
+*/
+int utf8_encode(U32 cp, U8 *bytes)
+{
+	int len = encoded_length(cp);
+	if (len == 1) {
+		bytes[0] = cp;
+		return 1;
+	}
+	for (int i = len - 1; i > 0; i--) {
+		bytes[i] = 0x80 | (cp & 0x3F);
+		cp >>= 6;
+	}
+	// 110xxxxx, 1110xxxx, or 11110xxx
+	bytes[0] = (0xF00 >> len) | cp;
+	return len;
+}
+
+// push the range of @lo to @hi
+static inline void push_range(CodepointRange *stack, int *top, U32 lo, U32 hi)
+{
+	stack[*top].lo = lo;
+	stack[*top].hi = hi;
+	(*top)++;
+}
+
+/* utf8_sequences()
+	@lo             smallest codepoint of the range
+	@hi             largest codepoint of the range, at most
+	                UTF8_MAX_CODEPOINT
+	@seqs           array of at least UTF8_MAX_SEQUENCES sequences, receives
+	                the pieces of the range in increasing order
+
+	@return         number of sequences written
+
+	Split a range of codepoints into sequences of byte ranges that match
+	exactly the UTF-8 encodings of the range. Surrogates are skipped since
+	they can't be encoded.
+
+	A piece is only a sequence once all its codepoints have the same
+	length, and any bytes before the last one that differ between its
+	bounds have their whole continuation range after them, eg U+0080-U+07FF
+	is [C2-DF][80-BF]. Otherwise the piece is cut at the first boundary
+	that fixes that, and the halves go on a stack with the lower one on
+	top, so the sequences come out in order.
+*/
+int utf8_sequences(U32 lo, U32 hi, Utf8Sequence *seqs)
+{
+	// the last code point of each encoded length except the longest
+	static const U32 max_for_length[] = {0x7F, 0x7FF, 0xFFFF};
+	CodepointRange stack[UTF8_MAX_SEQUENCES];
+	int top = 0;
+	int n = 0;
+	push_range(stack, &top, lo, hi);
+
+	U32 s, e, m, max;
+	bool split;
+	U8 s_bytes[UTF8_MAX_BYTES], e_bytes[UTF8_MAX_BYTES];
+	while (top > 0) {
+		top--;
+		s = stack[top].lo;
+		e = stack[top].hi;
+		if (s <= SURROGATE_HI && e >= SURROGATE_LO) {
+			if (e > SURROGATE_HI)
+				push_range(stack, &top, SURROGATE_HI + 1, e);
+			if (s < SURROGATE_LO)
+				push_range(stack, &top, s, SURROGATE_LO - 1);
+			continue;
+		}
+
+		split = false;
+		for (int i = 0; i < 3 && !split; i++) {
+			max = max_for_length[i];
+			if (s <= max && e > max) {
+				push_range(stack, &top, max + 1, e);
+				push_range(stack, &top, s, max);
+				split = true;
+			}
+		}
+		// m masks the bits of the last i continuation bytes
+		for (int i = 1; i < UTF8_MAX_BYTES && !split; i++) {
+			m = ((U32)1 << (6 * i)) - 1;
+			if ((s & ~m) == (e & ~m))
+				continue;
+			if (s & m) {
+				push_range(stack, &top, (s | m) + 1, e);
+				push_range(stack, &top, s, s | m);
+				split = true;
+			} else if ((e & m) != m) {
+				push_range(stack, &top, e & ~m, e);
+				push_range(stack, &top, s, (e & ~m) - 1);
+				split = true;
+			}
+		}
+		if (split)
+			continue;
+
+		seqs[n].len = utf8_encode(s, s_bytes);
+		utf8_encode(e, e_bytes);
+		for (int i = 0; i < seqs[n].len; i++) {
+			seqs[n].ranges[i].lo = s_bytes[i];
+			seqs[n].ranges[i].hi = e_bytes[i];
+		}
+		n++;
+	}
+	return n;
+}
+
+static int compare_codepoint_ranges(const void *r1, const void *r2)
+{
+	const CodepointRange *a = (const CodepointRange *)r1;
+	const CodepointRange *b = (const CodepointRange *)r2;
+	if (a->lo != b->lo)
+		return a->lo < b->lo ? -1 : 1;
+	if (a->hi != b->hi)
+		return a->hi < b->hi ? -1 : 1;
+	return 0;
+}
+
+// order sequences by their last byte range, then the one before, etc.
+static int compare_reversed(const void *s1, const void *s2)
+{
+	const Utf8Sequence *a = (const Utf8Sequence *)s1;
+	const Utf8Sequence *b = (const Utf8Sequence *)s2;
+	ByteRange ra, rb;
+	for (int i = 1; i <= a->len && i <= b->len; i++) {
+		ra = a->ranges[a->len - i];
+		rb = b->ranges[b->len - i];
+		if (ra.lo != rb.lo)
+			return ra.lo - rb.lo;
+		if (ra.hi != rb.hi)
+			return ra.hi - rb.hi;
+	}
+	return a->len - b->len;
+}
+
+/* byte_range_leaf()
+	@ast            ptr to AST struct
+	@chars          ptr to a nonempty set of bytes
+
+	@return         ptr to a literal if @chars has one byte, otherwise a
+	                class, NULL if fail
+*/
+static ASTNode *byte_range_leaf(AST *ast, const CharSet *chars)
+{
+	int ch = charset_single(chars);
+	return ch == -1 ? ast_class(ast, chars) : ast_literal(ast, ch);
+}
+
+// NULL stands for the empty prefix
+static bool same_prefix(ASTNode *lhs, ASTNode *rhs)
+{
+	if (!lhs || !rhs)
+		return lhs == rhs;
+	return ast_equal(lhs, rhs);
+}
+
+/* suffix_tree()
+	@ast            ptr to AST struct
+	@seqs           array of sequences sorted by compare_reversed(), all
+	                ending with the same @depth byte ranges
+	@num_seqs       number of sequences, at least 1, each longer than
+	                @depth
+	@depth          number of byte ranges at the end that are already
+	                matched
+
+	@return         syntax tree matching the first len - @depth bytes of
+	                every sequence, NULL if fail
+
+	Group the sequences by the byte range just before their shared suffix,
+	and build each group's prefixes recursively. Neighboring groups with
+	the same prefixes become one class, eg E0 [A0-BF] and E1 [A0-BF] would
+	be [E0-E1] [A0-BF]. The recursion is at most UTF8_MAX_BYTES deep.
+*/
+static ASTNode *suffix_tree(AST *ast, Utf8Sequence *seqs, int num_seqs,
+                            int depth)
+{
+	ASTNode *root = NULL;
+	ASTNode *prefix = NULL;   // prefixes of the pending groups
+	CharSet chars = {{0}};    // byte ranges of the pending groups
+	ASTNode *group_prefix, *leaf, *term;
+	ByteRange r, next;
+	int begin = 0, end, num_ended;
+	while (begin < num_seqs) {
+		r = seqs[begin].ranges[seqs[begin].len - 1 - depth];
+		end = begin;
+		num_ended = 0;
+		while (end < num_seqs) {
+			next = seqs[end].ranges[seqs[end].len - 1 - depth];
+			if (next.lo != r.lo || next.hi != r.hi)
+				break;
+			// sorted shortest first within the group
+			num_ended += seqs[end].len == depth + 1;
+			end++;
+		}
+
+		group_prefix = NULL;
+		if (num_ended < end - begin) {
+			group_prefix = suffix_tree(ast,
+			                           seqs + begin + num_ended,
+			                           end - begin - num_ended,
+			                           depth + 1);
+			if (group_prefix && num_ended)
+				group_prefix = ast_repeat(ast, group_prefix,
+				                          0, 1);
+			if (!group_prefix)
+				return NULL;
+		}
+
+		if (begin > 0 && same_prefix(prefix, group_prefix)) {
+			charset_add_range(&chars, r.lo, r.hi);
+		} else {
+			if (begin > 0) {
+				leaf = byte_range_leaf(ast, &chars);
+				term = leaf ? ast_concat(ast, prefix, leaf)
+				            : NULL;
+				if (!term)
+					return NULL;
+				if (!(root = ast_alt(ast, root, term)))
+					return NULL;
+			}
+			prefix = group_prefix;
+			chars = (CharSet){{0}};
+			charset_add_range(&chars, r.lo, r.hi);
+		}
+		begin = end;
+	}
+
+	if (!(leaf = byte_range_leaf(ast, &chars)))
+		return NULL;
+	term = ast_concat(ast, prefix, leaf);
+	if (!term)
+		return NULL;
+	return ast_alt(ast, root, term);
+}
+
+/* utf8_class()
+	@ast            ptr to AST struct
+	@ranges         array of codepoint ranges, gets sorted and merged
+	@num_ranges     number of ranges, at least 1
+
+	@return         syntax tree matching the UTF-8 encoding of any codepoint
+	                in @ranges, NULL if fail
+
+	Build the byte automaton of a class of Unicode chars. Overlapping and
+	adjacent ranges are merged first so the sequences don't overlap.
+*/
+ASTNode *utf8_class(AST *ast, CodepointRange *ranges, int num_ranges)
+{
+	qsort(ranges, num_ranges, sizeof(CodepointRange),
+	      compare_codepoint_ranges);
+	int merged = 0;
+	for (int i = 1; i < num_ranges; i++) {
+		if (ranges[i].lo <= ranges[merged].hi + 1) {
+			if (ranges[i].hi > ranges[merged].hi)
+				ranges[merged].hi = ranges[i].hi;
+		} else {
+			ranges[++merged] = ranges[i];
+		}
+	}
+	num_ranges = merged + 1;
+
+	Utf8Sequence *seqs = malloc(num_ranges * UTF8_MAX_SEQUENCES *
+	                            sizeof(Utf8Sequence));
+	if (!seqs)
+		return NULL;
+	int num_seqs = 0;
+	for (int i = 0; i < num_ranges; i++)
+		num_seqs += utf8_sequences(ranges[i].lo, ranges[i].hi,
+		                           seqs + num_seqs);
+	qsort(seqs, num_seqs, sizeof(Utf8Sequence), compare_reversed);
+	ASTNode *root = suffix_tree(ast, seqs, num_seqs, 0);
+	free(seqs);
+	return root;
+}
\ No newline at end of file
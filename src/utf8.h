@@ -0,0 +1,47 @@
+/** utf8.h
+
+Module definition for compiling Unicode codepoint ranges to UTF-8 byte
+automata.
+
+*/
+
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "common.h"
+
+#define UTF8_MAX_CODEPOINT  0x10FFFF
+#define UTF8_MAX_BYTES      4
+
+// most sequences utf8_sequences() can split one range into: 1 for ASCII,
+// 3 for 2 byte chars, 5 on each side of the surrogates for 3 byte chars,
+// and 7 for 4 byte chars
+#define UTF8_MAX_SEQUENCES  21
+
+typedef struct ByteRange {
+	U8 lo;
+	U8 hi;
+} ByteRange;
+
+// the byte strings whose i-th byte is in ranges[i]
+typedef struct Utf8Sequence {
+	ByteRange ranges[UTF8_MAX_BYTES];
+	int len;
+} Utf8Sequence;
+
+typedef struct CodepointRange {
+	U32 lo;
+	U32 hi;
+} CodepointRange;
+
+int utf8_length(U16 lead);
+bool utf8_is_continuation(U16 byte);
+bool utf8_is_valid(U32 cp, int len);
+int utf8_encode(U32 cp, U8 *bytes);
+int utf8_sequences(U32 lo, U32 hi, Utf8Sequence *seqs);
+ASTNode *utf8_class(AST *ast, CodepointRange *ranges, int num_ranges);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../../unity/unity.h"
+#include "ast.h"
+#include "charset.h"
+#include "control.h"
+#include "lexer.h"
+#include "nfa.h"
+#include "parser.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_arena(void)
+{
+	AST *ast = init_ast();
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_NULL(ast->blocks);
+
+	ASTNode *a = ast_literal(ast, 'a');
+	ASTNode *b = ast_literal(ast, 'b');
+	TEST_ASSERT_EQUAL_INT(2, ast->num_nodes);
+	TEST_ASSERT_EQUAL_INT(1, ast->num_blocks);
+	// nodes are bump allocated next to each other
+	TEST_ASSERT_TRUE((char *)b > (char *)a);
+	TEST_ASSERT_TRUE((char *)b - (char *)a < 2 * (int)sizeof(ASTNode));
+	TEST_ASSERT_EQUAL_INT(0, (size_t)b % sizeof(max_align_t));
+
+	// a full block starts another one
+	int per_block = AST_BLOCK_SIZE / sizeof(ASTNode);
+	for (int i = 0; i < per_block; i++)
+		ast_literal(ast, 'c');
+	TEST_ASSERT_EQUAL_INT(2, ast->num_blocks);
+	TEST_ASSERT_EQUAL_INT(per_block + 2, ast->num_nodes);
+
+	// allocations bigger than a block get their own
+	TEST_ASSERT_NOT_NULL(ast_alloc(ast, 2 * AST_BLOCK_SIZE));
+	TEST_ASSERT_EQUAL_INT(3, ast->num_blocks);
+	destroy_ast(ast);
+}
+
+void test_nodes(void)
+{
+	AST *ast = init_ast();
+	ASTNode *a = ast_literal(ast, 'a');
+	TEST_ASSERT_EQUAL_INT(AST_LITERAL, a->kind);
+	TEST_ASSERT_TRUE(ast_matches(a, 'a'));
+	TEST_ASSERT_FALSE(ast_matches(a, 'b'));
+
+	// [0-9_a-f]
+	CharSet chars = {{0x03FF000000000000, 0x0000007E80000000}};
+	ASTNode *hex = ast_class(ast, &chars);
+	TEST_ASSERT_EQUAL_INT(AST_CLASS, hex->kind);
+	TEST_ASSERT_TRUE(ast_matches(hex, '0'));
+	TEST_ASSERT_TRUE(ast_matches(hex, '_'));
+	TEST_ASSERT_TRUE(ast_matches(hex, 'f'));
+	TEST_ASSERT_FALSE(ast_matches(hex, 'g'));
+
+	ASTNode *dot = ast_wildcard(ast);
+	TEST_ASSERT_EQUAL_INT(AST_CLASS, dot->kind);
+	TEST_ASSERT_TRUE(ast_matches(dot, '\t'));
+	TEST_ASSERT_TRUE(ast_matches(dot, '\n'));
+	TEST_ASSERT_TRUE(ast_matches(dot, '~'));
+	TEST_ASSERT_FALSE(ast_matches(dot, '\r'));
+	TEST_ASSERT_FALSE(ast_matches(dot, 127));
+
+	// NULL operands pass through
+	TEST_ASSERT_EQUAL_PTR(a, ast_concat(ast, NULL, a));
+	TEST_ASSERT_EQUAL_PTR(a, ast_alt(ast, a, NULL));
+	TEST_ASSERT_NULL(ast_quantify(ast, NULL, '*'));
+	TEST_ASSERT_NULL(ast_quantify(ast, a, 'x'));
+
+	ASTNode *q = ast_quantify(ast, a, '*');
+	TEST_ASSERT_EQUAL_INT(AST_REPEAT, q->kind);
+	TEST_ASSERT_EQUAL_INT(0, q->min);
+	TEST_ASSERT_EQUAL_INT(AST_UNBOUNDED, q->max);
+	q = ast_quantify(ast, a, '?');
+	TEST_ASSERT_EQUAL_INT(0, q->min);
+	TEST_ASSERT_EQUAL_INT(1, q->max);
+	q = ast_quantify(ast, a, '+');
+	TEST_ASSERT_EQUAL_INT(1, q->min);
+	TEST_ASSERT_EQUAL_INT(AST_UNBOUNDED, q->max);
+	destroy_ast(ast);
+}
+
+void test_parse_ast(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+
+	// operators have no precedence, so this parses as (ab*|[a-cx]).
+	read_line(cc, "ab*|[a-cx].", 11);
+	AST *ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_NULL(cc->ast);
+	ASTNode *root = ast->root;
+	TEST_ASSERT_EQUAL_INT(AST_CONCAT, root->kind);
+	TEST_ASSERT_EQUAL_INT(AST_ALT, root->left->kind);
+	TEST_ASSERT_EQUAL_INT(AST_CONCAT, root->left->left->kind);
+	TEST_ASSERT_EQUAL_INT(AST_LITERAL, root->left->left->left->kind);
+	TEST_ASSERT_EQUAL_INT(AST_REPEAT, root->left->left->right->kind);
+
+	// a range is one leaf instead of a union per char
+	ASTNode *range = root->left->right;
+	TEST_ASSERT_EQUAL_INT(AST_CLASS, range->kind);
+	TEST_ASSERT_TRUE(ast_matches(range, 'b'));
+	TEST_ASSERT_TRUE(ast_matches(range, 'x'));
+	TEST_ASSERT_FALSE(ast_matches(range, 'd'));
+	TEST_ASSERT_EQUAL_INT(AST_CLASS, root->right->kind);
+	TEST_ASSERT_EQUAL_INT(4, count_positions(root));
+	// a, b, *, concat, range, alt, wildcard, concat
+	TEST_ASSERT_EQUAL_INT(8, ast->num_nodes);
+	TEST_ASSERT_EQUAL_INT(1, ast->num_blocks);
+	destroy_ast(ast);
+
+	// the whole regex fits in a few blocks
+	read_file(cc, "../../examples/c_tokens.txt");
+	ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_TRUE(ast->num_blocks <= ast->num_nodes *
+	                 (int)sizeof(ASTNode) / AST_BLOCK_SIZE + 1);
+	destroy_ast(ast);
+
+	// failed parses free their partial tree
+	read_line(cc, "ab(c|", 5);
+	TEST_ASSERT_NULL(parse_ast(cc));
+	TEST_ASSERT_NULL(cc->ast);
+	read_line(cc, "[z-a]", 5);
+	TEST_ASSERT_NULL(parse_ast(cc));
+
+	destroy_cmpctrl(cc);
+}
+
+// parse both regexes and compare their trees
+static void check_same_tree(CmpCtrl *cc, const char *lhs, const char *rhs)
+{
+	read_line(cc, lhs, strlen(lhs));
+	AST *expected = parse_ast(cc);
+	read_line(cc, rhs, strlen(rhs));
+	AST *actual = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(expected);
+	TEST_ASSERT_NOT_NULL(actual);
+	TEST_ASSERT_TRUE(ast_equal(expected->root, actual->root));
+	TEST_ASSERT_EQUAL_UINT64(ast_hash(expected->root),
+	                         ast_hash(actual->root));
+	destroy_ast(expected);
+	destroy_ast(actual);
+}
+
+void test_bounded_repeat(void)
+{
+	AST *ast = init_ast();
+	ASTNode *ab = ast_concat(ast, ast_literal(ast, 'a'),
+	                         ast_quantify(ast, ast_literal(ast, 'b'), '*'));
+	ASTNode *copy = ast_clone(ast, ab);
+	TEST_ASSERT_TRUE(ast_equal(ab, copy));
+	TEST_ASSERT_EQUAL_UINT64(ast_hash(ab), ast_hash(copy));
+	TEST_ASSERT_TRUE(ast_hash(ab) != ast_hash(ab->right));
+	TEST_ASSERT_TRUE(copy != ab && copy->left != ab->left &&
+	                 copy->right->left != ab->right->left);
+	TEST_ASSERT_EQUAL_INT(AST_UNBOUNDED, copy->right->max);
+
+	// {1} is the tree itself, {0,1} is ?, and {1,} is +
+	TEST_ASSERT_EQUAL_PTR(ab, ast_bounded_repeat(ast, ab, 1, 1));
+	ASTNode *r = ast_bounded_repeat(ast, ab, 0, 1);
+	TEST_ASSERT_EQUAL_INT(AST_REPEAT, r->kind);
+	TEST_ASSERT_EQUAL_INT(1, r->max);
+	r = ast_bounded_repeat(ast, ab, 1, AST_UNBOUNDED);
+	TEST_ASSERT_EQUAL_INT(1, r->min);
+	TEST_ASSERT_EQUAL_INT(AST_UNBOUNDED, r->max);
+	// the tree grows linearly: 100 copies of 4 nodes, 98 ?s, 99 concats
+	r = ast_bounded_repeat(ast, ab, 2, 100);
+	TEST_ASSERT_EQUAL_INT(200, count_positions(r));
+	TEST_ASSERT_EQUAL_INT(597, count_nodes(r));
+	destroy_ast(ast);
+
+	CmpCtrl *cc = init_cmpctrl();
+	check_same_tree(cc, "aa(a(a)?)?", "a{2,4}");
+	check_same_tree(cc, "aaa", "a{3}");
+	check_same_tree(cc, "aa+", "a{2,}");
+	check_same_tree(cc, "x*", "x{0,}");
+	check_same_tree(cc, "(ab|c)(ab|c)((ab|c))?", "(ab|c){2,3}");
+	check_same_tree(cc, "[a-z]([a-z])?", "[a-z]{1,2}");
+	// anything else after { is literal
+	check_same_tree(cc, "a\\{,3}", "a{,3}");
+	check_same_tree(cc, "a\\{2", "a{2");
+	check_same_tree(cc, "\\{\\}", "{}");
+	check_same_tree(cc, "a\\{2\\}", "a\\{2}");
+
+	// the counts are capped
+	read_line(cc, "a{1000}", 7);
+	ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_EQUAL_INT(1000, count_positions(ast->root));
+	destroy_ast(ast);
+	read_line(cc, "a{1001}", 7);
+	TEST_ASSERT_NULL(parse_ast(cc));
+	cc->max_repeat = 5;
+	read_line(cc, "a{2,6}", 6);
+	TEST_ASSERT_NULL(parse_ast(cc));
+	read_line(cc, "a{2,5}", 6);
+	ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	destroy_ast(ast);
+	read_line(cc, "a{99999999999}", 14);
+	TEST_ASSERT_NULL(parse_ast(cc));
+
+	destroy_cmpctrl(cc);
+}
+
+void test_ignore_case(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	check_same_tree(cc, "[Hh][Tt][Tt][Pp]", "(?i)hTtP");
+	check_same_tree(cc, "[a-cA-C_]+", "(?i)[a-c_]+");
+	check_same_tree(cc, "[Xx]|\\([Yy]\\)", "(?i)x|\\(y\\)");
+	// only a leading (?i) counts, and only for its own regex
+	check_same_tree(cc, "ab", "ab");
+	read_line(cc, "a(?i)b", 6);
+	TEST_ASSERT_NULL(parse_ast(cc));
+
+	cc->ignore_case = true;
+	check_same_tree(cc, "[Aa][Bb]", "ab");
+	check_same_tree(cc, "[Aa][Bb]", "(?i)ab");
+
+	// punctuation stays a literal
+	read_line(cc, "1", 1);
+	AST *ast = parse_ast(cc);
+	TEST_ASSERT_EQUAL_INT(AST_LITERAL, ast->root->kind);
+	destroy_ast(ast);
+	destroy_cmpctrl(cc);
+}
+
+void test_thompson(void)
+{
+	// a class is lowered to one transition, no matter how many chars
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "[a-cx]", 6);
+	AST *ast = parse_ast(cc);
+	NFA *nfa = thompson(ast->root);
+	TEST_ASSERT_NOT_NULL(nfa);
+	TEST_ASSERT_EQUAL_INT(2, nfa->size);
+	TEST_ASSERT_EQUAL_INT(CHAR_CLASS, nfa->start->ch);
+	TEST_ASSERT_EQUAL_UINT64(0, nfa->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0x0100000E00000000,
+	                         nfa->alphabet.bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, nfa->alphabet.bits[CHARS128_191]);
+	TEST_ASSERT_EQUAL_UINT64(0, nfa->alphabet.bits[CHARS192_255]);
+	destroy_nfa_and_states(nfa);
+	destroy_ast(ast);
+
+	read_line(cc, ".", 1);
+	ast = parse_ast(cc);
+	nfa = thompson(ast->root);
+	TEST_ASSERT_EQUAL_INT(2, nfa->size);
+	TEST_ASSERT_TRUE(charset_equal(&ast->root->chars, &nfa->alphabet));
+	destroy_nfa_and_states(nfa);
+	destroy_ast(ast);
+
+	destroy_cmpctrl(cc);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_arena);
+	RUN_TEST(test_nodes);
+	RUN_TEST(test_parse_ast);
+	RUN_TEST(test_bounded_repeat);
+	RUN_TEST(test_ignore_case);
+	RUN_TEST(test_thompson);
+
+	return UNITY_END();
+}
\ No newline at end of file
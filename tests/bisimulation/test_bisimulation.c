@@ -0,0 +1,164 @@
+#include <stdbool.h>
+
+#include "../../unity/unity.h"
+#include "../examples.h"
+#include "ast.h"
+#include "bisimulation.h"
+#include "control.h"
+#include "dfa.h"
+#include "glushkov.h"
+#include "minimize.h"
+#include "nfa.h"
+#include "parser.h"
+
+#define TEST_FOLLOW_HELPER(pnfa, p, expected) \
+	do { \
+		int exp[] = expected; \
+		TEST_ASSERT_EQUAL_INT(sizeof(exp)/sizeof(int), \
+		                      (pnfa)->follow[(p)].size); \
+		TEST_ASSERT_EQUAL_INT_ARRAY(exp, \
+		                            (pnfa)->follow[(p)].positions, \
+		                            sizeof(exp)/sizeof(int)); \
+	} while (0)
+
+// the preprocessor splits macro arguments on commas
+#define LIST(...) {__VA_ARGS__}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_backward(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "int|if|in", 9);
+	AST *ast = parse_ast(cc);
+	PositionNFA *pnfa = glushkov(ast->root);
+	TEST_ASSERT_EQUAL_INT(8, pnfa->size);
+
+	// each i is only reached from the start state, and both n's are only
+	// reached from an i, so it's a trie: start, i, n, t, f
+	PositionNFA *reduced = bisimulation_reduce(pnfa, BISIM_BACKWARD);
+	TEST_ASSERT_NOT_NULL(reduced);
+	TEST_ASSERT_EQUAL_INT(5, reduced->size);
+	TEST_ASSERT_EQUAL_INT('i', reduced->states[1].ch);
+	TEST_ASSERT_EQUAL_INT('n', reduced->states[2].ch);
+	TEST_ASSERT_EQUAL_INT('t', reduced->states[3].ch);
+	TEST_ASSERT_EQUAL_INT('f', reduced->states[4].ch);
+	TEST_FOLLOW_HELPER(reduced, 0, LIST(1));
+	TEST_FOLLOW_HELPER(reduced, 1, LIST(2, 4));
+	TEST_FOLLOW_HELPER(reduced, 2, LIST(3));
+	TEST_ASSERT_EQUAL_INT(0, reduced->follow[3].size);
+	TEST_ASSERT_EQUAL_INT(0, reduced->follow[4].size);
+	TEST_ASSERT_FALSE(reduced->is_accept[1]);
+	TEST_ASSERT_TRUE(reduced->is_accept[2]);
+	TEST_ASSERT_TRUE(reduced->is_accept[3]);
+	TEST_ASSERT_TRUE(reduced->is_accept[4]);
+	TEST_ASSERT_EQUAL_INT(0, gen_position_nfa_graphviz(reduced,
+	                      "dots/backward.dot"));
+	destroy_position_nfa(reduced);
+
+	// nothing has the same future, since t and f read different chars
+	reduced = bisimulation_reduce(pnfa, BISIM_FORWARD);
+	TEST_ASSERT_EQUAL_INT(8, reduced->size);
+	destroy_position_nfa(reduced);
+
+	destroy_position_nfa(pnfa);
+	destroy_ast(ast);
+	destroy_cmpctrl(cc);
+}
+
+void test_forward(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "ab|cb", 5);
+	AST *ast = parse_ast(cc);
+	PositionNFA *pnfa = glushkov(ast->root);
+	TEST_ASSERT_EQUAL_INT(5, pnfa->size);
+
+	// both b's accept and have no followers
+	PositionNFA *reduced = bisimulation_reduce(pnfa, BISIM_FORWARD);
+	TEST_ASSERT_EQUAL_INT(4, reduced->size);
+	TEST_FOLLOW_HELPER(reduced, 0, LIST(1, 3));
+	TEST_FOLLOW_HELPER(reduced, 1, LIST(2));
+	TEST_FOLLOW_HELPER(reduced, 3, LIST(2));
+	TEST_ASSERT_TRUE(reduced->is_accept[2]);
+	TEST_ASSERT_EQUAL_INT(0, gen_position_nfa_graphviz(reduced,
+	                      "dots/forward.dot"));
+	destroy_position_nfa(reduced);
+
+	// but they're reached from different states
+	reduced = bisimulation_reduce(pnfa, BISIM_BACKWARD);
+	TEST_ASSERT_EQUAL_INT(5, reduced->size);
+	destroy_position_nfa(reduced);
+	destroy_position_nfa(pnfa);
+	destroy_ast(ast);
+
+	// (ab|cb)d: the b's are forward bisimilar since both go to d
+	read_line(cc, "(xab|ycb)d|zb", 13);
+	ast = parse_ast(cc);
+	pnfa = glushkov(ast->root);
+	reduced = bisimulation_reduce(pnfa, BISIM_BOTH);
+	// start, x, y, z, a, c, b (of ab and cb), d, b (of zb)
+	TEST_ASSERT_EQUAL_INT(9, reduced->size);
+	destroy_position_nfa(reduced);
+	destroy_position_nfa(pnfa);
+	destroy_ast(ast);
+	destroy_cmpctrl(cc);
+}
+
+void test_equivalence(void)
+{
+	// the reduced automaton must minimize to the same DFA, whichever way
+	// it was reduced
+	static const int directions[] = {BISIM_FORWARD, BISIM_BACKWARD,
+	                                 BISIM_BOTH};
+	CmpCtrl *cc = init_cmpctrl();
+	AST *ast;
+	NFA *nfa;
+	PositionNFA *pnfa, *eps_free, *reduced;
+	DFA *dfa;
+	MinimalDFA *expected, *min_dfa;
+	for (int i = 0; i < NUM_EXAMPLES; i++) {
+		ast = read_example(cc, examples[i]);
+		pnfa = glushkov(ast->root);
+		dfa = convert_glushkov_to_dfa(pnfa);
+		expected = minimize(dfa);
+		destroy_dfa(dfa);
+		nfa = thompson(ast->root);
+		eps_free = remove_epsilons(nfa);
+
+		for (int d = 0; d < 6; d++) {
+			reduced = bisimulation_reduce(d < 3 ? pnfa : eps_free,
+			                              directions[d % 3]);
+			TEST_ASSERT_NOT_NULL(reduced);
+			TEST_ASSERT_TRUE(reduced->size <= pnfa->size);
+			TEST_ASSERT_TRUE(charset_equal(&pnfa->alphabet,
+			                               &reduced->alphabet));
+			dfa = convert_glushkov_to_dfa(reduced);
+			min_dfa = minimize(dfa);
+			TEST_ASSERT_EQUAL_INT(expected->size, min_dfa->size);
+			TEST_ASSERT_TRUE(same_language(expected, min_dfa));
+			destroy_minimal_dfa(min_dfa);
+			destroy_dfa(dfa);
+			destroy_position_nfa(reduced);
+		}
+
+		destroy_position_nfa(eps_free);
+		destroy_nfa_and_states(nfa);
+		destroy_minimal_dfa(expected);
+		destroy_position_nfa(pnfa);
+		destroy_ast(ast);
+	}
+	destroy_cmpctrl(cc);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_backward);
+	RUN_TEST(test_forward);
+	RUN_TEST(test_equivalence);
+
+	return UNITY_END();
+}
\ No newline at end of file
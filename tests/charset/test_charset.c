@@ -0,0 +1,125 @@
+#include <stdbool.h>
+
+#include "../../unity/unity.h"
+#include "charset.h"
+#include "common.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_charset(void)
+{
+	CharSet cs = {{0}};
+	TEST_ASSERT_TRUE(charset_is_empty(&cs));
+	TEST_ASSERT_EQUAL_INT(-1, charset_single(&cs));
+
+	charset_add(&cs, 0xFF);
+	TEST_ASSERT_TRUE(charset_has(&cs, 0xFF));
+	TEST_ASSERT_FALSE(charset_has(&cs, 0x7F));
+	TEST_ASSERT_EQUAL_UINT64(1ULL << 63, cs.bits[CHARS192_255]);
+	TEST_ASSERT_EQUAL_INT(0xFF, charset_single(&cs));
+
+	charset_add(&cs, 0);
+	TEST_ASSERT_EQUAL_INT(-1, charset_single(&cs));
+	TEST_ASSERT_EQUAL_INT(2, charset_size(&cs));
+
+	CharSet range = {{0}};
+	charset_add_range(&range, 0x70, 0x8F);
+	TEST_ASSERT_EQUAL_INT(32, charset_size(&range));
+	TEST_ASSERT_EQUAL_UINT64(0xFFFF000000000000, range.bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0x000000000000FFFF, range.bits[CHARS128_191]);
+	charset_union(&cs, &range);
+	TEST_ASSERT_EQUAL_INT(34, charset_size(&cs));
+
+	// the highest word decides the order
+	TEST_ASSERT_TRUE(charset_compare(&range, &cs) < 0);
+	TEST_ASSERT_TRUE(charset_compare(&cs, &range) > 0);
+	TEST_ASSERT_EQUAL_INT(0, charset_compare(&cs, &cs));
+	TEST_ASSERT_FALSE(charset_equal(&cs, &range));
+
+	// only ASCII letters have another case
+	CharSet folded = {{0}};
+	charset_add_range(&folded, 'X', 'c');
+	charset_add(&folded, 'z');
+	charset_add(&folded, 0xE9);
+	charset_fold_case(&folded);
+	TEST_ASSERT_EQUAL_INT(19, charset_size(&folded));
+	TEST_ASSERT_TRUE(charset_has(&folded, 'x'));
+	TEST_ASSERT_TRUE(charset_has(&folded, 'C'));
+	TEST_ASSERT_TRUE(charset_has(&folded, 'Z'));
+	TEST_ASSERT_TRUE(charset_has(&folded, '_'));
+	TEST_ASSERT_FALSE(charset_has(&folded, 'w'));
+	TEST_ASSERT_FALSE(charset_has(&folded, 'D'));
+	TEST_ASSERT_FALSE(charset_has(&folded, 0xC9));
+
+	CharSet wildcard;
+	charset_wildcard(&wildcard);
+	TEST_ASSERT_TRUE(charset_is_wildcard(&wildcard));
+	TEST_ASSERT_EQUAL_INT(97, charset_size(&wildcard));
+	TEST_ASSERT_TRUE(charset_has(&wildcard, '\n'));
+	TEST_ASSERT_FALSE(charset_has(&wildcard, 0x7F));
+	TEST_ASSERT_FALSE(charset_has(&wildcard, 0x80));
+	charset_add(&wildcard, 0x80);
+	TEST_ASSERT_FALSE(charset_is_wildcard(&wildcard));
+}
+
+void test_byte_classes(void)
+{
+	int classes[NUM_CHARS];
+
+	// no labels, no classes
+	TEST_ASSERT_EQUAL_INT(0, byte_classes(NULL, 0, classes));
+	for (int ch = 0; ch < NUM_CHARS; ch++)
+		TEST_ASSERT_EQUAL_INT(-1, classes[ch]);
+
+	// [a-z] and [m-p] split the lowercase letters in 3
+	CharSet labels[3] = {{{0}}};
+	charset_add_range(&labels[0], 'a', 'z');
+	charset_add_range(&labels[1], 'm', 'p');
+	TEST_ASSERT_EQUAL_INT(2, byte_classes(labels, 2, classes));
+	TEST_ASSERT_EQUAL_INT(0, classes['a']);
+	TEST_ASSERT_EQUAL_INT(0, classes['l']);
+	TEST_ASSERT_EQUAL_INT(1, classes['m']);
+	TEST_ASSERT_EQUAL_INT(1, classes['p']);
+	TEST_ASSERT_EQUAL_INT(0, classes['q']);
+	TEST_ASSERT_EQUAL_INT(0, classes['z']);
+	TEST_ASSERT_EQUAL_INT(-1, classes['A']);
+	TEST_ASSERT_EQUAL_INT(-1, classes[0xFF]);
+
+	// a label that's the same as a class doesn't split anything
+	labels[2] = labels[1];
+	TEST_ASSERT_EQUAL_INT(2, byte_classes(labels, 3, classes));
+
+	// classes are numbered by their smallest char, past 0x7F too
+	labels[0] = (CharSet){{0}};
+	charset_add(&labels[0], 0xFF);
+	charset_add(&labels[0], 'b');
+	labels[1] = (CharSet){{0}};
+	charset_add_range(&labels[1], 0x80, 0xFF);
+	labels[2] = (CharSet){{0}};
+	charset_add(&labels[2], 0);
+	TEST_ASSERT_EQUAL_INT(4, byte_classes(labels, 3, classes));
+	TEST_ASSERT_EQUAL_INT(0, classes[0]);
+	TEST_ASSERT_EQUAL_INT(1, classes['b']);
+	TEST_ASSERT_EQUAL_INT(2, classes[0x80]);
+	TEST_ASSERT_EQUAL_INT(2, classes[0xFE]);
+	TEST_ASSERT_EQUAL_INT(3, classes[0xFF]);
+	TEST_ASSERT_EQUAL_INT(-1, classes['a']);
+
+	// every char in its own class
+	CharSet singles[NUM_CHARS] = {{{0}}};
+	for (int ch = 0; ch < NUM_CHARS; ch++)
+		charset_add(&singles[ch], ch);
+	TEST_ASSERT_EQUAL_INT(NUM_CHARS, byte_classes(singles, NUM_CHARS,
+	                                              classes));
+	for (int ch = 0; ch < NUM_CHARS; ch++)
+		TEST_ASSERT_EQUAL_INT(ch, classes[ch]);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_charset);
+	RUN_TEST(test_byte_classes);
+	return UNITY_END();
+}
\ No newline at end of file
@@ -35,7 +35,8 @@ void test_read_file(void)
 
 	TEST_ASSERT_EQUAL_INT(0, read_file(cc, "../newlines.txt"));
 	// newlines are stripped and not counted in total length
-	TEST_ASSERT_EQUAL_INT(6, cc->buffer_len);
+	TEST_ASSERT_EQUAL_INT(7, cc->buffer_len);
+	TEST_ASSERT_EQUAL_MEMORY("abcdef.", cc->buffer, cc->buffer_len);
 
 	destroy_cmpctrl(cc);
 
@@ -47,6 +48,20 @@ void test_read_file(void)
 	destroy_cmpctrl(cc2);
 }
 
+void test_read_file_crlf(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+
+	// carriage returns are stripped along with the newlines
+	TEST_ASSERT_EQUAL_INT(0, read_file(cc, "../crlf.txt"));
+	TEST_ASSERT_EQUAL_INT(8, cc->buffer_len);
+	TEST_ASSERT_EQUAL_MEMORY("a(b|c)*d", cc->buffer, cc->buffer_len);
+
+	TEST_ASSERT_EQUAL_INT(-1, read_file(cc, "../nonexistent.txt"));
+
+	destroy_cmpctrl(cc);
+}
+
 void test_read_line(void)
 {
 	CmpCtrl *cc = init_cmpctrl();
@@ -83,6 +98,7 @@ int main(void)
 
 	RUN_TEST(test_init_cmpctrl);
 	RUN_TEST(test_read_file);
+	RUN_TEST(test_read_file_crlf);
 	RUN_TEST(test_read_line);
 
 	return UNITY_END();
@@ -0,0 +1,174 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../unity/unity.h"
+#include "ast.h"
+#include "common.h"
+#include "control.h"
+#include "counter.h"
+#include "glushkov.h"
+#include "parser.h"
+#include "simulate.h"
+
+#define MAX_INPUT_LEN 7
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static CounterNFA *parse_counter_nfa(CmpCtrl *cc, const char *regex)
+{
+	cc->keep_counts = true;
+	read_line(cc, regex, strlen(regex));
+	AST *ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	CounterNFA *cnfa = counter_nfa(ast->root);
+	TEST_ASSERT_NOT_NULL(cnfa);
+	destroy_ast(ast);
+	return cnfa;
+}
+
+void test_counter_nfa(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+
+	// the size doesn't depend on the counts
+	CounterNFA *cnfa = parse_counter_nfa(cc, "[0-9]{0,4096}");
+	TEST_ASSERT_EQUAL_INT(2, cnfa->pnfa->size);
+	TEST_ASSERT_EQUAL_INT(1, cnfa->num_counters);
+	TEST_ASSERT_EQUAL_INT(1, cnfa->min[1]);
+	TEST_ASSERT_EQUAL_INT(4096, cnfa->max[1]);
+	TEST_ASSERT_TRUE(cnfa->pnfa->is_accept[0]);
+	// counting up isn't a follow edge
+	TEST_ASSERT_EQUAL_INT(0, cnfa->pnfa->follow[1].size);
+	destroy_counter_nfa(cnfa);
+
+	cnfa = parse_counter_nfa(cc, "[A-Z]{2}-x{3,}(ab){2}y+");
+	TEST_ASSERT_EQUAL_INT(9, cnfa->pnfa->size);
+	TEST_ASSERT_EQUAL_INT(2, cnfa->num_counters);
+	TEST_ASSERT_EQUAL_INT(2, cnfa->min[1]);
+	TEST_ASSERT_EQUAL_INT(2, cnfa->max[1]);
+	TEST_ASSERT_EQUAL_INT(3, cnfa->min[3]);
+	TEST_ASSERT_EQUAL_INT(AST_UNBOUNDED, cnfa->max[3]);
+	// (ab){2} and y+ aren't counters
+	TEST_ASSERT_EQUAL_INT(0, cnfa->max[4]);
+	TEST_ASSERT_EQUAL_INT(0, cnfa->max[8]);
+	TEST_ASSERT_EQUAL_INT(0, gen_counter_nfa_graphviz(cnfa,
+	                      "dots/counters.dot"));
+	destroy_counter_nfa(cnfa);
+
+	// counts past the usual cap are fine, since nothing gets copied
+	cnfa = parse_counter_nfa(cc, ".{100000}");
+	TEST_ASSERT_EQUAL_INT(2, cnfa->pnfa->size);
+	destroy_counter_nfa(cnfa);
+	read_line(cc, "(ab){100000}", 12);
+	TEST_ASSERT_NULL(parse_ast(cc));
+
+	destroy_cmpctrl(cc);
+}
+
+// every input of up to MAX_INPUT_LEN chars from @alphabet must match the same
+// with counters as with the counts expanded
+static void check_same_matches(CmpCtrl *cc, const char *regex,
+                               const char *alphabet)
+{
+	CounterNFA *cnfa = parse_counter_nfa(cc, regex);
+	CounterVM *cvm = init_counter_vm(cnfa);
+	TEST_ASSERT_NOT_NULL(cvm);
+
+	cc->keep_counts = false;
+	read_line(cc, regex, strlen(regex));
+	AST *ast = parse_ast(cc);
+	PositionNFA *pnfa = glushkov(ast->root);
+	PositionVM *pvm = init_position_vm(pnfa);
+	TEST_ASSERT_NOT_NULL(pvm);
+
+	int base = strlen(alphabet);
+	char input[MAX_INPUT_LEN];
+	int digits[MAX_INPUT_LEN];
+	for (int len = 0; len <= MAX_INPUT_LEN; len++) {
+		memset(digits, 0, sizeof(digits));
+		for (;;) {
+			for (int i = 0; i < len; i++)
+				input[i] = alphabet[digits[i]];
+			TEST_ASSERT_EQUAL(position_vm_match(pvm, input, len),
+			                  counter_vm_match(cvm, input, len));
+			int i = 0;
+			while (i < len && ++digits[i] == base)
+				digits[i++] = 0;
+			if (i == len)
+				break;
+		}
+	}
+
+	destroy_position_vm(pvm);
+	destroy_position_nfa(pnfa);
+	destroy_ast(ast);
+	destroy_counter_vm(cvm);
+	destroy_counter_nfa(cnfa);
+}
+
+void test_counter_vm_match(void)
+{
+	const char *regexes[] = {
+		"a{3}", "a{2,4}", "a{0,2}", "a{2,}", "[ab]*a[ab]{2}",
+		"(a{2,3}b)*", "(a{2})*", "(a{2}|b)+", "a{1,2}a{2}",
+		"x[ab]{1,3}y{2,}", "(ab|a{0,2})+b", "[ab]{2,3}[ax]{0,3}"
+	};
+	CmpCtrl *cc = init_cmpctrl();
+	for (size_t i = 0; i < sizeof(regexes) / sizeof(regexes[0]); i++)
+		check_same_matches(cc, regexes[i], "abxy");
+	destroy_cmpctrl(cc);
+}
+
+void test_large_counts(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	char *input = malloc(5000);
+	TEST_ASSERT_NOT_NULL(input);
+	memset(input, '7', 5000);
+
+	CounterNFA *cnfa = parse_counter_nfa(cc, "[0-9]{0,4096},");
+	CounterVM *vm = init_counter_vm(cnfa);
+	input[4096] = ',';
+	TEST_ASSERT_TRUE(counter_vm_match(vm, input, 4097));
+	TEST_ASSERT_TRUE(counter_vm_match(vm, input + 4096, 1));
+	input[4096] = '7';
+	input[4097] = ',';
+	TEST_ASSERT_FALSE(counter_vm_match(vm, input, 4098));
+	input[4097] = '7';
+	destroy_counter_vm(vm);
+	destroy_counter_nfa(cnfa);
+
+	// a field of exactly 1000 chars
+	cnfa = parse_counter_nfa(cc, ".{1000}");
+	vm = init_counter_vm(cnfa);
+	TEST_ASSERT_TRUE(counter_vm_match(vm, input, 1000));
+	TEST_ASSERT_FALSE(counter_vm_match(vm, input, 999));
+	TEST_ASSERT_FALSE(counter_vm_match(vm, input, 1001));
+	destroy_counter_vm(vm);
+	destroy_counter_nfa(cnfa);
+
+	// a new count starts at every 7, and only the one 1000 chars before
+	// the end can finish
+	cnfa = parse_counter_nfa(cc, "[0-9]*7[0-9]{999}");
+	vm = init_counter_vm(cnfa);
+	TEST_ASSERT_TRUE(counter_vm_match(vm, input, 5000));
+	input[4000] = '1';
+	TEST_ASSERT_FALSE(counter_vm_match(vm, input, 5000));
+	TEST_ASSERT_TRUE(counter_vm_match(vm, input, 4999));
+	destroy_counter_vm(vm);
+	destroy_counter_nfa(cnfa);
+
+	free(input);
+	destroy_cmpctrl(cc);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_counter_nfa);
+	RUN_TEST(test_counter_vm_match);
+	RUN_TEST(test_large_counts);
+	return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "../../unity/unity.h"
+#include "../examples.h"
+#include "ast.h"
+#include "budget.h"
+#include "charset.h"
+#include "control.h"
+#include "derivative.h"
+#include "dfa.h"
+#include "glushkov.h"
+#include "minimize.h"
+#include "nfa.h"
+#include "parser.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_smart_constructors(void)
+{
+	TermTable *tt = init_term_table();
+	TEST_ASSERT_NOT_NULL(tt);
+	TEST_ASSERT_EQUAL_INT(2, tt->size);
+	TEST_ASSERT_FALSE(tt->empty->nullable);
+	TEST_ASSERT_TRUE(tt->epsilon->nullable);
+
+	Term *a = term_char(tt, 'a');
+	Term *b = term_char(tt, 'b');
+	Term *c = term_char(tt, 'c');
+	TEST_ASSERT_EQUAL_PTR(a, term_char(tt, 'a'));
+	TEST_ASSERT_NOT_EQUAL(a, b);
+	TEST_ASSERT_EQUAL_UINT64(0, tt->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0xE00000000, tt->alphabet.bits[CHARS64_127]);
+
+	// hash-consing
+	Term *ab = term_concat(tt, a, b);
+	TEST_ASSERT_EQUAL_PTR(ab, term_concat(tt, a, b));
+	TEST_ASSERT_EQUAL_INT(TERM_CONCAT, ab->kind);
+
+	// ∅ and ε
+	TEST_ASSERT_EQUAL_PTR(tt->empty, term_concat(tt, a, tt->empty));
+	TEST_ASSERT_EQUAL_PTR(tt->empty, term_concat(tt, tt->empty, a));
+	TEST_ASSERT_EQUAL_PTR(a, term_concat(tt, tt->epsilon, a));
+	TEST_ASSERT_EQUAL_PTR(a, term_concat(tt, a, tt->epsilon));
+	TEST_ASSERT_EQUAL_PTR(a, term_alt(tt, a, tt->empty));
+	TEST_ASSERT_EQUAL_PTR(a, term_alt(tt, tt->empty, a));
+
+	// concatenation is associative
+	TEST_ASSERT_EQUAL_PTR(term_concat(tt, term_concat(tt, a, b), c),
+	                      term_concat(tt, a, term_concat(tt, b, c)));
+
+	// alternation is associative, commutative, and idempotent
+	Term *a_b = term_alt(tt, a, b);
+	TEST_ASSERT_EQUAL_INT(TERM_ALT, a_b->kind);
+	TEST_ASSERT_EQUAL_PTR(a_b, term_alt(tt, b, a));
+	TEST_ASSERT_EQUAL_PTR(a, term_alt(tt, a, a));
+	TEST_ASSERT_EQUAL_PTR(a_b, term_alt(tt, a_b, b));
+	TEST_ASSERT_EQUAL_PTR(a_b, term_alt(tt, a, a_b));
+	Term *a_b_c = term_alt(tt, a_b, c);
+	TEST_ASSERT_EQUAL_PTR(a_b_c, term_alt(tt, a, term_alt(tt, b, c)));
+	TEST_ASSERT_EQUAL_PTR(a_b_c, term_alt(tt, term_alt(tt, c, a), b));
+	TEST_ASSERT_EQUAL_PTR(a_b_c, term_alt(tt, a_b_c, term_alt(tt, c, b)));
+	// normalized into a right-nested list sorted by id
+	TEST_ASSERT_EQUAL_PTR(a, a_b_c->left);
+	TEST_ASSERT_EQUAL_PTR(b, a_b_c->right->left);
+	TEST_ASSERT_EQUAL_PTR(c, a_b_c->right->right);
+
+	// Kleene star
+	Term *a_star = term_star(tt, a);
+	TEST_ASSERT_TRUE(a_star->nullable);
+	TEST_ASSERT_EQUAL_PTR(a_star, term_star(tt, a_star));
+	TEST_ASSERT_EQUAL_PTR(tt->epsilon, term_star(tt, tt->epsilon));
+	TEST_ASSERT_EQUAL_PTR(tt->epsilon, term_star(tt, tt->empty));
+
+	// nullable
+	TEST_ASSERT_FALSE(ab->nullable);
+	TEST_ASSERT_FALSE(term_concat(tt, a_star, b)->nullable);
+	TEST_ASSERT_TRUE(term_alt(tt, a_star, b)->nullable);
+	TEST_ASSERT_TRUE(term_concat(tt, a_star, a_star)->nullable);
+
+	destroy_term_table(tt);
+}
+
+void test_term_from_ast(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	TermTable *tt = init_term_table();
+
+	// the same language written differently gives the same term
+	read_line(cc, "(a|b)|c", 7);
+	AST *ast = parse_ast(cc);
+	Term *t1 = term_from_ast(tt, ast->root);
+	destroy_ast(ast);
+	read_line(cc, "c|(b|a)", 7);
+	ast = parse_ast(cc);
+	Term *t2 = term_from_ast(tt, ast->root);
+	destroy_ast(ast);
+	TEST_ASSERT_EQUAL_PTR(t1, t2);
+
+	// r+ = rr*
+	read_line(cc, "a+", 2);
+	ast = parse_ast(cc);
+	t1 = term_from_ast(tt, ast->root);
+	destroy_ast(ast);
+	read_line(cc, "aa*", 3);
+	ast = parse_ast(cc);
+	t2 = term_from_ast(tt, ast->root);
+	destroy_ast(ast);
+	TEST_ASSERT_EQUAL_PTR(t1, t2);
+
+	// r? = ε|r
+	read_line(cc, "a?", 2);
+	ast = parse_ast(cc);
+	t1 = term_from_ast(tt, ast->root);
+	destroy_ast(ast);
+	TEST_ASSERT_EQUAL_PTR(term_alt(tt, tt->epsilon, term_char(tt, 'a')),
+	                      t1);
+	TEST_ASSERT_TRUE(t1->nullable);
+
+	destroy_term_table(tt);
+	destroy_cmpctrl(cc);
+}
+
+void test_derivative(void)
+{
+	TermTable *tt = init_term_table();
+	Term *a = term_char(tt, 'a');
+	Term *b = term_char(tt, 'b');
+	Term *b_star = term_star(tt, b);
+	Term *ab_star = term_concat(tt, a, b_star);
+
+	TEST_ASSERT_EQUAL_PTR(tt->epsilon, derivative(tt, a, 'a'));
+	TEST_ASSERT_EQUAL_PTR(tt->empty, derivative(tt, a, 'b'));
+	TEST_ASSERT_EQUAL_PTR(tt->empty, derivative(tt, tt->epsilon, 'a'));
+	TEST_ASSERT_EQUAL_PTR(tt->empty, derivative(tt, tt->empty, 'a'));
+
+	// d/da ab* = b*
+	TEST_ASSERT_EQUAL_PTR(b_star, derivative(tt, ab_star, 'a'));
+	TEST_ASSERT_EQUAL_PTR(tt->empty, derivative(tt, ab_star, 'b'));
+	// d/db b* = b*
+	TEST_ASSERT_EQUAL_PTR(b_star, derivative(tt, b_star, 'b'));
+
+	// d/db b*ab = d/db(b*)ab | d/db(ab) = b*ab
+	Term *b_star_ab = term_concat(tt, b_star, term_concat(tt, a, b));
+	TEST_ASSERT_EQUAL_PTR(b_star_ab, derivative(tt, b_star_ab, 'b'));
+	// d/da b*ab = b
+	TEST_ASSERT_EQUAL_PTR(b, derivative(tt, b_star_ab, 'a'));
+
+	// memoized
+	TEST_ASSERT_NOT_NULL(b_star_ab->derivs);
+	TEST_ASSERT_EQUAL_PTR(b, b_star_ab->derivs[tt->mappings['a']]);
+
+	destroy_term_table(tt);
+}
+
+void test_derivative_dfa(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	TermTable *tt = init_term_table();
+	read_line(cc, "(a|b)*abb", 9);
+	AST *ast = parse_ast(cc);
+	Term *term = term_from_ast(tt, ast->root);
+	DFA *dfa = derivative_dfa(tt, term);
+	TEST_ASSERT_NOT_NULL(dfa);
+
+	// (a|b)*abb, (a|b)*abb|bb, (a|b)*abb|b, (a|b)*abb|ε
+	// which is already minimal
+	TEST_ASSERT_EQUAL_INT(4, dfa->size);
+	TEST_ASSERT_EQUAL_INT(1, dfa->accepts->size);
+	TEST_ASSERT_EQUAL_INT(0, dfa->start->index);
+	TEST_ASSERT_FALSE(dfa->start->is_accept);
+	// d0 -a-> d1, d0 -b-> d0
+	TEST_ASSERT_EQUAL_INT(1, dfa->delta[0][dfa->mappings['a']]);
+	TEST_ASSERT_EQUAL_INT(0, dfa->delta[0][dfa->mappings['b']]);
+	for (int i = 0; i < dfa->size; i++) {
+		TEST_ASSERT_EQUAL_INT(i, dfa->states[i]->index);
+		TEST_ASSERT_EQUAL_INT(1, dfa->delta[i][dfa->mappings['a']]);
+	}
+	TEST_ASSERT_EQUAL_INT(0, gen_dfa_graphviz(dfa,
+	                      "dots/derivative_abb.dot", false));
+
+	MinimalDFA *min_dfa = minimize(dfa);
+	TEST_ASSERT_EQUAL_INT(4, min_dfa->size);
+	destroy_minimal_dfa(min_dfa);
+	destroy_dfa(dfa);
+
+	Budget *budget = init_budget(3, 0);
+	TEST_ASSERT_NULL(bounded_derivative_dfa(tt, term, budget));
+	TEST_ASSERT_EQUAL_INT(BUDGET_STATES_EXCEEDED, budget->status);
+	destroy_budget(budget);
+
+	destroy_ast(ast);
+	destroy_term_table(tt);
+	destroy_cmpctrl(cc);
+}
+
+void test_classes(void)
+{
+	// a class is a single leaf, differentiated once per byte class
+	CmpCtrl *cc = init_cmpctrl();
+	TermTable *tt = init_term_table();
+	read_line(cc, "[a-z]*x", 7);
+	AST *ast = parse_ast(cc);
+	Term *term = term_from_ast(tt, ast->root);
+	TEST_ASSERT_NOT_NULL(term);
+	TEST_ASSERT_EQUAL_INT(TERM_CONCAT, term->kind);
+	TEST_ASSERT_EQUAL_INT(TERM_STAR, term->left->kind);
+	TEST_ASSERT_EQUAL_INT(TERM_CLASS, term->left->left->kind);
+	TEST_ASSERT_EQUAL_INT(26, charset_size(&term->left->left->chars));
+
+	// d/dq [a-z]*x = [a-z]*x, and x has a class of its own
+	TEST_ASSERT_EQUAL_PTR(term, derivative(tt, term, 'q'));
+	TEST_ASSERT_EQUAL_INT(2, tt->num_classes);
+	TEST_ASSERT_EQUAL_INT(tt->mappings['a'], tt->mappings['z']);
+	TEST_ASSERT_NOT_EQUAL(tt->mappings['a'], tt->mappings['x']);
+	TEST_ASSERT_EQUAL_INT(-1, tt->mappings['A']);
+	TEST_ASSERT_EQUAL_PTR(tt->empty, derivative(tt, term, 'A'));
+
+	// [a-z]*x, [a-z]*x|ε
+	DFA *dfa = derivative_dfa(tt, term);
+	TEST_ASSERT_NOT_NULL(dfa);
+	TEST_ASSERT_EQUAL_INT(2, dfa->alphabet_size);
+	TEST_ASSERT_EQUAL_INT(2, dfa->size);
+	destroy_dfa(dfa);
+
+	// m gets a class of its own, which drops the memoized derivatives
+	Term *m = term_char(tt, 'm');
+	TEST_ASSERT_EQUAL_PTR(tt->epsilon, derivative(tt, m, 'm'));
+	TEST_ASSERT_EQUAL_INT(3, tt->num_classes);
+	TEST_ASSERT_NULL(term->derivs);
+	TEST_ASSERT_EQUAL_PTR(term, derivative(tt, term, 'm'));
+	TEST_ASSERT_EQUAL_PTR(term, term->derivs[tt->mappings['m']]);
+
+	destroy_ast(ast);
+	destroy_term_table(tt);
+	destroy_cmpctrl(cc);
+}
+
+void test_one_state(void)
+{
+	// every derivative of these is the regex itself
+	const char *regexes[] = {"a*", "(a|b)*"};
+	CmpCtrl *cc = init_cmpctrl();
+	for (int i = 0; i < 2; i++) {
+		read_line(cc, regexes[i], strlen(regexes[i]));
+		AST *ast = parse_ast(cc);
+		TermTable *tt = init_term_table();
+		DFA *dfa = derivative_dfa(tt, term_from_ast(tt, ast->root));
+		TEST_ASSERT_NOT_NULL(dfa);
+		TEST_ASSERT_EQUAL_INT(1, dfa->size);
+		MinimalDFA *min_dfa = minimize(dfa);
+		TEST_ASSERT_NOT_NULL(min_dfa);
+		TEST_ASSERT_EQUAL_INT(1, min_dfa->size);
+		TEST_ASSERT_NOT_NULL(min_dfa->start);
+		TEST_ASSERT_EQUAL_INT(0, min_dfa->start->index);
+		TEST_ASSERT_TRUE(min_dfa->start->is_accept);
+		destroy_minimal_dfa(min_dfa);
+		destroy_dfa(dfa);
+		destroy_term_table(tt);
+		destroy_ast(ast);
+	}
+	destroy_cmpctrl(cc);
+}
+
+void test_equivalence(void)
+{
+	// derivatives must minimize to the same DFA as the other constructions
+	CmpCtrl *cc = init_cmpctrl();
+	AST *ast;
+	TermTable *tt;
+	PositionNFA *pnfa;
+	Term *term;
+	DFA *derivative_result, *glushkov_result;
+	MinimalDFA *derivative_min, *glushkov_min;
+	for (int i = 0; i < NUM_EXAMPLES; i++) {
+		ast = read_example(cc, examples[i]);
+		tt = init_term_table();
+		term = term_from_ast(tt, ast->root);
+		pnfa = glushkov(ast->root);
+		TEST_ASSERT_TRUE(charset_equal(&pnfa->alphabet,
+		                               &tt->alphabet));
+		derivative_result = derivative_dfa(tt, term);
+		glushkov_result = convert_glushkov_to_dfa(pnfa);
+		TEST_ASSERT_TRUE(derivative_result->size <=
+		                 glushkov_result->size);
+
+		derivative_min = minimize(derivative_result);
+		glushkov_min = minimize(glushkov_result);
+		TEST_ASSERT_EQUAL_INT(glushkov_min->size, derivative_min->size);
+		TEST_ASSERT_TRUE(same_language(glushkov_min, derivative_min));
+
+		destroy_minimal_dfa(derivative_min);
+		destroy_minimal_dfa(glushkov_min);
+		destroy_dfa(derivative_result);
+		destroy_dfa(glushkov_result);
+		destroy_position_nfa(pnfa);
+		destroy_term_table(tt);
+		destroy_ast(ast);
+	}
+	destroy_cmpctrl(cc);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_smart_constructors);
+	RUN_TEST(test_term_from_ast);
+	RUN_TEST(test_derivative);
+	RUN_TEST(test_derivative_dfa);
+	RUN_TEST(test_classes);
+	RUN_TEST(test_one_state);
+	RUN_TEST(test_equivalence);
+
+	return UNITY_END();
+}
\ No newline at end of file
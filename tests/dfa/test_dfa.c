@@ -1,6 +1,7 @@
 #include <stdbool.h>
 
 #include "../../unity/unity.h"
+#include "budget.h"
 #include "control.h"
 #include "dfa.h"
 #include "nfa.h"
@@ -233,7 +234,8 @@ void test_subset(void)
 	d0 = dfa->start;
 	TEST_ASSERT_NOT_NULL(d0->outs[dfa->mappings['w']]);
 	TEST_ASSERT_EACH_EQUAL_PTR(NULL, d0->outs, 6);
-	TEST_ASSERT_EQUAL_INT(5, d0->constituent_nfastates->size);
+	// one fan-out state and the start of each alternative
+	TEST_ASSERT_EQUAL_INT(4, d0->constituent_nfastates->size);
 	TEST_ASSERT_FALSE(set_find(dfa->accepts, d0));
 
 	d1 = d0->outs[dfa->mappings['w']];
@@ -348,7 +350,7 @@ void test_subset(void)
 void test_convert_nfa_to_dfa(void)
 {
 	CmpCtrl *cc = init_cmpctrl();
-	read_line(cc, "abc|[xb]*", 9);
+	read_line(cc, "abc|(x|b)*", 10);
 	NFA *nfa = parse(cc);
 	DFA *dfa = convert_nfa_to_dfa(nfa);
 
@@ -381,6 +383,19 @@ void test_convert_nfa_to_dfa(void)
 	TEST_ASSERT_EQUAL_INT_ARRAY(expected3, dfa->delta[3], 4);
 	TEST_ASSERT_EQUAL_INT_ARRAY(expected4, dfa->delta[4], 4);
 	TEST_ASSERT_EQUAL_INT_ARRAY(expected5, dfa->delta[5], 4);
+	destroy_nfa_and_states(nfa);
+	destroy_dfa(dfa);
+
+	// a range reads b and x on the same transition, so states 2 and 3
+	// above merge
+	read_line(cc, "abc|[xb]*", 9);
+	nfa = parse(cc);
+	dfa = convert_nfa_to_dfa(nfa);
+	TEST_ASSERT_EQUAL_INT(5, dfa->size);
+	int bx = dfa->delta[0][1];
+	TEST_ASSERT_EQUAL_INT(bx, dfa->delta[0][3]);
+	TEST_ASSERT_EQUAL_INT(bx, dfa->delta[bx][1]);
+	TEST_ASSERT_EQUAL_INT(bx, dfa->delta[bx][3]);
 
 	destroy_nfa_and_states(nfa);
 	destroy_dfa(dfa);
@@ -505,6 +520,83 @@ void test_gen_graphviz(void)
 	destroy_dfa(dfa);
 }
 
+void test_bounded_subset(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "abc|(x|b)*", 10);
+	NFA *nfa = parse(cc);
+	index_states(nfa);
+
+	// the DFA has 6 states, see test_convert_nfa_to_dfa()
+	Budget *budget = init_budget(6, 0);
+	DFA *dfa = bounded_subset(nfa, budget);
+	TEST_ASSERT_NOT_NULL(dfa);
+	TEST_ASSERT_EQUAL_INT(6, dfa->size);
+	TEST_ASSERT_EQUAL_INT(6, budget->states_used);
+	TEST_ASSERT_EQUAL_INT(BUDGET_OK, budget->status);
+	TEST_ASSERT_EQUAL_PTR(budget, dfa->budget);
+	destroy_dfa(dfa);
+	destroy_budget(budget);
+
+	budget = init_budget(5, 0);
+	dfa = bounded_subset(nfa, budget);
+	TEST_ASSERT_NULL(dfa);
+	TEST_ASSERT_EQUAL_INT(BUDGET_STATES_EXCEEDED, budget->status);
+	destroy_budget(budget);
+
+	// not even the DFA struct itself fits
+	budget = init_budget(0, 1);
+	dfa = bounded_subset(nfa, budget);
+	TEST_ASSERT_NULL(dfa);
+	TEST_ASSERT_EQUAL_INT(BUDGET_BYTES_EXCEEDED, budget->status);
+
+	// reusing an exceeded budget fails until it's reset
+	budget->max_bytes = 1000000;
+	TEST_ASSERT_NULL(bounded_subset(nfa, budget));
+	reset_budget(budget);
+	dfa = bounded_convert_nfa_to_dfa(nfa, budget);
+	TEST_ASSERT_NOT_NULL(dfa);
+	TEST_ASSERT_NOT_NULL(dfa->delta);
+	TEST_ASSERT_TRUE(budget->bytes_used > 0);
+	TEST_ASSERT_EQUAL_INT(BUDGET_OK, budget->status);
+	destroy_dfa(dfa);
+
+	// the subset DFA fits but the transition table doesn't
+	reset_budget(budget);
+	dfa = bounded_subset(nfa, budget);
+	size_t subset_bytes = budget->bytes_used;
+	destroy_dfa(dfa);
+	budget->max_bytes = subset_bytes + 1;
+	reset_budget(budget);
+	TEST_ASSERT_NULL(bounded_convert_nfa_to_dfa(nfa, budget));
+	TEST_ASSERT_EQUAL_INT(BUDGET_BYTES_EXCEEDED, budget->status);
+	destroy_budget(budget);
+	destroy_nfa_and_states(nfa);
+
+	// (a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)(a|b) needs 2^7 DFA states
+	read_line(cc, "(a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)", 37);
+	nfa = parse(cc);
+	index_states(nfa);
+	budget = init_budget(100, 0);
+	TEST_ASSERT_NULL(bounded_subset(nfa, budget));
+	TEST_ASSERT_EQUAL_INT(BUDGET_STATES_EXCEEDED, budget->status);
+	TEST_ASSERT_EQUAL_INT(101, budget->states_used);
+	destroy_budget(budget);
+	destroy_nfa_and_states(nfa);
+
+	// NULL budget is unlimited
+	read_line(cc, "abc|(x|b)*", 10);
+	nfa = parse(cc);
+	index_states(nfa);
+	dfa = bounded_subset(nfa, NULL);
+	TEST_ASSERT_NOT_NULL(dfa);
+	TEST_ASSERT_EQUAL_INT(6, dfa->size);
+	destroy_dfa(dfa);
+	destroy_nfa_and_states(nfa);
+
+	destroy_cmpctrl(cc);
+}
+
 int main(void)
 {
 	UNITY_BEGIN();
@@ -514,6 +606,7 @@ int main(void)
 	RUN_TEST(test_subset);
 	RUN_TEST(test_convert_nfa_to_dfa);
 	RUN_TEST(test_gen_graphviz);
+	RUN_TEST(test_bounded_subset);
 
 	return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../unity/unity.h"
+#include "budget.h"
+#include "charset.h"
+#include "control.h"
+#include "dfa.h"
+#include "dictionary.h"
+#include "minimize.h"
+#include "nfa.h"
+#include "parser.h"
+
+// every 4 digit number, so the minimal DFA is just 5 states in a row
+#define NUM_NUMBERS 10000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define ADD_WORD(dict, word) \
+	dictionary_add_word((dict), (const U8 *)(word), strlen((word)))
+
+#define CONTAINS(dict, word) \
+	dictionary_contains((dict), (const U8 *)(word), strlen((word)))
+
+// contents of a whole file, which the caller frees
+static char *read_whole_file(const char *file_name)
+{
+	FILE *f = fopen(file_name, "rb");
+	TEST_ASSERT_NOT_NULL(f);
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	rewind(f);
+	char *contents = calloc(len + 1, 1);
+	TEST_ASSERT_NOT_NULL(contents);
+	TEST_ASSERT_EQUAL_INT(len, fread(contents, 1, len, f));
+	fclose(f);
+	return contents;
+}
+
+// gen_dictionary_graphviz() must write the same file as going through the
+// MinimalDFA does
+static void check_graphviz(Dictionary *dict, const char *file_name)
+{
+	MinimalDFA *min_dfa = dictionary_to_minimal_dfa(dict, NULL);
+	TEST_ASSERT_NOT_NULL(min_dfa);
+	TEST_ASSERT_EQUAL_INT(0, gen_minimal_dfa_graphviz(min_dfa, file_name));
+	char *expected = read_whole_file(file_name);
+	TEST_ASSERT_EQUAL_INT(0, gen_dictionary_graphviz(dict, file_name));
+	char *actual = read_whole_file(file_name);
+	TEST_ASSERT_EQUAL_STRING(expected, actual);
+	free(expected);
+	free(actual);
+	destroy_minimal_dfa(min_dfa);
+}
+
+void test_add_word(void)
+{
+	Dictionary *dict = init_dictionary();
+	TEST_ASSERT_NOT_NULL(dict);
+	TEST_ASSERT_EQUAL_INT(1, dict->size);
+
+	TEST_ASSERT_EQUAL_INT(DICT_SUCCESS, ADD_WORD(dict, "tap"));
+	TEST_ASSERT_EQUAL_INT(DICT_SUCCESS, ADD_WORD(dict, "taps"));
+	TEST_ASSERT_EQUAL_INT(DICT_SUCCESS, ADD_WORD(dict, "top"));
+	TEST_ASSERT_EQUAL_INT(DICT_SUCCESS, ADD_WORD(dict, "top"));
+	TEST_ASSERT_EQUAL_INT(DICT_SUCCESS, ADD_WORD(dict, "tops"));
+	TEST_ASSERT_EQUAL_INT(DICT_SUCCESS, ADD_WORD(dict, ""));
+	TEST_ASSERT_EQUAL_INT(4, dict->num_words);
+	TEST_ASSERT_EQUAL_INT(6, dict->num_lines);
+
+	TEST_ASSERT_EQUAL_INT(DICT_UNSORTED, ADD_WORD(dict, "tap"));
+	TEST_ASSERT_EQUAL_INT(DICT_UNSORTED, ADD_WORD(dict, "to"));
+	TEST_ASSERT_EQUAL_INT(4, dict->num_words);
+
+	TEST_ASSERT_TRUE(finish_dictionary(dict));
+	TEST_ASSERT_EQUAL_INT(DICT_ERROR, ADD_WORD(dict, "zzz"));
+
+	// t -> [ao] -> p -> s, where p and s accept
+	TEST_ASSERT_EQUAL_INT(5, dict->size);
+	TEST_ASSERT_TRUE(CONTAINS(dict, "tap"));
+	TEST_ASSERT_TRUE(CONTAINS(dict, "taps"));
+	TEST_ASSERT_TRUE(CONTAINS(dict, "top"));
+	TEST_ASSERT_TRUE(CONTAINS(dict, "tops"));
+	TEST_ASSERT_FALSE(CONTAINS(dict, "ta"));
+	TEST_ASSERT_FALSE(CONTAINS(dict, "tip"));
+	TEST_ASSERT_FALSE(CONTAINS(dict, "topss"));
+	TEST_ASSERT_FALSE(CONTAINS(dict, ""));
+	destroy_dictionary(dict);
+
+	// every byte is a valid char
+	dict = init_dictionary();
+	TEST_ASSERT_EQUAL_INT(DICT_SUCCESS, ADD_WORD(dict, "caf\xc3\xa9"));
+	TEST_ASSERT_EQUAL_INT(DICT_SUCCESS, ADD_WORD(dict, "tu\x80"));
+	TEST_ASSERT_EQUAL_INT(DICT_SUCCESS, ADD_WORD(dict, "tu\xff"));
+	TEST_ASSERT_TRUE(finish_dictionary(dict));
+	TEST_ASSERT_TRUE(CONTAINS(dict, "tu\xff"));
+	TEST_ASSERT_FALSE(CONTAINS(dict, "tu\x7f"));
+	check_graphviz(dict, "dots/high_bytes.dot");
+	destroy_dictionary(dict);
+
+	// the unfinished path gets freed too
+	dict = init_dictionary();
+	ADD_WORD(dict, "unfinished");
+	destroy_dictionary(dict);
+}
+
+void test_minimal(void)
+{
+	// the dictionary must be exactly as big as the minimized DFA of the
+	// same words as a regex
+	Dictionary *dict = init_dictionary();
+	TEST_ASSERT_EQUAL_INT(DICT_SUCCESS,
+	                      read_dictionary(dict, "../../examples/keywords.txt"));
+	TEST_ASSERT_TRUE(CONTAINS(dict, "auto"));
+	TEST_ASSERT_TRUE(CONTAINS(dict, "while"));
+	TEST_ASSERT_TRUE(CONTAINS(dict, "do"));
+	TEST_ASSERT_TRUE(CONTAINS(dict, "double"));
+	TEST_ASSERT_FALSE(CONTAINS(dict, "dou"));
+
+	char regex[1024];
+	int len = 0;
+	FILE *f = fopen("../../examples/keywords.txt", "r");
+	TEST_ASSERT_NOT_NULL(f);
+	int c;
+	while ((c = fgetc(f)) != EOF)
+		regex[len++] = c == '\n' ? '|' : c;
+	fclose(f);
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, regex, len - 1);  // drop the last |
+	NFA *nfa = parse(cc);
+	DFA *dfa = convert_nfa_to_dfa(nfa);
+	MinimalDFA *expected = minimize(dfa);
+	TEST_ASSERT_EQUAL_INT(expected->size, dict->size);
+
+	MinimalDFA *min_dfa = dictionary_to_minimal_dfa(dict, NULL);
+	TEST_ASSERT_NOT_NULL(min_dfa);
+	TEST_ASSERT_EQUAL_INT(expected->size, min_dfa->size);
+	TEST_ASSERT_EQUAL_INT(expected->accepts->size, min_dfa->accepts->size);
+	TEST_ASSERT_EQUAL_INT(0, min_dfa->start->index);
+	int edges = 0;
+	int expected_edges = 0;
+	for (int i = 0; i < min_dfa->size; i++) {
+		for (int j = 0; j < min_dfa->size; j++) {
+			edges += !charset_is_empty(&min_dfa->delta[i][j]);
+			expected_edges +=
+				!charset_is_empty(&expected->delta[i][j]);
+		}
+	}
+	TEST_ASSERT_EQUAL_INT(expected_edges, edges);
+	check_graphviz(dict, "dots/keywords.dot");
+
+	// the states are only numbered for the conversion
+	destroy_minimal_dfa(min_dfa);
+	min_dfa = dictionary_to_minimal_dfa(dict, NULL);
+	TEST_ASSERT_EQUAL_INT(expected->size, min_dfa->size);
+
+	destroy_minimal_dfa(min_dfa);
+	destroy_minimal_dfa(expected);
+	destroy_dfa(dfa);
+	destroy_nfa_and_states(nfa);
+	destroy_cmpctrl(cc);
+	destroy_dictionary(dict);
+
+	dict = init_dictionary();
+	TEST_ASSERT_EQUAL_INT(DICT_ERROR, read_dictionary(dict, "nonexistent"));
+	destroy_dictionary(dict);
+}
+
+void test_large(void)
+{
+	Dictionary *dict = init_dictionary();
+	char word[8];
+	for (int i = 0; i < NUM_NUMBERS; i++) {
+		sprintf(word, "%04d", i);
+		TEST_ASSERT_EQUAL_INT(DICT_SUCCESS, ADD_WORD(dict, word));
+	}
+	TEST_ASSERT_TRUE(finish_dictionary(dict));
+	TEST_ASSERT_EQUAL_INT(5, dict->size);
+	TEST_ASSERT_TRUE(CONTAINS(dict, "0420"));
+	TEST_ASSERT_FALSE(CONTAINS(dict, "042"));
+
+	// the transition table doesn't fit in the budget
+	Budget *budget = init_budget(4, 0);
+	TEST_ASSERT_NULL(dictionary_to_minimal_dfa(dict, budget));
+	TEST_ASSERT_EQUAL_INT(BUDGET_STATES_EXCEEDED, budget->status);
+	destroy_budget(budget);
+	destroy_dictionary(dict);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_add_word);
+	RUN_TEST(test_minimal);
+	RUN_TEST(test_large);
+	return UNITY_END();
+}
\ No newline at end of file
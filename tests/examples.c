@@ -0,0 +1,158 @@
+/** examples.c
+
+The examples every construction must agree on, and a check that two minimal
+DFAs accept the same language.
+
+Comparing state and accept counts lets two different automata of the same
+shape through, so same_language() walks the product of both DFAs instead: the
+languages differ iff some pair of states reachable on the same input has one
+accepting and the other not.
+
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../unity/unity.h"
+#include "examples.h"
+#include "parser.h"
+
+const char *examples[NUM_EXAMPLES] = {
+	"../../examples/abc.txt",
+	"../../examples/abcdefxyz.txt",
+	"../../examples/c_ident.txt",
+	"../../examples/c_tokens.txt",
+	"../../examples/matchall.txt",
+	"../../examples/range.txt",
+	"../../examples/there.txt",
+	"../../examples/wildcard.txt",
+	"../../examples/keywords.txt"
+};
+
+/* read_example()
+	@cc             ptr to CmpCtrl struct
+	@file_name      example file
+
+	@return         ptr to the example's syntax tree
+
+	The word list is turned into one big alternation, like it would be
+	without -w.
+*/
+AST *read_example(CmpCtrl *cc, const char *file_name)
+{
+	if (!strstr(file_name, "keywords")) {
+		TEST_ASSERT_EQUAL_INT(0, read_file(cc, file_name));
+	} else {
+		FILE *f = fopen(file_name, "r");
+		TEST_ASSERT_NOT_NULL(f);
+		char regex[1024];
+		int len = 0;
+		int c;
+		while ((c = fgetc(f)) != EOF)
+			regex[len++] = c == '\n' ? '|' : c;
+		fclose(f);
+		read_line(cc, regex, len - 1);  // drop the last |
+	}
+	AST *ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	return ast;
+}
+
+/* dense_table()
+	@min_dfa        ptr to MinimalDFA struct
+
+	@return         table of size (min_dfa->size + 1) * NUM_CHARS
+
+	next[s * NUM_CHARS + ch] is the state s goes to on ch. Missing
+	transitions go to an extra dead state, numbered min_dfa->size.
+*/
+static int *dense_table(MinimalDFA *min_dfa)
+{
+	int n = min_dfa->size;
+	int *next = malloc((size_t)(n + 1) * NUM_CHARS * sizeof(int));
+	TEST_ASSERT_NOT_NULL(next);
+	for (int i = 0; i < (n + 1) * NUM_CHARS; i++)
+		next[i] = n;
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			for (int ch = 0; ch < NUM_CHARS; ch++) {
+				if (charset_has(&min_dfa->delta[i][j], ch))
+					next[i * NUM_CHARS + ch] = j;
+			}
+		}
+	}
+	return next;
+}
+
+/* accepting()
+	@min_dfa        ptr to MinimalDFA struct
+
+	@return         array of size min_dfa->size + 1, the dead state last
+*/
+static bool *accepting(MinimalDFA *min_dfa)
+{
+	bool *is_accept = calloc(min_dfa->size + 1, sizeof(bool));
+	TEST_ASSERT_NOT_NULL(is_accept);
+	Iterator *it = set_begin(min_dfa->accepts);
+	for (; it; advance_iter(&it))
+		is_accept[((MinimalDFAState *)it->element)->index] = true;
+	return is_accept;
+}
+
+/* same_language()
+	@a              ptr to MinimalDFA struct
+	@b              ptr to MinimalDFA struct
+
+	@return         whether a and b accept exactly the same strings
+
+	Breadth-first search over the pairs of states that a and b reach on the
+	same input, starting from both start states. Each pair is visited at
+	most once, so this takes O(a->size * b->size * NUM_CHARS) time.
+*/
+bool same_language(MinimalDFA *a, MinimalDFA *b)
+{
+	if (a->anchored_end != b->anchored_end)
+		return false;
+	int na = a->size + 1;  // the dead state included
+	int nb = b->size + 1;
+	int *next_a = dense_table(a);
+	int *next_b = dense_table(b);
+	bool *accept_a = accepting(a);
+	bool *accept_b = accepting(b);
+	bool *visited = calloc((size_t)na * nb, sizeof(bool));
+	int *queue = malloc((size_t)na * nb * sizeof(int));
+	TEST_ASSERT_NOT_NULL(visited);
+	TEST_ASSERT_NOT_NULL(queue);
+
+	bool same = true;
+	int head = 0, tail = 0;
+	int pair = a->start->index * nb + b->start->index;
+	visited[pair] = true;
+	queue[tail++] = pair;
+	while (head < tail) {
+		int p = queue[head] / nb;
+		int q = queue[head++] % nb;
+		if (accept_a[p] != accept_b[q]) {
+			same = false;
+			break;
+		}
+		for (int ch = 0; ch < NUM_CHARS; ch++) {
+			pair = next_a[p * NUM_CHARS + ch] * nb +
+			       next_b[q * NUM_CHARS + ch];
+			if (!visited[pair]) {
+				visited[pair] = true;
+				queue[tail++] = pair;
+			}
+		}
+	}
+
+	free(queue);
+	free(visited);
+	free(accept_b);
+	free(accept_a);
+	free(next_b);
+	free(next_a);
+	return same;
+}
\ No newline at end of file
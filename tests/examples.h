@@ -0,0 +1,23 @@
+/** examples.h
+
+Module definition for the examples shared by the equivalence tests.
+
+*/
+
+#ifndef EXAMPLES_H
+#define EXAMPLES_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "control.h"
+#include "minimize.h"
+
+#define NUM_EXAMPLES 9
+
+extern const char *examples[NUM_EXAMPLES];
+
+AST *read_example(CmpCtrl *cc, const char *file_name);
+bool same_language(MinimalDFA *a, MinimalDFA *b);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <stdbool.h>
+
+#include "../../unity/unity.h"
+#include "../examples.h"
+#include "ast.h"
+#include "charset.h"
+#include "budget.h"
+#include "control.h"
+#include "dfa.h"
+#include "followpos.h"
+#include "glushkov.h"
+#include "minimize.h"
+#include "parser.h"
+
+// positions are bits, so write them as bitfields
+#define BIT(p) ((U64)1 << (p))
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_followpos(void)
+{
+	// the example from the dragon book, figure 3.59
+	// (a|b)*abb#
+	// positions: a1 b2 a3 b4 b5 #6
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "(a|b)*abb", 9);
+	AST *ast = parse_ast(cc);
+	Followpos *fp = followpos(ast->root);
+	TEST_ASSERT_NOT_NULL(fp);
+	TEST_ASSERT_EQUAL_INT(6, fp->num_positions);
+	TEST_ASSERT_EQUAL_INT(6, fp->end);
+	TEST_ASSERT_EQUAL_INT(1, fp->words);
+	TEST_ASSERT_EQUAL_INT('a', charset_single(&fp->chars[1]));
+	TEST_ASSERT_EQUAL_INT('b', charset_single(&fp->chars[2]));
+	TEST_ASSERT_EQUAL_INT('a', charset_single(&fp->chars[3]));
+	TEST_ASSERT_EQUAL_INT('b', charset_single(&fp->chars[4]));
+	TEST_ASSERT_EQUAL_INT('b', charset_single(&fp->chars[5]));
+
+	TEST_ASSERT_EQUAL_UINT64(BIT(1)|BIT(2)|BIT(3), fp->firstpos[0]);
+	TEST_ASSERT_EQUAL_UINT64(BIT(1)|BIT(2)|BIT(3), fp->followpos[1]);
+	TEST_ASSERT_EQUAL_UINT64(BIT(1)|BIT(2)|BIT(3), fp->followpos[2]);
+	TEST_ASSERT_EQUAL_UINT64(BIT(4), fp->followpos[3]);
+	TEST_ASSERT_EQUAL_UINT64(BIT(5), fp->followpos[4]);
+	TEST_ASSERT_EQUAL_UINT64(BIT(6), fp->followpos[5]);
+	TEST_ASSERT_EQUAL_UINT64(0, fp->followpos[6]);
+
+	TEST_ASSERT_EQUAL_UINT64(BIT(1)|BIT(3), fp->char_positions['a'][0]);
+	TEST_ASSERT_EQUAL_UINT64(BIT(2)|BIT(4)|BIT(5),
+	                         fp->char_positions['b'][0]);
+	TEST_ASSERT_NULL(fp->char_positions['c']);
+	destroy_followpos(fp);
+	destroy_ast(ast);
+
+	// a nullable regex puts the end marker in the start state
+	// positions: a1 b2 #3
+	read_line(cc, "a*b?", 4);
+	ast = parse_ast(cc);
+	fp = followpos(ast->root);
+	TEST_ASSERT_EQUAL_INT(3, fp->end);
+	TEST_ASSERT_EQUAL_UINT64(BIT(1)|BIT(2)|BIT(3), fp->firstpos[0]);
+	TEST_ASSERT_EQUAL_UINT64(BIT(1)|BIT(2)|BIT(3), fp->followpos[1]);
+	TEST_ASSERT_EQUAL_UINT64(BIT(3), fp->followpos[2]);
+	destroy_followpos(fp);
+	destroy_ast(ast);
+
+	// positions spill into more than one U64
+	TEST_ASSERT_EQUAL_INT(0, read_file(cc, "../../examples/c_tokens.txt"));
+	ast = parse_ast(cc);
+	fp = followpos(ast->root);
+	TEST_ASSERT_EQUAL_INT(count_positions(ast->root) + 1, fp->end);
+	TEST_ASSERT_EQUAL_INT(fp->end / 64 + 1, fp->words);
+	destroy_followpos(fp);
+	destroy_ast(ast);
+
+	destroy_cmpctrl(cc);
+}
+
+void test_followpos_dfa(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "(a|b)*abb", 9);
+	AST *ast = parse_ast(cc);
+	Followpos *fp = followpos(ast->root);
+	DFA *dfa = followpos_dfa(fp);
+	TEST_ASSERT_NOT_NULL(dfa);
+
+	// dragon book figure 3.63
+	// A = {1,2,3}, B = {1,2,3,4}, C = {1,2,3,5}, D = {1,2,3,6}
+	TEST_ASSERT_EQUAL_INT(4, dfa->size);
+	TEST_ASSERT_EQUAL_INT(4, fp->num_dstates);
+	TEST_ASSERT_EQUAL_INT(1, dfa->accepts->size);
+	int a = dfa->mappings['a'];
+	int b = dfa->mappings['b'];
+	TEST_ASSERT_EQUAL_INT(1, dfa->delta[0][a]);  // A -a-> B
+	TEST_ASSERT_EQUAL_INT(0, dfa->delta[0][b]);  // A -b-> A
+	TEST_ASSERT_EQUAL_INT(1, dfa->delta[1][a]);  // B -a-> B
+	TEST_ASSERT_EQUAL_INT(2, dfa->delta[1][b]);  // B -b-> C
+	TEST_ASSERT_EQUAL_INT(1, dfa->delta[2][a]);  // C -a-> B
+	TEST_ASSERT_EQUAL_INT(3, dfa->delta[2][b]);  // C -b-> D
+	TEST_ASSERT_EQUAL_INT(1, dfa->delta[3][a]);  // D -a-> B
+	TEST_ASSERT_EQUAL_INT(0, dfa->delta[3][b]);  // D -b-> A
+	TEST_ASSERT_TRUE(dfa->states[3]->is_accept);
+	Set *constituents = dfa->states[3]->constituent_nfastates;
+	PosSet *d = (PosSet *)(constituents->head->element);
+	TEST_ASSERT_EQUAL_UINT64(BIT(1)|BIT(2)|BIT(3)|BIT(6), d->bits[0]);
+	TEST_ASSERT_EQUAL_INT(0, gen_dfa_graphviz(dfa,
+	                      "dots/followpos_abb.dot", false));
+
+	MinimalDFA *min_dfa = minimize(dfa);
+	TEST_ASSERT_EQUAL_INT(4, min_dfa->size);
+	destroy_minimal_dfa(min_dfa);
+	destroy_dfa(dfa);
+
+	// building again reuses the sets of positions
+	dfa = followpos_dfa(fp);
+	TEST_ASSERT_EQUAL_INT(4, dfa->size);
+	TEST_ASSERT_EQUAL_INT(4, fp->num_dstates);
+	destroy_dfa(dfa);
+
+	Budget *budget = init_budget(3, 0);
+	TEST_ASSERT_NULL(bounded_followpos_dfa(fp, budget));
+	TEST_ASSERT_EQUAL_INT(BUDGET_STATES_EXCEEDED, budget->status);
+	destroy_budget(budget);
+
+	destroy_followpos(fp);
+	destroy_ast(ast);
+	destroy_cmpctrl(cc);
+}
+
+void test_equivalence(void)
+{
+	// followpos and Glushkov determinize the same positions, but a
+	// Glushkov DFAState is the set of positions that were just matched,
+	// and a followpos DFAState is the set that can be matched next
+	// the latter merges far more states, eg [a-z][a-z0-9]* needs 2 instead
+	// of 1 + 26 + 36
+	CmpCtrl *cc = init_cmpctrl();
+	AST *ast;
+	Followpos *fp;
+	PositionNFA *pnfa;
+	DFA *followpos_result, *glushkov_result;
+	MinimalDFA *followpos_min, *glushkov_min;
+	for (int i = 0; i < NUM_EXAMPLES; i++) {
+		ast = read_example(cc, examples[i]);
+		fp = followpos(ast->root);
+		pnfa = glushkov(ast->root);
+		TEST_ASSERT_TRUE(charset_equal(&pnfa->alphabet,
+		                               &fp->alphabet));
+		followpos_result = followpos_dfa(fp);
+		glushkov_result = convert_glushkov_to_dfa(pnfa);
+		TEST_ASSERT_TRUE(followpos_result->size <=
+		                 glushkov_result->size);
+
+		followpos_min = minimize(followpos_result);
+		glushkov_min = minimize(glushkov_result);
+		TEST_ASSERT_EQUAL_INT(glushkov_min->size, followpos_min->size);
+		TEST_ASSERT_TRUE(same_language(glushkov_min, followpos_min));
+
+		destroy_minimal_dfa(followpos_min);
+		destroy_minimal_dfa(glushkov_min);
+		destroy_dfa(followpos_result);
+		destroy_dfa(glushkov_result);
+		destroy_position_nfa(pnfa);
+		destroy_followpos(fp);
+		destroy_ast(ast);
+	}
+	destroy_cmpctrl(cc);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_followpos);
+	RUN_TEST(test_followpos_dfa);
+	RUN_TEST(test_equivalence);
+
+	return UNITY_END();
+}
\ No newline at end of file
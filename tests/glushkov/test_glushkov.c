@@ -0,0 +1,335 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "../../unity/unity.h"
+#include "../examples.h"
+#include "ast.h"
+#include "budget.h"
+#include "control.h"
+#include "dfa.h"
+#include "glushkov.h"
+#include "minimize.h"
+#include "nfa.h"
+#include "parser.h"
+#include "simplify.h"
+
+// chars in a regex with no operators at all
+#define LONG_LITERAL 50000
+
+#define TEST_FOLLOW_HELPER(pnfa, p, expected) \
+	do { \
+		int exp[] = expected; \
+		TEST_ASSERT_EQUAL_INT(sizeof(exp)/sizeof(int), \
+		                      (pnfa)->follow[(p)].size); \
+		TEST_ASSERT_EQUAL_INT_ARRAY(exp, \
+		                            (pnfa)->follow[(p)].positions, \
+		                            sizeof(exp)/sizeof(int)); \
+	} while (0)
+
+// the preprocessor splits macro arguments on commas
+#define LIST(...) {__VA_ARGS__}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_glushkov(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	AST *ast;
+	PositionNFA *pnfa;
+
+	// a(b|c)*
+	// positions: a1 b2 c3
+	read_line(cc, "a(b|c)*", 7);
+	ast = parse_ast(cc);
+	pnfa = glushkov(ast->root);
+	TEST_ASSERT_NOT_NULL(pnfa);
+	TEST_ASSERT_EQUAL_INT(4, pnfa->size);
+	TEST_ASSERT_EQUAL_UINT8('a', pnfa->states[1].ch);
+	TEST_ASSERT_EQUAL_UINT8('b', pnfa->states[2].ch);
+	TEST_ASSERT_EQUAL_UINT8('c', pnfa->states[3].ch);
+	TEST_FOLLOW_HELPER(pnfa, 0, LIST(1));
+	TEST_FOLLOW_HELPER(pnfa, 1, LIST(2, 3));
+	TEST_FOLLOW_HELPER(pnfa, 2, LIST(2, 3));
+	TEST_FOLLOW_HELPER(pnfa, 3, LIST(2, 3));
+	TEST_ASSERT_FALSE(pnfa->is_accept[0]);
+	TEST_ASSERT_TRUE(pnfa->is_accept[1]);
+	TEST_ASSERT_TRUE(pnfa->is_accept[2]);
+	TEST_ASSERT_TRUE(pnfa->is_accept[3]);
+	TEST_ASSERT_EQUAL_UINT64(0, pnfa->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0xE00000000, pnfa->alphabet.bits[CHARS64_127]);
+	destroy_position_nfa(pnfa);
+	destroy_ast(ast);
+
+	// (a|b)*abb
+	// positions: a1 b2 a3 b4 b5
+	read_line(cc, "(a|b)*abb", 9);
+	ast = parse_ast(cc);
+	pnfa = glushkov(ast->root);
+	TEST_ASSERT_EQUAL_INT(6, pnfa->size);
+	TEST_FOLLOW_HELPER(pnfa, 0, LIST(1, 2, 3));
+	TEST_FOLLOW_HELPER(pnfa, 1, LIST(1, 2, 3));
+	TEST_FOLLOW_HELPER(pnfa, 2, LIST(1, 2, 3));
+	TEST_FOLLOW_HELPER(pnfa, 3, LIST(4));
+	TEST_FOLLOW_HELPER(pnfa, 4, LIST(5));
+	TEST_ASSERT_EQUAL_INT(0, pnfa->follow[5].size);
+	for (int p = 0; p < 5; p++)
+		TEST_ASSERT_FALSE(pnfa->is_accept[p]);
+	TEST_ASSERT_TRUE(pnfa->is_accept[5]);
+	destroy_position_nfa(pnfa);
+	destroy_ast(ast);
+
+	// nullable regexes make the start state accept
+	// positions: a1 b2 c3
+	read_line(cc, "a?(b+c)*", 8);
+	ast = parse_ast(cc);
+	pnfa = glushkov(ast->root);
+	TEST_FOLLOW_HELPER(pnfa, 0, LIST(1, 2));
+	TEST_FOLLOW_HELPER(pnfa, 1, LIST(2));
+	TEST_FOLLOW_HELPER(pnfa, 2, LIST(2, 3));
+	TEST_FOLLOW_HELPER(pnfa, 3, LIST(2));
+	TEST_ASSERT_TRUE(pnfa->is_accept[0]);
+	TEST_ASSERT_TRUE(pnfa->is_accept[1]);
+	TEST_ASSERT_FALSE(pnfa->is_accept[2]);
+	TEST_ASSERT_TRUE(pnfa->is_accept[3]);
+	destroy_position_nfa(pnfa);
+	destroy_ast(ast);
+
+	// a class is one position that reads any of its chars
+	// positions: [0-9]1 x2
+	read_line(cc, "[0-9]+x", 7);
+	ast = parse_ast(cc);
+	pnfa = glushkov(ast->root);
+	TEST_ASSERT_EQUAL_INT(3, pnfa->size);
+	TEST_ASSERT_EQUAL_INT(CHAR_CLASS, pnfa->states[1].ch);
+	TEST_ASSERT_EQUAL_UINT64(0x03FF000000000000,
+	                         pnfa->chars[1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, pnfa->chars[1].bits[CHARS64_127]);
+	TEST_FOLLOW_HELPER(pnfa, 0, LIST(1));
+	TEST_FOLLOW_HELPER(pnfa, 1, LIST(1, 2));
+	TEST_ASSERT_EQUAL_UINT64(0x03FF000000000000,
+	                         pnfa->alphabet.bits[CHARS0_63]);
+	destroy_position_nfa(pnfa);
+	destroy_ast(ast);
+
+	destroy_cmpctrl(cc);
+}
+
+void test_position_subset(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "(a|b)*abb", 9);
+	AST *ast = parse_ast(cc);
+	PositionNFA *pnfa = glushkov(ast->root);
+	DFA *dfa = convert_glushkov_to_dfa(pnfa);
+	TEST_ASSERT_NOT_NULL(dfa);
+
+	// states: {n0}, {n1, n3}, {n2}, {n2, n4}, {n2, n5}
+	// every state transitions to {n1, n3} on a, so there are no dead
+	// transitions
+	TEST_ASSERT_EQUAL_INT(2, dfa->alphabet_size);
+	TEST_ASSERT_EQUAL_INT(5, dfa->size);
+	TEST_ASSERT_EQUAL_INT(1, dfa->accepts->size);
+	TEST_ASSERT_EQUAL_INT(0, dfa->start->index);
+	TEST_ASSERT_FALSE(dfa->start->is_accept);
+	for (int i = 0; i < dfa->size; i++) {
+		TEST_ASSERT_EQUAL_INT(i, dfa->states[i]->index);
+		TEST_ASSERT_NOT_EQUAL(DEAD_STATE, dfa->delta[i][0]);
+		TEST_ASSERT_NOT_EQUAL(DEAD_STATE, dfa->delta[i][1]);
+	}
+	TEST_ASSERT_EQUAL_INT(0, gen_dfa_graphviz(dfa,
+	                      "dots/glushkov_abb.dot", true));
+
+	MinimalDFA *min_dfa = minimize(dfa);
+	TEST_ASSERT_EQUAL_INT(4, min_dfa->size);
+	destroy_minimal_dfa(min_dfa);
+	destroy_dfa(dfa);
+
+	// the budget applies just like it does to Thompson NFAs
+	Budget *budget = init_budget(3, 0);
+	dfa = bounded_convert_glushkov_to_dfa(pnfa, budget);
+	TEST_ASSERT_NULL(dfa);
+	TEST_ASSERT_EQUAL_INT(BUDGET_STATES_EXCEEDED, budget->status);
+	destroy_budget(budget);
+
+	destroy_position_nfa(pnfa);
+	destroy_ast(ast);
+	destroy_cmpctrl(cc);
+}
+
+void test_equivalence(void)
+{
+	// both constructions must minimize to the same DFA
+	CmpCtrl *cc = init_cmpctrl();
+	AST *ast;
+	NFA *nfa;
+	PositionNFA *pnfa;
+	DFA *thompson_dfa, *glushkov_dfa;
+	MinimalDFA *thompson_min, *glushkov_min;
+	for (int i = 0; i < NUM_EXAMPLES; i++) {
+		ast = read_example(cc, examples[i]);
+		nfa = thompson(ast->root);
+		pnfa = glushkov(ast->root);
+		TEST_ASSERT_EQUAL_INT(count_positions(ast->root) + 1,
+		                      pnfa->size);
+		TEST_ASSERT_TRUE(charset_equal(&nfa->alphabet,
+		                               &pnfa->alphabet));
+
+		thompson_dfa = convert_nfa_to_dfa(nfa);
+		glushkov_dfa = convert_glushkov_to_dfa(pnfa);
+		thompson_min = minimize(thompson_dfa);
+		glushkov_min = minimize(glushkov_dfa);
+		TEST_ASSERT_EQUAL_INT(thompson_min->size, glushkov_min->size);
+		TEST_ASSERT_TRUE(same_language(thompson_min, glushkov_min));
+
+		destroy_minimal_dfa(thompson_min);
+		destroy_minimal_dfa(glushkov_min);
+		destroy_dfa(thompson_dfa);
+		destroy_dfa(glushkov_dfa);
+		destroy_position_nfa(pnfa);
+		destroy_nfa_and_states(nfa);
+		destroy_ast(ast);
+	}
+
+	// same states and accepts, different strings
+	MinimalDFA *min_dfa[2];
+	const char *regex[2] = {"ab|c", "ab|d"};
+	for (int i = 0; i < 2; i++) {
+		read_line(cc, regex[i], 4);
+		ast = parse_ast(cc);
+		pnfa = glushkov(ast->root);
+		glushkov_dfa = convert_glushkov_to_dfa(pnfa);
+		min_dfa[i] = minimize(glushkov_dfa);
+		destroy_dfa(glushkov_dfa);
+		destroy_position_nfa(pnfa);
+		destroy_ast(ast);
+	}
+	TEST_ASSERT_EQUAL_INT(min_dfa[0]->size, min_dfa[1]->size);
+	TEST_ASSERT_EQUAL_INT(min_dfa[0]->accepts->size,
+	                      min_dfa[1]->accepts->size);
+	TEST_ASSERT_FALSE(same_language(min_dfa[0], min_dfa[1]));
+	TEST_ASSERT_TRUE(same_language(min_dfa[0], min_dfa[0]));
+	destroy_minimal_dfa(min_dfa[0]);
+	destroy_minimal_dfa(min_dfa[1]);
+	destroy_cmpctrl(cc);
+}
+
+void test_remove_epsilons(void)
+{
+	// removing the epsilons of the Thompson NFA leaves one state per
+	// position, just like the Glushkov automaton
+	CmpCtrl *cc = init_cmpctrl();
+	AST *ast;
+	NFA *nfa;
+	PositionNFA *pnfa, *eps_free;
+	DFA *glushkov_dfa, *eps_free_dfa;
+	MinimalDFA *glushkov_min, *eps_free_min;
+	for (int i = 0; i < NUM_EXAMPLES; i++) {
+		ast = read_example(cc, examples[i]);
+		nfa = thompson(ast->root);
+		pnfa = glushkov(ast->root);
+		eps_free = remove_epsilons(nfa);
+		TEST_ASSERT_NOT_NULL(eps_free);
+		TEST_ASSERT_EQUAL_INT(pnfa->size, eps_free->size);
+		TEST_ASSERT_EQUAL(pnfa->is_accept[0], eps_free->is_accept[0]);
+		TEST_ASSERT_TRUE(charset_equal(&nfa->alphabet,
+		                               &eps_free->alphabet));
+		TEST_ASSERT_TRUE(eps_free->size <= nfa->size);
+
+		glushkov_dfa = convert_glushkov_to_dfa(pnfa);
+		eps_free_dfa = convert_glushkov_to_dfa(eps_free);
+		TEST_ASSERT_EQUAL_INT(glushkov_dfa->size, eps_free_dfa->size);
+		glushkov_min = minimize(glushkov_dfa);
+		eps_free_min = minimize(eps_free_dfa);
+		TEST_ASSERT_EQUAL_INT(glushkov_min->size, eps_free_min->size);
+		TEST_ASSERT_TRUE(same_language(glushkov_min, eps_free_min));
+
+		destroy_minimal_dfa(glushkov_min);
+		destroy_minimal_dfa(eps_free_min);
+		destroy_dfa(glushkov_dfa);
+		destroy_dfa(eps_free_dfa);
+		destroy_position_nfa(eps_free);
+		destroy_position_nfa(pnfa);
+		destroy_nfa_and_states(nfa);
+		destroy_ast(ast);
+	}
+
+	// a(b|c)*
+	// the start state, a, b, and c
+	read_line(cc, "a(b|c)*", 7);
+	nfa = parse(cc);
+	eps_free = remove_epsilons(nfa);
+	TEST_ASSERT_EQUAL_INT(4, eps_free->size);
+	TEST_ASSERT_EQUAL_INT('a', eps_free->states[1].ch);
+	TEST_FOLLOW_HELPER(eps_free, 0, LIST(1));
+	TEST_FOLLOW_HELPER(eps_free, 1, LIST(2, 3));
+	TEST_FOLLOW_HELPER(eps_free, 2, LIST(2, 3));
+	TEST_FOLLOW_HELPER(eps_free, 3, LIST(2, 3));
+	TEST_ASSERT_FALSE(eps_free->is_accept[0]);
+	TEST_ASSERT_TRUE(eps_free->is_accept[1]);
+	TEST_ASSERT_TRUE(eps_free->is_accept[2]);
+	TEST_ASSERT_TRUE(eps_free->is_accept[3]);
+	TEST_ASSERT_EQUAL_INT(0, gen_position_nfa_graphviz(eps_free,
+	                      "dots/remove_epsilons.dot"));
+	destroy_position_nfa(eps_free);
+	destroy_nfa_and_states(nfa);
+	destroy_cmpctrl(cc);
+}
+
+void test_long_literal(void)
+{
+	// the parser's concatenations are one level deeper per char, which
+	// used to overflow the stack of every walk over the tree
+	CmpCtrl *cc = init_cmpctrl();
+	char *regex = malloc(LONG_LITERAL);
+	TEST_ASSERT_NOT_NULL(regex);
+	for (int i = 0; i < LONG_LITERAL; i++)
+		regex[i] = 'a' + i % 10;
+	read_line(cc, regex, LONG_LITERAL);
+	AST *ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_TRUE(simplify_ast(ast));
+	TEST_ASSERT_EQUAL_INT(LONG_LITERAL, count_positions(ast->root));
+	TEST_ASSERT_EQUAL_INT(2 * LONG_LITERAL - 1, count_nodes(ast->root));
+
+	// the same automaton comes out of the Thompson NFA without epsilons
+	NFA *nfa = thompson(ast->root);
+	TEST_ASSERT_NOT_NULL(nfa);
+	TEST_ASSERT_EQUAL_INT(2 * LONG_LITERAL, nfa->size);
+	PositionNFA *pnfa;
+	for (int i = 0; i < 2; i++) {
+		pnfa = i ? remove_epsilons(nfa) : glushkov(ast->root);
+		TEST_ASSERT_NOT_NULL(pnfa);
+		TEST_ASSERT_EQUAL_INT(LONG_LITERAL + 1, pnfa->size);
+		for (int p = 1; p <= LONG_LITERAL; p++) {
+			TEST_ASSERT_EQUAL_UINT8(regex[p-1], pnfa->states[p].ch);
+			TEST_ASSERT_EQUAL_INT(p < LONG_LITERAL,
+			                      pnfa->follow[p].size);
+			TEST_ASSERT_EQUAL(p == LONG_LITERAL,
+			                  pnfa->is_accept[p]);
+		}
+		TEST_FOLLOW_HELPER(pnfa, 0, LIST(1));
+		TEST_FOLLOW_HELPER(pnfa, 1, LIST(2));
+		TEST_FOLLOW_HELPER(pnfa, LONG_LITERAL - 1, LIST(LONG_LITERAL));
+		TEST_ASSERT_FALSE(pnfa->is_accept[0]);
+		destroy_position_nfa(pnfa);
+	}
+
+	destroy_nfa_and_states(nfa);
+	destroy_ast(ast);
+	free(regex);
+	destroy_cmpctrl(cc);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_glushkov);
+	RUN_TEST(test_position_subset);
+	RUN_TEST(test_equivalence);
+	RUN_TEST(test_remove_epsilons);
+	RUN_TEST(test_long_literal);
+
+	return UNITY_END();
+}
\ No newline at end of file
@@ -1,3 +1,6 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include "../../unity/unity.h"
 #include "common.h"
 #include "control.h"
@@ -5,28 +8,29 @@
 
 #define EXAMPLE1_LEN 7
 #define EXAMPLE2_LEN 210
+#define LONG_LINE_LEN 27
 
 void setUp(void) {}
 void tearDown(void) {}
 
 void test_get_char(void)
 {
-	U8 ch;
+	U16 ch;
 	CmpCtrl *cc = init_cmpctrl();
 	TEST_ASSERT_EQUAL_INT(0, read_file(cc, "../example.txt"));
 	char *example = "a(b|c)*";
 	for (int i = 0; i < EXAMPLE1_LEN; i++) {
 		ch = get_char(cc);
 		TEST_ASSERT_EQUAL_INT(i+1, cc->pos);
-		TEST_ASSERT_EQUAL_UINT8(example[i], ch);
+		TEST_ASSERT_EQUAL_INT(example[i], ch);
 	}
 	ch = get_char(cc);
 	TEST_ASSERT_EQUAL_INT(EXAMPLE1_LEN, cc->pos);
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, ch);
+	TEST_ASSERT_EQUAL_INT(TK_EOF, ch);
 	// get_char should continue to return TK_EOF
 	ch = get_char(cc);
 	TEST_ASSERT_EQUAL_INT(EXAMPLE1_LEN, cc->pos);
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, ch);
+	TEST_ASSERT_EQUAL_INT(TK_EOF, ch);
 	destroy_cmpctrl(cc);
 }
 
@@ -34,28 +38,28 @@ void test_lex(void)
 {
 	CmpCtrl *cc = init_cmpctrl();
 	TEST_ASSERT_EQUAL_INT(0, read_file(cc, "../example.txt"));
-	TEST_ASSERT_EQUAL_UINT8('a', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('a', cc->token);
+	TEST_ASSERT_EQUAL_INT('a', lex(cc));
+	TEST_ASSERT_EQUAL_INT('a', cc->token);
 	cc->flags |= CC_DISABLE_INSTEAD_FOUND;
 	print_error(cc, "blblblblbl");
-	TEST_ASSERT_EQUAL_UINT8(TK_LPAREN, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_LPAREN, cc->token);
-	TEST_ASSERT_EQUAL_UINT8('b', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('b', cc->token);
-	TEST_ASSERT_EQUAL_UINT8(TK_PIPE, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_PIPE, cc->token);
-	TEST_ASSERT_EQUAL_UINT8('c', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('c', cc->token);
-	TEST_ASSERT_EQUAL_UINT8(TK_RPAREN, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_RPAREN, cc->token);
-	TEST_ASSERT_EQUAL_UINT8(TK_STAR, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_STAR, cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_LPAREN, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_LPAREN, cc->token);
+	TEST_ASSERT_EQUAL_INT('b', lex(cc));
+	TEST_ASSERT_EQUAL_INT('b', cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_PIPE, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_PIPE, cc->token);
+	TEST_ASSERT_EQUAL_INT('c', lex(cc));
+	TEST_ASSERT_EQUAL_INT('c', cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_RPAREN, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_RPAREN, cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_STAR, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_STAR, cc->token);
 	cc->flags = 0 | CC_DISABLE_LINE_PRINT;
 	print_error(cc, "fake error, expected '(' or smth lol");
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, cc->token);
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_EOF, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_EOF, cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_EOF, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_EOF, cc->token);
 
 	TEST_ASSERT_EQUAL_INT(0, read_file(cc, "../example2.txt"));
 	for (int i = 0; i < EXAMPLE2_LEN; i++) {
@@ -63,58 +67,174 @@ void test_lex(void)
 		TEST_ASSERT_TRUE(cc->token < TK_EOF);
 	}
 	// read EOF again
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_EOF, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_EOF, cc->token);
 
 	TEST_ASSERT_EQUAL_INT(0, read_file(cc, "../escapes.txt"));
-	TEST_ASSERT_EQUAL_UINT8('(', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('(', cc->token);
-	TEST_ASSERT_EQUAL_UINT8('|', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('|', cc->token);
-	TEST_ASSERT_EQUAL_UINT8(')', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(')', cc->token);
+	TEST_ASSERT_EQUAL_INT('(', lex(cc));
+	TEST_ASSERT_EQUAL_INT('(', cc->token);
+	TEST_ASSERT_EQUAL_INT('|', lex(cc));
+	TEST_ASSERT_EQUAL_INT('|', cc->token);
+	TEST_ASSERT_EQUAL_INT(')', lex(cc));
+	TEST_ASSERT_EQUAL_INT(')', cc->token);
 	cc->flags |= CC_DISABLE_ERROR_MSG;
 	print_error(cc, "you can't see this");
-	TEST_ASSERT_EQUAL_UINT8('\t', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('\t', cc->token);
-	TEST_ASSERT_EQUAL_UINT8('*', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('*', cc->token);
-	TEST_ASSERT_EQUAL_UINT8('\n', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('\n', cc->token);
-	TEST_ASSERT_EQUAL_UINT8('\\', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('\\', cc->token);
-	TEST_ASSERT_EQUAL_UINT8('.', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('.', cc->token);
-	TEST_ASSERT_EQUAL_UINT8(TK_ILLEGAL, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_ILLEGAL, cc->token);
+	TEST_ASSERT_EQUAL_INT('\t', lex(cc));
+	TEST_ASSERT_EQUAL_INT('\t', cc->token);
+	TEST_ASSERT_EQUAL_INT('*', lex(cc));
+	TEST_ASSERT_EQUAL_INT('*', cc->token);
+	TEST_ASSERT_EQUAL_INT('\n', lex(cc));
+	TEST_ASSERT_EQUAL_INT('\n', cc->token);
+	TEST_ASSERT_EQUAL_INT('\\', lex(cc));
+	TEST_ASSERT_EQUAL_INT('\\', cc->token);
+	TEST_ASSERT_EQUAL_INT('.', lex(cc));
+	TEST_ASSERT_EQUAL_INT('.', cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_ILLEGAL, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_ILLEGAL, cc->token);
 	cc->flags = 0;
 	print_error(cc, "unknown character");
 	// read past illegal token
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, cc->token);
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_EOF, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_EOF, cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_EOF, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_EOF, cc->token);
 
 	TEST_ASSERT_EQUAL_INT(0, read_file(cc, "../newlines.txt"));
-	TEST_ASSERT_EQUAL_UINT8('a', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('a', cc->token);
-	TEST_ASSERT_EQUAL_UINT8('b', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('b', cc->token);
-	TEST_ASSERT_EQUAL_UINT8('c', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('c', cc->token);
-	TEST_ASSERT_EQUAL_UINT8('d', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('d', cc->token);
-	TEST_ASSERT_EQUAL_UINT8('e', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('e', cc->token);
+	TEST_ASSERT_EQUAL_INT('a', lex(cc));
+	TEST_ASSERT_EQUAL_INT('a', cc->token);
+	TEST_ASSERT_EQUAL_INT('b', lex(cc));
+	TEST_ASSERT_EQUAL_INT('b', cc->token);
+	TEST_ASSERT_EQUAL_INT('c', lex(cc));
+	TEST_ASSERT_EQUAL_INT('c', cc->token);
+	TEST_ASSERT_EQUAL_INT('d', lex(cc));
+	TEST_ASSERT_EQUAL_INT('d', cc->token);
+	TEST_ASSERT_EQUAL_INT('e', lex(cc));
+	TEST_ASSERT_EQUAL_INT('e', cc->token);
 	print_error(cc, "test error");
-	TEST_ASSERT_EQUAL_UINT8('f', lex(cc));
-	TEST_ASSERT_EQUAL_UINT8('f', cc->token);
-	TEST_ASSERT_EQUAL_UINT8(TK_WILDCARD, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_WILDCARD, cc->token);
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, cc->token);
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, lex(cc));
-	TEST_ASSERT_EQUAL_UINT8(TK_EOF, cc->token);
+	TEST_ASSERT_EQUAL_INT('f', lex(cc));
+	TEST_ASSERT_EQUAL_INT('f', cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_WILDCARD, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_WILDCARD, cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_EOF, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_EOF, cc->token);
+	TEST_ASSERT_EQUAL_INT(TK_EOF, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_EOF, cc->token);
+
+	// any byte can be escaped in hex, or written raw
+	TEST_ASSERT_EQUAL_INT(0, read_line(cc, "\\x41\\xfF\\x00\x80\x7f", 14));
+	TEST_ASSERT_EQUAL_INT('A', lex(cc));
+	TEST_ASSERT_EQUAL_INT(0xFF, lex(cc));
+	TEST_ASSERT_EQUAL_INT(0x00, lex(cc));
+	TEST_ASSERT_EQUAL_INT(0x80, lex(cc));
+	TEST_ASSERT_EQUAL_INT(0x7F, lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_EOF, lex(cc));
+	TEST_ASSERT_EQUAL_INT(0, read_line(cc, "\\xg0", 4));
+	TEST_ASSERT_EQUAL_INT(TK_ILLEGAL, lex(cc));
+	TEST_ASSERT_EQUAL_INT(0, read_line(cc, "\\x4", 3));
+	TEST_ASSERT_EQUAL_INT(TK_ILLEGAL, lex(cc));
+
+	// { is only special if a repeat count follows
+	TEST_ASSERT_EQUAL_INT(0, read_line(cc, "{2,}{1,5}{3}{,2}{x}\\{4}{", 24));
+	TEST_ASSERT_EQUAL_INT(TK_LBRACE, lex(cc));
+	TEST_ASSERT_EQUAL_INT('2', lex(cc));
+	TEST_ASSERT_EQUAL_INT(',', lex(cc));
+	TEST_ASSERT_EQUAL_INT('}', lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_LBRACE, lex(cc));
+	TEST_ASSERT_EQUAL_INT('1', lex(cc));
+	TEST_ASSERT_EQUAL_INT(',', lex(cc));
+	TEST_ASSERT_EQUAL_INT('5', lex(cc));
+	TEST_ASSERT_EQUAL_INT('}', lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_LBRACE, lex(cc));
+	TEST_ASSERT_EQUAL_INT('3', lex(cc));
+	TEST_ASSERT_EQUAL_INT('}', lex(cc));
+	TEST_ASSERT_EQUAL_INT('{', lex(cc));
+	TEST_ASSERT_EQUAL_INT(',', lex(cc));
+	TEST_ASSERT_EQUAL_INT('2', lex(cc));
+	TEST_ASSERT_EQUAL_INT('}', lex(cc));
+	TEST_ASSERT_EQUAL_INT('{', lex(cc));
+	TEST_ASSERT_EQUAL_INT('x', lex(cc));
+	TEST_ASSERT_EQUAL_INT('}', lex(cc));
+	TEST_ASSERT_EQUAL_INT('{', lex(cc));
+	TEST_ASSERT_EQUAL_INT('4', lex(cc));
+	TEST_ASSERT_EQUAL_INT('}', lex(cc));
+	TEST_ASSERT_EQUAL_INT('{', lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_EOF, lex(cc));
+
+	destroy_cmpctrl(cc);
+}
+
+// lex the whole buffer with and without prelex() and compare
+static void compare_prelex(CmpCtrl *cc)
+{
+	int len = cc->buffer_len;
+	U16 *tokens = malloc((len + 1) * sizeof(U16));
+	int *ends = malloc((len + 1) * sizeof(int));
+	int n = 0;
+	do {
+		tokens[n] = lex(cc);
+		ends[n++] = cc->pos;
+	} while (cc->token != TK_EOF);
+
+	cc->pos = 0;
+	TEST_ASSERT_TRUE(prelex(cc));
+	TEST_ASSERT_EQUAL_INT(n, cc->num_tokens);
+	TEST_ASSERT_EQUAL_INT(0, cc->pos);
+	for (int i = 0; i < n; i++) {
+		TEST_ASSERT_EQUAL_INT(tokens[i], lex(cc));
+		TEST_ASSERT_EQUAL_INT(ends[i], cc->pos);
+	}
+	// should continue to return TK_EOF
+	TEST_ASSERT_EQUAL_INT(TK_EOF, lex(cc));
+	TEST_ASSERT_EQUAL_INT(ends[n-1], cc->pos);
+	free(tokens);
+	free(ends);
+}
+
+void test_prelex(void)
+{
+	const char *files[] = {
+		"../example.txt", "../example2.txt", "../empty.txt",
+		"../escapes.txt", "../newlines.txt", "../tabs.txt",
+		"../../examples/c_tokens.txt", "../../examples/keywords.txt"
+	};
+	CmpCtrl *cc = init_cmpctrl();
+	for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+		TEST_ASSERT_EQUAL_INT(0, read_file(cc, files[i]));
+		compare_prelex(cc);
+	}
+
+	// a metachar at every offset of an 8 char word, and a trailing escape
+	const char metachars[] = "\\.()[|*?+]{$";
+	char line[LONG_LINE_LEN];
+	for (size_t m = 0; m < sizeof(metachars) - 1; m++) {
+		for (int i = 0; i < LONG_LINE_LEN; i++) {
+			memset(line, 'x', LONG_LINE_LEN);
+			line[i] = metachars[m];
+			TEST_ASSERT_EQUAL_INT(0, read_line(cc, line, LONG_LINE_LEN));
+			compare_prelex(cc);
+		}
+	}
+
+	// raw bytes past 0x7F take the fast path, escaped ones don't
+	TEST_ASSERT_EQUAL_INT(0, read_line(cc, "\xff\x80" "abcdefgh\\x80", 14));
+	compare_prelex(cc);
+
+	// the tokens start wherever the buffer was left
+	TEST_ASSERT_EQUAL_INT(0, read_line(cc, "ab(c)", 5));
+	lex(cc);
+	TEST_ASSERT_TRUE(prelex(cc));
+	TEST_ASSERT_EQUAL_INT(1, cc->pos);
+	TEST_ASSERT_EQUAL_INT(5, cc->num_tokens);
+	TEST_ASSERT_EQUAL_INT('b', lex(cc));
+	TEST_ASSERT_EQUAL_INT(2, cc->pos);
+	TEST_ASSERT_EQUAL_INT(TK_LPAREN, lex(cc));
+	TEST_ASSERT_EQUAL_INT(3, cc->pos);
+
+	// a new buffer drops the old tokens
+	TEST_ASSERT_EQUAL_INT(0, read_line(cc, "z", 1));
+	TEST_ASSERT_NULL(cc->tokens);
+	TEST_ASSERT_EQUAL_INT('z', lex(cc));
+	TEST_ASSERT_EQUAL_INT(TK_EOF, lex(cc));
 
 	destroy_cmpctrl(cc);
 }
@@ -125,6 +245,7 @@ int main(void)
 
 	RUN_TEST(test_get_char);
 	RUN_TEST(test_lex);
+	RUN_TEST(test_prelex);
 
 	return UNITY_END();
 }
\ No newline at end of file
@@ -1,10 +1,27 @@
+#include <string.h>
+
 #include "../../unity/unity.h"
+#include "budget.h"
+#include "charset.h"
 #include "control.h"
 #include "dfa.h"
 #include "minimize.h"
 #include "nfa.h"
 #include "parser.h"
 
+#define NUM_ACYCLIC 8
+
+static const char *acyclic[NUM_ACYCLIC] = {
+	"there|here",
+	"hi|this",
+	"abc|abd|xbc",
+	"a?b?c?",
+	"[0-9][0-9]?",
+	"(ab|cd)(ef|gh)",
+	"int|long|short|char|float|double|void|signed|unsigned",
+	"."
+};
+
 void setUp(void) {}
 void tearDown(void) {}
 
@@ -18,7 +35,7 @@ void test_inits(void)
 	destroy_minimal_dfastate(min_state);
 
 	CmpCtrl *cc = init_cmpctrl();
-	read_line(cc, "abc|[bx]*", 9);
+	read_line(cc, "abc|(b|x)*", 10);
 	NFA *nfa = parse(cc);
 	DFA *dfa = convert_nfa_to_dfa(nfa);
 	MinimalDFA *min_dfa = init_minimal_dfa(dfa);
@@ -72,13 +89,20 @@ void test_inits(void)
 	destroy_minimal_dfa(min_dfa);
 }
 
+// whether quotient() found two states distinguishable
+static bool distinguished(MinimalDFA *min_dfa, int i, int j)
+{
+	return !min_dfa->merge[i < j ? i : j][i < j ? j : i];
+}
+
 void test_distinguishable(void)
 {
 	CmpCtrl *cc = init_cmpctrl();
-	read_line(cc, "abc|[bx]*", 9);
+	read_line(cc, "abc|(b|x)*", 10);
 	NFA *nfa = parse(cc);
 	DFA *dfa = convert_nfa_to_dfa(nfa);
 	MinimalDFA *min_dfa = init_minimal_dfa(dfa);
+	TEST_ASSERT_EQUAL_INT(0, quotient(min_dfa, dfa));
 
 /*
 Table of Indistinguishable States
@@ -95,23 +119,24 @@ Table of Indistinguishable States
 
 	// rows/cols with 1 xor 4 were distinguished during init_minimal_dfa(),
 	// so don't test them
-	TEST_ASSERT_TRUE(distinguishable(0, 2, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(0, 3, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(0, 5, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(1, 4, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(2, 5, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(3, 5, min_dfa, dfa));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 2));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 3));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 5));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 1, 4));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 2, 5));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 3, 5));
 
-	TEST_ASSERT_FALSE(distinguishable(2, 3, min_dfa, dfa));
+	TEST_ASSERT_FALSE(distinguished(min_dfa, 2, 3));
 
 	destroy_nfa_and_states(nfa);
 	destroy_dfa(dfa);
 	destroy_minimal_dfa(min_dfa);
 
-	read_line(cc, "for|[f-h]*", 10);
+	read_line(cc, "for|(f|g|h)*", 12);
 	nfa = parse(cc);
 	dfa = convert_nfa_to_dfa(nfa);
 	min_dfa = init_minimal_dfa(dfa);
+	TEST_ASSERT_EQUAL_INT(0, quotient(min_dfa, dfa));
 
 /*
 Table of Indistinguishable States
@@ -129,22 +154,22 @@ Table of Indistinguishable States
 
 	// rows/cols with state 5 are distinguished during init_minimal_dfa(),
 	// so don't test them
-	TEST_ASSERT_TRUE(distinguishable(0, 1, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(0, 2, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(0, 3, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(0, 4, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(0, 6, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(1, 2, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(1, 3, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(1, 4, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(1, 6, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(2, 6, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(3, 6, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(4, 6, min_dfa, dfa));
-
-	TEST_ASSERT_FALSE(distinguishable(2, 3, min_dfa, dfa));
-	TEST_ASSERT_FALSE(distinguishable(2, 4, min_dfa, dfa));
-	TEST_ASSERT_FALSE(distinguishable(3, 4, min_dfa, dfa));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 1));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 2));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 3));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 4));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 6));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 1, 2));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 1, 3));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 1, 4));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 1, 6));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 2, 6));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 3, 6));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 4, 6));
+
+	TEST_ASSERT_FALSE(distinguished(min_dfa, 2, 3));
+	TEST_ASSERT_FALSE(distinguished(min_dfa, 2, 4));
+	TEST_ASSERT_FALSE(distinguished(min_dfa, 3, 4));
 
 	destroy_nfa_and_states(nfa);
 	destroy_dfa(dfa);
@@ -154,6 +179,7 @@ Table of Indistinguishable States
 	nfa = parse(cc);
 	dfa = convert_nfa_to_dfa(nfa);
 	min_dfa = init_minimal_dfa(dfa);
+	TEST_ASSERT_EQUAL_INT(0, quotient(min_dfa, dfa));
 /*
 Table of Indistinguishable States
 ----------------+----------------
@@ -168,18 +194,18 @@ Table of Indistinguishable States
 5           T   |   5
 */
 
-	TEST_ASSERT_TRUE(distinguishable(0, 1, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(0, 2, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(0, 3, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(0, 4, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(1, 2, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(1, 3, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(1, 4, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(2, 3, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(2, 4, min_dfa, dfa));
-	TEST_ASSERT_TRUE(distinguishable(3, 4, min_dfa, dfa));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 1));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 2));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 3));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 0, 4));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 1, 2));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 1, 3));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 1, 4));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 2, 3));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 2, 4));
+	TEST_ASSERT_TRUE(distinguished(min_dfa, 3, 4));
 
-	TEST_ASSERT_FALSE(distinguishable(5, 6, min_dfa, dfa));
+	TEST_ASSERT_FALSE(distinguished(min_dfa, 5, 6));
 
 	destroy_cmpctrl(cc);
 	destroy_nfa_and_states(nfa);
@@ -254,7 +280,7 @@ void test_quotient(void)
 	destroy_minimal_dfa(min_dfa);
 
 
-	read_line(cc, "abc|[bx]*", 9);
+	read_line(cc, "abc|(b|x)*", 10);
 	nfa = parse(cc);
 	dfa = convert_nfa_to_dfa(nfa);
 	min_dfa = init_minimal_dfa(dfa);
@@ -286,7 +312,7 @@ void test_quotient(void)
 	destroy_minimal_dfa(min_dfa);
 
 
-	read_line(cc, "for|[f-h]*", 10);
+	read_line(cc, "for|(f|g|h)*", 12);
 	nfa = parse(cc);
 	dfa = convert_nfa_to_dfa(nfa);
 	min_dfa = init_minimal_dfa(dfa);
@@ -519,7 +545,7 @@ void test_construct_minimal_states(void)
 	destroy_minimal_dfa(min_dfa);
 
 
-	read_line(cc, "abc|[bx]*", 9);
+	read_line(cc, "abc|(b|x)*", 10);
 	nfa = parse(cc);
 	dfa = convert_nfa_to_dfa(nfa);
 	min_dfa = init_minimal_dfa(dfa);
@@ -566,7 +592,7 @@ void test_construct_minimal_states(void)
 	destroy_minimal_dfa(min_dfa);
 
 
-	read_line(cc, "for|[f-h]*", 10);
+	read_line(cc, "for|(f|g|h)*", 12);
 	nfa = parse(cc);
 	dfa = convert_nfa_to_dfa(nfa);
 	min_dfa = init_minimal_dfa(dfa);
@@ -633,17 +659,17 @@ void test_construct_transition_table(void)
 0     | a
 1 b,c |
 */
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][1][ASCII0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][1].bits[CHARS0_63]);
 	exp = 1ULL << ('a'-64);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0][ASCII0_63]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0].bits[CHARS0_63]);
 	exp = 1ULL << ('b'-64);
 	exp |= 1ULL << ('c'-64);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1][ASCII64_127]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1].bits[CHARS64_127]);
 
 	destroy_nfa_and_states(nfa);
 	destroy_dfa(dfa);
@@ -663,34 +689,34 @@ void test_construct_transition_table(void)
 1 1 |   | 0
 2   | 0 | 1
 */
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][2][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][2][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][2][ASCII64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][2].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][2].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][2].bits[CHARS64_127]);
 
 	exp = 1ULL << '1';
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[2][2][ASCII0_63]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[2][2].bits[CHARS0_63]);
 	exp = 1ULL << '0';
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[2][1][ASCII0_63]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[2][1].bits[CHARS0_63]);
 
 	destroy_nfa_and_states(nfa);
 	destroy_dfa(dfa);
 	destroy_minimal_dfa(min_dfa);
 
 
-	read_line(cc, "abc|[bx]*", 9);
+	read_line(cc, "abc|(b|x)*", 10);
 	nfa = parse(cc);
 	dfa = convert_nfa_to_dfa(nfa);
 	min_dfa = init_minimal_dfa(dfa);
@@ -706,69 +732,69 @@ void test_construct_transition_table(void)
 3   |   |     |   | c
 4
 */
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][3][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][4][ASCII0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][3].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][4].bits[CHARS0_63]);
 
 	exp = 1ULL << ('a'-64);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][1][ASCII64_127]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][1].bits[CHARS64_127]);
 	exp = 1ULL << ('b'-64);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][3][ASCII64_127]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][3].bits[CHARS64_127]);
 	exp |= 1ULL << ('x'-64);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][2][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[2][2][ASCII64_127]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][2].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[2][2].bits[CHARS64_127]);
 	exp = 1ULL << ('c'-64);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[3][4][ASCII64_127]);
-
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][3][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][3][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][4][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][4][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][2][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][4][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][4][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][3][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][3][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][4][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][4][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][2][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][3][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][3][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][2][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][3][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][3][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][4][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][4][ASCII64_127]);
-
-	destroy_nfa_and_states(nfa);
-	destroy_dfa(dfa);
-	destroy_minimal_dfa(min_dfa);
-
-
-	read_line(cc, "for|[f-h]*", 10);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[3][4].bits[CHARS64_127]);
+
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][3].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][3].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][4].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][4].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][2].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][4].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][4].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][3].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][3].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][4].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][4].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][2].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][3].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][3].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][2].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][3].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][3].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][4].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][4].bits[CHARS64_127]);
+
+	destroy_nfa_and_states(nfa);
+	destroy_dfa(dfa);
+	destroy_minimal_dfa(min_dfa);
+
+
+	read_line(cc, "for|(f|g|h)*", 12);
 	nfa = parse(cc);
 	dfa = convert_nfa_to_dfa(nfa);
 	min_dfa = init_minimal_dfa(dfa);
@@ -783,64 +809,64 @@ void test_construct_transition_table(void)
 3   |   |       |   | r
 4
 */
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][3][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][4][ASCII0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][3].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][4].bits[CHARS0_63]);
 
 	exp = 1ULL << ('f'-64);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][1][ASCII64_127]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][1].bits[CHARS64_127]);
 	exp = 1ULL << ('g'-64);
 	exp |= 1ULL << ('h'-64);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][2][ASCII64_127]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[0][2].bits[CHARS64_127]);
 	exp |= 1ULL << ('f'-64);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][2][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[2][2][ASCII64_127]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][2].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[2][2].bits[CHARS64_127]);
 	exp = 1ULL << ('o'-64);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][3][ASCII64_127]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[1][3].bits[CHARS64_127]);
 	exp = 1ULL << ('r'-64);
-	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[3][4][ASCII64_127]);
-
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][3][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][3][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][4][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][4][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][4][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][4][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][3][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][3][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][4][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][4][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][2][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][3][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][3][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][0][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][0][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][1][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][1][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][2][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][2][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][3][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][3][ASCII64_127]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][4][ASCII0_63]);
-	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][4][ASCII64_127]);
+	TEST_ASSERT_EQUAL_UINT64(exp, min_dfa->delta[3][4].bits[CHARS64_127]);
+
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][3].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][3].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][4].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[0][4].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][4].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[1][4].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][3].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][3].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][4].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[2][4].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][2].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][3].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[3][3].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][0].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][0].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][1].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][1].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][2].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][2].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][3].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][3].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][4].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, min_dfa->delta[4][4].bits[CHARS64_127]);
 
 	destroy_nfa_and_states(nfa);
 	destroy_dfa(dfa);
@@ -881,7 +907,7 @@ void test_minimize_and_gen_graphviz(void)
 	destroy_minimal_dfa(min_dfa);
 
 
-	read_line(cc, "for|[f-h]*", 10);
+	read_line(cc, "for|(f|g|h)*", 12);
 	nfa = parse(cc);
 	dfa = convert_nfa_to_dfa(nfa);
 
@@ -1004,6 +1030,301 @@ maybe i need a more efficient algorithm?
 	destroy_minimal_dfa(min_dfa);
 }
 
+void test_minimize_budget(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "(0|(1(01*(00)*0)*1)*)*", 22);
+	NFA *nfa = parse(cc);
+
+	// find out how much the unbounded compilation uses
+	Budget *budget = init_budget(0, 0);
+	DFA *dfa = bounded_convert_nfa_to_dfa(nfa, budget);
+	size_t dfa_bytes = budget->bytes_used;
+	MinimalDFA *min_dfa = minimize(dfa);
+	TEST_ASSERT_NOT_NULL(min_dfa);
+	TEST_ASSERT_EQUAL_INT(BUDGET_OK, budget->status);
+	TEST_ASSERT_TRUE(budget->bytes_used > dfa_bytes);
+	size_t total_bytes = budget->bytes_used;
+	destroy_minimal_dfa(min_dfa);
+	destroy_dfa(dfa);
+
+	// the DFA fits, but the merge[][] table doesn't
+	budget->max_bytes = dfa_bytes + 1;
+	reset_budget(budget);
+	dfa = bounded_convert_nfa_to_dfa(nfa, budget);
+	TEST_ASSERT_NOT_NULL(dfa);
+	TEST_ASSERT_NULL(init_minimal_dfa(dfa));
+	TEST_ASSERT_EQUAL_INT(BUDGET_BYTES_EXCEEDED, budget->status);
+	destroy_dfa(dfa);
+
+	// everything but the transition table fits
+	budget->max_bytes = total_bytes - 1;
+	reset_budget(budget);
+	dfa = bounded_convert_nfa_to_dfa(nfa, budget);
+	TEST_ASSERT_NULL(minimize(dfa));
+	TEST_ASSERT_EQUAL_INT(BUDGET_BYTES_EXCEEDED, budget->status);
+	destroy_dfa(dfa);
+
+	budget->max_bytes = total_bytes;
+	reset_budget(budget);
+	dfa = bounded_convert_nfa_to_dfa(nfa, budget);
+	min_dfa = minimize(dfa);
+	TEST_ASSERT_NOT_NULL(min_dfa);
+	TEST_ASSERT_EQUAL_INT(BUDGET_OK, budget->status);
+
+	destroy_minimal_dfa(min_dfa);
+	destroy_dfa(dfa);
+	destroy_budget(budget);
+	destroy_nfa_and_states(nfa);
+	destroy_cmpctrl(cc);
+}
+
+// the quotient construction, like minimize() did before it found acyclic DFAs
+static MinimalDFA *quotient_minimize(DFA *dfa)
+{
+	MinimalDFA *min_dfa = init_minimal_dfa(dfa);
+	quotient(min_dfa, dfa);
+	construct_minimal_states(min_dfa, dfa);
+	construct_transition_table(min_dfa, dfa);
+	return min_dfa;
+}
+
+void test_minimize_acyclic(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	NFA *nfa;
+	DFA *dfa;
+	MinimalDFA *min_dfa, *expected;
+	for (int i = 0; i < NUM_ACYCLIC; i++) {
+		read_line(cc, acyclic[i], strlen(acyclic[i]));
+		nfa = parse(cc);
+		dfa = convert_nfa_to_dfa(nfa);
+		min_dfa = minimize(dfa);
+		expected = quotient_minimize(dfa);
+
+		// no merge[][] table means the quotient construction was skipped
+		TEST_ASSERT_NOT_NULL(min_dfa);
+		TEST_ASSERT_NULL(min_dfa->merge);
+
+		// states are numbered the same way, so the tables are identical
+		TEST_ASSERT_EQUAL_INT(expected->size, min_dfa->size);
+		TEST_ASSERT_EQUAL_INT(0, min_dfa->start->index);
+		TEST_ASSERT_EQUAL_INT(expected->accepts->size,
+		                      min_dfa->accepts->size);
+		for (int j = 0; j < min_dfa->size; j++) {
+			for (int k = 0; k < min_dfa->size; k++) {
+				TEST_ASSERT_EQUAL_UINT64_ARRAY(
+					expected->delta[j][k].bits,
+					min_dfa->delta[j][k].bits, CHARSET_WORDS);
+			}
+		}
+
+		destroy_minimal_dfa(expected);
+		destroy_minimal_dfa(min_dfa);
+		destroy_dfa(dfa);
+		destroy_nfa_and_states(nfa);
+	}
+
+	// a cycle needs the quotient construction
+	read_line(cc, "ab(cd)*", 7);
+	nfa = parse(cc);
+	dfa = convert_nfa_to_dfa(nfa);
+	min_dfa = minimize(dfa);
+	TEST_ASSERT_NOT_NULL(min_dfa->merge);
+	TEST_ASSERT_EQUAL_INT(4, min_dfa->size);
+	destroy_minimal_dfa(min_dfa);
+	destroy_dfa(dfa);
+	destroy_nfa_and_states(nfa);
+
+	destroy_cmpctrl(cc);
+}
+
+void test_high_bytes(void)
+{
+	// bytes past 0x7F and control chars are ordinary chars
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "\\xff\\x80[\\x00-\\x7f]+", 20);
+	NFA *nfa = parse(cc);
+	TEST_ASSERT_NOT_NULL(nfa);
+	DFA *dfa = convert_nfa_to_dfa(nfa);
+	TEST_ASSERT_NOT_NULL(dfa);
+	// [\x00-\x7f], \x80, and \xff are the only byte classes
+	TEST_ASSERT_EQUAL_INT(3, dfa->alphabet_size);
+	TEST_ASSERT_EQUAL_INT(-1, dfa->mappings[0x81]);
+	TEST_ASSERT_EQUAL_INT(dfa->mappings[0x00], dfa->mappings[0x7F]);
+	MinimalDFA *min_dfa = minimize(dfa);
+	TEST_ASSERT_NOT_NULL(min_dfa);
+	TEST_ASSERT_EQUAL_INT(4, min_dfa->size);
+	TEST_ASSERT_EQUAL_UINT64(1ULL << 63,
+	                         min_dfa->delta[0][1].bits[CHARS192_255]);
+	TEST_ASSERT_EQUAL_UINT64(1, min_dfa->delta[1][2].bits[CHARS128_191]);
+	TEST_ASSERT_EQUAL_UINT64(~0ULL, min_dfa->delta[2][3].bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(~0ULL, min_dfa->delta[3][3].bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_INT(0, gen_minimal_dfa_graphviz(min_dfa,
+	                      "dots/high_bytes.dot"));
+	destroy_minimal_dfa(min_dfa);
+	destroy_dfa(dfa);
+	destroy_nfa_and_states(nfa);
+	destroy_cmpctrl(cc);
+}
+
+void test_utf8_range(void)
+{
+	// U+4E00-U+9FA5 is over 20,000 chars, but only 7 states:
+	//   E4 [B8-BF] [80-BF] | [E5-E8] [80-BF] [80-BF] |
+	//   E9 [80-BD] [80-BF] | E9 BE [80-A5]
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "[\xe4\xb8\x80-\xe9\xbe\xa5]", 9);
+	NFA *nfa = parse(cc);
+	TEST_ASSERT_NOT_NULL(nfa);
+	DFA *dfa = convert_nfa_to_dfa(nfa);
+	MinimalDFA *min_dfa = minimize(dfa);
+	TEST_ASSERT_EQUAL_INT(7, min_dfa->size);
+	TEST_ASSERT_EQUAL_INT(1, min_dfa->accepts->size);
+	TEST_ASSERT_EQUAL_INT(0, gen_minimal_dfa_graphviz(min_dfa,
+	                      "dots/cjk.dot"));
+	destroy_minimal_dfa(min_dfa);
+	destroy_dfa(dfa);
+	destroy_nfa_and_states(nfa);
+	destroy_cmpctrl(cc);
+}
+
+void test_bounded_repeat(void)
+{
+	// one state per count, except the last one needs 2^4 states however
+	// it's written
+	const char *regexes[] = {"[a-z]{3,8}", "x{200}", "(a|b)*a(a|b){3}"};
+	const int sizes[] = {9, 201, 16};
+	CmpCtrl *cc = init_cmpctrl();
+	for (int i = 0; i < 3; i++) {
+		read_line(cc, regexes[i], strlen(regexes[i]));
+		NFA *nfa = parse(cc);
+		TEST_ASSERT_NOT_NULL(nfa);
+		DFA *dfa = convert_nfa_to_dfa(nfa);
+		MinimalDFA *min_dfa = minimize(dfa);
+		TEST_ASSERT_NOT_NULL(min_dfa);
+		TEST_ASSERT_EQUAL_INT(sizes[i], min_dfa->size);
+		destroy_minimal_dfa(min_dfa);
+		destroy_dfa(dfa);
+		destroy_nfa_and_states(nfa);
+	}
+	destroy_cmpctrl(cc);
+}
+
+void test_ignore_case(void)
+{
+	// the same states and byte classes as the regex without (?i)
+	const char *regexes[] = {"https?://[a-z]+", "(?i)https?://[a-z]+"};
+	int sizes[2];
+	int classes[2];
+	CmpCtrl *cc = init_cmpctrl();
+	for (int i = 0; i < 2; i++) {
+		read_line(cc, regexes[i], strlen(regexes[i]));
+		NFA *nfa = parse(cc);
+		TEST_ASSERT_NOT_NULL(nfa);
+		DFA *dfa = convert_nfa_to_dfa(nfa);
+		MinimalDFA *min_dfa = minimize(dfa);
+		TEST_ASSERT_NOT_NULL(min_dfa);
+		sizes[i] = min_dfa->size;
+		classes[i] = dfa->alphabet_size;
+		if (i == 1) {
+			TEST_ASSERT_EQUAL_INT(dfa->mappings['h'],
+			                      dfa->mappings['H']);
+			TEST_ASSERT_EQUAL_INT(0, gen_minimal_dfa_graphviz(min_dfa,
+			                      "dots/ignore_case.dot"));
+		}
+		destroy_minimal_dfa(min_dfa);
+		destroy_dfa(dfa);
+		destroy_nfa_and_states(nfa);
+	}
+	TEST_ASSERT_EQUAL_INT(sizes[0], sizes[1]);
+	TEST_ASSERT_EQUAL_INT(classes[0], classes[1]);
+	destroy_cmpctrl(cc);
+}
+
+void test_loops(void)
+{
+	// states that loop on the same chars, with or without the dead state
+	const char *regexes[] = {"(a|bb)*x", "xa*c|ya*d", "xa*c|ya*c"};
+	const int sizes[] = {3, 4, 3};
+	CmpCtrl *cc = init_cmpctrl();
+	for (int i = 0; i < 3; i++) {
+		read_line(cc, regexes[i], strlen(regexes[i]));
+		NFA *nfa = parse(cc);
+		TEST_ASSERT_NOT_NULL(nfa);
+		DFA *dfa = convert_nfa_to_dfa(nfa);
+		MinimalDFA *min_dfa = minimize(dfa);
+		TEST_ASSERT_NOT_NULL(min_dfa);
+		TEST_ASSERT_EQUAL_INT(sizes[i], min_dfa->size);
+		destroy_minimal_dfa(min_dfa);
+		destroy_dfa(dfa);
+		destroy_nfa_and_states(nfa);
+	}
+	destroy_cmpctrl(cc);
+}
+
+void test_nested_loops(void)
+{
+	// every pair found indistinguishable used to be compared again from
+	// every path that led to it, which never finished on these
+	const char *regexes[] = {
+		"(b+((c[ac])|(ba+))?((c(c(a*c+)))|(((c)|(((c*b)|(b*b?))"
+		"((c{1}a)|(b))+)).*))*)|(((a)|((([a-b]?[ac])|(.{0,1}a))+)|"
+		"([a-b](a)?)){1})",
+		"(a|b)*a(a|b){6}"
+	};
+	const int sizes[] = {6, 128};
+	CmpCtrl *cc = init_cmpctrl();
+	for (int i = 0; i < 2; i++) {
+		read_line(cc, regexes[i], strlen(regexes[i]));
+		NFA *nfa = parse(cc);
+		TEST_ASSERT_NOT_NULL(nfa);
+		DFA *dfa = convert_nfa_to_dfa(nfa);
+		TEST_ASSERT_NOT_NULL(dfa);
+		MinimalDFA *min_dfa = minimize(dfa);
+		TEST_ASSERT_NOT_NULL(min_dfa);
+		TEST_ASSERT_EQUAL_INT(sizes[i], min_dfa->size);
+		destroy_minimal_dfa(min_dfa);
+		destroy_dfa(dfa);
+		destroy_nfa_and_states(nfa);
+	}
+	destroy_cmpctrl(cc);
+}
+
+void test_reverse(void)
+{
+	// the last a is 4 chars from the end, but backwards it's 4 chars from
+	// the start, so the reverse only needs a state per char
+	const char *regexes[] = {"abc", "(a|b)*a(a|b){3}", "xa*c|ya*d"};
+	const int sizes[] = {4, 5, 4};
+	CmpCtrl *cc = init_cmpctrl();
+	for (int i = 0; i < 3; i++) {
+		read_line(cc, regexes[i], strlen(regexes[i]));
+		NFA *nfa = parse(cc);
+		TEST_ASSERT_NOT_NULL(nfa);
+		DFA *dfa = convert_nfa_to_dfa(nfa);
+		MinimalDFA *min_dfa = minimize(dfa);
+		TEST_ASSERT_NOT_NULL(min_dfa);
+		MinimalDFA *rev = minimize_reverse(min_dfa, NULL);
+		TEST_ASSERT_NOT_NULL(rev);
+		TEST_ASSERT_EQUAL_INT(sizes[i], rev->size);
+		// reversing twice gives back the same DFA
+		MinimalDFA *twice = minimize_reverse(rev, NULL);
+		TEST_ASSERT_NOT_NULL(twice);
+		TEST_ASSERT_EQUAL_INT(min_dfa->size, twice->size);
+		if (i == 1) {
+			TEST_ASSERT_EQUAL_INT(0, gen_minimal_dfa_graphviz(rev,
+			                      "dots/reverse.dot"));
+		}
+		destroy_minimal_dfa(twice);
+		destroy_minimal_dfa(rev);
+		destroy_minimal_dfa(min_dfa);
+		destroy_dfa(dfa);
+		destroy_nfa_and_states(nfa);
+	}
+	destroy_cmpctrl(cc);
+}
+
 int main(void)
 {
 	UNITY_BEGIN();
@@ -1014,6 +1335,15 @@ int main(void)
 	RUN_TEST(test_construct_minimal_states);
 	RUN_TEST(test_construct_transition_table);
 	RUN_TEST(test_minimize_and_gen_graphviz);
+	RUN_TEST(test_minimize_budget);
+	RUN_TEST(test_minimize_acyclic);
+	RUN_TEST(test_high_bytes);
+	RUN_TEST(test_utf8_range);
+	RUN_TEST(test_bounded_repeat);
+	RUN_TEST(test_ignore_case);
+	RUN_TEST(test_loops);
+	RUN_TEST(test_nested_loops);
+	RUN_TEST(test_reverse);
 
 	return UNITY_END();
 }
\ No newline at end of file
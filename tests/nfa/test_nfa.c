@@ -1,9 +1,16 @@
 #include <stddef.h>
+#include <stdlib.h>
 
 #include "../../unity/unity.h"
+#include "charset.h"
 #include "common.h"
+#include "control.h"
 #include "lexer.h"
 #include "nfa.h"
+#include "parser.h"
+#include "set.h"
+
+#define HUGE_NFA_SIZE 50000
 
 void setUp(void) {}
 void tearDown(void) {}
@@ -17,12 +24,11 @@ void test_inits(void)
 	TEST_ASSERT_NULL(state->out2);
 	TEST_ASSERT_EQUAL_INT(EPSILON, state->ch);
 	TEST_ASSERT_EQUAL_INT(-1, state->index);
-	TEST_ASSERT_FALSE(state->seen);
 
 	TEST_ASSERT_NULL(nfa->start);
 	TEST_ASSERT_NULL(nfa->accept);
-	TEST_ASSERT_EQUAL_UINT64(0, nfa->alphabet0_63);
-	TEST_ASSERT_EQUAL_UINT64(0, nfa->alphabet64_127);
+	TEST_ASSERT_EQUAL_UINT64(0, nfa->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, nfa->alphabet.bits[CHARS64_127]);
 	TEST_ASSERT_EQUAL_UINT64(0, nfa->size);
 	TEST_ASSERT_EQUAL_PTR(compare_nfastate_ptr, nfa->mem_region->compare);
 
@@ -40,10 +46,10 @@ void test_init_thompson_nfa(void)
 	TEST_ASSERT_EQUAL_PTR(t->accept, t->start->out1);
 	TEST_ASSERT_NULL(t->start->out2);
 
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, t->accept->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, t->accept->ch);
 
-	TEST_ASSERT_EQUAL_UINT64(0, t->alphabet0_63);
-	TEST_ASSERT_EQUAL_UINT64(1ULL << ('a' - 64), t->alphabet64_127);
+	TEST_ASSERT_EQUAL_UINT64(0, t->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(1ULL << ('a' - 64), t->alphabet.bits[CHARS64_127]);
 
 	TEST_ASSERT_EQUAL_INT(2, t->size);
 
@@ -62,8 +68,8 @@ void test_init_thompson_nfa(void)
 
 	TEST_ASSERT_EQUAL_UINT8(0, t2->accept->ch);
 
-	TEST_ASSERT_EQUAL_UINT64(0, t2->alphabet0_63);
-	TEST_ASSERT_EQUAL_UINT64(1ULL << ('Q' - 64), t2->alphabet64_127);
+	TEST_ASSERT_EQUAL_UINT64(0, t2->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(1ULL << ('Q' - 64), t2->alphabet.bits[CHARS64_127]);
 	TEST_ASSERT_EQUAL_INT(2, t2->size);
 
 	TEST_ASSERT_TRUE(set_find(t2->mem_region, t2->start));
@@ -81,8 +87,8 @@ void test_init_thompson_nfa(void)
 
 	TEST_ASSERT_EQUAL_UINT8(0, tab->accept->ch);
 
-	TEST_ASSERT_EQUAL_UINT64(1ULL << '\t', tab->alphabet0_63);
-	TEST_ASSERT_EQUAL_UINT64(0, tab->alphabet64_127);
+	TEST_ASSERT_EQUAL_UINT64(1ULL << '\t', tab->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, tab->alphabet.bits[CHARS64_127]);
 	TEST_ASSERT_EQUAL_INT(2, tab->size);
 
 	TEST_ASSERT_TRUE(set_find(tab->mem_region, tab->start));
@@ -90,11 +96,38 @@ void test_init_thompson_nfa(void)
 
 	destroy_nfa_and_states(tab);
 
-	// it makes more sense to test wildcard NFAs in gen_nfa_graphviz
-	// since wildcard would call nfa_union() and init_range_nfa()
-	// by the time we generate a graphviz, those other functions have been
-	// well tested. besides, the only way to practically examine an NFA for
-	// the wildcard is by examining the graphviz
+	// the wildcard is one transition on a set of chars
+	NFA *wildcard = init_thompson_nfa(TK_WILDCARD);
+	TEST_ASSERT_NOT_NULL(wildcard);
+	TEST_ASSERT_EQUAL_INT(2, wildcard->size);
+	TEST_ASSERT_EQUAL_INT(CHAR_CLASS, wildcard->start->ch);
+	TEST_ASSERT_EQUAL_UINT64(0xFFFFFFFF00000600,
+	                         wildcard->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0x7FFFFFFFFFFFFFFF,
+	                         wildcard->alphabet.bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(0, wildcard->alphabet.bits[CHARS128_191]);
+	TEST_ASSERT_EQUAL_UINT64(0, wildcard->alphabet.bits[CHARS192_255]);
+	TEST_ASSERT_TRUE(nfastate_reads(wildcard->start, '\t'));
+	TEST_ASSERT_TRUE(nfastate_reads(wildcard->start, '~'));
+	TEST_ASSERT_FALSE(nfastate_reads(wildcard->start, '\r'));
+	TEST_ASSERT_FALSE(nfastate_reads(wildcard->accept, 'a'));
+	destroy_nfa_and_states(wildcard);
+
+	// a class with one char is labeled with that char
+	CharSet chars = {{0}};
+	charset_add(&chars, 'a');
+	NFA *a = init_class_nfa(&chars);
+	TEST_ASSERT_EQUAL_INT('a', a->start->ch);
+	destroy_nfa_and_states(a);
+
+	// bytes past 0x7F are chars too
+	NFA *high = init_thompson_nfa(0xFF);
+	TEST_ASSERT_EQUAL_INT(0xFF, high->start->ch);
+	TEST_ASSERT_TRUE(nfastate_reads(high->start, 0xFF));
+	TEST_ASSERT_FALSE(nfastate_reads(high->start, 0x7F));
+	TEST_ASSERT_EQUAL_UINT64(1ULL << 63, high->alphabet.bits[CHARS192_255]);
+	gen_nfa_graphviz(high, "dots/high.dot");
+	destroy_nfa_and_states(high);
 }
 
 void test_nfa_union(void)
@@ -108,12 +141,12 @@ void test_nfa_union(void)
 	TEST_ASSERT_NOT_NULL(regex);
 	U64 new_alphabet = 1ULL << ('a' - 64);
 	new_alphabet |= (1ULL << ('b' - 64));
-	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet0_63);
-	TEST_ASSERT_EQUAL_UINT64(new_alphabet, regex->alphabet64_127);
+	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(new_alphabet, regex->alphabet.bits[CHARS64_127]);
 	TEST_ASSERT_EQUAL_INT(6, regex->size);
 
 	NFAState *curr = regex->start;
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, curr->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, curr->ch);
 	TEST_ASSERT_NOT_NULL(curr->out1);
 	TEST_ASSERT_NOT_NULL(curr->out2);
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
@@ -125,7 +158,7 @@ void test_nfa_union(void)
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
 
 	curr = curr->out1;
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, curr->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, curr->ch);
 	TEST_ASSERT_EQUAL_PTR(regex->accept, curr->out1);
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
 
@@ -136,13 +169,50 @@ void test_nfa_union(void)
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
 
 	curr = curr->out1;
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, curr->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, curr->ch);
 	TEST_ASSERT_EQUAL_PTR(regex->accept, curr->out1);
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
 
 	destroy_nfa_and_states(regex);
 }
 
+void test_nfa_union_all(void)
+{
+	NFA *a = init_thompson_nfa('a');
+	TEST_ASSERT_EQUAL_PTR(a, nfa_union_all(&a, 1));
+
+	NFA *nfas[4] = {a, init_thompson_nfa('b'), init_thompson_nfa('c'),
+	                init_thompson_nfa('d')};
+	NFA *regex = nfa_union_all(nfas, 4);
+	TEST_ASSERT_EQUAL_PTR(a, regex);
+	TEST_ASSERT_EQUAL_INT(10, regex->size);
+	TEST_ASSERT_EQUAL_INT(10, regex->mem_region->size);
+	U64 alphabet = 0xFULL << ('a' - 64);
+	TEST_ASSERT_EQUAL_UINT64(alphabet, regex->alphabet.bits[CHARS64_127]);
+
+	// one fan-out state, instead of 3 nested unions
+	NFAState *start = regex->start;
+	TEST_ASSERT_EQUAL_INT(EPSILON, start->ch);
+	TEST_ASSERT_EQUAL_INT(2, start->num_outs);
+	NFAState *outs[4] = {start->out1, start->out2, start->outs[0],
+	                     start->outs[1]};
+	for (int i = 0; i < 4; i++) {
+		TEST_ASSERT_EQUAL_UINT8('a' + i, outs[i]->ch);
+		TEST_ASSERT_EQUAL_PTR(regex->accept, outs[i]->out1->out1);
+	}
+
+	// every alternative is one epsilon transition away
+	index_states(regex);
+	Set *closure = epsilon_closure(start);
+	TEST_ASSERT_EQUAL_INT(5, closure->size);
+	for (int i = 0; i < 4; i++)
+		TEST_ASSERT_NOT_NULL(set_find(closure, outs[i]));
+	destroy_set(closure);
+
+	TEST_ASSERT_EQUAL_INT(0, gen_nfa_graphviz(regex, "dots/union_all.dot"));
+	destroy_nfa_and_states(regex);
+}
+
 void test_nfa_append(void)
 {
 	NFA *regex = init_thompson_nfa('x');
@@ -152,8 +222,8 @@ void test_nfa_append(void)
 
 	U64 new_alphabet = 1ULL << ('x' - 64);
 	new_alphabet |= (1ULL << ('y' - 64));
-	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet0_63);
-	TEST_ASSERT_EQUAL_UINT64(new_alphabet, regex->alphabet64_127);
+	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(new_alphabet, regex->alphabet.bits[CHARS64_127]);
 	TEST_ASSERT_EQUAL_INT(4, regex->size);
 
 	NFAState *curr = regex->start;
@@ -163,7 +233,7 @@ void test_nfa_append(void)
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
 
 	curr = curr->out1;
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, curr->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, curr->ch);
 	TEST_ASSERT_NOT_NULL(curr->out1);
 	TEST_ASSERT_NULL(curr->out2);
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
@@ -175,7 +245,7 @@ void test_nfa_append(void)
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
 
 	curr = curr->out1;
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, curr->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, curr->ch);
 	TEST_ASSERT_NULL(curr->out1);
 	TEST_ASSERT_NULL(curr->out2);
 	TEST_ASSERT_EQUAL_PTR(regex->accept, curr);
@@ -197,12 +267,12 @@ void test_transform(void)
 
 	regex = transform(regex, '*');
 	TEST_ASSERT_NOT_NULL(regex);
-	TEST_ASSERT_EQUAL_UINT64((1ULL << '$'), regex->alphabet0_63);
-	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet64_127);
+	TEST_ASSERT_EQUAL_UINT64((1ULL << '$'), regex->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet.bits[CHARS64_127]);
 	TEST_ASSERT_EQUAL_INT(4, regex->size);
 
 	NFAState *curr = regex->start;
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, curr->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, curr->ch);
 	TEST_ASSERT_EQUAL_PTR(regex->accept, curr->out2);
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
 
@@ -212,7 +282,7 @@ void test_transform(void)
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
 
 	curr = curr->out1;
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, curr->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, curr->ch);
 	TEST_ASSERT_NOT_NULL(curr->out1);
 	TEST_ASSERT_EQUAL_PTR(regex->start->out1, curr->out2);
 	TEST_ASSERT_NOT_NULL(curr->out2);
@@ -227,12 +297,12 @@ void test_transform(void)
 
 	regex = transform(regex, '?');
 	TEST_ASSERT_NOT_NULL(regex);
-	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet0_63);
-	TEST_ASSERT_EQUAL_UINT64((1ULL << ('w'-64)), regex->alphabet64_127);
+	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64((1ULL << ('w'-64)), regex->alphabet.bits[CHARS64_127]);
 	TEST_ASSERT_EQUAL_INT(4, regex->size);
 
 	curr = regex->start;
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, curr->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, curr->ch);
 	TEST_ASSERT_NOT_NULL(curr->out1);
 	TEST_ASSERT_NOT_NULL(curr->out2);
 	TEST_ASSERT_EQUAL_PTR(regex->accept, curr->out2);
@@ -244,7 +314,7 @@ void test_transform(void)
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
 
 	curr = curr->out1;
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, curr->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, curr->ch);
 	TEST_ASSERT_NOT_NULL(curr->out1);
 	TEST_ASSERT_EQUAL_PTR(regex->accept, curr->out1);
 	TEST_ASSERT_NULL(curr->out2);
@@ -259,12 +329,12 @@ void test_transform(void)
 	regex = transform(regex, '+');
 	TEST_ASSERT_NOT_NULL(regex);
 	TEST_ASSERT_NOT_NULL(regex);
-	TEST_ASSERT_EQUAL_UINT64((1ULL << ' '), regex->alphabet0_63);
-	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet64_127);
+	TEST_ASSERT_EQUAL_UINT64((1ULL << ' '), regex->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet.bits[CHARS64_127]);
 	TEST_ASSERT_EQUAL_INT(4, regex->size);
 
 	curr = regex->start;
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, curr->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, curr->ch);
 	TEST_ASSERT_NULL(curr->out2);
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
 
@@ -274,7 +344,7 @@ void test_transform(void)
 	TEST_ASSERT_TRUE(set_find(regex->mem_region, curr));
 
 	curr = curr->out1;
-	TEST_ASSERT_EQUAL_UINT8(EPSILON, curr->ch);
+	TEST_ASSERT_EQUAL_INT(EPSILON, curr->ch);
 	TEST_ASSERT_NOT_NULL(curr->out1);
 	TEST_ASSERT_EQUAL_PTR(regex->start->out1, curr->out2);
 	TEST_ASSERT_NOT_NULL(curr->out2);
@@ -293,8 +363,8 @@ void test_transform(void)
 	regex = transform(regex, '*');
 	TEST_ASSERT_NOT_NULL(regex);
 
-	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet0_63);
-	TEST_ASSERT_EQUAL_UINT64(((1ULL << ('a'-64)) | (1ULL << ('b'-64))), regex->alphabet64_127);
+	TEST_ASSERT_EQUAL_UINT64(0, regex->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(((1ULL << ('a'-64)) | (1ULL << ('b'-64))), regex->alphabet.bits[CHARS64_127]);
 	TEST_ASSERT_EQUAL_INT(8, regex->size);
 
 	curr = regex->start;
@@ -316,6 +386,20 @@ void test_init_range_nfa(void)
 {
 	NFA *range = NULL;
 
+	// every range is 2 states, no matter how wide
+	range = init_range_nfa('A', 'Z');
+	TEST_ASSERT_EQUAL_INT(2, range->size);
+	TEST_ASSERT_EQUAL_INT(CHAR_CLASS, range->start->ch);
+	TEST_ASSERT_EQUAL_UINT64(0, range->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(0x7FFFFFE, range->alphabet.bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_UINT64(range->alphabet.bits[CHARS64_127],
+	                         range->start->chars.bits[CHARS64_127]);
+	TEST_ASSERT_EQUAL_PTR(range->accept, range->start->out1);
+	destroy_nfa_and_states(range);
+	range = init_range_nfa('x', 'x');
+	TEST_ASSERT_EQUAL_UINT8('x', range->start->ch);
+	destroy_nfa_and_states(range);
+
 	// [A-B]
 	range = init_range_nfa('A', 'B');
 	TEST_ASSERT_NOT_NULL(range);
@@ -444,8 +528,8 @@ void test_graphviz_other(void)
 	gen_nfa_graphviz(wildcard, "dots/wildcard.dot");
 	U64 exp0_63 = 0xFFFFFFFF00000000 | 1ULL << '\n' | 1ULL << '\t';
 	U64 exp64_127 = 0x7FFFFFFFFFFFFFFF;
-	TEST_ASSERT_EQUAL_UINT64(exp0_63, wildcard->alphabet0_63);
-	TEST_ASSERT_EQUAL_UINT64(exp64_127, wildcard->alphabet64_127);
+	TEST_ASSERT_EQUAL_UINT64(exp0_63, wildcard->alphabet.bits[CHARS0_63]);
+	TEST_ASSERT_EQUAL_UINT64(exp64_127, wildcard->alphabet.bits[CHARS64_127]);
 	destroy_nfa_and_states(wildcard);
 }
 
@@ -487,6 +571,44 @@ void test_epsilon_closure(void)
 	destroy_set(eps);
 }
 
+void test_huge_nfa(void)
+{
+	// a 50000 char literal is 100000 states in a row, which used to be
+	// 100000 nested calls in every traversal
+	char *regex = malloc(2 * HUGE_NFA_SIZE);
+	TEST_ASSERT_NOT_NULL(regex);
+	for (int i = 0; i < HUGE_NFA_SIZE; i++)
+		regex[i] = 'a' + i % 26;
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, regex, HUGE_NFA_SIZE);
+	NFA *nfa = parse(cc);
+	TEST_ASSERT_NOT_NULL(nfa);
+	TEST_ASSERT_EQUAL_INT(2 * HUGE_NFA_SIZE - 1, index_states(nfa));
+	TEST_ASSERT_EQUAL_INT(0, nfa->start->index);
+	TEST_ASSERT_EQUAL_INT(2 * HUGE_NFA_SIZE - 1, nfa->accept->index);
+	TEST_ASSERT_EQUAL_INT(0, gen_nfa_graphviz(nfa, "dots/huge_literal.dot"));
+	destroy_nfa_and_states(nfa);
+
+	// a?a?a?... skips every a with epsilons, so the accept state is in the
+	// epsilon closure of the start state
+	for (int i = 0; i < HUGE_NFA_SIZE; i++) {
+		regex[2 * i] = 'a';
+		regex[2 * i + 1] = '?';
+	}
+	read_line(cc, regex, 2 * HUGE_NFA_SIZE);
+	nfa = parse(cc);
+	TEST_ASSERT_NOT_NULL(nfa);
+	TEST_ASSERT_EQUAL_INT(nfa->size - 1, index_states(nfa));
+	Set *eps = epsilon_closure(nfa->start);
+	TEST_ASSERT_NOT_NULL(eps);
+	TEST_ASSERT_NOT_NULL(set_find(eps, nfa->accept));
+	destroy_set(eps);
+	destroy_nfa_and_states(nfa);
+
+	free(regex);
+	destroy_cmpctrl(cc);
+}
+
 int main(void)
 {
 	UNITY_BEGIN();
@@ -494,12 +616,14 @@ int main(void)
 	RUN_TEST(test_inits);
 	RUN_TEST(test_init_thompson_nfa);
 	RUN_TEST(test_nfa_union);
+	RUN_TEST(test_nfa_union_all);
 	RUN_TEST(test_nfa_append);
 	RUN_TEST(test_transform);
 	RUN_TEST(test_init_range_nfa);
 	RUN_TEST(test_index_states_and_gen_graphviz);
 	RUN_TEST(test_graphviz_other);
 	RUN_TEST(test_epsilon_closure);
+	RUN_TEST(test_huge_nfa);
 
 	return UNITY_END();
 }
\ No newline at end of file
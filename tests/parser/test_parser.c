@@ -1,4 +1,8 @@
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "../../unity/unity.h"
+#include "ast.h"
 #include "common.h"
 #include "control.h"
 #include "nfa.h"
@@ -12,6 +16,8 @@
 	destroy_nfa_and_states((nfa)); \
 }
 
+#define HUGE_REGEX_SIZE 100000
+
 #define SET_BIT(u64, i) (u64) |= (1ULL << (i))
 
 void setUp(void) {}
@@ -79,6 +85,10 @@ void test_parse(void)
 	const char test_54[] = ".*";
 	const char test_55[] = "([abc].)*";
 	const char test_56[] = "a.a";
+	// UTF-8 chars in ranges
+	const char test_57[] = "[\xce\xb1-\xcf\x89]+";
+	const char test_58[] = "[a-\xc3\xa9_]";
+	const char test_59[] = "[\\xc3-\\xff]";
 
 	// for test_24
 	U64 check64_127 = 0;
@@ -134,7 +144,7 @@ void test_parse(void)
 	nfa = parse(cc);
 	TEST_ASSERT_NOT_NULL(nfa);
 	gen_nfa_graphviz(nfa, "dots/test_24.dot");
-	TEST_ASSERT_EQUAL_UINT64(nfa->alphabet64_127, check64_127);
+	TEST_ASSERT_EQUAL_UINT64(nfa->alphabet.bits[CHARS64_127], check64_127);
 	destroy_nfa_and_states(nfa);
 
 	TEST_PARSE_HELPER(cc, test_25, nfa, "dots/test_25.dot");
@@ -169,6 +179,9 @@ void test_parse(void)
 	TEST_PARSE_HELPER(cc, test_54, nfa, "dots/test_54.dot");
 	TEST_PARSE_HELPER(cc, test_55, nfa, "dots/test_55.dot");
 	TEST_PARSE_HELPER(cc, test_56, nfa, "dots/test_56.dot");
+	TEST_PARSE_HELPER(cc, test_57, nfa, "dots/test_57.dot");
+	TEST_PARSE_HELPER(cc, test_58, nfa, "dots/test_58.dot");
+	TEST_PARSE_HELPER(cc, test_59, nfa, "dots/test_59.dot");
 
 	destroy_cmpctrl(cc);
 }
@@ -221,7 +234,63 @@ void test_errors_and_recovery(void)
 	TEST_ERROR_HELPER(cc, "[.-A]",          nfa);
 	TEST_ERROR_HELPER(cc, "[\\(-.]",        nfa);
 	TEST_ERROR_HELPER(cc, "[abc.]",         nfa);
+	TEST_ERROR_HELPER(cc, "{2}",            nfa);
+	TEST_ERROR_HELPER(cc, "a{2}{3}",        nfa);
+	TEST_ERROR_HELPER(cc, "a*{2}",          nfa);
+	TEST_ERROR_HELPER(cc, "a{0}",           nfa);
+	TEST_ERROR_HELPER(cc, "(ab){0,0}",      nfa);
+	TEST_ERROR_HELPER(cc, "[a-z]{5,2}",     nfa);
+	TEST_ERROR_HELPER(cc, "a{1,1001}",      nfa);
+	TEST_ERROR_HELPER(cc, "(a|b){3}?",      nfa);
+
+	// malformed UTF-8 in a range
+	TEST_ERROR_HELPER(cc, "[\xce\xb1-\xcf]", nfa);
+	TEST_ERROR_HELPER(cc, "[\xcf\x89-\xce\xb1]", nfa);
+	TEST_ERROR_HELPER(cc, "[\xe2\x82]", nfa);
+	TEST_ERROR_HELPER(cc, "[\xe0\x80\x80]", nfa);
+	TEST_ERROR_HELPER(cc, "[\\xed\\xa0\\x80]", nfa);
+
+	destroy_cmpctrl(cc);
+}
+
+void test_huge_regex(void)
+{
+	// machine-generated regexes are way too big for a recursive parser,
+	// eg 100000 alternatives or 100000 nested parentheses
+	CmpCtrl *cc = init_cmpctrl();
+	char *regex = malloc(6 * HUGE_REGEX_SIZE + 1);
+	TEST_ASSERT_NOT_NULL(regex);
+	int len = 0;
+	for (int i = 0; i < HUGE_REGEX_SIZE; i++)
+		len += sprintf(regex + len, "%s%04d", i ? "|" : "", i % 10000);
+	read_line(cc, regex, len);
+	AST *ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_EQUAL_INT(AST_ALT, ast->root->kind);
+	// 4 literals and 3 concats per alternative, plus the alternations
+	TEST_ASSERT_EQUAL_INT(8 * HUGE_REGEX_SIZE - 1, ast->num_nodes);
+	// 2 states per literal, and one fan-out and one fan-in state
+	NFA *nfa = thompson(ast->root);
+	TEST_ASSERT_NOT_NULL(nfa);
+	TEST_ASSERT_EQUAL_INT(8 * HUGE_REGEX_SIZE + 2, nfa->size);
+	TEST_ASSERT_EQUAL_INT(8 * HUGE_REGEX_SIZE + 2, nfa->mem_region->size);
+	TEST_ASSERT_EQUAL_INT(HUGE_REGEX_SIZE - 2, nfa->start->num_outs);
+	TEST_ASSERT_EQUAL_INT(8 * HUGE_REGEX_SIZE + 1, index_states(nfa));
+	destroy_nfa_and_states(nfa);
+	destroy_ast(ast);
+
+	for (int i = 0; i < HUGE_REGEX_SIZE; i++) {
+		regex[i] = '(';
+		regex[HUGE_REGEX_SIZE + 1 + i] = ')';
+	}
+	regex[HUGE_REGEX_SIZE] = 'a';
+	read_line(cc, regex, 2 * HUGE_REGEX_SIZE + 1);
+	ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_EQUAL_INT(AST_LITERAL, ast->root->kind);
+	destroy_ast(ast);
 
+	free(regex);
 	destroy_cmpctrl(cc);
 }
 
@@ -231,6 +300,7 @@ int main(void)
 
 	RUN_TEST(test_parse);
 	RUN_TEST(test_errors_and_recovery);
+	RUN_TEST(test_huge_regex);
 
 	return UNITY_END();
 }
\ No newline at end of file
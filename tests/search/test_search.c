@@ -0,0 +1,422 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../unity/unity.h"
+#include "ast.h"
+#include "common.h"
+#include "control.h"
+#include "dfa.h"
+#include "glushkov.h"
+#include "minimize.h"
+#include "parser.h"
+#include "search.h"
+#include "simulate.h"
+
+#define MAX_INPUT_LEN 7
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// minimal DFA of a syntax tree
+static MinimalDFA *minimal_dfa(ASTNode *root)
+{
+	PositionNFA *pnfa = glushkov(root);
+	TEST_ASSERT_NOT_NULL(pnfa);
+	DFA *dfa = convert_glushkov_to_dfa(pnfa);
+	TEST_ASSERT_NOT_NULL(dfa);
+	MinimalDFA *min_dfa = minimize(dfa);
+	TEST_ASSERT_NOT_NULL(min_dfa);
+	destroy_dfa(dfa);
+	destroy_position_nfa(pnfa);
+	return min_dfa;
+}
+
+// the unanchored DFA of a regex, and if @reverse isn't NULL, the other two
+// DFAs search_span() needs, with their end anchors set like main() does
+static SearchDFA *compile_search(CmpCtrl *cc, const char *regex,
+                                 SearchDFA **reverse, SearchDFA **anchored)
+{
+	read_line(cc, regex, strlen(regex));
+	AST *ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	MinimalDFA *min_dfa;
+	if (reverse) {
+		min_dfa = minimal_dfa(ast->root);
+		min_dfa->anchored_end = ast->anchored_end;
+		*anchored = init_search_dfa(min_dfa);
+		TEST_ASSERT_NOT_NULL(*anchored);
+		MinimalDFA *rev = minimize_reverse(min_dfa, NULL);
+		TEST_ASSERT_NOT_NULL(rev);
+		rev->anchored_end = ast->anchored_start;
+		*reverse = init_search_dfa(rev);
+		TEST_ASSERT_NOT_NULL(*reverse);
+		destroy_minimal_dfa(rev);
+		destroy_minimal_dfa(min_dfa);
+	}
+	TEST_ASSERT_NOT_NULL(ast_unanchor(ast));
+	min_dfa = minimal_dfa(ast->root);
+	min_dfa->anchored_end = ast->anchored_end;
+	SearchDFA *sdfa = init_search_dfa(min_dfa);
+	TEST_ASSERT_NOT_NULL(sdfa);
+	destroy_minimal_dfa(min_dfa);
+	destroy_ast(ast);
+	return sdfa;
+}
+
+void test_anchors(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "^ab$", 4);
+	AST *ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_TRUE(ast->anchored_start);
+	TEST_ASSERT_TRUE(ast->anchored_end);
+	TEST_ASSERT_EQUAL_INT(3, ast->num_nodes);
+	// already anchored, so the tree stays the same
+	TEST_ASSERT_EQUAL_PTR(ast->root, ast_unanchor(ast));
+	destroy_ast(ast);
+
+	// anywhere else they're literals
+	read_line(cc, "a^b$c", 5);
+	ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_FALSE(ast->anchored_start);
+	TEST_ASSERT_FALSE(ast->anchored_end);
+	TEST_ASSERT_EQUAL_INT(5, count_positions(ast->root));
+	ASTNode *root = ast->root;
+	TEST_ASSERT_EQUAL_INT(AST_CONCAT, ast_unanchor(ast)->kind);
+	TEST_ASSERT_EQUAL_PTR(root, ast->root->right);
+	TEST_ASSERT_EQUAL_INT(AST_REPEAT, ast->root->left->kind);
+	destroy_ast(ast);
+
+	read_line(cc, "(?i)^\\^a\\$", 10);
+	ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_TRUE(ast->anchored_start);
+	TEST_ASSERT_FALSE(ast->anchored_end);
+	TEST_ASSERT_EQUAL_INT(3, count_positions(ast->root));
+	destroy_ast(ast);
+
+	// anchors alone are an empty regex
+	read_line(cc, "^$", 2);
+	cc->flags |= CC_DISABLE_ERROR_MSG;
+	TEST_ASSERT_NULL(parse_ast(cc));
+
+	destroy_cmpctrl(cc);
+}
+
+// contents of a whole file, which the caller frees
+static char *read_whole_file(const char *file_name)
+{
+	FILE *f = fopen(file_name, "rb");
+	TEST_ASSERT_NOT_NULL(f);
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	rewind(f);
+	char *contents = calloc(len + 1, 1);
+	TEST_ASSERT_NOT_NULL(contents);
+	TEST_ASSERT_EQUAL_INT(len, fread(contents, 1, len, f));
+	fclose(f);
+	return contents;
+}
+
+void test_end_anchor_output(void)
+{
+	// $ doesn't change the transitions of the DFA that -u compiles, so it
+	// has to be carried along to the DOT file
+	const char *regexes[] = {"ab", "ab$"};
+	const char *files[] = {"dots/ab.dot", "dots/ab_anchored.dot"};
+	char *dots[2];
+	CmpCtrl *cc = init_cmpctrl();
+	for (int i = 0; i < 2; i++) {
+		read_line(cc, regexes[i], strlen(regexes[i]));
+		AST *ast = parse_ast(cc);
+		TEST_ASSERT_NOT_NULL(ast);
+		TEST_ASSERT_NOT_NULL(ast_unanchor(ast));
+		MinimalDFA *min_dfa = minimal_dfa(ast->root);
+		min_dfa->anchored_end = ast->anchored_end;
+		TEST_ASSERT_EQUAL_INT(0, gen_minimal_dfa_graphviz(min_dfa,
+		                      files[i]));
+		dots[i] = read_whole_file(files[i]);
+		destroy_minimal_dfa(min_dfa);
+		destroy_ast(ast);
+	}
+	TEST_ASSERT_NULL(strstr(dots[0], "end of the input"));
+	TEST_ASSERT_NOT_NULL(strstr(dots[1], "end of the input"));
+	TEST_ASSERT_NOT_EQUAL(0, strcmp(dots[0], dots[1]));
+	free(dots[0]);
+	free(dots[1]);
+	destroy_cmpctrl(cc);
+}
+
+void test_search(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+
+	SearchDFA *sdfa = compile_search(cc, "ab+", NULL, NULL);
+	TEST_ASSERT_EQUAL_INT(4, search_dfa(sdfa, "xxabbbyab", 9,
+	                                    SEARCH_EARLIEST));
+	TEST_ASSERT_EQUAL_INT(9, search_dfa(sdfa, "xxabbbyab", 9,
+	                                    SEARCH_LONGEST));
+	TEST_ASSERT_EQUAL_INT(SEARCH_NO_MATCH, search_dfa(sdfa, "bbba", 4,
+	                                                  SEARCH_LONGEST));
+	destroy_search_dfa(sdfa);
+
+	// a dead state ends the search
+	sdfa = compile_search(cc, "^ab+", NULL, NULL);
+	TEST_ASSERT_EQUAL_INT(2, search_dfa(sdfa, "abbbxab", 7,
+	                                    SEARCH_EARLIEST));
+	TEST_ASSERT_EQUAL_INT(4, search_dfa(sdfa, "abbbxab", 7,
+	                                    SEARCH_LONGEST));
+	TEST_ASSERT_EQUAL_INT(SEARCH_NO_MATCH, search_dfa(sdfa, "xab", 3,
+	                                                  SEARCH_EARLIEST));
+	destroy_search_dfa(sdfa);
+
+	sdfa = compile_search(cc, "ab$", NULL, NULL);
+	TEST_ASSERT_EQUAL_INT(4, search_dfa(sdfa, "abab", 4, SEARCH_EARLIEST));
+	TEST_ASSERT_EQUAL_INT(SEARCH_NO_MATCH, search_dfa(sdfa, "aba", 3,
+	                                                  SEARCH_LONGEST));
+	destroy_search_dfa(sdfa);
+
+	// the empty regex matches right away
+	sdfa = compile_search(cc, "a*", NULL, NULL);
+	TEST_ASSERT_EQUAL_INT(0, search_dfa(sdfa, "aaa", 3, SEARCH_EARLIEST));
+	TEST_ASSERT_EQUAL_INT(3, search_dfa(sdfa, "aaa", 3, SEARCH_LONGEST));
+	destroy_search_dfa(sdfa);
+
+	destroy_cmpctrl(cc);
+}
+
+void test_search_span(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	SearchDFA *reverse, *anchored;
+	SearchDFA *forward = compile_search(cc, "[0-9]{3}-[0-9]{4}", &reverse,
+	                                    &anchored);
+	const char *line = "call 555-1234 or 555-9876";
+	int begin, end;
+	TEST_ASSERT_TRUE(search_span(anchored, reverse, line, 25,
+	                             &begin, &end));
+	TEST_ASSERT_EQUAL_INT(5, begin);
+	TEST_ASSERT_EQUAL_INT(13, end);
+	TEST_ASSERT_TRUE(search_span(anchored, reverse, line + end,
+	                             25 - end, &begin, &end));
+	TEST_ASSERT_EQUAL_INT(4, begin);
+	TEST_ASSERT_EQUAL_INT(12, end);
+	TEST_ASSERT_FALSE(search_span(anchored, reverse, line, 12,
+	                              &begin, &end));
+	destroy_search_dfa(forward);
+	destroy_search_dfa(reverse);
+	destroy_search_dfa(anchored);
+
+	// the leftmost match wins, even if another one ends first
+	forward = compile_search(cc, "abcd|c", &reverse, &anchored);
+	TEST_ASSERT_TRUE(search_span(anchored, reverse, "abcd", 4,
+	                             &begin, &end));
+	TEST_ASSERT_EQUAL_INT(0, begin);
+	TEST_ASSERT_EQUAL_INT(4, end);
+	destroy_search_dfa(forward);
+	destroy_search_dfa(reverse);
+	destroy_search_dfa(anchored);
+
+	// and among those, the longest
+	forward = compile_search(cc, "a+", &reverse, &anchored);
+	TEST_ASSERT_TRUE(search_span(anchored, reverse, "aaa", 3,
+	                             &begin, &end));
+	TEST_ASSERT_EQUAL_INT(0, begin);
+	TEST_ASSERT_EQUAL_INT(3, end);
+	destroy_search_dfa(forward);
+	destroy_search_dfa(reverse);
+	destroy_search_dfa(anchored);
+
+	forward = compile_search(cc, "a+b", &reverse, &anchored);
+	TEST_ASSERT_TRUE(search_span(anchored, reverse, "xaaab", 5,
+	                             &begin, &end));
+	TEST_ASSERT_EQUAL_INT(1, begin);
+	TEST_ASSERT_EQUAL_INT(5, end);
+	// reading back from the end, the shortest match starts at 3
+	TEST_ASSERT_EQUAL_INT(3, search_dfa_reverse(reverse, "xaaab", 5,
+	                                            SEARCH_EARLIEST));
+	destroy_search_dfa(forward);
+	destroy_search_dfa(reverse);
+	destroy_search_dfa(anchored);
+
+	destroy_cmpctrl(cc);
+}
+
+// leftmost start from @from of a match that ends at @end, SEARCH_NO_MATCH if
+// none does, where ^ means offset @from
+static int first_start(PositionVM *pvm, AST *ast, const char *input,
+                       int from, int end)
+{
+	for (int begin = from; begin <= end; begin++) {
+		if (ast->anchored_start && begin != from)
+			break;
+		if (position_vm_match(pvm, input + begin, end - begin))
+			return begin;
+	}
+	return SEARCH_NO_MATCH;
+}
+
+// every input of up to MAX_INPUT_LEN chars from "abx" must give the same spans
+// as trying every substring with a PositionVM
+static void check_search(CmpCtrl *cc, const char *regex)
+{
+	SearchDFA *reverse, *anchored;
+	SearchDFA *sdfa = compile_search(cc, regex, &reverse, &anchored);
+	read_line(cc, regex, strlen(regex));
+	AST *ast = parse_ast(cc);
+	PositionNFA *pnfa = glushkov(ast->root);
+	PositionVM *pvm = init_position_vm(pnfa);
+	TEST_ASSERT_NOT_NULL(pvm);
+
+	char input[MAX_INPUT_LEN];
+	int digits[MAX_INPUT_LEN];
+	int earliest, longest, leftmost, leftmost_end, begin;
+	int span_begin, span_end;
+	for (int len = 0; len <= MAX_INPUT_LEN; len++) {
+		memset(digits, 0, sizeof(digits));
+		for (;;) {
+			for (int i = 0; i < len; i++)
+				input[i] = "abx"[digits[i]];
+			earliest = longest = SEARCH_NO_MATCH;
+			for (int end = 0; end <= len; end++) {
+				if (ast->anchored_end && end != len)
+					continue;
+				if (first_start(pvm, ast, input, 0, end) ==
+				    SEARCH_NO_MATCH)
+					continue;
+				if (earliest == SEARCH_NO_MATCH)
+					earliest = end;
+				longest = end;
+			}
+			TEST_ASSERT_EQUAL_INT(earliest, search_dfa(sdfa, input,
+			                      len, SEARCH_EARLIEST));
+			TEST_ASSERT_EQUAL_INT(longest, search_dfa(sdfa, input,
+			                      len, SEARCH_LONGEST));
+
+			// every match, searching again from the end of the
+			// last one like the caller of search_span() would
+			for (int from = 0; from <= len;) {
+				leftmost = leftmost_end = SEARCH_NO_MATCH;
+				for (int end = from; end <= len; end++) {
+					if (ast->anchored_end && end != len)
+						continue;
+					begin = first_start(pvm, ast, input,
+					                    from, end);
+					// the leftmost start, and the longest
+					// match that starts there
+					if (begin != SEARCH_NO_MATCH &&
+					    (leftmost == SEARCH_NO_MATCH ||
+					     begin <= leftmost)) {
+						leftmost = begin;
+						leftmost_end = end;
+					}
+				}
+				TEST_ASSERT_EQUAL(leftmost != SEARCH_NO_MATCH,
+				                  search_span(anchored, reverse,
+				                              input + from,
+				                              len - from,
+				                              &span_begin,
+				                              &span_end));
+				if (leftmost == SEARCH_NO_MATCH)
+					break;
+				TEST_ASSERT_EQUAL_INT(leftmost,
+				                      from + span_begin);
+				TEST_ASSERT_EQUAL_INT(leftmost_end,
+				                      from + span_end);
+				from = leftmost_end;
+				if (leftmost == leftmost_end)
+					from++;
+			}
+			int i = 0;
+			while (i < len && ++digits[i] == 3)
+				digits[i++] = 0;
+			if (i == len)
+				break;
+		}
+	}
+
+	destroy_position_vm(pvm);
+	destroy_position_nfa(pnfa);
+	destroy_ast(ast);
+	destroy_search_dfa(sdfa);
+	destroy_search_dfa(reverse);
+	destroy_search_dfa(anchored);
+}
+
+void test_search_every_input(void)
+{
+	const char *regexes[] = {
+		"ab", "a*b", "^ab*", "(ab|b)a$", "^(a|x)+$", "a?", "b{2,3}",
+		"[ab]x[ab]", "^x*a*$", "(a|bb)*x", "xab|b", "a(b|x)*a", "a+",
+		"abxa|bx|x+$"
+	};
+	CmpCtrl *cc = init_cmpctrl();
+	for (size_t i = 0; i < sizeof(regexes) / sizeof(regexes[0]); i++)
+		check_search(cc, regexes[i]);
+	destroy_cmpctrl(cc);
+}
+
+void test_search_every_match(void)
+{
+	// one match every 8 chars, which takes quadratic time if each search
+	// reads the rest of the input
+	enum { LEN = 1 << 20 };
+	char *input = malloc(LEN);
+	TEST_ASSERT_NOT_NULL(input);
+	for (int i = 0; i < LEN; i++)
+		input[i] = i % 8 == 3 ? 'a' : 'x';
+	CmpCtrl *cc = init_cmpctrl();
+	SearchDFA *reverse, *anchored;
+	SearchDFA *forward = compile_search(cc, "a", &reverse, &anchored);
+	int begin, end;
+	int count = 0;
+	for (int from = 0;
+	     search_span(anchored, reverse, input + from, LEN - from, &begin,
+	                 &end);
+	     from += end) {
+		TEST_ASSERT_EQUAL_INT(8 * count + 3, from + begin);
+		TEST_ASSERT_EQUAL_INT(8 * count + 4, from + end);
+		count++;
+	}
+	TEST_ASSERT_EQUAL_INT(LEN / 8, count);
+	destroy_search_dfa(forward);
+	destroy_search_dfa(reverse);
+	destroy_search_dfa(anchored);
+
+	// a match that starts earlier wins even if it ends later
+	memset(input, 'x', LEN);
+	for (int i = 0; i + 4 <= LEN; i += 8)
+		memcpy(input + i, "abcd", 4);
+	forward = compile_search(cc, "abcd|c|xx", &reverse, &anchored);
+	count = 0;
+	for (int from = 0;
+	     search_span(anchored, reverse, input + from, LEN - from, &begin,
+	                 &end);
+	     from += end) {
+		// abcd, then xx twice
+		TEST_ASSERT_EQUAL_INT(count % 3 ? 2 : 4, end - begin);
+		count++;
+	}
+	TEST_ASSERT_EQUAL_INT(3 * (LEN / 8), count);
+	destroy_search_dfa(forward);
+	destroy_search_dfa(reverse);
+	destroy_search_dfa(anchored);
+	destroy_cmpctrl(cc);
+	free(input);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_anchors);
+	RUN_TEST(test_end_anchor_output);
+	RUN_TEST(test_search);
+	RUN_TEST(test_search_span);
+	RUN_TEST(test_search_every_input);
+	RUN_TEST(test_search_every_match);
+	return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../unity/unity.h"
+#include "../examples.h"
+#include "ast.h"
+#include "control.h"
+#include "dfa.h"
+#include "minimize.h"
+#include "nfa.h"
+#include "parser.h"
+#include "simplify.h"
+
+// keya|keyb|...|keyz|keba|...
+#define NUM_KEYWORDS 200
+#define KEYWORDS_SIZE (NUM_KEYWORDS * 6 + 1)
+
+// abc|xyz|abc|xyz|...
+#define NUM_COPIES 10000
+
+// ((aaa)*0)|((aab)*0)|...
+#define NUM_KEYS 10000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// parse both regexes, simplify the first, and check they're the same tree
+#define TEST_SIMPLIFY_HELPER(cc, regex, expected) \
+	do { \
+		read_line((cc), (regex), strlen((regex))); \
+		AST *before = parse_ast((cc)); \
+		TEST_ASSERT_TRUE(simplify_ast(before)); \
+		read_line((cc), (expected), strlen((expected))); \
+		AST *after = parse_ast((cc)); \
+		TEST_ASSERT_TRUE(ast_equal(before->root, after->root)); \
+		destroy_ast(before); \
+		destroy_ast(after); \
+	} while (0)
+
+void test_simplify(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+
+	// nested quantifiers
+	TEST_SIMPLIFY_HELPER(cc, "(a*)*", "a*");
+	TEST_SIMPLIFY_HELPER(cc, "(a+)+", "a+");
+	TEST_SIMPLIFY_HELPER(cc, "(a?)?", "a?");
+	TEST_SIMPLIFY_HELPER(cc, "(x?)+", "x*");
+	TEST_SIMPLIFY_HELPER(cc, "(a+)?", "a*");
+	TEST_SIMPLIFY_HELPER(cc, "((a*)+)?", "a*");
+
+	// quantifiers of nullable subtrees
+	TEST_SIMPLIFY_HELPER(cc, "(a*b?)+", "(a*b?)*");
+	TEST_SIMPLIFY_HELPER(cc, "(a*b?)?", "a*b?");
+
+	// char alternatives become one class
+	TEST_SIMPLIFY_HELPER(cc, "[ab]|c", "[a-c]");
+	TEST_SIMPLIFY_HELPER(cc, "a|b|c", "[abc]");
+	TEST_SIMPLIFY_HELPER(cc, "a|a", "a");
+	TEST_SIMPLIFY_HELPER(cc, "[a]", "a");
+	TEST_SIMPLIFY_HELPER(cc, "xy|a|zw|b", "xy|[ab]|zw");
+	TEST_SIMPLIFY_HELPER(cc, "a|.", ".");
+
+	// duplicate alternatives
+	TEST_SIMPLIFY_HELPER(cc, "ab|cd|ab", "ab|cd");
+	TEST_SIMPLIFY_HELPER(cc, "(ab|cd)|(cd|ab)", "ab|cd");
+	TEST_SIMPLIFY_HELPER(cc, "a*[b]|x+|a*b", "a*b|x+");
+	TEST_SIMPLIFY_HELPER(cc, "(ab)*|(ab)+|(ab)*", "(ab)*|(ab)+");
+
+	// common prefixes
+	TEST_SIMPLIFY_HELPER(cc, "abc|abd", "ab[cd]");
+	TEST_SIMPLIFY_HELPER(cc, "abc|x|abd", "ab[cd]|x");
+	TEST_SIMPLIFY_HELPER(cc, "\\+|\\+\\+|\\+=", "\\+[\\+=]?");
+	TEST_SIMPLIFY_HELPER(cc, "int|if|in", "i(nt?|f)");
+	TEST_SIMPLIFY_HELPER(cc, "a*b|a*c", "a*[bc]");
+
+	// common suffixes
+	TEST_SIMPLIFY_HELPER(cc, "ab|cb", "[ac]b");
+	TEST_SIMPLIFY_HELPER(cc, "==|!=", "[=!]=");
+	TEST_SIMPLIFY_HELPER(cc, "xab|yab|b", "([xy]a)?b");
+
+	// groups are already gone
+	TEST_SIMPLIFY_HELPER(cc, "(((a)))", "a");
+
+	// nothing to do
+	TEST_SIMPLIFY_HELPER(cc, "ab*c", "ab*c");
+
+	destroy_cmpctrl(cc);
+}
+
+void test_equivalence(void)
+{
+	// simplification can only shrink the syntax tree and the Thompson NFA,
+	// and the minimal DFA must not change
+	CmpCtrl *cc = init_cmpctrl();
+	AST *ast;
+	NFA *nfa;
+	DFA *dfa;
+	MinimalDFA *min_before, *min_dfa;
+	int nodes_before, nfa_before;
+	for (int i = 0; i < NUM_EXAMPLES; i++) {
+		ast = read_example(cc, examples[i]);
+		nodes_before = count_nodes(ast->root);
+		nfa = thompson(ast->root);
+		nfa_before = nfa->size;
+		dfa = convert_nfa_to_dfa(nfa);
+		min_before = minimize(dfa);
+		destroy_dfa(dfa);
+		destroy_nfa_and_states(nfa);
+
+		TEST_ASSERT_TRUE(simplify_ast(ast));
+		TEST_ASSERT_TRUE(count_nodes(ast->root) <= nodes_before);
+		nfa = thompson(ast->root);
+		TEST_ASSERT_TRUE(nfa->size <= nfa_before);
+		dfa = convert_nfa_to_dfa(nfa);
+		min_dfa = minimize(dfa);
+		TEST_ASSERT_EQUAL_INT(min_before->size, min_dfa->size);
+		TEST_ASSERT_TRUE(same_language(min_before, min_dfa));
+
+		destroy_minimal_dfa(min_before);
+		destroy_minimal_dfa(min_dfa);
+		destroy_dfa(dfa);
+		destroy_nfa_and_states(nfa);
+		destroy_ast(ast);
+	}
+
+	// the single char tokens of c_tokens all merge into the wildcard
+	TEST_ASSERT_EQUAL_INT(0, read_file(cc, "../../examples/c_tokens.txt"));
+	ast = parse_ast(cc);
+	nfa = thompson(ast->root);
+	nfa_before = nfa->size;
+	destroy_nfa_and_states(nfa);
+	simplify_ast(ast);
+	nfa = thompson(ast->root);
+	TEST_ASSERT_TRUE(nfa->size < nfa_before * 2 / 3);
+	destroy_nfa_and_states(nfa);
+	destroy_ast(ast);
+
+	// a keyword list collapses into a trie
+	char keywords[KEYWORDS_SIZE];
+	int len = 0;
+	for (int i = 0; i < NUM_KEYWORDS; i++) {
+		len += sprintf(keywords + len, "%skey%c%c", i ? "|" : "",
+		               'a' + i / 26, 'a' + i % 26);
+	}
+	read_line(cc, keywords, len);
+	ast = parse_ast(cc);
+	nfa = thompson(ast->root);
+	nfa_before = nfa->size;
+	destroy_nfa_and_states(nfa);
+	simplify_ast(ast);
+	nfa = thompson(ast->root);
+	TEST_ASSERT_TRUE(nfa->size < nfa_before / 10);
+	destroy_nfa_and_states(nfa);
+	destroy_ast(ast);
+
+	destroy_cmpctrl(cc);
+}
+
+void test_duplicates(void)
+{
+	// every copy is dropped without comparing it to all the others
+	CmpCtrl *cc = init_cmpctrl();
+	char *regex = malloc(NUM_COPIES * 8);
+	TEST_ASSERT_NOT_NULL(regex);
+	int len = 0;
+	for (int i = 0; i < NUM_COPIES; i++)
+		len += sprintf(regex + len, "%sabc|xyz", i ? "|" : "");
+	read_line(cc, regex, len);
+	AST *ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_EQUAL_INT(6 * NUM_COPIES, count_positions(ast->root));
+	TEST_ASSERT_TRUE(simplify_ast(ast));
+	read_line(cc, "abc|xyz", 7);
+	AST *expected = parse_ast(cc);
+	TEST_ASSERT_TRUE(ast_equal(expected->root, ast->root));
+
+	destroy_ast(expected);
+	destroy_ast(ast);
+	free(regex);
+	destroy_cmpctrl(cc);
+}
+
+void test_distinct_keys(void)
+{
+	// no two alternatives start the same way, but they all end the same,
+	// so there are as many groups of prefixes as alternatives
+	CmpCtrl *cc = init_cmpctrl();
+	char *regex = malloc(NUM_KEYS * 12);
+	TEST_ASSERT_NOT_NULL(regex);
+	int len = 0;
+	for (int i = 0; i < NUM_KEYS; i++) {
+		len += sprintf(regex + len, "%s((%c%c%c)*0)", i ? "|" : "",
+		               'a' + i / 676, 'a' + i / 26 % 26, 'a' + i % 26);
+	}
+	read_line(cc, regex, len);
+	AST *ast = parse_ast(cc);
+	TEST_ASSERT_NOT_NULL(ast);
+	TEST_ASSERT_TRUE(simplify_ast(ast));
+	// ((aaa)*|(aab)*|...)0
+	TEST_ASSERT_EQUAL_INT(AST_CONCAT, ast->root->kind);
+	TEST_ASSERT_EQUAL_INT(AST_ALT, ast->root->left->kind);
+	TEST_ASSERT_EQUAL_INT(AST_LITERAL, ast->root->right->kind);
+	TEST_ASSERT_EQUAL_INT(3 * NUM_KEYS + 1, count_positions(ast->root));
+
+	destroy_ast(ast);
+	free(regex);
+	destroy_cmpctrl(cc);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_simplify);
+	RUN_TEST(test_equivalence);
+	RUN_TEST(test_duplicates);
+	RUN_TEST(test_distinct_keys);
+
+	return UNITY_END();
+}
\ No newline at end of file
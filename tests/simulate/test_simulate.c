@@ -0,0 +1,273 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "../../unity/unity.h"
+#include "charset.h"
+#include "common.h"
+#include "control.h"
+#include "glushkov.h"
+#include "nfa.h"
+#include "parser.h"
+#include "simulate.h"
+
+#define TEST_MATCH_HELPER(vm, str, expected) \
+	TEST_ASSERT_EQUAL((expected), pikevm_match((vm), (str), sizeof((str))-1))
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_sparse_set(void)
+{
+	SparseSet *ss = init_sparse_set(10);
+	TEST_ASSERT_NOT_NULL(ss);
+	TEST_ASSERT_EQUAL_INT(0, ss->size);
+	for (int i = 0; i < 10; i++)
+		TEST_ASSERT_FALSE(sparse_set_contains(ss, i));
+
+	sparse_set_insert(ss, 7);
+	sparse_set_insert(ss, 2);
+	sparse_set_insert(ss, 9);
+	TEST_ASSERT_EQUAL_INT(3, ss->size);
+	TEST_ASSERT_TRUE(sparse_set_contains(ss, 7));
+	TEST_ASSERT_TRUE(sparse_set_contains(ss, 2));
+	TEST_ASSERT_TRUE(sparse_set_contains(ss, 9));
+	TEST_ASSERT_FALSE(sparse_set_contains(ss, 0));
+	TEST_ASSERT_FALSE(sparse_set_contains(ss, 3));
+
+	// iteration follows insertion order
+	int expected[] = {7, 2, 9};
+	TEST_ASSERT_EQUAL_INT_ARRAY(expected, ss->dense, 3);
+
+	sparse_set_clear(ss);
+	TEST_ASSERT_EQUAL_INT(0, ss->size);
+	TEST_ASSERT_FALSE(sparse_set_contains(ss, 7));
+	TEST_ASSERT_FALSE(sparse_set_contains(ss, 2));
+	TEST_ASSERT_FALSE(sparse_set_contains(ss, 9));
+
+	destroy_sparse_set(ss);
+}
+
+void test_init_pikevm(void)
+{
+	// a(b|c)*
+	// see /tests/nfa/svgs/cooper_torczon_example2.5.svg
+	CmpCtrl *cc = init_cmpctrl();
+	read_line(cc, "a(b|c)*", 7);
+	NFA *nfa = parse(cc);
+	PikeVM *vm = init_pikevm(nfa);
+	TEST_ASSERT_NOT_NULL(vm);
+
+	TEST_ASSERT_EQUAL_INT(nfa->size, vm->num_states);
+	TEST_ASSERT_EQUAL_INT(nfa->start->index, vm->start);
+	TEST_ASSERT_EQUAL_INT(nfa->accept->index, vm->accept);
+	TEST_ASSERT_EQUAL_INT('a', charset_single(&vm->chars[vm->start]));
+	TEST_ASSERT_EQUAL_INT(nfa->start->out1->index, vm->outs[vm->start]);
+
+	// the accept state has no transitions at all
+	TEST_ASSERT_EQUAL_INT(-1, vm->outs[vm->accept]);
+	TEST_ASSERT_EQUAL_INT(vm->eps_begin[vm->accept],
+	                      vm->eps_begin[vm->accept + 1]);
+
+	// every epsilon state has 1 or 2 edges, every char state has none
+	int num_edges;
+	for (int i = 0; i < vm->num_states; i++) {
+		num_edges = vm->eps_begin[i+1] - vm->eps_begin[i];
+		if (!charset_is_empty(&vm->chars[i]))
+			TEST_ASSERT_EQUAL_INT(0, num_edges);
+		else if (i != vm->accept)
+			TEST_ASSERT_TRUE(num_edges == 1 || num_edges == 2);
+	}
+
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+	destroy_cmpctrl(cc);
+}
+
+void test_pikevm_match(void)
+{
+	CmpCtrl *cc = init_cmpctrl();
+	NFA *nfa;
+	PikeVM *vm;
+
+	read_line(cc, "a(b|c)*", 7);
+	nfa = parse(cc);
+	vm = init_pikevm(nfa);
+	TEST_MATCH_HELPER(vm, "a", true);
+	TEST_MATCH_HELPER(vm, "ab", true);
+	TEST_MATCH_HELPER(vm, "ac", true);
+	TEST_MATCH_HELPER(vm, "abcbcbbbccc", true);
+	TEST_MATCH_HELPER(vm, "", false);
+	TEST_MATCH_HELPER(vm, "b", false);
+	TEST_MATCH_HELPER(vm, "aa", false);
+	TEST_MATCH_HELPER(vm, "abca", false);
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+
+	read_line(cc, "(0|1)*11001*", 12);
+	nfa = parse(cc);
+	vm = init_pikevm(nfa);
+	TEST_MATCH_HELPER(vm, "1100", true);
+	TEST_MATCH_HELPER(vm, "11001", true);
+	TEST_MATCH_HELPER(vm, "0101110011111", true);
+	TEST_MATCH_HELPER(vm, "110", false);
+	TEST_MATCH_HELPER(vm, "11002", false);
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+
+	read_line(cc, "a*", 2);
+	nfa = parse(cc);
+	vm = init_pikevm(nfa);
+	TEST_MATCH_HELPER(vm, "", true);
+	TEST_MATCH_HELPER(vm, "a", true);
+	TEST_MATCH_HELPER(vm, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", true);
+	TEST_MATCH_HELPER(vm, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", false);
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+
+	read_line(cc, "(ab|c){2,3}d", 12);
+	nfa = parse(cc);
+	vm = init_pikevm(nfa);
+	TEST_MATCH_HELPER(vm, "abcd", true);
+	TEST_MATCH_HELPER(vm, "ccd", true);
+	TEST_MATCH_HELPER(vm, "ababcd", true);
+	TEST_MATCH_HELPER(vm, "cd", false);
+	TEST_MATCH_HELPER(vm, "ababcabd", false);
+	TEST_MATCH_HELPER(vm, "abab", false);
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+
+	read_line(cc, "x{3,}", 5);
+	nfa = parse(cc);
+	vm = init_pikevm(nfa);
+	TEST_MATCH_HELPER(vm, "xx", false);
+	TEST_MATCH_HELPER(vm, "xxx", true);
+	TEST_MATCH_HELPER(vm, "xxxxxxxxxxxxxxxxxxxx", true);
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+
+	read_line(cc, "[A-Za-z_][A-Za-z0-9_]*", 22);
+	nfa = parse(cc);
+	vm = init_pikevm(nfa);
+	TEST_MATCH_HELPER(vm, "_", true);
+	TEST_MATCH_HELPER(vm, "main", true);
+	TEST_MATCH_HELPER(vm, "init_pikevm", true);
+	TEST_MATCH_HELPER(vm, "NUM_ASCII_CHARS", true);
+	TEST_MATCH_HELPER(vm, "9lives", false);
+	TEST_MATCH_HELPER(vm, "two words", false);
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+
+	// wildcard patterns that the subset construction struggles with
+	read_line(cc, "a.*a", 4);
+	nfa = parse(cc);
+	vm = init_pikevm(nfa);
+	TEST_MATCH_HELPER(vm, "aa", true);
+	TEST_MATCH_HELPER(vm, "a\tb\nc a", true);
+	TEST_MATCH_HELPER(vm, "a", false);
+	TEST_MATCH_HELPER(vm, "ab", false);
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+
+	read_line(cc, "\\(x\\|y\\)", 8);
+	nfa = parse(cc);
+	vm = init_pikevm(nfa);
+	TEST_MATCH_HELPER(vm, "(x|y)", true);
+	TEST_MATCH_HELPER(vm, "x", false);
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+
+	// UTF-8 bytes and DEL are chars like any other
+	read_line(cc, "caf\\xc3\\xa9\\x7f", 15);
+	nfa = parse(cc);
+	vm = init_pikevm(nfa);
+	TEST_MATCH_HELPER(vm, "caf\xc3\xa9\x7f", true);
+	TEST_MATCH_HELPER(vm, "caf\xc3\xa8\x7f", false);
+	TEST_MATCH_HELPER(vm, "caf\xc3\xa9", false);
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+
+	// [α-ω]+ reads whole UTF-8 chars
+	read_line(cc, "[\xce\xb1-\xcf\x89]+", 8);
+	nfa = parse(cc);
+	vm = init_pikevm(nfa);
+	TEST_MATCH_HELPER(vm, "\xce\xbb\xce\xbf\xce\xb3\xce\xbf\xcf\x82", true);
+	TEST_MATCH_HELPER(vm, "\xce\xb1", true);
+	TEST_MATCH_HELPER(vm, "\xce\xb1\xce", false);
+	TEST_MATCH_HELPER(vm, "\xce\x91", false);
+	TEST_MATCH_HELPER(vm, "\xcf\x8c", false);
+	TEST_MATCH_HELPER(vm, "a", false);
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+
+	read_file(cc, "../../examples/c_tokens.txt");
+	nfa = parse(cc);
+	vm = init_pikevm(nfa);
+	TEST_MATCH_HELPER(vm, "->", true);
+	TEST_MATCH_HELPER(vm, "<<", true);
+	TEST_MATCH_HELPER(vm, "!=", true);
+	TEST_MATCH_HELPER(vm, "x", true);
+	TEST_MATCH_HELPER(vm, "identifier_123", true);
+	TEST_MATCH_HELPER(vm, "<<=", false);
+	TEST_MATCH_HELPER(vm, "===", false);
+	destroy_pikevm(vm);
+	destroy_nfa_and_states(nfa);
+
+	destroy_cmpctrl(cc);
+}
+
+void test_position_vm_match(void)
+{
+	// the epsilon-free NFA must agree with the Pike VM on every input
+	static const char *regexes[] = {
+		"a(b|c)*", "(0|1)*11001*", "a*", "[A-Za-z_][A-Za-z0-9_]*",
+		"a.*a", "(a|b|c)?d?", "(ab|a)(bc|c)*", "\\xff\\x80[\\x01-\\x7f]+",
+		"[a-z\xce\xb1-\xcf\x89]+"
+	};
+	static const char *inputs[] = {
+		"", "a", "ab", "ac", "abcbcbbbccc", "aa", "abca", "1100",
+		"0101110011111", "11002", "_", "init_pikevm", "9lives",
+		"a\tb\nc a", "d", "bd", "abcc", "abbc", "\xff\x80\x7f\x01",
+		"\xff\x80\x81", "\xff\x80", "\x80", "\xce\xbb\xce\xbf\xce\xb3os",
+		"\xce\xbb\xce"
+	};
+	int num_regexes = sizeof(regexes) / sizeof(regexes[0]);
+	int num_inputs = sizeof(inputs) / sizeof(inputs[0]);
+
+	CmpCtrl *cc = init_cmpctrl();
+	NFA *nfa;
+	PikeVM *vm;
+	PositionNFA *pnfa;
+	PositionVM *pvm;
+	for (int i = 0; i < num_regexes; i++) {
+		read_line(cc, regexes[i], strlen(regexes[i]));
+		nfa = parse(cc);
+		TEST_ASSERT_NOT_NULL(nfa);
+		vm = init_pikevm(nfa);
+		pnfa = remove_epsilons(nfa);
+		pvm = init_position_vm(pnfa);
+		TEST_ASSERT_NOT_NULL(pvm);
+		for (int j = 0; j < num_inputs; j++) {
+			TEST_ASSERT_EQUAL(pikevm_match(vm, inputs[j],
+			                               strlen(inputs[j])),
+			                  position_vm_match(pvm, inputs[j],
+			                                    strlen(inputs[j])));
+		}
+		destroy_position_vm(pvm);
+		destroy_position_nfa(pnfa);
+		destroy_pikevm(vm);
+		destroy_nfa_and_states(nfa);
+	}
+	destroy_cmpctrl(cc);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_sparse_set);
+	RUN_TEST(test_init_pikevm);
+	RUN_TEST(test_pikevm_match);
+	RUN_TEST(test_position_vm_match);
+
+	return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include <stdbool.h>
+
+#include "../../unity/unity.h"
+#include "ast.h"
+#include "charset.h"
+#include "common.h"
+#include "utf8.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// number of sequences that match @bytes
+static int count_matches(Utf8Sequence *seqs, int n, U8 *bytes, int len)
+{
+	int matches = 0;
+	bool match;
+	for (int i = 0; i < n; i++) {
+		if (seqs[i].len != len)
+			continue;
+		match = true;
+		for (int j = 0; j < len && match; j++) {
+			match = seqs[i].ranges[j].lo <= bytes[j] &&
+			        bytes[j] <= seqs[i].ranges[j].hi;
+		}
+		matches += match;
+	}
+	return matches;
+}
+
+// every char in [lo, hi] must match exactly one sequence, and no other
+// char near the range can match any
+static void check_sequences(U32 lo, U32 hi)
+{
+	Utf8Sequence seqs[UTF8_MAX_SEQUENCES];
+	int n = utf8_sequences(lo, hi, seqs);
+	TEST_ASSERT_TRUE(n >= 1);
+	TEST_ASSERT_TRUE(n <= UTF8_MAX_SEQUENCES);
+
+	U8 bytes[UTF8_MAX_BYTES];
+	int len;
+	U32 begin = lo > 0x1000 ? lo - 0x1000 : 0;
+	U32 end = hi + 0x1000 < UTF8_MAX_CODEPOINT ? hi + 0x1000
+	                                           : UTF8_MAX_CODEPOINT;
+	for (U32 cp = begin; cp <= end; cp++) {
+		if (cp >= 0xD800 && cp <= 0xDFFF)
+			continue;
+		len = utf8_encode(cp, bytes);
+		TEST_ASSERT_EQUAL_INT(lo <= cp && cp <= hi,
+		                      count_matches(seqs, n, bytes, len));
+		// skip the middle of huge ranges
+		if (cp == lo + 0x2000 && hi > lo + 0x4000)
+			cp = hi - 0x2000;
+	}
+}
+
+void test_encode(void)
+{
+	U8 bytes[UTF8_MAX_BYTES];
+	TEST_ASSERT_EQUAL_INT(1, utf8_encode('a', bytes));
+	TEST_ASSERT_EQUAL_HEX8('a', bytes[0]);
+	// α
+	TEST_ASSERT_EQUAL_INT(2, utf8_encode(0x3B1, bytes));
+	TEST_ASSERT_EQUAL_HEX8(0xCE, bytes[0]);
+	TEST_ASSERT_EQUAL_HEX8(0xB1, bytes[1]);
+	// €
+	TEST_ASSERT_EQUAL_INT(3, utf8_encode(0x20AC, bytes));
+	TEST_ASSERT_EQUAL_HEX8(0xE2, bytes[0]);
+	TEST_ASSERT_EQUAL_HEX8(0x82, bytes[1]);
+	TEST_ASSERT_EQUAL_HEX8(0xAC, bytes[2]);
+	TEST_ASSERT_EQUAL_INT(4, utf8_encode(UTF8_MAX_CODEPOINT, bytes));
+	TEST_ASSERT_EQUAL_HEX8(0xF4, bytes[0]);
+	TEST_ASSERT_EQUAL_HEX8(0x8F, bytes[1]);
+	TEST_ASSERT_EQUAL_HEX8(0xBF, bytes[2]);
+	TEST_ASSERT_EQUAL_HEX8(0xBF, bytes[3]);
+
+	TEST_ASSERT_EQUAL_INT(1, utf8_length('a'));
+	TEST_ASSERT_EQUAL_INT(2, utf8_length(0xCE));
+	TEST_ASSERT_EQUAL_INT(3, utf8_length(0xE2));
+	TEST_ASSERT_EQUAL_INT(4, utf8_length(0xF4));
+	TEST_ASSERT_EQUAL_INT(0, utf8_length(0x80));
+	TEST_ASSERT_EQUAL_INT(0, utf8_length(0xC0));
+	TEST_ASSERT_EQUAL_INT(0, utf8_length(0xF5));
+	TEST_ASSERT_TRUE(utf8_is_continuation(0xBF));
+	TEST_ASSERT_FALSE(utf8_is_continuation(0xC0));
+
+	TEST_ASSERT_TRUE(utf8_is_valid(0x3B1, 2));
+	TEST_ASSERT_FALSE(utf8_is_valid(0x3B1, 3));  // overlong
+	TEST_ASSERT_FALSE(utf8_is_valid(0xD800, 3));  // surrogate
+	TEST_ASSERT_FALSE(utf8_is_valid(0x110000, 4));
+}
+
+void test_sequences(void)
+{
+	Utf8Sequence seqs[UTF8_MAX_SEQUENCES];
+
+	// [α-ω] is CE [B1-BF] | CF [80-89]
+	TEST_ASSERT_EQUAL_INT(2, utf8_sequences(0x3B1, 0x3C9, seqs));
+	TEST_ASSERT_EQUAL_INT(2, seqs[0].len);
+	TEST_ASSERT_EQUAL_HEX8(0xCE, seqs[0].ranges[0].lo);
+	TEST_ASSERT_EQUAL_HEX8(0xCE, seqs[0].ranges[0].hi);
+	TEST_ASSERT_EQUAL_HEX8(0xB1, seqs[0].ranges[1].lo);
+	TEST_ASSERT_EQUAL_HEX8(0xBF, seqs[0].ranges[1].hi);
+	TEST_ASSERT_EQUAL_HEX8(0xCF, seqs[1].ranges[0].lo);
+	TEST_ASSERT_EQUAL_HEX8(0x80, seqs[1].ranges[1].lo);
+	TEST_ASSERT_EQUAL_HEX8(0x89, seqs[1].ranges[1].hi);
+
+	// every 2 byte char is one sequence
+	TEST_ASSERT_EQUAL_INT(1, utf8_sequences(0x80, 0x7FF, seqs));
+	TEST_ASSERT_EQUAL_HEX8(0xC2, seqs[0].ranges[0].lo);
+	TEST_ASSERT_EQUAL_HEX8(0xDF, seqs[0].ranges[0].hi);
+
+	// everything past ASCII, the surrogates split the 3 byte chars
+	TEST_ASSERT_EQUAL_INT(8, utf8_sequences(0x80, UTF8_MAX_CODEPOINT,
+	                                        seqs));
+	TEST_ASSERT_EQUAL_HEX8(0xED, seqs[3].ranges[0].lo);
+	TEST_ASSERT_EQUAL_HEX8(0x9F, seqs[3].ranges[1].hi);
+
+	const U32 ranges[][2] = {
+		{0, 0}, {0, 0x7F}, {'a', 'z'}, {0x3B1, 0x3C9}, {0x7F, 0x80},
+		{0x4E00, 0x9FA5}, {0xD7FF, 0xE000}, {0x801, 0xFFFE},
+		{0x81, 0x10FFFE}, {0, UTF8_MAX_CODEPOINT}, {0x10000, 0x10000},
+		{0x1F600, 0x1F64F}, {0xFFFF, 0x10000}, {0x7FF, 0xD800}
+	};
+	for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++)
+		check_sequences(ranges[i][0], ranges[i][1]);
+}
+
+void test_utf8_class(void)
+{
+	AST *ast = init_ast();
+	// [α-ω]
+	CodepointRange greek[] = {{0x3B1, 0x3C9}};
+	ASTNode *root = utf8_class(ast, greek, 1);
+	TEST_ASSERT_NOT_NULL(root);
+	TEST_ASSERT_EQUAL_INT(AST_ALT, root->kind);
+	TEST_ASSERT_EQUAL_INT(4, count_positions(root));
+
+	// overlapping and adjacent ranges merge, in any order
+	CodepointRange split[] = {
+		{0x3C0, 0x3C9}, {0x3B1, 0x3B8}, {0x3B5, 0x3BF}
+	};
+	TEST_ASSERT_TRUE(ast_equal(root, utf8_class(ast, split, 3)));
+
+	// the 3 and 4 byte sequences share their continuation bytes, so far
+	// fewer positions than the 26 bytes of the sequences themselves
+	CodepointRange all[] = {{0x80, UTF8_MAX_CODEPOINT}};
+	root = utf8_class(ast, all, 1);
+	TEST_ASSERT_NOT_NULL(root);
+	TEST_ASSERT_TRUE(count_positions(root) < 20);
+
+	// the last bytes are shared, then [E1-EC] and [EE-EF] share a class
+	CodepointRange three_bytes[] = {{0x800, 0xFFFF}};
+	root = utf8_class(ast, three_bytes, 1);
+	TEST_ASSERT_EQUAL_INT(AST_CONCAT, root->kind);
+	TEST_ASSERT_EQUAL_INT(AST_CLASS, root->right->kind);
+	TEST_ASSERT_TRUE(ast_matches(root->right, 0x80));
+	TEST_ASSERT_TRUE(ast_matches(root->right, 0xBF));
+	destroy_ast(ast);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_encode);
+	RUN_TEST(test_sequences);
+	RUN_TEST(test_utf8_class);
+	return UNITY_END();
+}
\ No newline at end of file